@@ -30,6 +30,10 @@ SOFTWARE.
 #include "stdbool.h"
 #include "string.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 
 /* User: change these */
 // 1) Change to correct handler
@@ -47,6 +51,29 @@ SOFTWARE.
 // 3) Timeout of I2C communication
 #define IAM20680HP_I2C_TIMEOUT 100
 
+// 4) Bus backend: 1 uses the STM32 HAL I2C functions in iam20680hp.c. Set to 0 when an other backend
+// provides iam20680hpBusTransmit(), iam20680hpBusReceive() and iam20680hpBusDelay() (e.g. iam20680hp_replay.c)
+#ifndef IAM20680HP_USE_HAL
+#define IAM20680HP_USE_HAL 1
+#endif
+
+// 5) RTOS port of iam20680hp_rtos.c: 0 none (HAL_Delay), 1 CMSIS-RTOS2 (osDelay), 2 POSIX threads (host)
+#ifndef IAM20680HP_RTOS
+#define IAM20680HP_RTOS 0
+#endif
+
+// 6) Bus recovery of iam20680hp_recovery.c (HAL backend): retries with a short timeout, the bus is un-jammed before the 
+// second and later retries. Define IAM20680HP_SCL_PORT/PIN and IAM20680HP_SDA_PORT/PIN to clock out a stuck SDA. 
+// The timeout of a transfer is twice its duration at IAM20680HP_I2C_BUS_HZ plus IAM20680HP_I2C_RETRY_TIMEOUT (ms)
+#ifndef IAM20680HP_RECOVERY
+#define IAM20680HP_RECOVERY 0
+#endif
+#define IAM20680HP_I2C_RETRIES 3
+#define IAM20680HP_I2C_RETRY_TIMEOUT 2
+#ifndef IAM20680HP_I2C_BUS_HZ
+#define IAM20680HP_I2C_BUS_HZ 400000
+#endif
+
 
 //INITIAL CONFIGURATION
 #define SAMPLE_RATE_DIV 0x00                    //Sample rate divider, 0x09 = 1khz/(1+9) = 100hz
@@ -80,6 +107,28 @@ SOFTWARE.
 // Result of WHO_AM_I register, if correct I2C device
 #define IAM20680HP_DEVICE_ID 0xF8
 
+// Bytes per FIFO frame: accel (6), temperature (2), gyro (6)
+#define IAM20680HP_FIFO_FRAME_SIZE 14
+
+// Bytes per FIFO frame with only the accelerometer enabled
+#define IAM20680HP_FIFO_ACCEL_FRAME_SIZE 6
+
+// Self-test (AN-000143): samples averaged with and without excitation, settle time after switching (ms)
+#define IAM20680HP_SELF_TEST_SAMPLES 200
+#define IAM20680HP_SELF_TEST_SETTLE_MS 20
+
+// Bias calibration: maximum number of FiFo drains (chunks) used for the outlier rejection, rejection limit in median absolute deviations
+#define IAM20680HP_CALIB_MAX_CHUNKS 32
+#define IAM20680HP_CALIB_OUTLIER_MAD 4
+
+// FiFo overflow: 0 realigns and keeps the frames in the FiFo, 1 resets the FiFo (FIFO_RST) and discards them
+#define IAM20680HP_FIFO_OVERFLOW_RESET 0
+
+// Drain scheduler: fill level (percent) which counts as near overflow, and the drain interval limits (ms)
+#define IAM20680HP_DRAIN_NEAR_OVERFLOW 85
+#define IAM20680HP_DRAIN_MIN_INTERVAL 1
+#define IAM20680HP_DRAIN_MAX_INTERVAL 1000
+
 #define IAM20680HP_SELF_TEST_X_GYRO 0x00
 #define IAM20680HP_SELF_TEST_Y_GYRO 0x01
 #define IAM20680HP_SELF_TEST_Z_GYRO 0x02
@@ -151,6 +200,7 @@ typedef enum
     IAM20680HP_ERR_NOT_ENABLED,             /**< Device is not enabled */
     IAM20680HP_ERR_DEVICE_ID,               /**< Device ID is not correct */
     IAM20680HP_ERR_EOL,                     /**< End of list */
+    IAM20680HP_ERR_CRC,                     /**< CRC check failed */
 
 } IAM20680HP_err_t;
 
@@ -171,6 +221,23 @@ typedef struct
     uint8_t selfTestZAccel;     /**< Self-test result for the Z-axis accelerometer. */
 } IAM20680HP_selfTest_t;
 
+/*! 
+ * @brief Structure to hold the result of the self-test procedure (AN-000143).
+ *
+ * The ratio is the self-test response (output with minus without self-test excitation) divided by the factory self-test
+ * value calculated from the self-test code. If the self-test code is 0, the ratio is 0 and the absolute limits are used.
+*/
+typedef struct
+{
+    float gyroRatio[3];         /**< Self-test response / factory value for the X, Y and Z-axis gyroscope. */
+    float accelRatio[3];        /**< Self-test response / factory value for the X, Y and Z-axis accelerometer. */
+    int16_t gyroResponse[3];    /**< Self-test response in LSB (250dps) for the X, Y and Z-axis gyroscope. */
+    int16_t accelResponse[3];   /**< Self-test response in LSB (2g) for the X, Y and Z-axis accelerometer. */
+    bool gyroPass[3];           /**< Pass/fail for the X, Y and Z-axis gyroscope (response and offset). */
+    bool accelPass[3];          /**< Pass/fail for the X, Y and Z-axis accelerometer. */
+    bool pass;                  /**< All axes passed. */
+} IAM20680HP_selfTestResult_t;
+
 /*! 
  * @brief Structure to hold the offset for the gyro.
  *
@@ -346,7 +413,129 @@ typedef struct
     IAM20680HP_gyroData_t gyroData;         /**< FIFO data for the gyroscope. */
 } IAM20680HP_fifoData_t;
 
+/*! 
+    * @brief Enum to hold the orientation of the device during the bias calibration (axis along gravity).
+*/
+typedef enum
+{
+    IAM20680HP_X_UP = 0,                    /**< X-axis up (+1g) */
+    IAM20680HP_X_DOWN,                      /**< X-axis down (-1g) */
+    IAM20680HP_Y_UP,                        /**< Y-axis up (+1g) */
+    IAM20680HP_Y_DOWN,                      /**< Y-axis down (-1g) */
+    IAM20680HP_Z_UP,                        /**< Z-axis up (+1g), device flat */
+    IAM20680HP_Z_DOWN,                      /**< Z-axis down (-1g) */
+} IAM20680HP_orientation_t;
+
+/*! 
+    * @brief Structure to hold the result of the bias calibration.
+    *
+    * The offsets are the values written to the offset registers, store them (e.g. in flash) to write them at boot 
+    * with iam20680hpGyroOffsetAdjustment() and iam20680hpAccelerometerOffset().
+*/
+typedef struct
+{
+    IAM20680HP_gyroOffset_t gyroOffset;     /**< Written gyroscope offset registers. */
+    IAM20680HP_accelOffset_t accelOffset;   /**< Written accelerometer offset registers. */
+    float gyroResidual[3];                  /**< Remaining gyroscope bias after calibration in LSB (current full-scale). */
+    float accelResidual[3];                 /**< Remaining accelerometer bias after calibration in LSB (current full-scale). */
+    uint8_t rejectedChunks;                 /**< Number of FiFo drains rejected as outlier (movement). */
+} IAM20680HP_biasCalibration_t;
+
+/*! 
+    * @brief Structure to hold the gap marker of a FiFo drain.
+    *
+    * Frames before the first frame of the drained block are lost. Integrators can compensate with lostFrames / ODR.
+*/
+typedef struct
+{
+    bool overflow;              /**< FiFo overflow interrupt (FIFO_OFLOW_INT) was set. */
+    bool misaligned;            /**< FiFo count was not a multiple of the frame size, the partial frame is discarded. */
+    uint32_t lostFrames;        /**< Estimated number of lost frames, 0 if there is no gap. */
+    uint16_t fifoBytes;         /**< FiFo count at the drain in bytes (for the drain scheduler). */
+    IAM20680HP_intStatus_t intStatus; /**< INT_STATUS read by the drain, the other interrupts are cleared on the device. */
+} IAM20680HP_fifoGap_t;
+
+/*! 
+    * @brief Structure to hold the adaptive FiFo drain scheduler.
+    *
+    * The device has no FiFo watermark interrupt. The scheduler learns the fill rate of the FiFo and returns the time until
+    * the next drain, so the FiFo is drained at the target fill level: as few wakeups as possible without overflow.
+*/
+typedef struct
+{
+    uint16_t fifoSize;          /**< FiFo size in bytes. */
+    uint16_t targetBytes;       /**< Target fill level in bytes. */
+    uint32_t fillRate;          /**< Learned fill rate in bytes per second. */
+    uint32_t intervalMs;        /**< Time until the next drain in ms. */
+    uint32_t minIntervalMs;     /**< Lower limit of the drain interval in ms. */
+    uint32_t maxIntervalMs;     /**< Upper limit of the drain interval in ms. */
+    uint32_t remainingBytes;    /**< Bytes left in the FiFo by the previous drain (maxFrames reached). */
+    uint32_t drains;            /**< Number of drains. */
+    uint32_t emptyDrains;       /**< Number of drains without data (backed off). */
+    uint32_t nearOverflows;     /**< Number of drains above IAM20680HP_DRAIN_NEAR_OVERFLOW percent (tightened). */
+} IAM20680HP_drainScheduler_t;
+
+
+/*! @brief Bus backend: transmits bytes to the device
+ *
+ *  All register access of the driver goes through this function. The first byte is the register address,
+ *  the following bytes (if any) are written to that register and the next ones (auto increment).
+ *
+ *  @param buffer Pointer to the bytes to transmit
+ *  @param size Number of bytes to transmit
+ *  @retval IAM20680HP_OK if the bytes are transmitted
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpBusTransmit(uint8_t *buffer, uint16_t size);
+
+/*! @brief Bus backend: receives bytes from the register selected by the last iam20680hpBusTransmit()
+ *
+ *  @param buffer Pointer to the buffer where the received bytes will be stored
+ *  @param size Number of bytes to receive
+ *  @retval IAM20680HP_OK if the bytes are received
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpBusReceive(uint8_t *buffer, uint16_t size);
+
+/*! @brief Bus backend: blocking delay in milliseconds (HAL_Delay, osDelay with IAM20680HP_RTOS)
+ *
+ *  @param ms Delay in milliseconds
+ */
+void iam20680hpBusDelay(uint32_t ms);
+
+/*! @brief Selects the device for all following calls (two devices on one bus: 0x68 and 0x69)
+ *
+ *  The HAL backend addresses the selected device, other backends can read it with iam20680hpSelectedDevice().
+ *
+ *  @param address I2C address of the device (IAM20680HP_I2C_ADDRESS at start)
+ *  @retval IAM20680HP_OK if the device is selected
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if the address is not 0x68 or 0x69
+ */
+IAM20680HP_err_t iam20680hpSelectDevice(uint8_t address);
+
+/*! @brief Returns the I2C address of the selected device
+ *
+ *  @retval I2C address
+ */
+uint8_t iam20680hpSelectedDevice(void);
+
+/*! @brief Bus backend: keeps the written register values of the selected device (register shadow)
+ *
+ *  Called by the bus backend after a successful write. Reset and self clearing bits are not kept, a device reset 
+ *  (PWR_MGMT_1 DEVICE_RESET) clears the shadow.
+ *
+ *  @param buffer Register address followed by the written bytes (as iam20680hpBusTransmit())
+ *  @param size Number of bytes
+ */
+void iam20680hpShadowRecord(const uint8_t *buffer, uint16_t size);
 
+/*! @brief Reads a register value from the register shadow of the selected device
+ *
+ *  @param reg Register address
+ *  @param value Pointer to the value where the shadowed value will be stored
+ *  @retval true if the register was written since the last reset
+ */
+bool iam20680hpShadowGet(uint8_t reg, uint8_t *value);
 
 /*! @brief Check if the device is connected and is the correct device
  *
@@ -377,6 +566,27 @@ IAM20680HP_err_t iam20680hpResetDevice(void);
  */
 IAM20680HP_err_t iam20680hpReadSelfTestRegisters(IAM20680HP_selfTest_t *selfTest);
 
+/*! @brief Runs the self-test procedure of AN-000143 and checks the result against the factory self-test codes
+ *
+ * The device is set to 1kHz, DLPF 92Hz/99Hz, +/- 250dps and +/- 2g. The FiFo is used to average the samples without and with
+ * self-test excitation (xGyroSelfTest etc. in IAM20680HP_gyroConfig_t and IAM20680HP_accelConfig_t). Limits of the application note:
+ * 
+ * - Gyro: ratio > 0.5 (or response >= 60dps if the code is 0) and offset <= 20dps
+ * 
+ * - Accel: 0.5 < ratio < 1.5 (or 225mg <= response <= 675mg if the code is 0)
+ * 
+ * The configuration is restored afterwards. With 200 samples the test takes about 450ms.
+ *
+ * @param selfTestResult Pointer to the struct IAM20680HP_selfTestResult_t where the result will be stored
+ * @param samples Number of samples to average (IAM20680HP_SELF_TEST_SAMPLES)
+ * @retval IAM20680HP_OK if the self-test is executed, see selfTestResult->pass for the result
+ * @retval IAM20680HP_ERR_INVALID_PARAM if samples is 0
+ * @retval IAM20680HP_ERR_NOT_READY if the FiFo does not deliver the samples
+ * @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ * @note The device has to be stationary during the self-test.
+ */
+IAM20680HP_err_t iam20680hpRunSelfTest(IAM20680HP_selfTestResult_t *selfTestResult, uint16_t samples);
+
 /*! @brief Adjust the gyro offset
  *
  * This function adjusts the gyro offset by writing the offset values to the device or reading the offset values from the device
@@ -757,12 +967,156 @@ IAM20680HP_err_t iam20680hpReadFifoCount(uint16_t *fifoCount);
  */
 IAM20680HP_err_t iam20680hpReadFifoData(IAM20680HP_fifoData_t *fifoData);
 
+/*! @brief Reads all complete frames in the FiFo in one burst. See page 44 of datasheet for more information
+ *
+ * Reads the FiFo count and then up to maxFrames frames in one transaction, directly into fifoData. The frames are decoded 
+ * in place (same conversion as iam20680hpReadFifoData()). Incomplete frames stay in the FiFo.
+ *
+ * @param fifoData Pointer to the array of IAM20680HP_fifoData_t where the frames will be stored
+ * @param maxFrames Number of frames that fit in fifoData
+ * @param framesRead Pointer to the value where the number of read frames will be stored (0 if the FiFo is empty)
+ * @retval IAM20680HP_OK if the FiFo data is read
+ * @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpReadFifoBlock(IAM20680HP_fifoData_t *fifoData, uint16_t maxFrames, uint16_t *framesRead);
+
+/*! @brief Same as iam20680hpReadFifoBlock(), also returns the FiFo count read before the burst (for the drain scheduler)
+ *
+ * @param fifoData Pointer to the array of IAM20680HP_fifoData_t where the frames will be stored
+ * @param maxFrames Number of frames that fit in fifoData
+ * @param framesRead Pointer to the value where the number of read frames will be stored (0 if the FiFo is empty)
+ * @param fifoCount Pointer to the value where the FiFo count in bytes will be stored
+ * @retval IAM20680HP_OK if the FiFo data is read
+ * @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpReadFifoBlockWithCount(IAM20680HP_fifoData_t *fifoData, uint16_t maxFrames, uint16_t *framesRead, uint16_t *fifoCount);
+
+/*! @brief Reads all complete accelerometer frames in the FiFo in one burst (only ACCEL_FIFO_EN set in FIFO_EN)
+ *
+ * Same as iam20680hpReadFifoBlock() for 6 byte frames, for high rate accelerometer streams.
+ *
+ * @param accelData Pointer to the array of IAM20680HP_accelData_t where the frames will be stored
+ * @param maxSamples Number of frames that fit in accelData
+ * @param samplesRead Pointer to the value where the number of read frames will be stored (0 if the FiFo is empty)
+ * @retval IAM20680HP_OK if the FiFo data is read
+ * @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpReadFifoAccelBlock(IAM20680HP_accelData_t *accelData, uint16_t maxSamples, uint16_t *samplesRead);
+
+/*! @brief Same as iam20680hpReadFifoAccelBlock(), also returns the FiFo count read before the burst (for the drain scheduler)
+ *
+ * @param accelData Pointer to the array of IAM20680HP_accelData_t where the frames will be stored
+ * @param maxSamples Number of frames that fit in accelData
+ * @param samplesRead Pointer to the value where the number of read frames will be stored (0 if the FiFo is empty)
+ * @param fifoCount Pointer to the value where the FiFo count in bytes will be stored
+ * @retval IAM20680HP_OK if the FiFo data is read
+ * @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpReadFifoAccelBlockWithCount(IAM20680HP_accelData_t *accelData, uint16_t maxSamples, uint16_t *samplesRead,
+                                                       uint16_t *fifoCount);
+
+/*! @brief Resets the FiFo (FIFO_RST in USER_CTRL), FIFO_EN is kept
+ *
+ * @retval IAM20680HP_OK if the FiFo is reset
+ * @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpFifoReset(void);
+
+/*! @brief Reads all complete frames in the FiFo in one burst, with overflow detection and resynchronisation
+ *
+ * Same as iam20680hpReadFifoBlock(), but first reads INT_STATUS. After an overflow (FIFO_OFLOW_INT) or when the FiFo count is not 
+ * a multiple of the frame size, the partial frame at the head of the FiFo is discarded so the frames are aligned again
+ * (or the FiFo is reset when IAM20680HP_FIFO_OVERFLOW_RESET is 1). The gap marker tells how many frames are lost before the block.
+ *
+ * @param fifoData Pointer to the array of IAM20680HP_fifoData_t where the frames will be stored
+ * @param maxFrames Number of frames that fit in fifoData
+ * @param framesRead Pointer to the value where the number of read frames will be stored
+ * @param odrHz Output data rate in Hz, to estimate the lost frames (see iam20680hpReadOutputDataRate())
+ * @param elapsedMs Time since the previous drain in ms, to estimate the lost frames
+ * @param gap Pointer to the struct IAM20680HP_fifoGap_t where the gap marker will be stored
+ * @retval IAM20680HP_OK if the FiFo data is read
+ * @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ * @note Reading INT_STATUS clears all interrupt status bits (see iam20680hpIntStatus()), also WOM_INT and DATA_RDY_INT. 
+ *       They are passed on in gap->intStatus; an application that polls INT_STATUS itself uses these instead.
+ */
+IAM20680HP_err_t iam20680hpReadFifoBlockWithGap(IAM20680HP_fifoData_t *fifoData, uint16_t maxFrames, uint16_t *framesRead,
+                                                uint16_t odrHz, uint32_t elapsedMs, IAM20680HP_fifoGap_t *gap);
+
+/*! @brief Initialises the adaptive FiFo drain scheduler
+ *
+ * The initial fill rate is calculated from the output data rate and the frame size, and is learned during the drains.
+ *
+ * @param scheduler Pointer to the struct IAM20680HP_drainScheduler_t
+ * @param odrHz Output data rate in Hz, see iam20680hpReadOutputDataRate()
+ * @param frameSize Bytes per FiFo frame
+ * @param fifoSize FiFo size in bytes (512, 1024, 2048 or 4096, see iam20680hpAccelConfig())
+ * @param targetFill Target fill level at the next drain in percent (1 - IAM20680HP_DRAIN_NEAR_OVERFLOW)
+ * @retval IAM20680HP_OK if the scheduler is initialised
+ * @retval IAM20680HP_ERR_INVALID_PARAM if the parameter is invalid
+ */
+IAM20680HP_err_t iam20680hpDrainSchedulerInit(IAM20680HP_drainScheduler_t *scheduler, uint16_t odrHz, uint16_t frameSize, uint16_t fifoSize, uint8_t targetFill);
+
+/*! @brief Initialises the adaptive FiFo drain scheduler with the output data rate and FiFo size of the device
+ *
+ * @param scheduler Pointer to the struct IAM20680HP_drainScheduler_t
+ * @param targetFill Target fill level at the next drain in percent (1 - IAM20680HP_DRAIN_NEAR_OVERFLOW)
+ * @retval IAM20680HP_OK if the scheduler is initialised
+ * @retval IAM20680HP_ERR_INVALID_PARAM if the parameter is invalid
+ * @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpDrainSchedulerInitFromDevice(IAM20680HP_drainScheduler_t *scheduler, uint8_t targetFill);
+
+/*! @brief Updates the drain scheduler after a drain
+ *
+ * Learns the fill rate from the FiFo count (minus what the previous drain left in the FiFo), backs off after an empty drain 
+ * and tightens after a drain near overflow. A drain limited by the buffer size therefore does not lower the learned rate.
+ *
+ * Called once per drain, also for an empty one (fifoBytes 0). A failed read is not a drain and is not passed on. Callers: 
+ * iam20680hpDrainSchedulerDrain(), iam20680hpDrainSchedulerUpdateWithGap() (RTOS task, dual sensors) and the low power 
+ * accelerometer drain, which passes the FiFo size for both after an overflow reset.
+ *
+ * @param scheduler Pointer to the struct IAM20680HP_drainScheduler_t
+ * @param fifoBytes FiFo count at the drain in bytes (see iam20680hpReadFifoBlockWithCount())
+ * @param readBytes Bytes taken out of the FiFo: frames read * frame size, plus discarded bytes (fifoBytes after a FiFo reset)
+ * @param elapsedMs Time since the previous drain in ms
+ * @return Time until the next drain in ms (to arm the timer)
+ */
+uint32_t iam20680hpDrainSchedulerUpdate(IAM20680HP_drainScheduler_t *scheduler, uint32_t fifoBytes, uint32_t readBytes, uint32_t elapsedMs);
+
+/*! @brief Updates the drain scheduler after a drain with iam20680hpReadFifoBlockWithGap()
+ *
+ * The discarded partial frame (misaligned) and, with IAM20680HP_FIFO_OVERFLOW_RESET, the frames of the reset FiFo count as 
+ * taken out, so the next drain learns the fill rate from the new frames only.
+ *
+ * @param scheduler Pointer to the struct IAM20680HP_drainScheduler_t
+ * @param gap Pointer to the gap marker of the drain
+ * @param framesRead Number of frames read by the drain
+ * @param elapsedMs Time since the previous drain in ms
+ * @return Time until the next drain in ms (to arm the timer)
+ */
+uint32_t iam20680hpDrainSchedulerUpdateWithGap(IAM20680HP_drainScheduler_t *scheduler, const IAM20680HP_fifoGap_t *gap, uint16_t framesRead,
+                                               uint32_t elapsedMs);
+
+/*! @brief Drains the FiFo with iam20680hpReadFifoBlock() and updates the drain scheduler
+ *
+ * @param scheduler Pointer to the struct IAM20680HP_drainScheduler_t
+ * @param fifoData Pointer to the array of IAM20680HP_fifoData_t where the frames will be stored, should fit a full FiFo
+ * @param maxFrames Number of frames that fit in fifoData
+ * @param elapsedMs Time since the previous drain in ms
+ * @param framesRead Pointer to the value where the number of read frames will be stored
+ * @param nextDrainMs Pointer to the value where the time until the next drain in ms will be stored
+ * @retval IAM20680HP_OK if the FiFo is drained
+ * @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpDrainSchedulerDrain(IAM20680HP_drainScheduler_t *scheduler, IAM20680HP_fifoData_t *fifoData, uint16_t maxFrames,
+                                               uint32_t elapsedMs, uint16_t *framesRead, uint32_t *nextDrainMs);
+
 //TODO -  FiFo write functions not implemented yet
 
 /*! @brief Reads or writes the Accelerometer Offset data. See page 45 of datasheet for more information
  *
  * ±16g Offset cancellation in all Full-Scale modes, 15 bit 0.98-mg steps. The offset cancellation is performed by adding 
- * the offset value from the sensor data.
+ * the offset value from the sensor data. The reserved bit 0 of the low registers is preserved.
  * 
  * @param offSet Pointer to the struct IAM20680HP_accelOffset_t where the accelerometer offset values will be stored
  * @param writeConfig If true, the accelerometer offset values will be written to the device, if false, the accelerometer offset values will be read from the device
@@ -771,6 +1125,59 @@ IAM20680HP_err_t iam20680hpReadFifoData(IAM20680HP_fifoData_t *fifoData);
  */
 IAM20680HP_err_t iam20680hpAccelerometerOffset(IAM20680HP_accelOffset_t *offSet, bool writeConfig);
 
+/*! @brief Calibrates the gyro and accelerometer bias with the offset registers
+ *
+ * Captures samples frames (1kHz) from the FiFo while the device is stationary, calculates the bias per axis (FiFo drains with 
+ * an outlier mean are rejected), converts it to the units of XG_OFFS_USR (4 / 2^FS_SEL LSB) and XA_OFFSET (0.98mg, 15 bit, 
+ * bit 0 preserved) for the current full-scale, writes the offsets and verifies the residual bias with samples / 2 frames.
+ * The configuration is restored afterwards, also after an error; after a failed offset write or verification the offsets 
+ * of before the calibration are written back. With 250 samples the calibration takes about 400ms.
+ *
+ * @param calibration Pointer to the struct IAM20680HP_biasCalibration_t where the offsets and residuals will be stored
+ * @param orientation Axis along gravity during the calibration
+ * @param samples Number of samples to average
+ * @retval IAM20680HP_OK if the calibration is executed
+ * @retval IAM20680HP_ERR_INVALID_PARAM if the parameter is invalid
+ * @retval IAM20680HP_ERR_NOT_READY if the FiFo does not deliver the samples
+ * @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpCalibrateBias(IAM20680HP_biasCalibration_t *calibration, IAM20680HP_orientation_t orientation, uint16_t samples);
+
+/*! @brief Averages accel and gyro data captured from the FiFo in the current full-scale
+ *
+ *  Same capture as iam20680hpCalibrateBias() (1kHz, FiFo drains with an outlier mean are rejected) without changing the 
+ *  offset registers. The configuration is restored afterwards, also after an error. The device must be stationary.
+ *
+ *  @param samples Number of samples to average
+ *  @param accel Pointer to 3 floats where the average accelerometer data (LSB) will be stored
+ *  @param gyro Pointer to 3 floats where the average gyroscope data (LSB) will be stored
+ *  @param rejectedChunks Pointer where the number of rejected FiFo drains will be stored, NULL to use all drains
+ *  @retval IAM20680HP_OK if the data is captured
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if the parameter is invalid
+ *  @retval IAM20680HP_ERR_NOT_READY if the FiFo does not deliver the samples
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpCaptureAverage(uint16_t samples, float *accel, float *gyro, uint8_t *rejectedChunks);
+
+/*! @brief Calculates the CRC-16/CCITT-FALSE (polynomial 0x1021, init 0xFFFF), used by the log and calibration formats
+ *
+ * @param buffer Pointer to the bytes
+ * @param size Number of bytes
+ * @return CRC of the bytes
+ */
+uint16_t iam20680hpCrc16(const uint8_t *buffer, size_t size);
+
+/*! @brief Reads the output data rate (FiFo rate) of the device
+ *
+ * Calculated from CONFIG, GYRO_CONFIG and SMPLRT_DIV, see table 17 of the datasheet: 32kHz when the DLPF is bypassed (FChoice_B),
+ * 8kHz for DLPF_CFG 0 or 7, otherwise 1kHz / (1 + SMPLRT_DIV).
+ *
+ * @param odrHz Pointer to the value where the output data rate in Hz will be stored
+ * @retval IAM20680HP_OK if the output data rate is read
+ * @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpReadOutputDataRate(uint16_t *odrHz);
+
 /*! @brief Initialises the device with the standard settings
  *
  * @note Sometimes it is wise to disable (HAL_NVIC_DisableIRQ) the IRQ function and clear pending IRQs (NVIC_ClearPendingIRQ) before 
@@ -795,4 +1202,8 @@ IAM20680HP_err_t iam20680hpEnableWomModeFunction(void);
  */
 IAM20680HP_err_t iam20680hpDisableWomModeFunction(void);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // IAM20680HP_H
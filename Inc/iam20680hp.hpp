@@ -0,0 +1,483 @@
+/*
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#ifndef IAM20680HP_HPP_
+#define IAM20680HP_HPP_
+
+#include "iam20680hp.h"
+#include "iam20680hp_config.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/* 
+ * Header-only C++17 layer over iam20680hp.h:
+ * - Registers and fields are types (e.g. GyroConfig::FsSel) built from the IAM20680HP_* addresses and the bit masks of 
+ *   iam20680hp.c. A write to a read-only register or outside the write mask of a register does not compile.
+ * - Iam20680hp<Transport> reads and writes them through any transport with write(buffer, size) (register address first), 
+ *   read(buffer, size) and delay(ms). BusTransport uses the bus backend of the C driver (iam20680hpBusTransmit()/Receive()).
+ * - The FiFo is read in bursts into a Span of the caller, without copies or allocations. The bus traffic is the same 
+ *   as with the C functions.
+ */
+
+namespace iam20680hp
+{
+
+/*! 
+ * @brief Register at an address, with the bits which can be written (0: read-only).
+*/
+template <uint8_t Address, uint8_t WriteMask = 0xFF>
+struct Register
+{
+    static constexpr uint8_t address = Address;
+    static constexpr uint8_t writeMask = WriteMask;
+    static constexpr bool writable = WriteMask != 0;
+};
+
+/*! 
+ * @brief Field of a register: the bits of Mask, the value is shifted to bit 0.
+*/
+template <typename Reg, uint8_t Mask>
+struct Field
+{
+    using reg = Reg;
+    static constexpr uint8_t mask = Mask;
+    static constexpr uint8_t shift = (Mask & 0x01) ? 0 : (Mask & 0x02) ? 1 : (Mask & 0x04) ? 2 : (Mask & 0x08) ? 3 :
+                                     (Mask & 0x10) ? 4 : (Mask & 0x20) ? 5 : (Mask & 0x40) ? 6 : 7;
+    static constexpr uint8_t max = Mask >> shift;
+    static_assert(Mask != 0, "Field without bits");
+
+    static constexpr uint8_t encode(uint8_t value) { return static_cast<uint8_t>((value << shift) & Mask); }
+    static constexpr uint8_t decode(uint8_t value) { return static_cast<uint8_t>((value & Mask) >> shift); }
+};
+
+// Registers, e.g. reg::GyroConfig::FsSel
+namespace reg
+{
+
+using SmplrtDiv = Register<IAM20680HP_SMPLRT_DIV>;
+
+struct Config : Register<IAM20680HP_CONFIG, 0x7F>
+{
+    using FifoMode = Field<Config, 0x40>;
+    using ExtSyncSet = Field<Config, 0x38>;
+    using DlpfCfg = Field<Config, 0x07>;
+};
+
+struct GyroConfig : Register<IAM20680HP_GYRO_CONFIG, 0xFB>
+{
+    using XgSt = Field<GyroConfig, 0x80>;
+    using YgSt = Field<GyroConfig, 0x40>;
+    using ZgSt = Field<GyroConfig, 0x20>;
+    using FsSel = Field<GyroConfig, 0x18>;
+    using FChoiceB = Field<GyroConfig, 0x03>;
+};
+
+struct AccelConfig : Register<IAM20680HP_ACCEL_CONFIG, 0xF8>
+{
+    using XaSt = Field<AccelConfig, 0x80>;
+    using YaSt = Field<AccelConfig, 0x40>;
+    using ZaSt = Field<AccelConfig, 0x20>;
+    using FsSel = Field<AccelConfig, 0x18>;
+};
+
+struct AccelConfig2 : Register<IAM20680HP_ACCEL_CONFIG2>
+{
+    using FifoSize = Field<AccelConfig2, 0xC0>;
+    using Dec2Cfg = Field<AccelConfig2, 0x30>;
+    using FChoiceB = Field<AccelConfig2, 0x08>;
+    using DlpfCfg = Field<AccelConfig2, 0x07>;
+};
+
+struct LpModeCfg : Register<IAM20680HP_LP_MODE_CFG>
+{
+    using GyroCycle = Field<LpModeCfg, 0x80>;
+    using GAvgCfg = Field<LpModeCfg, 0x70>;
+    using LpOdr = Field<LpModeCfg, 0x0F>;
+};
+
+using AccelWomThr = Register<IAM20680HP_ACCEL_WOM_THR>;
+
+struct FifoEn : Register<IAM20680HP_FIFO_EN, 0xF8>
+{
+    using Temp = Field<FifoEn, 0x80>;
+    using Xg = Field<FifoEn, 0x40>;
+    using Yg = Field<FifoEn, 0x20>;
+    using Zg = Field<FifoEn, 0x10>;
+    using Accel = Field<FifoEn, 0x08>;
+};
+
+struct FsyncInt : Register<IAM20680HP_FSYNC_INT, 0x00>
+{
+    using Int = Field<FsyncInt, 0x80>;
+};
+
+struct IntPinCfg : Register<IAM20680HP_INT_PIN_CFG, 0xFC>
+{
+    using IntLevel = Field<IntPinCfg, 0x80>;
+    using IntOpen = Field<IntPinCfg, 0x40>;
+    using LatchIntEn = Field<IntPinCfg, 0x20>;
+    using IntRdClear = Field<IntPinCfg, 0x10>;
+    using FsyncIntLevel = Field<IntPinCfg, 0x08>;
+    using FsyncIntModeEn = Field<IntPinCfg, 0x04>;
+};
+
+struct IntEnable : Register<IAM20680HP_INT_ENABLE, 0xF5>
+{
+    using WomIntEn = Field<IntEnable, 0xE0>;
+    using FifoOflowEn = Field<IntEnable, 0x10>;
+    using GdriveIntEn = Field<IntEnable, 0x04>;
+    using DataRdyEn = Field<IntEnable, 0x01>;
+};
+
+struct IntStatus : Register<IAM20680HP_INT_STATUS, 0x00>
+{
+    using WomInt = Field<IntStatus, 0xE0>;
+    using FifoOflowInt = Field<IntStatus, 0x10>;
+    using GdriveInt = Field<IntStatus, 0x04>;
+    using DataRdyInt = Field<IntStatus, 0x01>;
+};
+
+struct SignalPathReset : Register<IAM20680HP_SIGNAL_PATH_RESET, 0x03>
+{
+    using Accel = Field<SignalPathReset, 0x02>;
+    using Temp = Field<SignalPathReset, 0x01>;
+};
+
+struct AccelIntelCtrl : Register<IAM20680HP_ACCEL_INTEL_CTRL, 0xC0>
+{
+    using En = Field<AccelIntelCtrl, 0x80>;
+    using Mode = Field<AccelIntelCtrl, 0x40>;
+};
+
+struct UserCtrl : Register<IAM20680HP_USER_CTRL, 0x55>
+{
+    using FifoEn = Field<UserCtrl, 0x40>;
+    using I2cIfDis = Field<UserCtrl, 0x10>;
+    using FifoRst = Field<UserCtrl, 0x04>;
+    using SigCondRst = Field<UserCtrl, 0x01>;
+};
+
+struct PwrMgmt1 : Register<IAM20680HP_PWR_MGMT_1>
+{
+    using DeviceReset = Field<PwrMgmt1, 0x80>;
+    using Sleep = Field<PwrMgmt1, 0x40>;
+    using Cycle = Field<PwrMgmt1, 0x20>;
+    using GyroStandby = Field<PwrMgmt1, 0x10>;
+    using TempDis = Field<PwrMgmt1, 0x08>;
+    using Clksel = Field<PwrMgmt1, 0x07>;
+};
+
+struct PwrMgmt2 : Register<IAM20680HP_PWR_MGMT_2, 0xBF>
+{
+    using FifoLpEn = Field<PwrMgmt2, 0x80>;
+    using StbyXa = Field<PwrMgmt2, 0x20>;
+    using StbyYa = Field<PwrMgmt2, 0x10>;
+    using StbyZa = Field<PwrMgmt2, 0x08>;
+    using StbyXg = Field<PwrMgmt2, 0x04>;
+    using StbyYg = Field<PwrMgmt2, 0x02>;
+    using StbyZg = Field<PwrMgmt2, 0x01>;
+};
+
+using FifoCountH = Register<IAM20680HP_FIFO_COUNTH, 0x00>;
+using FifoRW = Register<IAM20680HP_FIFO_R_W, 0x00>;
+using WhoAmI = Register<IAM20680HP_WHO_AM_I, 0x00>;
+
+} // namespace reg
+
+/*! 
+ * @brief View on an array of the caller (as std::span of C++20).
+*/
+template <typename T>
+class Span
+{
+public:
+    constexpr Span(T *data, size_t size) : data_(data), size_(size) {}
+
+    template <size_t N>
+    constexpr Span(T (&array)[N]) : data_(array), size_(N) {}
+
+    template <typename Container>
+    constexpr Span(Container &container) : data_(container.data()), size_(container.size()) {}
+
+    constexpr T *data() const { return data_; }
+    constexpr size_t size() const { return size_; }
+    constexpr T *begin() const { return data_; }
+    constexpr T *end() const { return data_ + size_; }
+    constexpr T &operator[](size_t i) const { return data_[i]; }
+
+private:
+    T *data_;
+    size_t size_;
+};
+
+/*! 
+ * @brief Transport over the bus backend of the C driver (HAL, replay, bus scheduler, recovery and shadow included).
+*/
+struct BusTransport
+{
+    IAM20680HP_err_t write(const uint8_t *buffer, uint16_t size)
+    {
+        // The backend takes a writable buffer, the bytes are copied (longest write is the register image of Config)
+        uint8_t copy[8];
+        if (size > sizeof(copy))
+            return IAM20680HP_ERR_INVALID_PARAM;
+        for (uint16_t i = 0; i < size; i++)
+            copy[i] = buffer[i];
+        return iam20680hpBusTransmit(copy, size);
+    }
+    IAM20680HP_err_t read(uint8_t *buffer, uint16_t size) { return iam20680hpBusReceive(buffer, size); }
+    void delay(uint32_t ms) { iam20680hpBusDelay(ms); }
+};
+
+/*! 
+ * @brief IAM-20680HP on a transport, see the description above.
+*/
+template <typename Transport>
+class Iam20680hp
+{
+public:
+    static_assert(sizeof(IAM20680HP_fifoData_t) == IAM20680HP_FIFO_FRAME_SIZE, "FIFO frames are decoded in place");
+    static_assert(sizeof(IAM20680HP_accelData_t) == IAM20680HP_FIFO_ACCEL_FRAME_SIZE, "FIFO frames are decoded in place");
+
+    explicit Iam20680hp(Transport &transport) : transport_(transport) {}
+
+    /*! @brief Reads registers from Reg on (burst)
+     *
+     *  @param buffer Values of the registers
+     *  @param size Number of registers
+     *  @retval IAM20680HP_OK if the registers are read
+     *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+     */
+    template <typename Reg>
+    IAM20680HP_err_t read(uint8_t *buffer, uint16_t size)
+    {
+        const uint8_t address = Reg::address;
+        if (transport_.write(&address, 1) != IAM20680HP_OK || transport_.read(buffer, size) != IAM20680HP_OK)
+        {
+            return IAM20680HP_ERR_I2C;
+        }
+        return IAM20680HP_OK;
+    }
+
+    /*! @brief Reads a register
+     *
+     *  @param value Value of the register
+     *  @retval IAM20680HP_OK if the register is read
+     *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+     */
+    template <typename Reg>
+    IAM20680HP_err_t read(uint8_t &value)
+    {
+        return read<Reg>(&value, 1);
+    }
+
+    /*! @brief Writes a register, only the bits of the write mask
+     *
+     *  @param value Value of the register
+     *  @retval IAM20680HP_OK if the register is written
+     *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+     */
+    template <typename Reg>
+    IAM20680HP_err_t write(uint8_t value)
+    {
+        static_assert(Reg::writable, "Register is read-only");
+        const uint8_t buffer[2] = {Reg::address, static_cast<uint8_t>(value & Reg::writeMask)};
+        return transport_.write(buffer, 2) != IAM20680HP_OK ? IAM20680HP_ERR_I2C : IAM20680HP_OK;
+    }
+
+    /*! @brief Reads a field
+     *
+     *  @param value Value of the field (shifted to bit 0)
+     *  @retval IAM20680HP_OK if the field is read
+     *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+     */
+    template <typename F>
+    IAM20680HP_err_t get(uint8_t &value)
+    {
+        uint8_t current = 0;
+        IAM20680HP_err_t result = read<typename F::reg>(current);
+        value = F::decode(current);
+        return result;
+    }
+
+    /*! @brief Writes a field, the other bits of the register are read first (read-modify-write)
+     *
+     *  @param value Value of the field (shifted to bit 0)
+     *  @retval IAM20680HP_OK if the field is written
+     *  @retval IAM20680HP_ERR_INVALID_PARAM if the value does not fit in the field
+     *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+     */
+    template <typename F>
+    IAM20680HP_err_t set(uint8_t value)
+    {
+        using Reg = typename F::reg;
+        static_assert((F::mask & ~Reg::writeMask) == 0, "Field is read-only");
+
+        if (value > F::max)
+        {
+            return IAM20680HP_ERR_INVALID_PARAM;
+        }
+
+        uint8_t current = 0;
+        if (F::mask != Reg::writeMask)
+        {
+            IAM20680HP_err_t result = read<Reg>(current);
+            if (result != IAM20680HP_OK)
+                return result;
+        }
+        return write<Reg>(static_cast<uint8_t>((current & ~F::mask) | F::encode(value)));
+    }
+
+    /*! @brief Resets the device, checks WHO_AM_I and writes the register image of Cfg in one burst (as iam20680hpInit())
+     *
+     *  @retval IAM20680HP_OK if the device is initialised
+     *  @retval IAM20680HP_ERR_DEVICE_ID if the WHO_AM_I register is not correct
+     *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+     */
+    template <typename Cfg = DefaultConfig>
+    IAM20680HP_err_t init()
+    {
+        IAM20680HP_err_t result = write<reg::PwrMgmt1>(reg::PwrMgmt1::DeviceReset::encode(1) | reg::PwrMgmt1::Clksel::encode(1));
+        if (result != IAM20680HP_OK)
+            return result;
+        transport_.delay(50);
+
+        uint8_t deviceId;
+        result = read<reg::WhoAmI>(deviceId);
+        if (result != IAM20680HP_OK)
+            return result;
+        if (deviceId != IAM20680HP_DEVICE_ID)
+            return IAM20680HP_ERR_DEVICE_ID;
+
+        return transport_.write(Cfg::image, sizeof(Cfg::image)) != IAM20680HP_OK ? IAM20680HP_ERR_I2C : IAM20680HP_OK;
+    }
+
+    /*! @brief Reads the number of bytes in the FiFo
+     *
+     *  @param count Bytes in the FiFo
+     *  @retval IAM20680HP_OK if the count is read
+     *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+     */
+    IAM20680HP_err_t readFifoCount(uint16_t &count)
+    {
+        uint8_t buffer[2] = {0, 0};
+        IAM20680HP_err_t result = read<reg::FifoCountH>(buffer, 2);
+        count = static_cast<uint16_t>(buffer[0] << 8 | buffer[1]);
+        return result;
+    }
+
+    /*! @brief Reads the complete frames in the FiFo (up to the size of frames) in one burst, as iam20680hpReadFifoBlock()
+     *
+     *  @param frames Buffer of the caller, the frames are decoded in place
+     *  @param framesRead Number of frames read
+     *  @retval IAM20680HP_OK if the frames are read
+     *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+     */
+    IAM20680HP_err_t readFifo(Span<IAM20680HP_fifoData_t> frames, uint16_t &framesRead)
+    {
+        uint8_t *raw = reinterpret_cast<uint8_t *>(frames.data());
+        IAM20680HP_err_t result = readFifoRaw(raw, frames.size(), IAM20680HP_FIFO_FRAME_SIZE, framesRead);
+
+        for (uint16_t i = 0; i < framesRead; i++)
+        {
+            const uint8_t *frame = &raw[i * IAM20680HP_FIFO_FRAME_SIZE];
+            int16_t temperature = static_cast<int16_t>(frame[6] << 8 | frame[7]);
+            IAM20680HP_fifoData_t decoded;
+            decoded.accelData = decodeAccel(frame);
+            decoded.temperature = static_cast<int16_t>(((temperature / 326.8) + 25) * 100);
+            decoded.gyroData.xGyro = static_cast<int16_t>(frame[8] << 8 | frame[9]);
+            decoded.gyroData.yGyro = static_cast<int16_t>(frame[10] << 8 | frame[11]);
+            decoded.gyroData.zGyro = static_cast<int16_t>(frame[12] << 8 | frame[13]);
+            frames[i] = decoded;
+        }
+        return result;
+    }
+
+    /*! @brief Reads the accelerometer samples in the FiFo (accelerometer only) in one burst, as iam20680hpReadFifoAccelBlock()
+     *
+     *  @param samples Buffer of the caller, the samples are decoded in place
+     *  @param samplesRead Number of samples read
+     *  @retval IAM20680HP_OK if the samples are read
+     *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+     */
+    IAM20680HP_err_t readFifoAccel(Span<IAM20680HP_accelData_t> samples, uint16_t &samplesRead)
+    {
+        uint8_t *raw = reinterpret_cast<uint8_t *>(samples.data());
+        IAM20680HP_err_t result = readFifoRaw(raw, samples.size(), IAM20680HP_FIFO_ACCEL_FRAME_SIZE, samplesRead);
+
+        for (uint16_t i = 0; i < samplesRead; i++)
+        {
+            samples[i] = decodeAccel(&raw[i * IAM20680HP_FIFO_ACCEL_FRAME_SIZE]);
+        }
+        return result;
+    }
+
+private:
+    Transport &transport_;
+
+    /*
+     * Reads the complete frames of the FiFo count, up to maxFrames, in one burst into raw
+     */
+    IAM20680HP_err_t readFifoRaw(uint8_t *raw, size_t maxFrames, uint16_t frameSize, uint16_t &framesRead)
+    {
+        uint16_t count;
+        framesRead = 0;
+
+        IAM20680HP_err_t result = readFifoCount(count);
+        if (result != IAM20680HP_OK)
+            return result;
+
+        uint16_t frames = count / frameSize;
+        if (frames > maxFrames)
+        {
+            frames = static_cast<uint16_t>(maxFrames);
+        }
+        if (frames == 0)
+        {
+            return IAM20680HP_OK;
+        }
+
+        result = read<reg::FifoRW>(raw, static_cast<uint16_t>(frames * frameSize));
+        if (result != IAM20680HP_OK)
+            return result;
+
+        framesRead = frames;
+        return IAM20680HP_OK;
+    }
+
+    static IAM20680HP_accelData_t decodeAccel(const uint8_t *frame)
+    {
+        IAM20680HP_accelData_t accel;
+        accel.xAccel = static_cast<int16_t>(frame[0] << 8 | frame[1]);
+        accel.yAccel = static_cast<int16_t>(frame[2] << 8 | frame[3]);
+        accel.zAccel = static_cast<int16_t>(frame[4] << 8 | frame[5]);
+        return accel;
+    }
+};
+
+} // namespace iam20680hp
+
+#endif // IAM20680HP_HPP_
@@ -0,0 +1,181 @@
+/*
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#ifndef IAM20680HP_BUS_H_
+#define IAM20680HP_BUS_H_
+
+#include "iam20680hp.h"
+
+/* 
+ * Shared bus scheduler: the IMU and other devices on the same I2C/SPI peripheral submit register transactions to one queue.
+ * The highest priority runs first (FiFo drains highest), then the earliest deadline, then the order of submission. 
+ * Queued writes to adjacent registers of a device are merged into one burst, identical reads flagged IAM20680HP_BUS_MERGE 
+ * are done once. A reservation for the next FiFo drain (iam20680hpBusReserveDrain()) holds back lower priority transactions 
+ * that would still be on the bus when the drain has to start, also the driver access of an other device. The timeout of a 
+ * transfer follows from its length instead of IAM20680HP_I2C_TIMEOUT. When several tasks submit or run, the lock of the 
+ * settings (e.g. iam20680hpRtosBusLock()) is held while the queue changes and during a transfer, done functions are called 
+ * outside it.
+ *
+ * With IAM20680HP_USE_HAL 0 and IAM20680HP_BUS_BACKEND 1 this file is the bus backend of the driver: every register access 
+ * of the driver becomes a transaction (FiFo registers at IAM20680HP_BUS_PRIORITY_FIFO) and waits until it is done. 
+ * The backend is opt-in: an other backend (e.g. iam20680hp_replay.c) defines the same functions, only one may be linked.
+ */
+
+#ifndef IAM20680HP_BUS_BACKEND
+#define IAM20680HP_BUS_BACKEND 0                //1: provides iam20680hpBusTransmit()/Receive()/Delay() when IAM20680HP_USE_HAL is 0
+#endif
+
+#define IAM20680HP_BUS_QUEUE 16                 //Queued transactions
+#define IAM20680HP_BUS_MERGE_SIZE 32            //Largest merged write (bytes)
+#define IAM20680HP_BUS_PRIORITY_FIFO 7          //Priority of FiFo drains (highest)
+#define IAM20680HP_BUS_PRIORITY_IMU 4           //Priority of other IMU register access
+#define IAM20680HP_BUS_OVERHEAD_BITS 30         //Start, address, stop and repeated start per transfer (bit times)
+
+#define IAM20680HP_BUS_MERGE 0x01               //Transaction flag: identical reads may be done once
+
+/*! 
+ * @brief Function that does a register transfer on the bus (e.g. HAL_I2C_Mem_Write / HAL_I2C_Mem_Read).
+*/
+typedef IAM20680HP_err_t (*IAM20680HP_busTransfer_t)(uint8_t address, uint8_t reg, uint8_t *buffer, uint16_t size, bool read,
+                                                     uint32_t timeoutMs, void *context);
+
+typedef struct IAM20680HP_busTransaction IAM20680HP_busTransaction_t;
+
+/*! 
+ * @brief Function that is called when a transaction is done.
+*/
+typedef void (*IAM20680HP_busDone_t)(IAM20680HP_busTransaction_t *transaction, void *context);
+
+/*! 
+ * @brief Structure to hold a register transaction, owned by the caller until done.
+*/
+struct IAM20680HP_busTransaction
+{
+    uint8_t address;                        /**< I2C address of the device. */
+    uint8_t reg;                            /**< First register. */
+    uint8_t *buffer;                        /**< Bytes to write or buffer for the bytes read. */
+    uint16_t size;                          /**< Number of bytes. */
+    bool read;                              /**< Read (true) or write. */
+    uint8_t priority;                       /**< Priority, higher first. */
+    uint8_t flags;                          /**< IAM20680HP_BUS_... flags. */
+    bool hasDeadline;                       /**< deadlineUs is valid. */
+    uint32_t deadlineUs;                    /**< Time the transaction has to be done (us). */
+    IAM20680HP_busDone_t done;              /**< Called when done (may be NULL). */
+    void *context;                          /**< Context of done. */
+    volatile bool finished;                 /**< Set when done. */
+    volatile IAM20680HP_err_t result;       /**< Result when done. */
+    uint32_t sequence;                      /**< Order of submission (set by iam20680hpBusSubmit()). */
+};
+
+/*! 
+ * @brief Structure to hold the bus settings.
+*/
+typedef struct
+{
+    uint32_t busHz;                         /**< Bus clock (Hz). */
+    IAM20680HP_busTransfer_t transfer;      /**< Transfer function. */
+    uint32_t (*clockUs)(void);              /**< Free running microsecond clock. */
+    void (*delayMs)(uint32_t ms);           /**< Delay (iam20680hpBusDelay() of the backend). */
+    void *context;                          /**< Context of the transfer function. */
+    void (*lock)(bool lock);                /**< Takes (true) or gives back the scheduler lock, NULL with one task. */
+} IAM20680HP_busConfig_t;
+
+/*! 
+ * @brief Structure to hold the bus scheduler.
+*/
+typedef struct
+{
+    IAM20680HP_busConfig_t config;                          /**< Settings. */
+    IAM20680HP_busTransaction_t *queue[IAM20680HP_BUS_QUEUE]; /**< Queued transactions. */
+    uint8_t count;                                          /**< Number of queued transactions. */
+    uint32_t sequence;                                      /**< Next submission number. */
+    bool reserved;                                          /**< A FiFo drain is reserved. */
+    uint8_t reserveAddress;                                 /**< Device of the reserved drain. */
+    uint32_t reserveUs;                                     /**< Latest start of the reserved drain (us). */
+    uint32_t reserveEndUs;                                  /**< End of the reserved drain (us), the reservation expires after it. */
+    uint8_t merge[IAM20680HP_BUS_MERGE_SIZE];               /**< Buffer of a merged write. */
+    uint32_t transfers;                                     /**< Transfers on the bus. */
+    uint32_t merged;                                        /**< Transactions merged into an other transfer. */
+    uint32_t heldBack;                                      /**< Runs stopped for a reserved drain. */
+    uint32_t expired;                                       /**< Reservations that expired without a drain. */
+    uint32_t missedDeadlines;                               /**< Transactions done after their deadline. */
+} IAM20680HP_busScheduler_t;
+
+/*! @brief Initialises the bus scheduler
+ *
+ *  @param scheduler Pointer to the bus scheduler
+ *  @param config Pointer to the settings (copied)
+ *  @retval IAM20680HP_OK if the scheduler is initialised
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if a setting is missing
+ */
+IAM20680HP_err_t iam20680hpBusInit(IAM20680HP_busScheduler_t *scheduler, const IAM20680HP_busConfig_t *config);
+
+/*! @brief Queues a transaction, it is done by iam20680hpBusRun()
+ *
+ *  @param scheduler Pointer to the bus scheduler
+ *  @param transaction Pointer to the transaction (must stay valid until finished)
+ *  @retval IAM20680HP_OK if the transaction is queued
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if the queue is full or the transaction is empty
+ */
+IAM20680HP_err_t iam20680hpBusSubmit(IAM20680HP_busScheduler_t *scheduler, IAM20680HP_busTransaction_t *transaction);
+
+/*! @brief Does the queued transactions in order until the queue is empty or a reserved drain is due
+ *
+ *  @param scheduler Pointer to the bus scheduler
+ *  @retval Number of transfers on the bus
+ */
+uint16_t iam20680hpBusRun(IAM20680HP_busScheduler_t *scheduler);
+
+/*! @brief Reserves the bus for the next FiFo drain
+ *
+ *  The drain is due when the FiFo reaches IAM20680HP_DRAIN_NEAR_OVERFLOW percent, from the fill rate of the drain scheduler. 
+ *  The reservation ends with the next transaction at IAM20680HP_BUS_PRIORITY_FIFO, or expires when no drain came until the 
+ *  estimated end of the drain. Driver access of the same device still runs (it holds the driver the drain needs), driver 
+ *  access of an other device waits.
+ *
+ *  @param scheduler Pointer to the bus scheduler
+ *  @param address I2C address of the device of the FiFo
+ *  @param drain Pointer to the drain scheduler of the FiFo
+ *  @param lastDrainUs Time of the last drain (us)
+ */
+void iam20680hpBusReserveDrain(IAM20680HP_busScheduler_t *scheduler, uint8_t address, const IAM20680HP_drainScheduler_t *drain, 
+                               uint32_t lastDrainUs);
+
+/*! @brief Estimated time of a transfer on the bus
+ *
+ *  @param scheduler Pointer to the bus scheduler
+ *  @param size Number of data bytes
+ *  @param read Read (register address and repeated start) or write
+ *  @retval Time (us)
+ */
+uint32_t iam20680hpBusDuration(const IAM20680HP_busScheduler_t *scheduler, uint16_t size, bool read);
+
+/*! @brief Selects the scheduler used by the driver backend (IAM20680HP_BUS_BACKEND)
+ *
+ *  @param scheduler Pointer to the bus scheduler
+ */
+void iam20680hpBusAttach(IAM20680HP_busScheduler_t *scheduler);
+
+#endif // IAM20680HP_BUS_H_
@@ -0,0 +1,187 @@
+/*
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#ifndef IAM20680HP_CALIB_H_
+#define IAM20680HP_CALIB_H_
+
+#include "iam20680hp.h"
+#include "iam20680hp_tempcomp.h"
+
+/* 
+ * Calibration record: offset registers, scale/misalignment matrices and the temperature model. 
+ * Serialized as a versioned, CRC protected blob of IAM20680HP_CALIB_BLOB_SIZE bytes (little endian) to store in flash.
+ */
+
+#define IAM20680HP_CALIB_VERSION 1
+#define IAM20680HP_CALIB_BLOB_SIZE 96
+#define IAM20680HP_CALIB_MATRIX_ONE 16384       //1.0 in the Q14 matrices
+#define IAM20680HP_CALIB_BLOCK 32               //Frames per block of iam20680hpCalibApply(), deinterleaved on the stack
+
+/*! 
+ * @brief Structure to hold the calibration record.
+*/
+typedef struct
+{
+    IAM20680HP_gyroOffset_t gyroOffset;     /**< Gyroscope offset registers (XG_OFFS_USR). */
+    IAM20680HP_accelOffset_t accelOffset;   /**< Accelerometer offset registers (XA_OFFSET, 15 bit). */
+    int16_t accelMatrix[3][3];              /**< Accelerometer scale and misalignment matrix, Q14 (IAM20680HP_CALIB_MATRIX_ONE = 1.0). */
+    int16_t gyroMatrix[3][3];               /**< Gyroscope scale and misalignment matrix, Q14. */
+    int32_t tempCoefficient[3][3];          /**< Temperature model polynomial, see IAM20680HP_tempComp_t. */
+    int16_t tempReference;                  /**< Reference temperature of the temperature model (celcius * 100). */
+    uint8_t tempOrder;                      /**< Order of the temperature model. */
+    bool tempValid;                         /**< The temperature model is fitted. */
+} IAM20680HP_calibration_t;
+
+/*! 
+ * @brief Structure to hold the captures of the six-position accelerometer calibration.
+*/
+typedef struct
+{
+    float accel[6][3];                      /**< Average accelerometer data (LSB) per IAM20680HP_orientation_t. */
+    IAM20680HP_accelOffset_t accelOffset;   /**< Offset registers during the captures. */
+    uint8_t accelFsSel;                     /**< Accelerometer full-scale during the captures. */
+    uint8_t captured;                       /**< Bit mask of the captured orientations (1 << orientation). */
+    uint8_t rejectedChunks;                 /**< Total number of rejected FiFo drains. */
+} IAM20680HP_sixPosition_t;
+
+/*! @brief Initialises the calibration record: zero offsets, identity matrices and no temperature model
+ *
+ *  @param calibration Pointer to the calibration record
+ */
+void iam20680hpCalibInit(IAM20680HP_calibration_t *calibration);
+
+/*! @brief Reads the offset registers of the device into the calibration record
+ *
+ *  @param calibration Pointer to the calibration record
+ *  @retval IAM20680HP_OK if the offsets are read
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpCalibReadOffsets(IAM20680HP_calibration_t *calibration);
+
+/*! @brief Writes the offset registers of the calibration record to the device
+ *
+ *  One burst for XG_OFFS_USR (0x13 - 0x18) and one for XA_OFFSET (0x77 - 0x7E), see iam20680hpGyroOffsetAdjustment() 
+ *  and iam20680hpAccelerometerOffset(). The XA_OFFSET burst spans the reserved registers 0x79 and 0x7C and bit 0 of 
+ *  the low registers, which are not part of the record, so it is preceded by a read of 0x77 - 0x7E: three 
+ *  transmits and one receive in total. Call after iam20680hpInit().
+ *
+ *  @param calibration Pointer to the calibration record
+ *  @retval IAM20680HP_OK if the offsets are written
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpCalibRestore(const IAM20680HP_calibration_t *calibration);
+
+/*! @brief Copies the fitted polynomial of the temperature model into the calibration record
+ *
+ *  @param calibration Pointer to the calibration record
+ *  @param model Pointer to the temperature model
+ */
+void iam20680hpCalibFromTempComp(IAM20680HP_calibration_t *calibration, const IAM20680HP_tempComp_t *model);
+
+/*! @brief Initialises the temperature model with the polynomial of the calibration record (the bins are empty)
+ *
+ *  @param calibration Pointer to the calibration record
+ *  @param model Pointer to the temperature model
+ */
+void iam20680hpCalibToTempComp(const IAM20680HP_calibration_t *calibration, IAM20680HP_tempComp_t *model);
+
+/*! @brief Serializes the calibration record
+ *
+ *  @param calibration Pointer to the calibration record
+ *  @param buffer Pointer to the output buffer of IAM20680HP_CALIB_BLOB_SIZE bytes
+ */
+void iam20680hpCalibSerialize(const IAM20680HP_calibration_t *calibration, uint8_t *buffer);
+
+/*! @brief Deserializes a calibration record
+ *
+ *  @param buffer Pointer to the blob
+ *  @param size Size of the blob
+ *  @param calibration Pointer to the calibration record where the result will be stored, not changed on an error
+ *  @retval IAM20680HP_OK if the record is deserialized
+ *  @retval IAM20680HP_ERR_EOL if the blob is too small
+ *  @retval IAM20680HP_ERR_NOT_SUPPORTED if the magic or version is not correct (e.g. erased flash)
+ *  @retval IAM20680HP_ERR_CRC if the CRC check failed
+ */
+IAM20680HP_err_t iam20680hpCalibDeserialize(const uint8_t *buffer, size_t size, IAM20680HP_calibration_t *calibration);
+
+/*! @brief Multiplies blocks of 3-axis samples with a Q14 matrix (out = matrix * in), in place with saturation
+ *
+ *  The axes are separate arrays, so the loop vectorizes (host) or maps to multiply-accumulate and saturate (Cortex-M4). 
+ *  The sum of the absolute values of a matrix row must be below 2.0, as guaranteed by iam20680hpCalibSixPositionSolve().
+ *
+ *  @param matrix Q14 matrix
+ *  @param x Pointer to the X-axis samples
+ *  @param y Pointer to the Y-axis samples
+ *  @param z Pointer to the Z-axis samples
+ *  @param count Number of samples
+ */
+void iam20680hpCalibMatrixKernel(const int16_t matrix[3][3], int16_t *restrict x, int16_t *restrict y, int16_t *restrict z, uint16_t count);
+
+/*! @brief Applies the accelerometer and gyroscope matrices of the calibration record to FiFo frames, in place
+ *
+ *  The frames are processed in blocks of IAM20680HP_CALIB_BLOCK with iam20680hpCalibMatrixKernel().
+ *
+ *  @param calibration Pointer to the calibration record
+ *  @param frames Pointer to the frames
+ *  @param count Number of frames
+ */
+void iam20680hpCalibApply(const IAM20680HP_calibration_t *calibration, IAM20680HP_fifoData_t *frames, uint16_t count);
+
+/*! @brief Initialises the six-position accelerometer calibration
+ *
+ *  @param sixPosition Pointer to the six-position captures
+ */
+void iam20680hpCalibSixPositionInit(IAM20680HP_sixPosition_t *sixPosition);
+
+/*! @brief Captures one position of the six-position accelerometer calibration
+ *
+ *  Place the device stationary with the axis of orientation along gravity and call for every orientation (any order). 
+ *  The average is captured with iam20680hpCaptureAverage() in the current accelerometer full-scale.
+ *
+ *  @param sixPosition Pointer to the six-position captures
+ *  @param orientation Axis along gravity
+ *  @param samples Number of samples to average
+ *  @retval IAM20680HP_OK if the position is captured
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if the device is not in the orientation or the full-scale changed between captures
+ *  @retval IAM20680HP_ERR_NOT_READY if the FiFo does not deliver the samples
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpCalibSixPositionCapture(IAM20680HP_sixPosition_t *sixPosition, IAM20680HP_orientation_t orientation, uint16_t samples);
+
+/*! @brief Calculates the accelerometer matrix and offsets from the six captured positions
+ *
+ *  Model: measured = S * true + bias. The columns of S follow from the up/down pairs, the bias is the mean of the six positions. 
+ *  The accelerometer offsets of the record are set to cancel the bias (write them with iam20680hpCalibRestore()) and 
+ *  accelMatrix to the inverse of S. The gyroscope matrix is not changed (needs a rate table).
+ *
+ *  @param sixPosition Pointer to the six-position captures
+ *  @param calibration Pointer to the calibration record where the result will be stored
+ *  @retval IAM20680HP_OK if the calibration is calculated
+ *  @retval IAM20680HP_ERR_NOT_READY if not all six positions are captured
+ *  @retval IAM20680HP_ERR_NOT_CALIBRATED if the result is out of range (e.g. wrong positions)
+ */
+IAM20680HP_err_t iam20680hpCalibSixPositionSolve(const IAM20680HP_sixPosition_t *sixPosition, IAM20680HP_calibration_t *calibration);
+
+#endif // IAM20680HP_CALIB_H_
@@ -0,0 +1,129 @@
+/*
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#ifndef IAM20680HP_CONFIG_H_
+#define IAM20680HP_CONFIG_H_
+
+#include "iam20680hp.h"
+
+/* 
+ * Compile-time configuration:
+ * - The settings of "INITIAL CONFIGURATION" are checked against the datasheet limits when compiling (C11 _Static_assert, 
+ *   C++ static_assert), instead of the range checks of the functions at runtime.
+ * - The register bytes are assembled by the preprocessor, IAM20680HP_INIT_TABLE is the register image SMPLRT_DIV to 
+ *   ACCEL_CONFIG2 which iam20680hpInit() copies from flash and writes in one burst.
+ * - In C++ iam20680hp::Config<...> does the same for any combination of settings (constexpr register image).
+ */
+
+// Register bytes of the settings
+#define IAM20680HP_CONFIG_BYTE(dlpf) ((uint8_t)((dlpf) & 0x07))
+#define IAM20680HP_GYRO_CONFIG_BYTE(fsSel, fChoice) ((uint8_t)((((fsSel) & 0x03) << 3) | ((fChoice) & 0x03)))
+#define IAM20680HP_ACCEL_CONFIG_BYTE(fsSel) ((uint8_t)(((fsSel) & 0x03) << 3))
+#define IAM20680HP_ACCEL_CONFIG2_BYTE(fifoSize, dec2Cfg, fChoice, dlpf) \
+    ((uint8_t)((((fifoSize) & 0x03) << 6) | (((dec2Cfg) & 0x03) << 4) | (((fChoice) & 0x01) << 3) | ((dlpf) & 0x07)))
+
+// Datasheet limits. The sample rate divider only works with the DLPF in use: FCHOICE_B 0 and 0 < DLPF_CFG < 7
+#define IAM20680HP_VALID_DIVIDER(divider, dlpf, fChoice) \
+    ((divider) <= 0xFF && ((divider) == 0 || ((fChoice) == 0 && (dlpf) > 0 && (dlpf) < 7)))
+#define IAM20680HP_VALID_GYRO(fsSel, fChoice, dlpf) ((fsSel) <= 3 && (fChoice) <= 3 && (dlpf) <= 7)
+#define IAM20680HP_VALID_ACCEL(fsSel, fifoSize, dec2Cfg, fChoice, dlpf) \
+    ((fsSel) <= 3 && (fifoSize) <= 3 && (dec2Cfg) <= 3 && (fChoice) <= 1 && (dlpf) <= 7)
+
+// Output data rate (Hz), Table 17 datasheet: 32kHz with FCHOICE_B != 0, 8kHz with DLPF_CFG 0 and 7, otherwise 1kHz divided 
+// by 1 + SMPLRT_DIV. Also used by iam20680hpReadOutputDataRate() for the register values read back
+#define IAM20680HP_OUTPUT_DATA_RATE_HZ(divider, dlpf, fChoice) \
+    ((uint16_t)((fChoice) != 0 ? 32000 : ((dlpf) == 0 || (dlpf) == 7) ? 8000 : 1000 / (1 + (divider))))
+
+// Register image of the initial configuration, SMPLRT_DIV (0x19) to ACCEL_CONFIG2 (0x1D)
+#define IAM20680HP_INIT_TABLE                                                                   \
+    {                                                                                           \
+        IAM20680HP_SMPLRT_DIV,                                                                  \
+        (uint8_t)(SAMPLE_RATE_DIV),                                                             \
+        IAM20680HP_CONFIG_BYTE(LOW_PASS_FILTER_GYRO_DLPF_CFG),                                  \
+        IAM20680HP_GYRO_CONFIG_BYTE(GYRO_FS_SEL, GYRO_FCHOICE),                                 \
+        IAM20680HP_ACCEL_CONFIG_BYTE(ACCEL_FS_SEL),                                             \
+        IAM20680HP_ACCEL_CONFIG2_BYTE(ACCEL_FIFO_SIZE, ACCEL_DEC2_CFG, ACCEL_FCHOICE, ACCEL_DLPF_CFG) \
+    }
+
+#ifdef __cplusplus
+
+namespace iam20680hp
+{
+
+/*! 
+ * @brief Configuration checked and assembled at compile time, image is the register image SMPLRT_DIV to ACCEL_CONFIG2 
+ *        (register address first) as IAM20680HP_INIT_TABLE.
+*/
+template <uint8_t Divider, uint8_t Dlpf, uint8_t GyroFsSel, uint8_t GyroFChoice, uint8_t AccelFsSel, uint8_t FifoSize,
+          uint8_t Dec2Cfg, uint8_t AccelFChoice, uint8_t AccelDlpf>
+struct Config
+{
+    static_assert(IAM20680HP_VALID_DIVIDER(Divider, Dlpf, GyroFChoice), "Sample rate divider needs FCHOICE_B 0 and 0 < DLPF_CFG < 7");
+    static_assert(IAM20680HP_VALID_GYRO(GyroFsSel, GyroFChoice, Dlpf), "Gyro setting out of range");
+    static_assert(IAM20680HP_VALID_ACCEL(AccelFsSel, FifoSize, Dec2Cfg, AccelFChoice, AccelDlpf), "Accel setting out of range");
+
+    static constexpr uint8_t image[6] = {
+        IAM20680HP_SMPLRT_DIV,
+        Divider,
+        IAM20680HP_CONFIG_BYTE(Dlpf),
+        IAM20680HP_GYRO_CONFIG_BYTE(GyroFsSel, GyroFChoice),
+        IAM20680HP_ACCEL_CONFIG_BYTE(AccelFsSel),
+        IAM20680HP_ACCEL_CONFIG2_BYTE(FifoSize, Dec2Cfg, AccelFChoice, AccelDlpf)};
+
+    // Same expression as iam20680hpReadOutputDataRate() for the register values of image
+    static constexpr uint16_t outputDataRateHz = IAM20680HP_OUTPUT_DATA_RATE_HZ(Divider, Dlpf, GyroFChoice);
+};
+
+// Table 17 datasheet
+static_assert(Config<0, 0, 0, 1, 0, 0, 0, 0, 0>::outputDataRateHz == 32000, "FCHOICE_B != 0 runs at 32kHz");
+static_assert(Config<0, 0, 0, 2, 0, 0, 0, 0, 0>::outputDataRateHz == 32000, "FCHOICE_B != 0 runs at 32kHz");
+static_assert(Config<0, 0, 0, 3, 0, 0, 0, 0, 0>::outputDataRateHz == 32000 && Config<0, 0, 0, 3, 0, 0, 0, 0, 0>::image[3] == 0x03,
+              "FCHOICE_B 3 (x1) runs at 32kHz");
+static_assert(Config<0, 0, 0, 0, 0, 0, 0, 0, 0>::outputDataRateHz == 8000, "DLPF_CFG 0 runs at 8kHz");
+static_assert(Config<0, 7, 0, 0, 0, 0, 0, 0, 0>::outputDataRateHz == 8000, "DLPF_CFG 7 runs at 8kHz");
+static_assert(Config<9, 1, 0, 0, 0, 0, 0, 0, 0>::outputDataRateHz == 100, "DLPF_CFG 1 - 6 runs at 1kHz / (1 + SMPLRT_DIV)");
+
+// Settings of iam20680hp.h
+using DefaultConfig = Config<SAMPLE_RATE_DIV, LOW_PASS_FILTER_GYRO_DLPF_CFG, GYRO_FS_SEL, GYRO_FCHOICE, ACCEL_FS_SEL,
+                             ACCEL_FIFO_SIZE, ACCEL_DEC2_CFG, ACCEL_FCHOICE, ACCEL_DLPF_CFG>;
+
+} // namespace iam20680hp
+
+#else
+
+_Static_assert(IAM20680HP_VALID_DIVIDER(SAMPLE_RATE_DIV, LOW_PASS_FILTER_GYRO_DLPF_CFG, GYRO_FCHOICE),
+               "SAMPLE_RATE_DIV needs GYRO_FCHOICE 0 and 0 < LOW_PASS_FILTER_GYRO_DLPF_CFG < 7");
+_Static_assert(IAM20680HP_VALID_GYRO(GYRO_FS_SEL, GYRO_FCHOICE, LOW_PASS_FILTER_GYRO_DLPF_CFG), "Gyro setting out of range");
+_Static_assert(IAM20680HP_VALID_ACCEL(ACCEL_FS_SEL, ACCEL_FIFO_SIZE, ACCEL_DEC2_CFG, ACCEL_FCHOICE, ACCEL_DLPF_CFG),
+               "Accel setting out of range");
+_Static_assert(IAM20680HP_OUTPUT_DATA_RATE_HZ(0, 0, 1) == 32000 && IAM20680HP_OUTPUT_DATA_RATE_HZ(0, 0, 0) == 8000 &&
+               IAM20680HP_OUTPUT_DATA_RATE_HZ(0, 7, 0) == 8000 && IAM20680HP_OUTPUT_DATA_RATE_HZ(9, 1, 0) == 100,
+               "Output data rate differs from Table 17");
+_Static_assert(WOL_THRESHOLD <= 0xFF && ACCEL_AVG_CFG <= 3 && ACCEL_FREQ_WAKEUP <= 11 && ACCEL_INTEL_MODE <= 1,
+               "Wake on motion setting out of range");
+
+#endif
+
+#endif // IAM20680HP_CONFIG_H_
@@ -0,0 +1,162 @@
+/*
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#ifndef IAM20680HP_DSP_H_
+#define IAM20680HP_DSP_H_
+
+#include "iam20680hp.h"
+
+/* 
+ * Multi-stage decimating filter for 3-axis blocks (e.g. gyro at 8kHz or 32kHz down to the application rate). 
+ * A stage is a FIR decimator (only every decimation-th output is calculated) or a biquad cascade with optional decimation.
+ * The axes are separate arrays (X, Y, Z), processed in place; the state is kept between blocks (FiFo drains).
+ * Samples are int16: FIR taps Q15 with 32 bit accumulate, biquad coefficients Q30 (int32) with 64 bit accumulate. The 
+ * biquad feedback state keeps 8 bits below the output LSB and the rounding remainder goes into the next sample (error 
+ * feedback), so low cut-off frequencies with poles close to 1 stay within about 0.5 LSB of the float filter. The FIR 
+ * history is a doubled ring buffer, so the dot product is one contiguous loop.
+ */
+
+#define IAM20680HP_DSP_MAX_STAGES 3         //Stages per filter
+#define IAM20680HP_DSP_MAX_TAPS 32          //Taps per FIR stage
+#define IAM20680HP_DSP_MAX_BIQUADS 4        //Sections per biquad stage
+#ifndef IAM20680HP_DSP_SIMD
+#define IAM20680HP_DSP_SIMD 0               //1: FIR dot product two taps per __SMLAD (Cortex-M4/M7, CMSIS from main.h), same result
+#endif
+
+/*! 
+ * @brief Enum to hold the type of a filter stage.
+*/
+typedef enum
+{
+    IAM20680HP_DSP_FIR = 0,                 /**< FIR decimator, taps Q15. */
+    IAM20680HP_DSP_BIQUAD,                  /**< Biquad cascade (direct form I), coefficients Q30 {b0, b1, b2, a1, a2} per section. */
+} IAM20680HP_dspStageType_t;
+
+/*! 
+ * @brief Structure to hold one filter stage.
+*/
+typedef struct
+{
+    IAM20680HP_dspStageType_t type;                             /**< Type of the stage. */
+    const int16_t *taps;                                        /**< FIR taps (not copied). */
+    const int32_t *biquads;                                     /**< Biquad coefficients (not copied). */
+    uint8_t length;                                             /**< Number of taps or sections. */
+    uint8_t decimation;                                         /**< Decimation factor (1 = none). */
+    uint8_t phase;                                              /**< Input samples since the last output. */
+    uint8_t position;                                           /**< Position in the FIR ring buffer. */
+    int16_t history[3][2 * IAM20680HP_DSP_MAX_TAPS];            /**< FIR ring buffer per axis (doubled). */
+    int32_t state[3][IAM20680HP_DSP_MAX_BIQUADS][5];            /**< Biquad state per axis {x1, x2, y1, y2 (1/256 LSB), remainder Q30}. */
+} IAM20680HP_dspStage_t;
+
+/*! 
+ * @brief Structure to hold a multi-stage filter.
+*/
+typedef struct
+{
+    IAM20680HP_dspStage_t stages[IAM20680HP_DSP_MAX_STAGES];    /**< Stages, processed in order. */
+    uint8_t numStages;                                          /**< Number of stages. */
+} IAM20680HP_dsp_t;
+
+/*! @brief Initialises a filter without stages (pass through)
+ *
+ *  @param filter Pointer to the filter
+ */
+void iam20680hpDspInit(IAM20680HP_dsp_t *filter);
+
+/*! @brief Clears the state of all stages (e.g. after a FiFo overflow)
+ *
+ *  @param filter Pointer to the filter
+ */
+void iam20680hpDspReset(IAM20680HP_dsp_t *filter);
+
+/*! @brief Adds a FIR decimator stage
+ *
+ *  @param filter Pointer to the filter
+ *  @param taps Pointer to the taps (Q15), must stay valid. The sum of the absolute taps must be below 2.0
+ *  @param numTaps Number of taps (1 - IAM20680HP_DSP_MAX_TAPS)
+ *  @param decimation Decimation factor (1 = none)
+ *  @retval IAM20680HP_OK if the stage is added
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if a parameter is invalid or there are no free stages
+ */
+IAM20680HP_err_t iam20680hpDspAddFir(IAM20680HP_dsp_t *filter, const int16_t *taps, uint8_t numTaps, uint8_t decimation);
+
+/*! @brief Adds a biquad cascade stage
+ *
+ *  y = (b0 * x0 + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2) >> 30 per section, y1 and y2 with 8 bits below the LSB and the 
+ *  remainder of the previous sample added.
+ *
+ *  @param filter Pointer to the filter
+ *  @param coefficients Pointer to 5 coefficients (Q30) per section, must stay valid
+ *  @param sections Number of sections (1 - IAM20680HP_DSP_MAX_BIQUADS)
+ *  @param decimation Decimation factor of the output (1 = none)
+ *  @retval IAM20680HP_OK if the stage is added
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if a parameter is invalid or there are no free stages
+ */
+IAM20680HP_err_t iam20680hpDspAddBiquad(IAM20680HP_dsp_t *filter, const int32_t *coefficients, uint8_t sections, uint8_t decimation);
+
+/*! @brief Filters a block of 3-axis samples in place
+ *
+ *  @param filter Pointer to the filter
+ *  @param x Pointer to the X-axis samples
+ *  @param y Pointer to the Y-axis samples
+ *  @param z Pointer to the Z-axis samples
+ *  @param count Number of input samples
+ *  @retval Number of output samples at the start of x, y and z
+ */
+uint16_t iam20680hpDspProcess(IAM20680HP_dsp_t *filter, int16_t *x, int16_t *y, int16_t *z, uint16_t count);
+
+/*! @brief Copies the accel or gyro data of FiFo frames to separate axis arrays
+ *
+ *  @param frames Pointer to the frames
+ *  @param count Number of frames
+ *  @param gyro If true, the gyro data will be copied, if false, the accel data will be copied
+ *  @param x Pointer to the X-axis samples
+ *  @param y Pointer to the Y-axis samples
+ *  @param z Pointer to the Z-axis samples
+ */
+void iam20680hpDspSplitFrames(const IAM20680HP_fifoData_t *frames, uint16_t count, bool gyro, int16_t *x, int16_t *y, int16_t *z);
+
+/*! @brief Designs a low pass FIR (windowed sinc, Hamming, unity DC gain)
+ *
+ *  @param taps Pointer to the output taps (Q15)
+ *  @param numTaps Number of taps (1 - IAM20680HP_DSP_MAX_TAPS)
+ *  @param cutoff Cut-off frequency as a fraction of the input rate (0 - 0.5)
+ *  @retval IAM20680HP_OK if the taps are calculated
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if a parameter is invalid
+ */
+IAM20680HP_err_t iam20680hpDspDesignFir(int16_t *taps, uint8_t numTaps, float cutoff);
+
+/*! @brief Designs a low pass biquad section (RBJ cookbook)
+ *
+ *  @param coefficients Pointer to the 5 output coefficients (Q30)
+ *  @param cutoff Cut-off frequency as a fraction of the input rate (0 - 0.5)
+ *  @param q Quality factor, 0.7071 for Butterworth
+ *  @retval IAM20680HP_OK if the coefficients are calculated
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if a parameter is invalid, a coefficient is out of range or the cut-off is too low 
+ *          for Q30 (b0 rounds to 0, below about 0.00001)
+ */
+IAM20680HP_err_t iam20680hpDspDesignBiquad(int32_t *coefficients, float cutoff, float q);
+
+#endif // IAM20680HP_DSP_H_
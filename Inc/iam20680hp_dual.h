@@ -0,0 +1,142 @@
+/*
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#ifndef IAM20680HP_DUAL_H_
+#define IAM20680HP_DUAL_H_
+
+#include "iam20680hp.h"
+
+/* 
+ * Two sensors on one bus (0x68 and 0x69): the FiFos are drained in turns, each sensor halfway the drain interval of the 
+ * other, so both FiFos stay at a low fill and one drain never waits for the other. The frames are timestamped 
+ * (drain time backwards with the sample period), paired and combined: the average of both (sqrt(2) less noise), the other 
+ * sensor when one is saturated, a fault flag when the sensors disagree.
+ *
+ * Frames are paired by their index since the FiFo reset (both FiFos are reset back to back), frames lost in an overflow 
+ * count, so a drain never shifts the pairs. The timestamps can not pair the frames: the newest frame of a drain is up to 
+ * one period older than the drain time, so the timestamps of the same sample of both sensors differ by up to a period. 
+ * Their difference, tracked over the drains with its change per frame, follows the drift of the sensor clocks: when the 
+ * frames of a pair are more than half a period (and a margin) apart, the pairs move by one frame and a frame of one sensor 
+ * is dropped. The tracking has the noise of the timestamps, near a move the frames of a pair can be about a period apart.
+ *
+ * Configure both sensors the same (iam20680hpSelectDevice() and iam20680hpInit() per sensor) before iam20680hpDualInit().
+ * The drains change the selected device.
+ */
+
+#define IAM20680HP_DUAL_QUEUE 80                //Frames per sensor waiting for a pair, at least the frames at the target fill (59 at 2kB, 117 at 4kB)
+#define IAM20680HP_DUAL_BUS_LOAD 70             //Maximum bus load of both FiFo streams (percent)
+#define IAM20680HP_DUAL_TARGET_FILL 40          //Target FiFo fill at a drain (percent)
+#define IAM20680HP_DUAL_ACCEL_LIMIT 1000        //Largest accel difference between the sensors (LSB)
+#define IAM20680HP_DUAL_GYRO_LIMIT 300          //Largest gyro difference between the sensors (LSB)
+#define IAM20680HP_DUAL_TRACK_ALPHA 16          //Offset gain (1/alpha) of the tracking of the time between the frames of a pair
+#define IAM20680HP_DUAL_TRACK_BETA 512          //Drift gain (1/beta) of the tracking
+#define IAM20680HP_DUAL_SHIFT_MARGIN 8          //Pairs move when their frames are half a period + period / margin apart
+
+#define IAM20680HP_DUAL_FAULT 0x01              //Sample flag: the sensors disagree, the sample is the average
+#define IAM20680HP_DUAL_ONLY_A 0x02             //Sample flag: sensor B saturated, the sample is sensor A
+#define IAM20680HP_DUAL_ONLY_B 0x04             //Sample flag: sensor A saturated, the sample is sensor B
+
+/*! 
+ * @brief Structure to hold a combined sample.
+*/
+typedef struct
+{
+    IAM20680HP_fifoData_t frame;            /**< Combined frame. */
+    uint32_t timestampUs;                   /**< Timestamp (us). */
+    uint8_t flags;                          /**< IAM20680HP_DUAL_... flags. */
+} IAM20680HP_dualSample_t;
+
+/*! 
+ * @brief Function that receives the combined samples.
+*/
+typedef void (*IAM20680HP_dualOutput_t)(const IAM20680HP_dualSample_t *sample, void *context);
+
+/*! 
+ * @brief Structure to hold the dual sensor acquisition.
+*/
+typedef struct
+{
+    uint8_t address[2];                                         /**< I2C address of sensor A and B. */
+    IAM20680HP_drainScheduler_t scheduler[2];                   /**< Drain interval per sensor. */
+    IAM20680HP_fifoData_t queue[2][IAM20680HP_DUAL_QUEUE];      /**< Frames waiting for a pair. */
+    uint32_t queueUs[2][IAM20680HP_DUAL_QUEUE];                 /**< Timestamps of the waiting frames (us). */
+    uint32_t queueIndex[2][IAM20680HP_DUAL_QUEUE];              /**< Index of the waiting frames since the FiFo reset. */
+    uint32_t nextIndex[2];                                      /**< Index of the next frame per sensor. */
+    int32_t shift;                                              /**< Index of sensor B minus index of sensor A of a pair. */
+    int32_t offsetQ8;                                           /**< Tracked time from a frame of B to its partner of A (us, Q8). */
+    int32_t driftQ8;                                            /**< Tracked change of offsetQ8 per frame (us, Q8). */
+    uint32_t trackIndex;                                        /**< Index of sensor A at the last tracking. */
+    uint16_t fill[2];                                           /**< Number of waiting frames. */
+    uint32_t lastDrainUs[2];                                    /**< Time of the previous drain (us). */
+    uint16_t odrHz;                                             /**< Output data rate of both sensors. */
+    uint32_t periodUs;                                          /**< Sample period (us). */
+    uint8_t next;                                               /**< Sensor of the next drain. */
+    int16_t accelLimit;                                         /**< Largest accel difference (LSB). */
+    int16_t gyroLimit;                                          /**< Largest gyro difference (LSB). */
+    IAM20680HP_dualOutput_t output;                             /**< Output function. */
+    void *context;                                              /**< Context of the output function. */
+    uint32_t samples;                                           /**< Combined samples. */
+    uint32_t faults;                                            /**< Samples with IAM20680HP_DUAL_FAULT. */
+    uint32_t unpaired;                                          /**< Frames without a pair (dropped). */
+    uint32_t lostFrames;                                        /**< Frames lost in FiFo overflows. */
+} IAM20680HP_dual_t;
+
+/*! @brief Initialises the dual sensor acquisition and starts both FiFos
+ *
+ *  @param dual Pointer to the dual sensor acquisition
+ *  @param addressA I2C address of sensor A
+ *  @param addressB I2C address of sensor B
+ *  @param busHz Bus clock (e.g. 400000), to check that both FiFo streams fit
+ *  @param output Function that receives the combined samples
+ *  @param context Context of the output function
+ *  @retval IAM20680HP_OK if the acquisition is started
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if the addresses or rates differ, the streams do not fit on the bus or the frames at 
+ *          IAM20680HP_DUAL_TARGET_FILL of the FiFo do not fit IAM20680HP_DUAL_QUEUE
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpDualInit(IAM20680HP_dual_t *dual, uint8_t addressA, uint8_t addressB, uint32_t busHz,
+                                    IAM20680HP_dualOutput_t output, void *context);
+
+/*! @brief Drains the FiFo of the sensor in turn and passes the paired samples on
+ *
+ *  @param dual Pointer to the dual sensor acquisition
+ *  @param timestampUs Time of the drain (us)
+ *  @param nextDrainMs Pointer to the value where the time until the next drain in ms will be stored
+ *  @retval IAM20680HP_OK if the FiFo is drained
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpDualDrain(IAM20680HP_dual_t *dual, uint32_t timestampUs, uint32_t *nextDrainMs);
+
+/*! @brief Pairs and combines frames of both sensors (used by iam20680hpDualDrain())
+ *
+ *  @param dual Pointer to the dual sensor acquisition
+ *  @param sensor Sensor of the frames (0: A, 1: B)
+ *  @param frames Pointer to the frames, the frames that follow the previous call of the sensor
+ *  @param count Number of frames
+ *  @param timestampUs Time of the last frame (us)
+ */
+void iam20680hpDualProcess(IAM20680HP_dual_t *dual, uint8_t sensor, const IAM20680HP_fifoData_t *frames, uint16_t count, uint32_t timestampUs);
+
+#endif // IAM20680HP_DUAL_H_
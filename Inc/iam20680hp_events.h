@@ -0,0 +1,176 @@
+/*
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#ifndef IAM20680HP_EVENTS_H_
+#define IAM20680HP_EVENTS_H_
+
+#include "iam20680hp.h"
+
+/* 
+ * Software event detectors on blocks of FiFo frames: free-fall (low |a|), shock (high |a|), stillness (low gyro variance, 
+ * e.g. for gyro bias updates) and single/double tap (short peak of the sample to sample accel change). 
+ * Every event is passed with the timestamp of its first frame to the output function; the frame timestamps follow from the 
+ * timestamp of the last frame of the block and the ODR. A single tap is reported after the double tap window expired.
+ */
+
+#define IAM20680HP_EVENTS_FREE_FALL_MG 300          //Free-fall below this |a| (mg)
+#define IAM20680HP_EVENTS_FREE_FALL_MS 80           //Minimum free-fall duration (ms), about 3cm drop
+#define IAM20680HP_EVENTS_SHOCK_MG 1800             //Shock above this |a| (mg), use a larger ACCEL_FS_SEL for higher values
+#define IAM20680HP_EVENTS_SHOCK_HOLDOFF_MS 100      //No new shock within this time (ms)
+#define IAM20680HP_EVENTS_STILL_GYRO_LSB 8          //Stillness below this gyro standard deviation (LSB) on all axes
+#define IAM20680HP_EVENTS_STILL_WINDOW_MS 500       //Stillness evaluation window (ms)
+#define IAM20680HP_EVENTS_STILL_MAX_FRAMES 65536    //Largest stillness window (frames), n * sum(x^2) must fit in int64
+#define IAM20680HP_EVENTS_TAP_MG 400                //Tap above this sample to sample change (mg)
+#define IAM20680HP_EVENTS_TAP_DURATION_MS 30        //Maximum duration of a tap (ms)
+#define IAM20680HP_EVENTS_TAP_QUIET_MS 50           //Ignored time after a tap (ms)
+#define IAM20680HP_EVENTS_TAP_WINDOW_MS 300         //Second tap of a double tap within this time (ms)
+
+/*! 
+ * @brief Enum to hold the event types, also used as bit mask (1 << type) to enable the detectors.
+*/
+typedef enum
+{
+    IAM20680HP_EVENT_FREE_FALL = 0,         /**< Free-fall, value: |a| minimum (mg). */
+    IAM20680HP_EVENT_SHOCK,                 /**< Shock, value: |a| peak (mg). */
+    IAM20680HP_EVENT_STILL_START,           /**< Stillness started, value: largest gyro variance (LSB^2). */
+    IAM20680HP_EVENT_STILL_END,             /**< Stillness ended, value: largest gyro variance (LSB^2). */
+    IAM20680HP_EVENT_TAP,                   /**< Single tap, value: peak change (mg). */
+    IAM20680HP_EVENT_DOUBLE_TAP,            /**< Double tap, value: peak change of the second tap (mg). */
+} IAM20680HP_eventType_t;
+
+#define IAM20680HP_EVENTS_ALL 0x3F          //Enable mask with all detectors
+
+/*! 
+ * @brief Structure to hold one event.
+*/
+typedef struct
+{
+    IAM20680HP_eventType_t type;            /**< Event type. */
+    int8_t axis;                            /**< Axis of a tap (0 - 2), -1 for the other events. */
+    int32_t value;                          /**< Value, see IAM20680HP_eventType_t. */
+    uint32_t timestampUs;                   /**< Timestamp of the first frame of the event (us). */
+} IAM20680HP_event_t;
+
+/*! 
+ * @brief Output function, called for every event.
+*/
+typedef void (*IAM20680HP_eventOutput_t)(const IAM20680HP_event_t *event, void *context);
+
+/*! 
+ * @brief Structure to hold the detector settings.
+*/
+typedef struct
+{
+    uint8_t enable;                         /**< Bit mask (1 << IAM20680HP_eventType_t), STILL_START enables both stillness events. */
+    uint16_t freeFallMg;                    /**< Free-fall threshold (mg). */
+    uint16_t freeFallMs;                    /**< Minimum free-fall duration (ms). */
+    uint16_t shockMg;                       /**< Shock threshold (mg). */
+    uint16_t shockHoldoffMs;                /**< Shock hold-off (ms). */
+    uint16_t stillGyroLsb;                  /**< Stillness gyro standard deviation threshold (LSB). */
+    uint16_t stillWindowMs;                 /**< Stillness window (ms). */
+    uint16_t tapMg;                         /**< Tap threshold (mg). */
+    uint16_t tapDurationMs;                 /**< Maximum tap duration (ms). */
+    uint16_t tapQuietMs;                    /**< Quiet time after a tap (ms). */
+    uint16_t tapWindowMs;                   /**< Double tap window (ms). */
+} IAM20680HP_eventConfig_t;
+
+/*! 
+ * @brief Structure to hold the state of the detectors. Thresholds in LSB (squared for |a|), times in frames.
+*/
+typedef struct
+{
+    IAM20680HP_eventConfig_t config;        /**< Settings. */
+    IAM20680HP_eventOutput_t output;        /**< Output function. */
+    void *context;                          /**< Passed to the output function. */
+    uint32_t periodUs;                      /**< Frame period (us). */
+    float mgPerLsb;                         /**< Accel mg per LSB. */
+    uint32_t freeFallLimit;                 /**< Free-fall threshold (|a|^2). */
+    uint32_t shockLimit;                    /**< Shock threshold (|a|^2). */
+    int32_t tapLimit;                       /**< Tap threshold (LSB). */
+    uint32_t freeFallFrames;                /**< Minimum free-fall duration (frames). */
+    uint32_t shockHoldoffFrames;            /**< Shock hold-off (frames). */
+    uint32_t stillFrames;                   /**< Stillness window (frames). */
+    int64_t stillLimit;                     /**< Stillness variance threshold (LSB^2). */
+    uint32_t tapDurationFrames;             /**< Maximum tap duration (frames). */
+    uint32_t tapQuietFrames;                /**< Quiet time after a tap (frames). */
+    uint32_t tapWindowFrames;               /**< Double tap window (frames). */
+    uint32_t frame;                         /**< Frame counter. */
+    int16_t previous[3];                    /**< Previous accel sample. */
+    bool havePrevious;                      /**< previous is set. */
+    uint32_t freeFallCount;                 /**< Frames of the current free-fall. */
+    uint32_t freeFallStartUs;               /**< Start of the current free-fall. */
+    uint32_t freeFallMinimum;               /**< Minimum |a|^2 of the current free-fall. */
+    bool freeFallReported;                  /**< The current free-fall is reported. */
+    bool shockActive;                       /**< |a| is above the shock threshold. */
+    uint32_t shockStartUs;                  /**< Start of the current shock. */
+    uint32_t shockPeak;                     /**< Peak |a|^2 of the current shock. */
+    uint32_t shockEnd;                      /**< Frame at the end of the hold-off. */
+    int64_t stillSum[3];                    /**< Gyro sums of the stillness window. */
+    int64_t stillSquares[3];                /**< Squared gyro sums of the stillness window. */
+    uint32_t stillCount;                    /**< Frames in the stillness window. */
+    uint32_t stillStartUs;                  /**< Start of the stillness window. */
+    bool still;                             /**< The device is still. */
+    uint8_t tapState;                       /**< 0 idle, 1 in a tap, 2 quiet. */
+    uint32_t tapStart;                      /**< Frame of the tap start. */
+    uint32_t tapStartUs;                    /**< Timestamp of the tap start. */
+    uint32_t tapQuietEnd;                   /**< Frame at the end of the quiet time. */
+    int16_t tapBaseline[3];                 /**< Accel sample before the current tap. */
+    int32_t tapPeak;                        /**< Peak change of the current tap (LSB). */
+    int8_t tapAxis;                         /**< Axis of the peak change. */
+    bool tapPending;                        /**< A single tap waits for the double tap window. */
+    uint32_t pendingFrame;                  /**< Frame of the waiting single tap. */
+    IAM20680HP_event_t pendingTap;          /**< The waiting single tap. */
+} IAM20680HP_eventDetector_t;
+
+/*! @brief Fills the settings with the default values (IAM20680HP_EVENTS_...), all detectors enabled
+ *
+ *  @param config Pointer to the settings
+ */
+void iam20680hpEventsDefaultConfig(IAM20680HP_eventConfig_t *config);
+
+/*! @brief Initialises the detectors
+ *
+ *  @param detector Pointer to the detectors
+ *  @param config Pointer to the settings (copied)
+ *  @param accelFsSel Accel full-scale (AFS_SEL 0 - 3) of the frames
+ *  @param odrHz Output data rate of the frames, see iam20680hpReadOutputDataRate()
+ *  @param output Output function
+ *  @param context Passed to the output function
+ *  @retval IAM20680HP_OK if the detectors are initialised
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if a parameter is invalid or the stillness window exceeds IAM20680HP_EVENTS_STILL_MAX_FRAMES
+ */
+IAM20680HP_err_t iam20680hpEventsInit(IAM20680HP_eventDetector_t *detector, const IAM20680HP_eventConfig_t *config, uint8_t accelFsSel, 
+                                      uint16_t odrHz, IAM20680HP_eventOutput_t output, void *context);
+
+/*! @brief Runs the detectors over a block of frames
+ *
+ *  @param detector Pointer to the detectors
+ *  @param frames Pointer to the frames
+ *  @param count Number of frames
+ *  @param timestampUs Timestamp (us) of the last frame, e.g. the time of the FiFo drain
+ */
+void iam20680hpEventsProcess(IAM20680HP_eventDetector_t *detector, const IAM20680HP_fifoData_t *frames, uint16_t count, uint32_t timestampUs);
+
+#endif // IAM20680HP_EVENTS_H_
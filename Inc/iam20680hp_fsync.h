@@ -0,0 +1,120 @@
+/*
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#ifndef IAM20680HP_FSYNC_H_
+#define IAM20680HP_FSYNC_H_
+
+#include "iam20680hp.h"
+
+/* 
+ * FSYNC tagging: with EXT_SYNC_SET the device writes the FSYNC state into the LSB of one channel, the first sample after an 
+ * FSYNC edge (e.g. the camera shutter) carries a 1. The tags are taken out of the drained FiFo frames (the LSB is cleared), 
+ * no extra bus reads. Each tag is paired with the timestamp of the external event (iam20680hpFsyncEvent() from the camera 
+ * ISR), which gives the IMU frame of every camera frame and the IMU sample period in the clock of the host.
+ *
+ * The temperature channel cannot be used, the FiFo decoding converts it.
+ */
+
+#define IAM20680HP_FSYNC_EVENTS 8               //External events waiting for their tag
+#define IAM20680HP_FSYNC_TOLERANCE_US 2000      //Uncertainty of the frame time from the drain time (us)
+
+/*! 
+ * @brief Structure to hold a tagged frame.
+*/
+typedef struct
+{
+    uint32_t frame;                         /**< Number of the frame since iam20680hpFsyncStart(). */
+    uint16_t index;                         /**< Index of the frame in the processed block. */
+    uint32_t frameUs;                       /**< Time of the frame from the drain time (us). */
+    uint32_t eventUs;                       /**< Time of the external event (us). */
+    bool matched;                           /**< An external event belongs to the tag (eventUs valid). */
+} IAM20680HP_fsyncTag_t;
+
+/*! 
+ * @brief Function that receives the tagged frames.
+*/
+typedef void (*IAM20680HP_fsyncOutput_t)(const IAM20680HP_fsyncTag_t *tag, void *context);
+
+/*! 
+ * @brief Structure to hold the FSYNC tagging.
+*/
+typedef struct
+{
+    uint8_t channel;                                /**< EXT_SYNC_SET (2 - 7). */
+    uint32_t periodUs;                              /**< Nominal sample period (us). */
+    volatile uint32_t eventUs[IAM20680HP_FSYNC_EVENTS]; /**< External events waiting for their tag. */
+    volatile uint8_t eventHead;                     /**< Written by iam20680hpFsyncEvent(). */
+    uint8_t eventTail;                              /**< Read by iam20680hpFsyncProcess(). */
+    uint32_t frames;                                /**< Frames processed. */
+    bool started;                                   /**< The first tag is matched. */
+    uint32_t firstFrame;                            /**< Frame of the first matched tag. */
+    uint32_t firstEventUs;                          /**< Event of the first matched tag (us). */
+    uint32_t lastFrame;                             /**< Frame of the last matched tag. */
+    uint32_t lastEventUs;                           /**< Event of the last matched tag (us). */
+    float measuredPeriodUs;                         /**< Sample period in the clock of the events (us), 0 until two tags. */
+    uint32_t tags;                                  /**< Tags found. */
+    uint32_t unmatchedTags;                         /**< Tags without an external event. */
+    uint32_t missedEvents;                          /**< External events without a tag. */
+    IAM20680HP_fsyncOutput_t output;                /**< Output function. */
+    void *context;                                  /**< Context of the output function. */
+} IAM20680HP_fsync_t;
+
+/*! @brief Starts FSYNC tagging (writes EXT_SYNC_SET)
+ *
+ *  @param sync Pointer to the FSYNC tagging
+ *  @param channel EXT_SYNC_SET: 2 GYRO_XOUT_L[0], 3 GYRO_YOUT_L[0], 4 GYRO_ZOUT_L[0], 5 ACCEL_XOUT_L[0], 6 ACCEL_YOUT_L[0], 7 ACCEL_ZOUT_L[0]
+ *  @param output Function that receives the tagged frames
+ *  @param context Context of the output function
+ *  @retval IAM20680HP_OK if the tagging is started
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if the channel is invalid
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpFsyncStart(IAM20680HP_fsync_t *sync, uint8_t channel, IAM20680HP_fsyncOutput_t output, void *context);
+
+/*! @brief Stores the time of an external event (camera shutter), call from the ISR of the event
+ *
+ *  @param sync Pointer to the FSYNC tagging
+ *  @param timestampUs Time of the event (us)
+ */
+void iam20680hpFsyncEvent(IAM20680HP_fsync_t *sync, uint32_t timestampUs);
+
+/*! @brief Takes the tags out of a block of drained frames and pairs them with the external events
+ *
+ *  @param sync Pointer to the FSYNC tagging
+ *  @param frames Pointer to the frames, the tag bit is cleared
+ *  @param count Number of frames
+ *  @param timestampUs Time of the drain (time of the last frame, us)
+ */
+void iam20680hpFsyncProcess(IAM20680HP_fsync_t *sync, IAM20680HP_fifoData_t *frames, uint16_t count, uint32_t timestampUs);
+
+/*! @brief Stops FSYNC tagging (EXT_SYNC_SET 0)
+ *
+ *  @param sync Pointer to the FSYNC tagging
+ *  @retval IAM20680HP_OK if the tagging is stopped
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpFsyncStop(IAM20680HP_fsync_t *sync);
+
+#endif // IAM20680HP_FSYNC_H_
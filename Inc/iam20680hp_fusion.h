@@ -0,0 +1,141 @@
+/*
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#ifndef IAM20680HP_FUSION_H_
+#define IAM20680HP_FUSION_H_
+
+#include "iam20680hp.h"
+
+/* 
+ * Attitude estimation (quaternion) from accel and gyro FiFo frames, e.g. the blocks of iam20680hpDrainSchedulerDrain(). 
+ * One call updates a whole block. The float filter supports Mahony and Madgwick, the fixed-point filter is Mahony 
+ * (Q30 quaternion, 32 bit multiply with 64 bit accumulate) for targets without FPU. Per sample with a valid accel vector 
+ * it does one integer square root and three 32 bit divisions (accel normalisation), the quaternion renormalisation has 
+ * no division. No cycle counts are given: they depend on the core (hardware divider) and the compiler. Measure them on the 
+ * target with IAM20680HP_FUSION_PROFILE 1 (cycles field of the filter), or the updates per second on the host with 
+ * make -C Test bench.
+ * The sample period follows from the block timestamps, so ODR drift and lost frames are handled.
+ */
+
+#define IAM20680HP_FUSION_MAHONY_KP 1.0f            //Proportional gain Mahony (1/s)
+#define IAM20680HP_FUSION_MAHONY_KI 0.0f            //Integral gain Mahony (1/s^2), gyro bias estimation
+#define IAM20680HP_FUSION_MADGWICK_BETA 0.1f        //Gain Madgwick (rad/s)
+#define IAM20680HP_FUSION_MAX_GAP_US 100000         //Blocks further apart use the nominal sample period
+#define IAM20680HP_FUSION_Q30 (1L << 30)            //1.0 in the fixed-point quaternion
+#ifndef IAM20680HP_FUSION_PROFILE
+#define IAM20680HP_FUSION_PROFILE 0                 //1: core cycles of the updates from the DWT cycle counter (Cortex-M3 and up)
+#endif
+
+/*! 
+ * @brief Enum to hold the algorithm of the float filter.
+*/
+typedef enum
+{
+    IAM20680HP_FUSION_MAHONY = 0,           /**< Mahony complementary filter (PI correction of the gyro rate). */
+    IAM20680HP_FUSION_MADGWICK,             /**< Madgwick gradient descent filter. */
+} IAM20680HP_fusionAlgorithm_t;
+
+/*! 
+ * @brief Structure to hold the state of the float filter.
+*/
+typedef struct
+{
+    float q[4];                             /**< Quaternion (w, x, y, z), sensor frame to earth frame. */
+    float integral[3];                      /**< Integral feedback Mahony (rad/s). */
+    float kp;                               /**< Proportional gain Mahony. */
+    float ki;                               /**< Integral gain Mahony. */
+    float beta;                             /**< Gain Madgwick. */
+    float gyroScale;                        /**< Gyro rad/s per LSB. */
+    uint32_t samplePeriodUs;                /**< Nominal sample period (us). */
+    uint32_t lastTimestampUs;               /**< Timestamp of the last frame of the previous block. */
+    uint32_t updates;                       /**< Number of processed frames. */
+    uint32_t cycles;                        /**< Core cycles spent in the updates (IAM20680HP_FUSION_PROFILE 1, wraps). */
+    bool timestampValid;                    /**< lastTimestampUs is set. */
+    IAM20680HP_fusionAlgorithm_t algorithm; /**< Algorithm. */
+} IAM20680HP_fusion_t;
+
+/*! 
+ * @brief Structure to hold the state of the fixed-point filter (Mahony).
+*/
+typedef struct
+{
+    int32_t q[4];                           /**< Quaternion (w, x, y, z), IAM20680HP_FUSION_Q30 = 1.0. */
+    int32_t integral[3];                    /**< Integral feedback (rad/s * 2^16). */
+    int32_t kp;                             /**< Proportional gain * 2^16. */
+    int32_t ki;                             /**< Integral gain * 2^16. */
+    int32_t gyroScale;                      /**< Gyro rad/s per LSB * 2^32. */
+    uint32_t samplePeriodUs;                /**< Nominal sample period (us). */
+    uint32_t lastTimestampUs;               /**< Timestamp of the last frame of the previous block. */
+    uint32_t updates;                       /**< Number of processed frames. */
+    uint32_t cycles;                        /**< Core cycles spent in the updates (IAM20680HP_FUSION_PROFILE 1, wraps). */
+    bool timestampValid;                    /**< lastTimestampUs is set. */
+} IAM20680HP_fusionFixed_t;
+
+#if IAM20680HP_FUSION_PROFILE
+/*! @brief Enables the DWT cycle counter for the cycles field of the filters, call once before the first update
+ */
+void iam20680hpFusionProfileStart(void);
+#endif
+
+/*! @brief Initialises the float filter (identity quaternion, default gains)
+ *
+ *  @param fusion Pointer to the filter
+ *  @param algorithm Mahony or Madgwick
+ *  @param gyroFsSel Gyro full-scale (FS_SEL 0 - 3) of the frames
+ *  @param odrHz Output data rate of the frames, see iam20680hpReadOutputDataRate()
+ *  @retval IAM20680HP_OK if the filter is initialised
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if a parameter is invalid
+ */
+IAM20680HP_err_t iam20680hpFusionInit(IAM20680HP_fusion_t *fusion, IAM20680HP_fusionAlgorithm_t algorithm, uint8_t gyroFsSel, uint16_t odrHz);
+
+/*! @brief Updates the float filter with a block of frames
+ *
+ *  @param fusion Pointer to the filter
+ *  @param frames Pointer to the frames (accel and gyro are used)
+ *  @param count Number of frames
+ *  @param timestampUs Timestamp (us) of the last frame, e.g. the time of the FiFo drain
+ */
+void iam20680hpFusionUpdate(IAM20680HP_fusion_t *fusion, const IAM20680HP_fifoData_t *frames, uint16_t count, uint32_t timestampUs);
+
+/*! @brief Initialises the fixed-point filter (identity quaternion, default Mahony gains)
+ *
+ *  @param fusion Pointer to the filter
+ *  @param gyroFsSel Gyro full-scale (FS_SEL 0 - 3) of the frames
+ *  @param odrHz Output data rate of the frames, see iam20680hpReadOutputDataRate()
+ *  @retval IAM20680HP_OK if the filter is initialised
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if a parameter is invalid
+ */
+IAM20680HP_err_t iam20680hpFusionFixedInit(IAM20680HP_fusionFixed_t *fusion, uint8_t gyroFsSel, uint16_t odrHz);
+
+/*! @brief Updates the fixed-point filter with a block of frames
+ *
+ *  @param fusion Pointer to the filter
+ *  @param frames Pointer to the frames (accel and gyro are used)
+ *  @param count Number of frames
+ *  @param timestampUs Timestamp (us) of the last frame, e.g. the time of the FiFo drain
+ */
+void iam20680hpFusionFixedUpdate(IAM20680HP_fusionFixed_t *fusion, const IAM20680HP_fifoData_t *frames, uint16_t count, uint32_t timestampUs);
+
+#endif // IAM20680HP_FUSION_H_
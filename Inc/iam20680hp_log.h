@@ -0,0 +1,191 @@
+/*
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#ifndef IAM20680HP_LOG_H_
+#define IAM20680HP_LOG_H_
+
+#include "iam20680hp.h"
+#include "stddef.h"
+
+/* 
+ * Compact streaming log of decoded FIFO frames. Only depends on iam20680hp.h types, so the decoder can be 
+ * used on a PC as reader library.
+ *
+ * Header (24 bytes): "IAML", version, ODR (uint16), gyro FS_SEL, accel AFS_SEL, FIFO_EN register, 
+ * gyro offsets (3x int16), accel offsets (3x int16), CRC-16.
+ *
+ * Block: sync 0xA5 0x5A, frame count (uint16), timestamp (uint32), payload length (uint16), payload, CRC-16 
+ * (over count up to the end of the payload). The payload holds per frame the 7 channels (accel, temperature, gyro)
+ * as zigzag varints: the first frame of a block absolute, the next frames as delta to the previous frame. 
+ * Every block can be decoded on its own. Multibyte fields are little endian.
+ */
+
+#define IAM20680HP_LOG_VERSION 1
+#define IAM20680HP_LOG_HEADER_SIZE 24
+#define IAM20680HP_LOG_BLOCK_OVERHEAD 12                //Sync, count, timestamp, length and CRC
+#define IAM20680HP_LOG_CHANNELS 7
+#define IAM20680HP_LOG_MAX_BLOCK_SIZE(frames) (IAM20680HP_LOG_BLOCK_OVERHEAD + (frames) * IAM20680HP_LOG_CHANNELS * 3)
+#define IAM20680HP_LOG_MAX_FRAMES (0xFFFF / (IAM20680HP_LOG_CHANNELS * 3)) //Frames per block, worst case payload fits the uint16 length
+
+/*! 
+ * @brief Structure to hold the log header: the settings needed to interpret the samples.
+*/
+typedef struct
+{
+    uint16_t odrHz;                         /**< Output data rate in Hz. */
+    uint8_t gyroFsSel;                      /**< Gyroscope full-scale range selection. */
+    uint8_t accelFsSel;                     /**< Accelerometer full-scale range selection. */
+    uint8_t fifoEnable;                     /**< FIFO_EN register (FIFO layout). */
+    IAM20680HP_gyroOffset_t gyroOffset;     /**< Gyroscope offset registers (calibration). */
+    IAM20680HP_accelOffset_t accelOffset;   /**< Accelerometer offset registers (calibration). */
+} IAM20680HP_logHeader_t;
+
+/*! 
+ * @brief Output function of the log writer, e.g. to a file on the SD card or the radio.
+ *
+ * @return true if all bytes are written
+*/
+typedef bool (*IAM20680HP_logOutput_t)(void *context, const uint8_t *buffer, size_t size);
+
+/*! 
+ * @brief Structure to hold the log writer.
+*/
+typedef struct
+{
+    IAM20680HP_logOutput_t output;  /**< Output function. */
+    void *context;                  /**< Context passed to the output function. */
+    uint8_t *buffer;                /**< Buffer for one encoded block, see IAM20680HP_LOG_MAX_BLOCK_SIZE(). */
+    size_t bufferSize;              /**< Size of the buffer. */
+    uint32_t blocks;                /**< Number of written blocks. */
+    uint32_t frames;                /**< Number of written frames. */
+    uint32_t bytes;                 /**< Number of written bytes. */
+} IAM20680HP_logWriter_t;
+
+/*! @brief Fills the log header with the current settings of the device
+ *
+ *  @param header Pointer to the struct IAM20680HP_logHeader_t where the settings will be stored
+ *  @retval IAM20680HP_OK if the settings are read
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpLogReadHeaderFromDevice(IAM20680HP_logHeader_t *header);
+
+/*! @brief Encodes the log header
+ *
+ *  @param header Pointer to the header
+ *  @param buffer Pointer to the output buffer, at least IAM20680HP_LOG_HEADER_SIZE bytes
+ */
+void iam20680hpLogEncodeHeader(const IAM20680HP_logHeader_t *header, uint8_t *buffer);
+
+/*! @brief Decodes the log header
+ *
+ *  @param buffer Pointer to the encoded header
+ *  @param size Number of available bytes
+ *  @param header Pointer to the struct IAM20680HP_logHeader_t where the header will be stored
+ *  @retval IAM20680HP_OK if the header is decoded
+ *  @retval IAM20680HP_ERR_EOL if there are not enough bytes
+ *  @retval IAM20680HP_ERR_NOT_SUPPORTED if the magic or version is not correct
+ *  @retval IAM20680HP_ERR_CRC if the CRC check failed
+ */
+IAM20680HP_err_t iam20680hpLogDecodeHeader(const uint8_t *buffer, size_t size, IAM20680HP_logHeader_t *header);
+
+/*! @brief Encodes a block of frames
+ *
+ *  @param fifoData Pointer to the frames
+ *  @param frames Number of frames, up to IAM20680HP_LOG_MAX_FRAMES
+ *  @param timestamp Timestamp of the first frame (user defined unit, e.g. ms or µs)
+ *  @param buffer Pointer to the output buffer
+ *  @param bufferSize Size of the output buffer, IAM20680HP_LOG_MAX_BLOCK_SIZE(frames) is always enough
+ *  @param written Pointer to the value where the number of encoded bytes will be stored
+ *  @retval IAM20680HP_OK if the block is encoded
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if the buffer is too small or there are more than IAM20680HP_LOG_MAX_FRAMES frames
+ */
+IAM20680HP_err_t iam20680hpLogEncodeBlock(const IAM20680HP_fifoData_t *fifoData, uint16_t frames, uint32_t timestamp, 
+                                          uint8_t *buffer, size_t bufferSize, size_t *written);
+
+/*! @brief Decodes a block of frames
+ *
+ *  On IAM20680HP_ERR_CRC or IAM20680HP_ERR_NOT_SUPPORTED (no sync), skip one byte and try again to resynchronise.
+ *
+ *  @param buffer Pointer to the encoded block
+ *  @param size Number of available bytes
+ *  @param fifoData Pointer to the array where the frames will be stored
+ *  @param maxFrames Number of frames that fit in fifoData
+ *  @param frames Pointer to the value where the number of decoded frames will be stored
+ *  @param timestamp Pointer to the value where the timestamp of the block will be stored
+ *  @param consumed Pointer to the value where the size of the block will be stored
+ *  @retval IAM20680HP_OK if the block is decoded
+ *  @retval IAM20680HP_ERR_EOL if there are not enough bytes for a complete block
+ *  @retval IAM20680HP_ERR_NOT_SUPPORTED if there is no sync at the start of the buffer
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if the block has more than maxFrames frames
+ *  @retval IAM20680HP_ERR_CRC if the CRC check or the payload is not correct
+ */
+IAM20680HP_err_t iam20680hpLogDecodeBlock(const uint8_t *buffer, size_t size, IAM20680HP_fifoData_t *fifoData, uint16_t maxFrames,
+                                          uint16_t *frames, uint32_t *timestamp, size_t *consumed);
+
+/*! @brief Initialises the log writer and writes the log header
+ *
+ *  @param writer Pointer to the writer
+ *  @param header Pointer to the header
+ *  @param output Output function
+ *  @param context Context passed to the output function
+ *  @param buffer Buffer for one encoded block
+ *  @param bufferSize Size of the buffer
+ *  @retval IAM20680HP_OK if the header is written
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if the buffer is smaller than the header
+ *  @retval IAM20680HP_ERR_BUSY if the output function failed
+ */
+IAM20680HP_err_t iam20680hpLogWriterInit(IAM20680HP_logWriter_t *writer, const IAM20680HP_logHeader_t *header, IAM20680HP_logOutput_t output, 
+                                         void *context, uint8_t *buffer, size_t bufferSize);
+
+/*! @brief Encodes and writes a block of frames
+ *
+ *  @param writer Pointer to the writer
+ *  @param fifoData Pointer to the frames
+ *  @param frames Number of frames, nothing is written for 0 frames, up to IAM20680HP_LOG_MAX_FRAMES
+ *  @param timestamp Timestamp of the first frame
+ *  @retval IAM20680HP_OK if the block is written
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if the buffer of the writer is too small or there are too many frames
+ *  @retval IAM20680HP_ERR_BUSY if the output function failed
+ */
+IAM20680HP_err_t iam20680hpLogWriteBlock(IAM20680HP_logWriter_t *writer, const IAM20680HP_fifoData_t *fifoData, uint16_t frames, uint32_t timestamp);
+
+/*! @brief Drains the FiFo and writes the frames as one block
+ *
+ *  The FiFo is read with iam20680hpReadFifoBlock() into fifoData and encoded from there into the buffer of the writer.
+ *
+ *  @param writer Pointer to the writer
+ *  @param fifoData Pointer to the frame buffer used for the drain
+ *  @param maxFrames Number of frames that fit in fifoData, limited to IAM20680HP_LOG_MAX_FRAMES
+ *  @param timestamp Timestamp of the first frame
+ *  @param frames Pointer to the value where the number of drained frames will be stored
+ *  @retval IAM20680HP_OK if the FiFo is drained and written
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if the buffer of the writer is too small
+ *  @retval IAM20680HP_ERR_BUSY if the output function failed
+ */
+IAM20680HP_err_t iam20680hpLogDrainFifo(IAM20680HP_logWriter_t *writer, IAM20680HP_fifoData_t *fifoData, uint16_t maxFrames, 
+                                        uint32_t timestamp, uint16_t *frames);
+
+#endif // IAM20680HP_LOG_H_
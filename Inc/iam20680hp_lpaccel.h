@@ -0,0 +1,108 @@
+/*
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#ifndef IAM20680HP_LPACCEL_H_
+#define IAM20680HP_LPACCEL_H_
+
+#include "iam20680hp.h"
+
+/* 
+ * Low power accelerometer streaming: the accelerometer runs in cycle mode (LP_MODE_CFG rate, DEC2 averaging) with the gyro 
+ * off and writes only accel samples (6 bytes) to the FiFo (FIFO_LP_EN). The MCU wakes up once per FiFo fill instead of once
+ * per sample, the drain interval follows from the drain scheduler with a long maximum interval.
+ *
+ * Low power rates (LP_MODE_CFG): 4: 3.9Hz, 5: 7.8Hz, 6: 15.6Hz, 7: 31.3Hz, 8: 62.5Hz, 9: 125Hz, 10: 250Hz, 11: 500Hz
+ */
+
+#define IAM20680HP_LPACCEL_MAX_INTERVAL 60000   //Longest drain interval (ms)
+#define IAM20680HP_LPACCEL_TARGET_FILL 70       //Target FiFo fill at a drain (percent)
+
+/*! 
+ * @brief Structure to hold the low power accel streaming report.
+ *
+ * A drain is one FIFO_COUNT read and one FIFO_R_W burst. Test/test_lpaccel.c counts the bus transfers of the drains and 
+ * of polled reads of the same samples (ACCEL_XOUT_H) through the replay backend.
+*/
+typedef struct
+{
+    uint32_t samples;                       /**< Samples read. */
+    uint32_t wakeups;                       /**< Drains (MCU wakeups). */
+    float samplesPerWakeup;                 /**< Measured samples per wakeup. */
+    uint32_t busBytes;                      /**< Register address and data bytes on the bus for the drains. */
+    uint32_t overflows;                     /**< Drains of a full FiFo (samples lost). */
+} IAM20680HP_lpAccelReport_t;
+
+/*! 
+ * @brief Structure to hold the low power accel streaming.
+*/
+typedef struct
+{
+    IAM20680HP_drainScheduler_t scheduler;              /**< Drain interval. */
+    IAM20680HP_lpAccelReport_t report;                  /**< Report. */
+    IAM20680HP_powerManagement_t savedPowerManagement;  /**< Settings before iam20680hpLpAccelStart(). */
+    IAM20680HP_accelConfig_t savedAccelConfig;          /**< Settings before iam20680hpLpAccelStart(). */
+    bool savedFifoEnable[5];                            /**< Settings before iam20680hpLpAccelStart(). */
+    IAM20680HP_userControl_t savedUserControl;          /**< Settings before iam20680hpLpAccelStart(). */
+    bool savedGyroCycle;                                /**< Settings before iam20680hpLpAccelStart(). */
+    uint8_t savedAvgCfg;                                /**< Settings before iam20680hpLpAccelStart(). */
+    uint8_t savedRate;                                  /**< Settings before iam20680hpLpAccelStart(). */
+} IAM20680HP_lpAccel_t;
+
+/*! @brief Starts low power accel streaming through the FiFo (saves the settings, restores them after a failed write)
+ *
+ *  @param lpAccel Pointer to the low power accel streaming
+ *  @param rate Low power rate (4 - 11)
+ *  @param dec2Cfg DEC2_CFG averaging (0: 4, 1: 8, 2: 16, 3: 32 samples)
+ *  @param targetFill Target FiFo fill at a drain in percent (e.g. IAM20680HP_LPACCEL_TARGET_FILL)
+ *  @retval IAM20680HP_OK if the streaming is started
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if a parameter is invalid
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpLpAccelStart(IAM20680HP_lpAccel_t *lpAccel, uint8_t rate, uint8_t dec2Cfg, uint8_t targetFill);
+
+/*! @brief Drains the accel samples from the FiFo, call after nextDrainMs
+ *
+ *  @param lpAccel Pointer to the low power accel streaming
+ *  @param samples Pointer to the array where the samples will be stored, should fit a full FiFo
+ *  @param maxSamples Number of samples that fit in samples
+ *  @param elapsedMs Time since the previous drain in ms
+ *  @param samplesRead Pointer to the value where the number of read samples will be stored
+ *  @param nextDrainMs Pointer to the value where the time until the next drain in ms will be stored
+ *  @retval IAM20680HP_OK if the FiFo is drained (a full FiFo or a FiFo count of not whole samples is an overflow: the FiFo 
+ *  is reset and samplesRead is 0)
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpLpAccelDrain(IAM20680HP_lpAccel_t *lpAccel, IAM20680HP_accelData_t *samples, uint16_t maxSamples, uint32_t elapsedMs,
+                                        uint16_t *samplesRead, uint32_t *nextDrainMs);
+
+/*! @brief Stops low power accel streaming and restores the settings (also USER_CTRL FIFO_EN), resets the FiFo
+ *
+ *  @param lpAccel Pointer to the low power accel streaming
+ *  @retval IAM20680HP_OK if the settings are restored
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpLpAccelStop(IAM20680HP_lpAccel_t *lpAccel);
+
+#endif // IAM20680HP_LPACCEL_H_
@@ -0,0 +1,239 @@
+/*
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#ifndef IAM20680HP_POWER_H_
+#define IAM20680HP_POWER_H_
+
+#include "iam20680hp.h"
+
+/* 
+ * Power manager: moves the device between wake on motion, accel-only low power (DEC2 averaging), gyro standby and full 
+ * rate based on the recent activity (accel peak to peak in mg, see iam20680hpPowerActivity()).
+ *
+ * A higher state is entered as soon as the activity reaches its threshold, a lower state after the activity stayed below the 
+ * threshold minus the hysteresis for dwellMs (one state per dwell). In wake on motion there is no data: 
+ * iam20680hpPowerUpdate() polls the WoM interrupt (or call iam20680hpPowerSetState() from the INT pin handler).
+ * With a current budget the full and gyro standby states are not entered while the average current is above the budget.
+ *
+ * The gyro warm standby (iam20680hpGyroWake...) makes the gyro available again within the DLPF group delay.
+ *
+ * @note Entering wake on motion resets the device (see iam20680hpEnableWomModeFunction()), the configuration after waking up 
+ * is the configuration of iam20680hpInit(). Restore offsets etc. in the application (e.g. iam20680hpCalibRestore()).
+ */
+
+// Supply current per state (uA). Estimates for the default ODR and averaging, set from the datasheet or a measurement
+#define IAM20680HP_POWER_WOM_UA 20
+#define IAM20680HP_POWER_LP_ACCEL_UA 100
+#define IAM20680HP_POWER_GYRO_STANDBY_UA 1600
+#define IAM20680HP_POWER_FULL_UA 2800
+
+#define IAM20680HP_POWER_QUIET_MG 20            //Below this activity: wake on motion
+#define IAM20680HP_POWER_STANDBY_MG 60          //From this activity: gyro standby
+#define IAM20680HP_POWER_FULL_MG 150            //From this activity: full rate
+#define IAM20680HP_POWER_HYSTERESIS_MG 10       //Hysteresis of the thresholds going down
+#define IAM20680HP_POWER_DWELL_MS 2000          //Time below the threshold before going down one state
+#define IAM20680HP_POWER_AVERAGE_MS 60000       //Time constant of the average current for the budget
+#define IAM20680HP_GYRO_WAKE_SETTLE_US 0        //Extra settling after a gyro wake on top of the DLPF group delay (us)
+
+/*! 
+ * @brief Enum to hold the power states, lowest current first.
+*/
+typedef enum
+{
+    IAM20680HP_POWER_WOM = 0,               /**< Wake on motion, accel cycling at ACCEL_FREQ_WAKEUP. */
+    IAM20680HP_POWER_LP_ACCEL,              /**< Accelerometer low power (cycle mode with DEC2 averaging), gyro off. */
+    IAM20680HP_POWER_GYRO_STANDBY,          /**< Accelerometer on, gyro drive on but sense paths off (fast gyro start). */
+    IAM20680HP_POWER_FULL,                  /**< Accelerometer and gyro on. */
+} IAM20680HP_powerState_t;
+
+/*! 
+ * @brief Structure to hold the power manager settings.
+*/
+typedef struct
+{
+    uint16_t quietMg;                       /**< Below this activity: wake on motion. */
+    uint16_t standbyMg;                     /**< From this activity: gyro standby. */
+    uint16_t fullMg;                        /**< From this activity: full rate. */
+    uint16_t hysteresisMg;                  /**< Hysteresis of the thresholds going down. */
+    uint32_t dwellMs;                       /**< Time below the threshold before going down one state. */
+    uint16_t currentUa[4];                  /**< Supply current per IAM20680HP_powerState_t (uA). */
+    uint16_t budgetUa;                      /**< Maximum average current (uA), 0 = no budget. */
+    uint8_t dec2Cfg;                        /**< DEC2_CFG averaging in low power accel (0: 4, 1: 8, 2: 16, 3: 32 samples). */
+    uint8_t lowPowerRate;                   /**< Accel low power rate (4 - 11, see iam20680hpLowPowerMode()). */
+} IAM20680HP_powerConfig_t;
+
+/*! 
+ * @brief Structure to hold the power manager report.
+*/
+typedef struct
+{
+    uint32_t timeMs[4];                     /**< Time per IAM20680HP_powerState_t (ms). */
+    float averageUa;                        /**< Average current since the start (uA). */
+    float recentUa;                         /**< Average current with time constant IAM20680HP_POWER_AVERAGE_MS (uA). */
+    uint32_t transitions;                   /**< Number of state changes. */
+} IAM20680HP_powerReport_t;
+
+/*! 
+ * @brief Structure to hold the power manager.
+*/
+typedef struct
+{
+    IAM20680HP_powerConfig_t config;        /**< Settings. */
+    IAM20680HP_powerState_t state;          /**< Current state. */
+    uint32_t belowMs;                       /**< Time the activity is below the threshold of the current state. */
+    uint64_t chargeUaMs;                    /**< Sum of current * time (uA * ms). */
+    IAM20680HP_powerReport_t report;        /**< Report. */
+} IAM20680HP_power_t;
+
+/*! 
+ * @brief Structure to hold the gyro warm standby.
+ *
+ * In warm standby (GYRO_STANDBY in PWR_MGMT_1) the gyro drive and PLL keep running and only the sense paths are off. 
+ * Standby and wake are one register write each, from a copy of PWR_MGMT_1 (no read). Gyro axes that are not used stay 
+ * off with their STBY_xG bit. After a wake the samples within the DLPF group delay are discarded.
+*/
+typedef struct
+{
+    uint8_t pwrMgmt1;                       /**< Copy of PWR_MGMT_1 without GYRO_STANDBY. */
+    bool standby;                           /**< Gyro in warm standby. */
+    uint16_t odrHz;                         /**< Output data rate. */
+    uint32_t groupDelayUs;                  /**< Gyro DLPF group delay (us). */
+    uint16_t discardSamples;                /**< Samples discarded after a wake. */
+    uint16_t pending;                       /**< Samples still to discard. */
+    bool waiting;                           /**< Waiting for the first valid sample after a wake. */
+    uint32_t wakeUs;                        /**< Timestamp of the last wake (us). */
+    uint32_t firstValidUs;                  /**< Time from the last wake to the first valid sample (us). */
+} IAM20680HP_gyroWake_t;
+
+/*! @brief Fills the settings with the default values (IAM20680HP_POWER_...)
+ *
+ *  @param config Pointer to the settings
+ */
+void iam20680hpPowerDefaultConfig(IAM20680HP_powerConfig_t *config);
+
+/*! @brief Initialises the power manager and puts the device in the start state
+ *
+ *  @param power Pointer to the power manager
+ *  @param config Pointer to the settings (copied)
+ *  @param state Start state
+ *  @retval IAM20680HP_OK if the power manager is initialised
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if a parameter is invalid
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpPowerInit(IAM20680HP_power_t *power, const IAM20680HP_powerConfig_t *config, IAM20680HP_powerState_t state);
+
+/*! @brief Updates the time statistics and changes the state when the activity asks for it
+ *
+ *  @param power Pointer to the power manager
+ *  @param activityMg Activity since the previous update (mg), ignored in wake on motion
+ *  @param elapsedMs Time since the previous update (ms)
+ *  @retval IAM20680HP_OK if the power manager is updated
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpPowerUpdate(IAM20680HP_power_t *power, uint16_t activityMg, uint32_t elapsedMs);
+
+/*! @brief Puts the device in a state (e.g. after a WoM interrupt on the INT pin)
+ *
+ *  @param power Pointer to the power manager
+ *  @param state New state
+ *  @retval IAM20680HP_OK if the state is set
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if the state is invalid
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpPowerSetState(IAM20680HP_power_t *power, IAM20680HP_powerState_t state);
+
+/*! @brief Returns the time per state and the estimated average current
+ *
+ *  @param power Pointer to the power manager
+ *  @param report Pointer to the struct IAM20680HP_powerReport_t where the report will be stored
+ */
+void iam20680hpPowerGetReport(const IAM20680HP_power_t *power, IAM20680HP_powerReport_t *report);
+
+/*! @brief Activity of a block of frames: largest accel peak to peak of the axes (mg)
+ *
+ *  @param frames Pointer to the frames
+ *  @param count Number of frames
+ *  @param accelFsSel Accel full-scale (AFS_SEL 0 - 3) of the frames
+ *  @retval Activity (mg)
+ */
+uint16_t iam20680hpPowerActivity(const IAM20680HP_fifoData_t *frames, uint16_t count, uint8_t accelFsSel);
+
+/*! @brief Activity of a block of accelerometer samples (e.g. low power accel): largest peak to peak of the axes (mg)
+ *
+ *  @param accelData Pointer to the samples
+ *  @param count Number of samples
+ *  @param accelFsSel Accel full-scale (AFS_SEL 0 - 3) of the samples
+ *  @retval Activity (mg)
+ */
+uint16_t iam20680hpPowerActivityAccel(const IAM20680HP_accelData_t *accelData, uint16_t count, uint8_t accelFsSel);
+
+/*! @brief Initialises the gyro warm standby from the device settings (DLPF, FCHOICE, sample rate)
+ *
+ *  @param wake Pointer to the gyro warm standby
+ *  @param gyroX Use the X gyro
+ *  @param gyroY Use the Y gyro
+ *  @param gyroZ Use the Z gyro
+ *  @retval IAM20680HP_OK if the gyro warm standby is initialised, gyro on
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpGyroWakeInit(IAM20680HP_gyroWake_t *wake, bool gyroX, bool gyroY, bool gyroZ);
+
+/*! @brief Puts the gyro in warm standby (one register write)
+ *
+ *  @param wake Pointer to the gyro warm standby
+ *  @retval IAM20680HP_OK if the gyro is in warm standby
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpGyroWakeStandby(IAM20680HP_gyroWake_t *wake);
+
+/*! @brief Wakes the gyro from warm standby (one register write) and starts discarding the settling samples
+ *
+ *  @param wake Pointer to the gyro warm standby
+ *  @param timestampUs Time of the wake (us)
+ *  @retval IAM20680HP_OK if the gyro is on
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpGyroWake(IAM20680HP_gyroWake_t *wake, uint32_t timestampUs);
+
+/*! @brief Counts new samples against the settling samples after a wake
+ *
+ *  @param wake Pointer to the gyro warm standby
+ *  @param count Number of new samples
+ *  @param timestampUs Time of the last of the new samples (us)
+ *  @retval Number of the new samples (from the first) to discard
+ */
+uint16_t iam20680hpGyroWakeDiscard(IAM20680HP_gyroWake_t *wake, uint16_t count, uint32_t timestampUs);
+
+/*! @brief Removes the settling frames after a wake from a block of FiFo frames
+ *
+ *  @param wake Pointer to the gyro warm standby
+ *  @param frames Pointer to the frames, the valid frames are moved to the start
+ *  @param count Number of frames
+ *  @param timestampUs Time of the last frame (us)
+ *  @retval Number of valid frames
+ */
+uint16_t iam20680hpGyroWakeFilter(IAM20680HP_gyroWake_t *wake, IAM20680HP_fifoData_t *frames, uint16_t count, uint32_t timestampUs);
+
+#endif // IAM20680HP_POWER_H_
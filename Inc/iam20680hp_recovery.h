@@ -0,0 +1,139 @@
+/*
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#ifndef IAM20680HP_RECOVERY_H_
+#define IAM20680HP_RECOVERY_H_
+
+#include "iam20680hp.h"
+
+/* 
+ * Bus error recovery (IAM20680HP_RECOVERY 1, HAL backend):
+ * - Every transfer has a short timeout (twice its duration at IAM20680HP_I2C_BUS_HZ plus IAM20680HP_I2C_RETRY_TIMEOUT) and is repeated up to IAM20680HP_I2C_RETRIES times, 
+ *   before the second and later retries the bus is un-jammed (I2C peripheral re-initialised, with IAM20680HP_SCL_PIN up to 
+ *   nine SCL clocks until the device releases SDA and a STOP).
+ * - iam20680hpRecoveryCheck() checks WHO_AM_I and compares the main settings with the register shadow. After a reset 
+ *   or a corrupted register the whole configuration is written again from the shadow.
+ * - The re-initialisation is automatic: after a transfer failed after all retries, the HAL backend runs 
+ *   iam20680hpRecoveryCheck() before the next transfer (deferred, not from the failing transfer). With a device that 
+ *   stays away every transfer that fails arms the next check (IAM20680HP_RECOVERY_STARTUP_MS each).
+ * - The scrubber (iam20680hpScrubberUpdate()) reads the configuration ranges periodically in three short bursts, 
+ *   a register that differs from the shadow is written again, a device reset is restored completely.
+ */
+
+#define IAM20680HP_RECOVERY_HALF_CLOCK 100      //Busy loop per half SCL clock of the un-jam (about 5us)
+#define IAM20680HP_RECOVERY_STARTUP_MS 100      //Wait after a device that does not answer, before the configuration is written
+#define IAM20680HP_SCRUB_PERIOD_MS 1000         //Default time between two scrubs
+
+/*! 
+ * @brief Structure to hold the recovery counters.
+*/
+typedef struct
+{
+    uint32_t retries;                       /**< Repeated transfers. */
+    uint32_t unjams;                        /**< Bus un-jams. */
+    uint32_t failures;                      /**< Transfers failed after all retries. */
+    uint32_t checks;                        /**< Health checks. */
+    uint32_t restores;                      /**< Configurations written again from the shadow. */
+} IAM20680HP_recoveryStats_t;
+
+/*! 
+ * @brief Structure to hold the configuration scrubber.
+*/
+typedef struct
+{
+    uint8_t address;                        /**< I2C address of the device. */
+    uint32_t periodMs;                      /**< Time between two scrubs. */
+    uint32_t elapsedMs;                     /**< Time since the last scrub. */
+    uint32_t scrubs;                        /**< Scrubs done. */
+    uint32_t mismatches;                    /**< Registers that differed from the shadow. */
+    uint32_t repairs;                       /**< Registers written again. */
+    uint32_t resets;                        /**< Device resets found (whole configuration restored). */
+    uint32_t errors;                        /**< Scrubs with a bus error. */
+} IAM20680HP_scrubber_t;
+
+/*! @brief Counts a failed transfer and prepares the retry (used by the HAL backend)
+ *
+ *  @param attempt Number of the failed attempt (0: first)
+ *  @retval true if the transfer is to be repeated
+ */
+bool iam20680hpRecoveryRetry(uint8_t attempt);
+
+/*! @brief Returns true once after a transfer failed after all retries (used by the HAL backend for the deferred check)
+ *
+ *  @retval true if iam20680hpRecoveryCheck() is due
+ */
+bool iam20680hpRecoveryDue(void);
+
+/*! @brief Un-jams the bus: re-initialises the I2C peripheral, clocks out a stuck SDA when the pins are defined
+ */
+void iam20680hpRecoveryUnjam(void);
+
+/*! @brief Checks the selected device and writes the configuration again when it is lost
+ *
+ *  @param restored Pointer to the value that is set when the configuration is written again
+ *  @retval IAM20680HP_OK if the device is fine (again)
+ *  @retval IAM20680HP_ERR_DEVICE_ID if WHO_AM_I is not correct
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpRecoveryCheck(bool *restored);
+
+/*! @brief Writes all shadowed registers of the selected device again
+ *
+ *  @retval IAM20680HP_OK if the configuration is written
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpRecoveryRestore(void);
+
+/*! @brief Initialises the scrubber for the selected device
+ *
+ *  @param scrubber Pointer to the scrubber
+ *  @param periodMs Time between two scrubs (e.g. IAM20680HP_SCRUB_PERIOD_MS)
+ */
+void iam20680hpScrubberInit(IAM20680HP_scrubber_t *scrubber, uint32_t periodMs);
+
+/*! @brief Scrubs the configuration when the period passed
+ *
+ *  @param scrubber Pointer to the scrubber
+ *  @param elapsedMs Time since the previous call
+ *  @retval IAM20680HP_OK if nothing was due or the configuration is fine (again)
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpScrubberUpdate(IAM20680HP_scrubber_t *scrubber, uint32_t elapsedMs);
+
+/*! @brief Scrubs the configuration now: reads the configuration ranges, repairs differences from the shadow
+ *
+ *  @param scrubber Pointer to the scrubber
+ *  @retval IAM20680HP_OK if the configuration is fine (again)
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpScrub(IAM20680HP_scrubber_t *scrubber);
+
+/*! @brief Returns the recovery counters
+ *
+ *  @param stats Pointer to the struct IAM20680HP_recoveryStats_t where the counters will be stored
+ */
+void iam20680hpRecoveryGetStats(IAM20680HP_recoveryStats_t *stats);
+
+#endif // IAM20680HP_RECOVERY_H_
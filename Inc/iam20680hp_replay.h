@@ -0,0 +1,118 @@
+/*
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#ifndef IAM20680HP_REPLAY_H_
+#define IAM20680HP_REPLAY_H_
+
+#include "iam20680hp.h"
+#include "stddef.h"
+
+/* 
+ * Replay backend for host builds (POSIX), compile with IAM20680HP_USE_HAL set to 0 and add iam20680hp_replay.c. 
+ * It defines the bus backend functions, so iam20680hp_bus.c may only be linked with IAM20680HP_BUS_BACKEND 0 (default).
+ * A recorded session is memory mapped and served to the driver through iam20680hpBusTransmit() and 
+ * iam20680hpBusReceive(), so iam20680hpReadFifoCount(), iam20680hpReadFifoData() and the conversion of the 
+ * driver run unchanged. Delays are skipped, the replay runs as fast as the host allows.
+ *
+ * Raw FIFO dump: the bytes as read from FIFO_R_W, back to back. FIFO_COUNT reports the remaining bytes, limited to 
+ * the whole frames (FIFO_EN) that fit the FIFO size of ACCEL_CONFIG2, so a dump never looks like an overflowed FIFO. 
+ * All other registers are served from a register shadow.
+ *
+ * Trace: the magic "IAMT" followed by records of the bus transactions:
+ * - uint8_t type:      'W' write, 'R' read
+ * - uint8_t reg:       register address
+ * - uint16_t length:   payload length, little endian
+ * - uint8_t payload[length]
+ */
+
+#define IAM20680HP_REPLAY_TRACE_MAGIC "IAMT"
+#define IAM20680HP_REPLAY_TRACE_WRITE 'W'
+#define IAM20680HP_REPLAY_TRACE_READ 'R'
+#define IAM20680HP_REPLAY_SEARCH_WINDOW 64      //Records searched ahead for a matching read, otherwise served from the shadow
+
+/*! 
+ * @brief Enum to hold the format of a recorded session.
+*/
+typedef enum
+{
+    IAM20680HP_REPLAY_RAW_FIFO = 0,         /**< Raw FIFO dump */
+    IAM20680HP_REPLAY_TRACE,                /**< Register/FIFO trace */
+} IAM20680HP_replayFormat_t;
+
+/*! 
+ * @brief Structure to hold the replay statistics.
+*/
+typedef struct
+{
+    size_t fileSize;            /**< Size of the recorded session in bytes. */
+    size_t position;            /**< Current position in the recorded session. */
+    uint32_t transmits;         /**< Number of iam20680hpBusTransmit() calls. */
+    uint32_t receives;          /**< Number of iam20680hpBusReceive() calls. */
+    uint32_t shadowReads;       /**< Reads served from the register shadow (not in the recording). */
+    uint64_t fifoBytes;         /**< Number of FIFO bytes replayed. */
+    uint64_t busBytes;          /**< Number of bytes passed to the bus functions (register addresses and data). */
+} IAM20680HP_replayStats_t;
+
+/*! @brief Opens and memory maps a recorded session
+ *
+ *  @param path Path to the recorded session
+ *  @param format Format of the recorded session
+ *  @retval IAM20680HP_OK if the session is opened
+ *  @retval IAM20680HP_ERR_DEVICE_NOT_FOUND if the file can't be opened or mapped
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if the trace magic is not correct
+ */
+IAM20680HP_err_t iam20680hpReplayOpen(const char *path, IAM20680HP_replayFormat_t format);
+
+/*! @brief Closes the recorded session and unmaps the file
+ */
+void iam20680hpReplayClose(void);
+
+/*! @brief Restarts the recorded session from the beginning, the register shadow is reset
+ */
+void iam20680hpReplayRewind(void);
+
+/*! @brief Reads the replay statistics
+ *
+ *  @param stats Pointer to the struct IAM20680HP_replayStats_t where the statistics will be stored
+ */
+void iam20680hpReplayGetStats(IAM20680HP_replayStats_t *stats);
+
+/*! @brief Checks if the whole recorded session is replayed
+ *
+ *  @return true if the end of the recorded session is reached
+ */
+bool iam20680hpReplayFinished(void);
+
+/*! @brief Simulates a device reset (e.g. a brown-out): the registers return to their reset values, the driver is not told
+ */
+void iam20680hpReplayInjectReset(void);
+
+/*! @brief Simulates a bus error: one following bus function call fails with IAM20680HP_ERR_I2C and has no effect
+ *
+ *  @param transfer Number of the call that fails (1 is the next call), 0 cancels a pending error
+ */
+void iam20680hpReplayInjectError(uint32_t transfer);
+
+#endif // IAM20680HP_REPLAY_H_
@@ -0,0 +1,185 @@
+/*
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#ifndef IAM20680HP_RTOS_H_
+#define IAM20680HP_RTOS_H_
+
+#include "iam20680hp.h"
+
+/* 
+ * RTOS layer (IAM20680HP_RTOS 1: CMSIS-RTOS2, e.g. FreeRTOS, 2: POSIX threads for tests on a PC).
+ *
+ * - A sensor task per device drains the FiFo when the INT pin ISR notifies it (iam20680hpRtosNotifyFromIsr()) or after 
+ *   the drain interval of the drain scheduler, whichever is first.
+ * - The frames are drained directly into blocks of a preallocated pool, the consumer receives a pointer to the block and 
+ *   releases it after use (no copy).
+ * - iam20680hpRtosLock() / iam20680hpRtosUnlock() protect a device. The driver keeps its buffer and the selected device 
+ *   in globals, so the lock also holds the driver: every driver call outside the sensor task goes between them.
+ * - Waits in the driver use osDelay (iam20680hpRtosDelay()).
+ * - iam20680hpRtosBusLock() is the lock of the shared bus scheduler (lock of IAM20680HP_busConfig_t).
+ */
+
+#if IAM20680HP_RTOS
+
+#if IAM20680HP_RTOS == 1
+#include "cmsis_os2.h"
+#elif IAM20680HP_RTOS == 2
+#include "pthread.h"
+#endif
+
+#define IAM20680HP_RTOS_BLOCKS 4                //Blocks in the pool of a device
+#define IAM20680HP_RTOS_BLOCK_FRAMES 40         //Frames per block (a full 512 byte FiFo is 36 frames)
+#define IAM20680HP_RTOS_TARGET_FILL 50          //Target FiFo fill at a drain without notification (percent)
+#define IAM20680HP_RTOS_STACK_SIZE 1024         //Stack of the sensor task (bytes, CMSIS-RTOS2)
+
+/*! 
+ * @brief Structure to hold a block of frames.
+*/
+typedef struct
+{
+    IAM20680HP_fifoData_t frames[IAM20680HP_RTOS_BLOCK_FRAMES];   /**< Frames. */
+    uint16_t count;                                             /**< Number of frames. */
+    uint32_t timestampMs;                                       /**< Time of the drain (ms). */
+    IAM20680HP_fifoGap_t gap;                                   /**< Frames lost before this block. */
+} IAM20680HP_rtosBlock_t;
+
+/*! 
+ * @brief Structure to hold a queue of block pointers.
+*/
+typedef struct
+{
+#if IAM20680HP_RTOS == 1
+    osMessageQueueId_t queue;               /**< Message queue of pointers. */
+#elif IAM20680HP_RTOS == 2
+    pthread_mutex_t mutex;                  /**< Protects the ring. */
+    pthread_cond_t changed;                 /**< Signalled on put. */
+    IAM20680HP_rtosBlock_t *ring[IAM20680HP_RTOS_BLOCKS]; /**< Pointers. */
+    uint8_t head;                           /**< Oldest pointer. */
+    uint8_t count;                          /**< Number of pointers. */
+    bool created;                           /**< Mutex and condition exist. */
+#endif
+} IAM20680HP_rtosQueue_t;
+
+/*! 
+ * @brief Structure to hold the sensor task of a device.
+*/
+typedef struct
+{
+    uint8_t address;                                    /**< I2C address of the device. */
+    IAM20680HP_drainScheduler_t scheduler;              /**< Drain interval. */
+    uint16_t odrHz;                                     /**< Output data rate. */
+    IAM20680HP_rtosBlock_t blocks[IAM20680HP_RTOS_BLOCKS]; /**< Block pool. */
+    IAM20680HP_rtosQueue_t free;                        /**< Free blocks. */
+    IAM20680HP_rtosQueue_t full;                        /**< Blocks for the consumer. */
+    volatile bool running;                              /**< Cleared by iam20680hpRtosStop(). */
+    uint32_t lastDrainMs;                               /**< Time of the previous drain (ms). */
+    uint32_t drains;                                    /**< Drains. */
+    uint32_t notifications;                             /**< Drains after a notification. */
+    uint32_t noFreeBlock;                               /**< Drains skipped, all blocks at the consumer. */
+    uint32_t errors;                                    /**< Drains with a bus error. */
+#if IAM20680HP_RTOS == 1
+    osThreadId_t thread;                                /**< Sensor task. */
+    volatile bool stopped;                              /**< Set when the sensor task ends. */
+#elif IAM20680HP_RTOS == 2
+    pthread_t thread;                                   /**< Sensor task. */
+    pthread_mutex_t mutex;                              /**< Protects pending. */
+    pthread_cond_t notify;                              /**< Signalled by a notification. */
+    bool pending;                                       /**< Notification not yet taken. */
+#endif
+} IAM20680HP_rtos_t;
+
+/*! @brief Creates the locks, call once before the other functions
+ *
+ *  @retval IAM20680HP_OK if the locks are created
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if the RTOS objects cannot be created
+ */
+IAM20680HP_err_t iam20680hpRtosInit(void);
+
+/*! @brief Locks a device (and the driver) and selects it
+ *
+ *  @param address I2C address of the device (0x68 or 0x69)
+ */
+void iam20680hpRtosLock(uint8_t address);
+
+/*! @brief Unlocks a device
+ *
+ *  @param address I2C address of the device (0x68 or 0x69)
+ */
+void iam20680hpRtosUnlock(uint8_t address);
+
+/*! @brief Lock of the shared bus scheduler, for the lock of IAM20680HP_busConfig_t
+ *
+ *  @param lock true to take, false to give back
+ */
+void iam20680hpRtosBusLock(bool lock);
+
+/*! @brief Waits without blocking other tasks
+ *
+ *  @param ms Time in milliseconds
+ */
+void iam20680hpRtosDelay(uint32_t ms);
+
+/*! @brief Starts the sensor task of a device, the FiFo must be configured
+ *
+ *  The frames at the target fill (IAM20680HP_RTOS_TARGET_FILL of the FiFo size) must fit a block: 512 byte and 1 kByte FiFo.
+ *
+ *  @param rtos Pointer to the sensor task (must stay valid while running)
+ *  @param address I2C address of the device
+ *  @retval IAM20680HP_OK if the task is started
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if the RTOS objects cannot be created or the target fill does not fit a block
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpRtosStart(IAM20680HP_rtos_t *rtos, uint8_t address);
+
+/*! @brief Stops the sensor task, waits until it ended and deletes the queues and locks of the task
+ *
+ *  @param rtos Pointer to the sensor task
+ */
+void iam20680hpRtosStop(IAM20680HP_rtos_t *rtos);
+
+/*! @brief Wakes the sensor task, call from the INT pin ISR (e.g. HAL_GPIO_EXTI_Callback())
+ *
+ *  @param rtos Pointer to the sensor task
+ */
+void iam20680hpRtosNotifyFromIsr(IAM20680HP_rtos_t *rtos);
+
+/*! @brief Waits for the next block of frames
+ *
+ *  @param rtos Pointer to the sensor task
+ *  @param timeoutMs Longest wait in ms
+ *  @retval Pointer to the block, NULL after the timeout. Give it back with iam20680hpRtosRelease().
+ */
+IAM20680HP_rtosBlock_t *iam20680hpRtosReceive(IAM20680HP_rtos_t *rtos, uint32_t timeoutMs);
+
+/*! @brief Gives a block back to the pool
+ *
+ *  @param rtos Pointer to the sensor task
+ *  @param block Pointer to the block from iam20680hpRtosReceive()
+ */
+void iam20680hpRtosRelease(IAM20680HP_rtos_t *rtos, IAM20680HP_rtosBlock_t *block);
+
+#endif // IAM20680HP_RTOS
+
+#endif // IAM20680HP_RTOS_H_
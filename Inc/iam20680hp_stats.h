@@ -0,0 +1,149 @@
+/*
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#ifndef IAM20680HP_STATS_H_
+#define IAM20680HP_STATS_H_
+
+#include "iam20680hp.h"
+
+/* 
+ * Streaming statistics per axis (mean, variance, RMS, min/max) with constant memory, updated with whole FiFo blocks.
+ *
+ * Tumbling: statistics of consecutive windows of length samples, the output function is called at the end of every window. 
+ * Sliding: the window is split in IAM20680HP_STATS_SLOTS slots, the result covers the last (SLOTS - 1) full slots and the 
+ * current one, so between length * (SLOTS - 1) / SLOTS and length samples.
+ * Exponential (EWMA): alpha = 2^-shift, fixed-point mean and variance (West's recurrence).
+ *
+ * Tumbling and sliding use exact integer sums of the samples minus the first sample of a slot (int64), so there is no 
+ * rounding in the accumulation and no cancellation in the variance for the int16 data.
+ */
+
+#define IAM20680HP_STATS_SLOTS 8                //Slots of a sliding window
+#define IAM20680HP_STATS_MAX_LENGTH (1UL << 24) //Maximum window length (samples), keeps the slot sums in int64
+
+/*! 
+ * @brief Enum to hold the window mode.
+*/
+typedef enum
+{
+    IAM20680HP_STATS_TUMBLING = 0,          /**< Consecutive windows. */
+    IAM20680HP_STATS_SLIDING,               /**< Sliding window in slots. */
+    IAM20680HP_STATS_EWMA,                  /**< Exponentially weighted. */
+} IAM20680HP_statsMode_t;
+
+/*! 
+ * @brief Structure to hold the statistics of a window.
+*/
+typedef struct
+{
+    float mean[3];                          /**< Mean (LSB). */
+    float variance[3];                      /**< Variance (LSB^2). */
+    float rms[3];                           /**< Root mean square, including the mean (LSB). */
+    int16_t minimum[3];                     /**< Minimum (LSB), since the start for EWMA. */
+    int16_t maximum[3];                     /**< Maximum (LSB), since the start for EWMA. */
+    uint32_t count;                         /**< Number of samples. */
+} IAM20680HP_statsResult_t;
+
+/*! 
+ * @brief Output function, called at the end of every tumbling window.
+*/
+typedef void (*IAM20680HP_statsOutput_t)(const IAM20680HP_statsResult_t *result, void *context);
+
+/*! 
+ * @brief Structure to hold the sums of a slot.
+*/
+typedef struct
+{
+    int64_t sum[3];                         /**< Sum of (sample - offset). */
+    int64_t sumSquares[3];                  /**< Sum of (sample - offset)^2. */
+    int16_t offset[3];                      /**< First sample of the slot. */
+    int16_t minimum[3];                     /**< Minimum. */
+    int16_t maximum[3];                     /**< Maximum. */
+    uint32_t count;                         /**< Number of samples. */
+} IAM20680HP_statsSlot_t;
+
+/*! 
+ * @brief Structure to hold the statistics engine.
+*/
+typedef struct
+{
+    IAM20680HP_statsMode_t mode;                        /**< Window mode. */
+    IAM20680HP_statsSlot_t slots[IAM20680HP_STATS_SLOTS];   /**< Slots (tumbling: only the first). */
+    uint32_t slotLength;                                /**< Samples per slot. */
+    uint8_t current;                                    /**< Slot being filled. */
+    uint8_t fullSlots;                                  /**< Number of full slots (sliding). */
+    uint8_t shift;                                      /**< EWMA: alpha = 2^-shift. */
+    int64_t mean[3];                                    /**< EWMA mean (LSB * 2^16). */
+    int64_t variance[3];                                /**< EWMA variance (LSB^2 * 2^16). */
+    IAM20680HP_statsResult_t last;                      /**< Result of the last tumbling window. */
+    IAM20680HP_statsOutput_t output;                    /**< Output function, can be NULL. */
+    void *context;                                      /**< Passed to the output function. */
+} IAM20680HP_stats_t;
+
+/*! @brief Initialises the statistics engine
+ *
+ *  @param stats Pointer to the statistics engine
+ *  @param mode Window mode
+ *  @param length Window length in samples (tumbling, sliding: multiple of IAM20680HP_STATS_SLOTS) or shift (EWMA: 1 - 16)
+ *  @param output Output function for tumbling windows, can be NULL
+ *  @param context Passed to the output function
+ *  @retval IAM20680HP_OK if the statistics engine is initialised
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if a parameter is invalid
+ */
+IAM20680HP_err_t iam20680hpStatsInit(IAM20680HP_stats_t *stats, IAM20680HP_statsMode_t mode, uint32_t length, IAM20680HP_statsOutput_t output, void *context);
+
+/*! @brief Clears all samples, the settings are kept
+ *
+ *  @param stats Pointer to the statistics engine
+ */
+void iam20680hpStatsReset(IAM20680HP_stats_t *stats);
+
+/*! @brief Updates the statistics with the accel or gyro data of a block of FiFo frames
+ *
+ *  @param stats Pointer to the statistics engine
+ *  @param frames Pointer to the frames
+ *  @param count Number of frames
+ *  @param gyro If true, the gyro data will be used, if false, the accel data will be used
+ */
+void iam20680hpStatsUpdateFrames(IAM20680HP_stats_t *stats, const IAM20680HP_fifoData_t *frames, uint16_t count, bool gyro);
+
+/*! @brief Updates the statistics with a block of accelerometer samples (e.g. iam20680hpReadFifoAccelBlock())
+ *
+ *  @param stats Pointer to the statistics engine
+ *  @param accelData Pointer to the samples
+ *  @param count Number of samples
+ */
+void iam20680hpStatsUpdateAccel(IAM20680HP_stats_t *stats, const IAM20680HP_accelData_t *accelData, uint16_t count);
+
+/*! @brief Calculates the current statistics (sliding, EWMA) or returns the last tumbling window
+ *
+ *  @param stats Pointer to the statistics engine
+ *  @param result Pointer to the struct IAM20680HP_statsResult_t where the statistics will be stored
+ *  @retval IAM20680HP_OK if the statistics are calculated
+ *  @retval IAM20680HP_ERR_NOT_READY if there are no samples (or no complete tumbling window) yet
+ */
+IAM20680HP_err_t iam20680hpStatsResult(const IAM20680HP_stats_t *stats, IAM20680HP_statsResult_t *result);
+
+#endif // IAM20680HP_STATS_H_
@@ -0,0 +1,122 @@
+/*
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#ifndef IAM20680HP_TEMPCOMP_H_
+#define IAM20680HP_TEMPCOMP_H_
+
+#include "iam20680hp.h"
+
+/* 
+ * Temperature compensation of the gyro bias. During stationary periods the gyro bias is collected in temperature bins, 
+ * a polynomial (order 0 - 2) is fitted over the bins and subtracted from every sample. The fit only runs after a bin update,
+ * the correction per sample is fixed-point (32 bit multiply with 64 bit accumulate).
+ * Temperatures are in celcius * 100, as in IAM20680HP_fifoData_t.
+ */
+
+#define IAM20680HP_TEMPCOMP_ORDER 2                 //Default polynomial order
+#define IAM20680HP_TEMPCOMP_BINS 26                 //Number of temperature bins
+#define IAM20680HP_TEMPCOMP_MIN_TEMP (-4000)        //Lower limit of the first bin (celcius * 100)
+#define IAM20680HP_TEMPCOMP_BIN_WIDTH 500           //Width of a bin (celcius * 100)
+#define IAM20680HP_TEMPCOMP_BIN_WEIGHT 16           //Bias of a bin is averaged over the last (about) 16 updates
+#define IAM20680HP_TEMPCOMP_MIN_FRAMES 20           //Minimum frames in a block for a stationary update
+#define IAM20680HP_TEMPCOMP_STILL_GYRO 40           //Maximum gyro peak to peak (LSB) in a stationary block
+#define IAM20680HP_TEMPCOMP_STILL_ACCEL 200         //Maximum accel peak to peak (LSB) in a stationary block
+
+/*! 
+ * @brief Structure to hold one temperature bin.
+*/
+typedef struct
+{
+    int32_t bias[3];            /**< Gyro bias (X, Y, Z) in LSB * 16. */
+    int32_t temperature;        /**< Average temperature of the updates (celcius * 100). */
+    uint16_t count;             /**< Number of updates. */
+} IAM20680HP_tempCompBin_t;
+
+/*! 
+ * @brief Structure to hold the temperature compensation model.
+ *
+ * bias(t) = c0 + c1 * t + c2 * t^2, with t = temperature - referenceTemperature (celcius * 100).
+ * coefficient[axis][0] in LSB * 2^8, [1] in LSB * 2^20 per 0.01C, [2] in LSB * 2^32 per 0.01C^2.
+*/
+typedef struct
+{
+    IAM20680HP_tempCompBin_t bins[IAM20680HP_TEMPCOMP_BINS];    /**< Temperature bins. */
+    int32_t coefficient[3][3];                                  /**< Fixed-point polynomial per axis. */
+    int16_t referenceTemperature;                               /**< Reference temperature of the polynomial (celcius * 100). */
+    uint8_t order;                                              /**< Polynomial order (0 - 2), lower while there are not enough bins. */
+    uint8_t maxOrder;                                           /**< Requested polynomial order. */
+    uint32_t updates;                                           /**< Number of stationary updates. */
+    bool valid;                                                 /**< A polynomial is fitted. */
+} IAM20680HP_tempComp_t;
+
+/*! @brief Initialises the temperature compensation model (no correction until the first stationary update)
+ *
+ *  @param model Pointer to the model
+ *  @param order Polynomial order 0 - 2 (IAM20680HP_TEMPCOMP_ORDER)
+ *  @param referenceTemperature Reference temperature (celcius * 100), e.g. 2500
+ *  @retval IAM20680HP_OK if the model is initialised
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if the order is invalid
+ */
+IAM20680HP_err_t iam20680hpTempCompInit(IAM20680HP_tempComp_t *model, uint8_t order, int16_t referenceTemperature);
+
+/*! @brief Adds a stationary gyro bias estimate and fits the polynomial again
+ *
+ *  @param model Pointer to the model
+ *  @param temperature Temperature (celcius * 100)
+ *  @param gyroBias Gyro bias (X, Y, Z) in LSB * 16
+ *  @retval IAM20680HP_OK if the estimate is added
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if the temperature is out of the range of the bins
+ */
+IAM20680HP_err_t iam20680hpTempCompAddBias(IAM20680HP_tempComp_t *model, int16_t temperature, const int32_t *gyroBias);
+
+/*! @brief Checks if a drained block is stationary and adds its gyro bias to the model
+ *
+ *  The block is stationary if the gyro and accel peak to peak values are below IAM20680HP_TEMPCOMP_STILL_GYRO and 
+ *  IAM20680HP_TEMPCOMP_STILL_ACCEL. Call before iam20680hpTempCompApply() on the same block.
+ *
+ *  @param model Pointer to the model
+ *  @param fifoData Pointer to the frames (uncorrected)
+ *  @param frames Number of frames
+ *  @return true if the block was stationary and the model is updated
+ */
+bool iam20680hpTempCompUpdate(IAM20680HP_tempComp_t *model, const IAM20680HP_fifoData_t *fifoData, uint16_t frames);
+
+/*! @brief Subtracts the temperature dependent gyro bias from a block of frames (fixed-point)
+ *
+ *  @param model Pointer to the model
+ *  @param fifoData Pointer to the frames, corrected in place
+ *  @param frames Number of frames
+ */
+void iam20680hpTempCompApply(const IAM20680HP_tempComp_t *model, IAM20680HP_fifoData_t *fifoData, uint16_t frames);
+
+/*! @brief Calculates the gyro bias of the model at a temperature (fixed-point)
+ *
+ *  @param model Pointer to the model
+ *  @param temperature Temperature (celcius * 100)
+ *  @param gyroBias Pointer to the array (X, Y, Z) where the bias in LSB * 256 will be stored
+ */
+void iam20680hpTempCompBias(const IAM20680HP_tempComp_t *model, int16_t temperature, int32_t *gyroBias);
+
+#endif // IAM20680HP_TEMPCOMP_H_
@@ -0,0 +1,169 @@
+/*
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#ifndef IAM20680HP_VIBRATION_H_
+#define IAM20680HP_VIBRATION_H_
+
+#include "iam20680hp.h"
+
+/* 
+ * Vibration analysis: the accelerometer streams through the FiFo (accel only) and per axis a Hann windowed FFT with 50% 
+ * overlap is averaged (Welch) over IAM20680HP_VIBRATION_AVERAGES windows. Only the feature vector (RMS, peak, crest factor, 
+ * spectral peaks and band RMS) is passed to the output function, e.g. for the radio.
+ *
+ * IAM20680HP_VIBRATION_4KHZ: accel DLPF bypass (4kHz, 1046Hz bandwidth). The FiFo runs at the gyro rate of 8kHz, every 
+ * sample is stored twice and only every second is used. The accel stream is 48kB/s, more than a 400kHz I2C bus moves: 
+ * use a faster bus backend (see IAM20680HP_USE_HAL). IAM20680HP_VIBRATION_1KHZ: accel DLPF 7 (420Hz), 6kB/s.
+ */
+
+#define IAM20680HP_VIBRATION_FFT_SIZE 256       //Samples per FFT window, power of 2
+#define IAM20680HP_VIBRATION_AVERAGES 16        //Default number of windows per feature vector
+#define IAM20680HP_VIBRATION_PEAKS 4            //Spectral peaks per axis
+#define IAM20680HP_VIBRATION_BANDS 8            //Frequency bands per axis (equal width, DC excluded)
+
+/*! 
+ * @brief Enum to hold the sample rate of the vibration analysis.
+*/
+typedef enum
+{
+    IAM20680HP_VIBRATION_1KHZ = 0,          /**< 1kHz, accel DLPF 420Hz. */
+    IAM20680HP_VIBRATION_4KHZ,              /**< 4kHz, accel DLPF bypass (1046Hz). */
+} IAM20680HP_vibrationRate_t;
+
+/*! 
+ * @brief Structure to hold one feature vector. Amplitudes in LSB, frequencies in Hz.
+*/
+typedef struct
+{
+    float rms[3];                                               /**< RMS around the mean (time domain). */
+    float peak[3];                                              /**< Largest deviation from the mean. */
+    float crestFactor[3];                                       /**< peak / rms. */
+    float peakFrequency[3][IAM20680HP_VIBRATION_PEAKS];         /**< Frequency of the largest spectral peaks, largest first. */
+    float peakAmplitude[3][IAM20680HP_VIBRATION_PEAKS];         /**< Amplitude of the spectral peaks. */
+    float bandRms[3][IAM20680HP_VIBRATION_BANDS];               /**< RMS per frequency band (0 - sampleRate / 2). */
+    uint16_t sampleRate;                                        /**< Sample rate (Hz). */
+    uint16_t windows;                                           /**< Number of averaged windows. */
+    uint32_t lostSamples;                                       /**< Samples discarded after FiFo overflows since the previous vector. */
+} IAM20680HP_vibrationFeatures_t;
+
+/*! 
+ * @brief Output function, called for every feature vector.
+*/
+typedef void (*IAM20680HP_vibrationOutput_t)(const IAM20680HP_vibrationFeatures_t *features, void *context);
+
+/*! 
+ * @brief Structure to hold the state of the vibration analysis (about 7.3kB with the default FFT size, 7kB of it the 
+ * windows, spectra and FFT tables).
+*/
+typedef struct
+{
+    int16_t samples[3][IAM20680HP_VIBRATION_FFT_SIZE];          /**< Input window per axis. */
+    float power[3][IAM20680HP_VIBRATION_FFT_SIZE / 2];          /**< Sum of the squared FFT magnitudes. */
+    float real[IAM20680HP_VIBRATION_FFT_SIZE];                  /**< FFT work buffer. */
+    float imaginary[IAM20680HP_VIBRATION_FFT_SIZE];             /**< FFT work buffer. */
+    float window[IAM20680HP_VIBRATION_FFT_SIZE];                /**< Hann window. */
+    float cosine[IAM20680HP_VIBRATION_FFT_SIZE / 2];            /**< FFT twiddle factors. */
+    float sine[IAM20680HP_VIBRATION_FFT_SIZE / 2];              /**< FFT twiddle factors. */
+    int64_t sum[3];                                             /**< Sum of the samples since the previous vector. */
+    int64_t sumSquares[3];                                      /**< Sum of the squared samples. */
+    int16_t minimum[3];                                         /**< Minimum sample. */
+    int16_t maximum[3];                                         /**< Maximum sample. */
+    uint32_t count;                                             /**< Number of samples since the previous vector. */
+    uint32_t lostSamples;                                       /**< Samples discarded after FiFo overflows. */
+    uint16_t fill;                                              /**< Samples in the input window. */
+    uint16_t windows;                                           /**< Windows since the previous vector. */
+    uint16_t averages;                                          /**< Windows per feature vector. */
+    uint16_t sampleRate;                                        /**< Sample rate (Hz). */
+    uint8_t decimation;                                         /**< FiFo samples per used sample. */
+    uint8_t phase;                                              /**< FiFo samples since the last used sample. */
+    IAM20680HP_vibrationOutput_t output;                        /**< Output function. */
+    void *context;                                              /**< Passed to the output function. */
+    IAM20680HP_accelConfig_t savedAccelConfig;                  /**< Configuration before iam20680hpVibrationStart(). */
+    IAM20680HP_gyroConfig_t savedGyroConfig;                    /**< Configuration before iam20680hpVibrationStart(). */
+    uint8_t savedDlpf;                                          /**< Configuration before iam20680hpVibrationStart(). */
+    uint8_t savedDivider;                                       /**< Configuration before iam20680hpVibrationStart(). */
+    bool savedFifoEnable[5];                                    /**< FIFO_EN before iam20680hpVibrationStart() (temp, gyro x, y, z, accel). */
+    IAM20680HP_userControl_t savedUserControl;                  /**< USER_CTRL before iam20680hpVibrationStart() (FIFO_EN). */
+} IAM20680HP_vibration_t;
+
+/*! @brief Initialises the analysis without device configuration (e.g. for recorded data)
+ *
+ *  @param vibration Pointer to the analysis
+ *  @param sampleRate Sample rate (Hz) after decimation
+ *  @param decimation Input samples per used sample (1 = all)
+ *  @param averages Windows per feature vector
+ *  @param output Output function
+ *  @param context Passed to the output function
+ *  @retval IAM20680HP_OK if the analysis is initialised
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if a parameter is invalid
+ */
+IAM20680HP_err_t iam20680hpVibrationInit(IAM20680HP_vibration_t *vibration, uint16_t sampleRate, uint8_t decimation, uint16_t averages,
+                                         IAM20680HP_vibrationOutput_t output, void *context);
+
+/*! @brief Configures the device for the vibration analysis and starts the accelerometer FiFo stream
+ *
+ *  The configuration is saved for iam20680hpVibrationStop(), a failed write restores it right away.
+ *
+ *  @param vibration Pointer to the analysis
+ *  @param rate Sample rate
+ *  @param averages Windows per feature vector (IAM20680HP_VIBRATION_AVERAGES)
+ *  @param output Output function
+ *  @param context Passed to the output function
+ *  @retval IAM20680HP_OK if the analysis is started
+ *  @retval IAM20680HP_ERR_INVALID_PARAM if a parameter is invalid
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpVibrationStart(IAM20680HP_vibration_t *vibration, IAM20680HP_vibrationRate_t rate, uint16_t averages,
+                                          IAM20680HP_vibrationOutput_t output, void *context);
+
+/*! @brief Drains the accelerometer FiFo and processes the samples
+ *
+ *  Call at least every 10ms (4kHz) or 80ms (1kHz) with a 512 byte FiFo. After an overflow the FiFo is reset and the 
+ *  current window is discarded. The overflow follows from FIFO_COUNT (full or not a multiple of 6 bytes), INT_STATUS is 
+ *  not read so the interrupt status bits stay for the application.
+ *
+ *  @param vibration Pointer to the analysis
+ *  @retval IAM20680HP_OK if the FiFo is drained
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpVibrationDrain(IAM20680HP_vibration_t *vibration);
+
+/*! @brief Processes accelerometer samples
+ *
+ *  @param vibration Pointer to the analysis
+ *  @param samples Pointer to the samples
+ *  @param count Number of samples
+ */
+void iam20680hpVibrationProcess(IAM20680HP_vibration_t *vibration, const IAM20680HP_accelData_t *samples, uint16_t count);
+
+/*! @brief Stops the FiFo stream and restores the configuration of before iam20680hpVibrationStart() (also USER_CTRL FIFO_EN)
+ *
+ *  @param vibration Pointer to the analysis
+ *  @retval IAM20680HP_OK if the configuration is restored
+ *  @retval IAM20680HP_ERR_I2C if there is an error during I2C communication
+ */
+IAM20680HP_err_t iam20680hpVibrationStop(IAM20680HP_vibration_t *vibration);
+
+#endif // IAM20680HP_VIBRATION_H_
@@ -23,23 +23,220 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 
 Be careful with the scd41 instructions to stop almost always periodic measurement!
-Some delays are neccessary for the instructions to work, change to osdelay for rtos.
+Some delays are neccessary for the instructions to work, with IAM20680HP_RTOS they use osDelay.
 Some texts are copied from the datasheet of the sensor, to make it easier to understand the functions.
 
 */
 
 #include "iam20680hp.h"
+#include "iam20680hp_config.h"
 
+#if IAM20680HP_USE_HAL
 // Location of the I2C handler, or elsewhere
 #include "main.h"
 
 extern I2C_HandleTypeDef I2C_HANDLER;
 
 HAL_StatusTypeDef status;
+#endif
+#if IAM20680HP_RTOS
+#include "iam20680hp_rtos.h"
+#endif
+#if IAM20680HP_RECOVERY
+#include "iam20680hp_recovery.h"
+#endif
 IAM20680HP_err_t iam20680hpStatus;
 
 uint8_t data[20];
 
+static uint8_t iam20680hpAddress = IAM20680HP_I2C_ADDRESS;
+
+// Register shadow per device (0x68, 0x69), valid bit per register
+static uint8_t shadowValue[2][128];
+static uint8_t shadowValid[2][16];
+
+// Initial configuration, checked and assembled at compile time (iam20680hp_config.h)
+static const uint8_t initTable[] = IAM20680HP_INIT_TABLE;
+_Static_assert(sizeof(initTable) <= sizeof(data), "initTable is sent from data[]");
+
+_Static_assert(sizeof(IAM20680HP_fifoData_t) == IAM20680HP_FIFO_FRAME_SIZE, "FIFO frames are decoded in place");
+_Static_assert(sizeof(IAM20680HP_accelData_t) == IAM20680HP_FIFO_ACCEL_FRAME_SIZE, "FIFO frames are decoded in place");
+
+
+/*
+ * Decodes one raw FIFO frame (big endian, accel - temperature - gyro). All bytes are read before the 
+ * result is written, so raw and fifoData can point to the same memory.
+ */
+static void iam20680hpDecodeFifoFrame(const uint8_t *raw, IAM20680HP_fifoData_t *fifoData)
+{
+    int16_t xAccel = (int16_t)(raw[0] << 8 | raw[1]);
+    int16_t yAccel = (int16_t)(raw[2] << 8 | raw[3]);
+    int16_t zAccel = (int16_t)(raw[4] << 8 | raw[5]);
+    int16_t temperature = (int16_t)(raw[6] << 8 | raw[7]);
+    int16_t xGyro = (int16_t)(raw[8] << 8 | raw[9]);
+    int16_t yGyro = (int16_t)(raw[10] << 8 | raw[11]);
+    int16_t zGyro = (int16_t)(raw[12] << 8 | raw[13]);
+
+    fifoData->accelData.xAccel = xAccel;
+    fifoData->accelData.yAccel = yAccel;
+    fifoData->accelData.zAccel = zAccel;
+    fifoData->temperature = ((temperature / 326.8) + 25) * 100;
+    fifoData->gyroData.xGyro = xGyro;
+    fifoData->gyroData.yGyro = yGyro;
+    fifoData->gyroData.zGyro = zGyro;
+}
+
+#if IAM20680HP_USE_HAL
+#if IAM20680HP_RECOVERY
+// Register of the last register select, selected again before a repeated read
+static uint8_t busRegister;
+
+/*
+ * Timeout of a transfer of size bytes (ms): twice the duration at IAM20680HP_I2C_BUS_HZ (9 bit times per byte, register 
+ * address, start, device address and stop as iam20680hpBusDuration()) plus IAM20680HP_I2C_RETRY_TIMEOUT
+ */
+static uint32_t iam20680hpRetryTimeout(uint16_t size)
+{
+    uint32_t bits = 30 + ((uint32_t)size + 1) * 9;
+    return (uint32_t)((uint64_t)bits * 2000 / IAM20680HP_I2C_BUS_HZ) + IAM20680HP_I2C_RETRY_TIMEOUT;
+}
+
+/*
+ * Runs the health check after a transfer failed after all retries, before the next transfer (not from the failing 
+ * transfer itself). The check uses data[], the content of the caller is kept.
+ */
+static void iam20680hpRecoveryDeferredCheck(void)
+{
+    static bool active;
+
+    if (active || !iam20680hpRecoveryDue())
+    {
+        return;
+    }
+
+    active = true;
+    uint8_t callerData[sizeof(data)];
+    memcpy(callerData, data, sizeof(data));
+    bool restored;
+    iam20680hpRecoveryCheck(&restored);
+    memcpy(data, callerData, sizeof(data));
+
+    // Failures of the check itself do not arm the next check, only failures of the caller's transfers
+    iam20680hpRecoveryDue();
+    active = false;
+}
+#endif
+
+IAM20680HP_err_t iam20680hpBusTransmit(uint8_t *buffer, uint16_t size)
+{
+#if IAM20680HP_RECOVERY
+    iam20680hpRecoveryDeferredCheck();
+    for (uint8_t attempt = 0;; attempt++)
+    {
+        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(iam20680hpAddress << 1), buffer, size, iam20680hpRetryTimeout(size));
+        if (status == HAL_OK || !iam20680hpRecoveryRetry(attempt))
+            break;
+    }
+    busRegister = buffer[0];
+#else
+    status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(iam20680hpAddress << 1), buffer, size, IAM20680HP_I2C_TIMEOUT);
+#endif
+    if (status != HAL_OK)
+    {
+        return IAM20680HP_ERR_I2C;
+    }
+    iam20680hpShadowRecord(buffer, size);
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpBusReceive(uint8_t *buffer, uint16_t size)
+{
+#if IAM20680HP_RECOVERY
+    for (uint8_t attempt = 0;; attempt++)
+    {
+        status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(iam20680hpAddress << 1), buffer, size, iam20680hpRetryTimeout(size));
+
+        // A FiFo read is not repeated, the bytes read are gone (the next drain realigns)
+        if (status == HAL_OK || busRegister == IAM20680HP_FIFO_R_W || !iam20680hpRecoveryRetry(attempt))
+            break;
+
+        // A partial read moved the register pointer
+        HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(iam20680hpAddress << 1), &busRegister, 1, iam20680hpRetryTimeout(1));
+    }
+#else
+    status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(iam20680hpAddress << 1), buffer, size, IAM20680HP_I2C_TIMEOUT);
+#endif
+    if (status != HAL_OK)
+    {
+        return IAM20680HP_ERR_I2C;
+    }
+    return IAM20680HP_OK;
+}
+
+void iam20680hpBusDelay(uint32_t ms)
+{
+#if IAM20680HP_RTOS
+    iam20680hpRtosDelay(ms);
+#else
+    HAL_Delay(ms);
+#endif
+}
+#endif
+
+
+IAM20680HP_err_t iam20680hpSelectDevice(uint8_t address)
+{
+    if (address != 0x68 && address != 0x69)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    iam20680hpAddress = address;
+    return IAM20680HP_OK;
+}
+
+uint8_t iam20680hpSelectedDevice(void)
+{
+    return iam20680hpAddress;
+}
+
+void iam20680hpShadowRecord(const uint8_t *buffer, uint16_t size)
+{
+    uint8_t device = iam20680hpAddress & 0x01;
+
+    for (uint16_t i = 1; i < size; i++)
+    {
+        uint8_t reg = (uint8_t)(buffer[0] + i - 1) & 0x7F;
+        uint8_t value = buffer[i];
+
+        if (reg == IAM20680HP_PWR_MGMT_1 && (value & 0x80))
+        {
+            // Device reset: back to the default values
+            memset(shadowValid[device], 0, sizeof(shadowValid[device]));
+            continue;
+        }
+        if (reg == IAM20680HP_FIFO_R_W || reg == IAM20680HP_SIGNAL_PATH_RESET || reg == IAM20680HP_INT_STATUS)
+        {
+            continue;
+        }
+        if (reg == IAM20680HP_USER_CTRL)
+        {
+            // FIFO_RST and SIG_COND_RST clear themselves
+            value &= (uint8_t)~0x05;
+        }
+        shadowValue[device][reg] = value;
+        shadowValid[device][reg >> 3] |= (uint8_t)(1 << (reg & 0x07));
+    }
+}
+
+bool iam20680hpShadowGet(uint8_t reg, uint8_t *value)
+{
+    uint8_t device = iam20680hpAddress & 0x01;
+
+    reg &= 0x7F;
+    *value = shadowValue[device][reg];
+    return (shadowValid[device][reg >> 3] >> (reg & 0x07)) & 0x01;
+}
 
 IAM20680HP_err_t iam20680hpCheckDeviceID()
 {
@@ -47,14 +244,14 @@ IAM20680HP_err_t iam20680hpCheckDeviceID()
 
     data[0] = IAM20680HP_WHO_AM_I;
 
-    status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-    if (status != HAL_OK)
+    iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+    if (iam20680hpStatus != IAM20680HP_OK)
     {
         return IAM20680HP_ERR_I2C;
     }
 
-    status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), &deviceID, 1, IAM20680HP_I2C_TIMEOUT);
-    if (status != HAL_OK)
+    iam20680hpStatus = iam20680hpBusReceive(&deviceID, 1);
+    if (iam20680hpStatus != IAM20680HP_OK)
     {
         return IAM20680HP_ERR_I2C;
     }
@@ -73,14 +270,14 @@ IAM20680HP_err_t iam20680hpResetDevice()
     // For the IAM20680HP, the PWR_MGMT_1 register is used to reset the device, set to "or 0x80" to reset
     data[0] = IAM20680HP_PWR_MGMT_1;
     data[1] = 0x81;
-    status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 2, IAM20680HP_I2C_TIMEOUT);
+    iam20680hpStatus = iam20680hpBusTransmit(data, 2);
 
-    if (status != HAL_OK)
+    if (iam20680hpStatus != IAM20680HP_OK)
     {
         return IAM20680HP_ERR_I2C;
     }
 
-    HAL_Delay(50);
+    iam20680hpBusDelay(50);
     return IAM20680HP_OK;
 }
 
@@ -88,15 +285,15 @@ IAM20680HP_err_t iam20680hpReadSelfTestRegisters(IAM20680HP_selfTest_t *selfTest
 {
 
     data[0] = IAM20680HP_SELF_TEST_X_GYRO;
-    status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-    if (status != HAL_OK)
+    iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+    if (iam20680hpStatus != IAM20680HP_OK)
     {
         return IAM20680HP_ERR_I2C;
     }
 
     memset(data, 0, 6);
-    status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 6, IAM20680HP_I2C_TIMEOUT);
-    if (status != HAL_OK)
+    iam20680hpStatus = iam20680hpBusReceive(data, 6);
+    if (iam20680hpStatus != IAM20680HP_OK)
     {
         return IAM20680HP_ERR_I2C;
     }
@@ -108,7 +305,405 @@ IAM20680HP_err_t iam20680hpReadSelfTestRegisters(IAM20680HP_selfTest_t *selfTest
     selfTest->selfTestYAccel = data[4];
     selfTest->selfTestZAccel = data[5];
 
-    // TODO - Function to check the values against the given formula/values
+    // The values are checked against the formula of AN-000143 by iam20680hpRunSelfTest()
+
+    return IAM20680HP_OK;
+}
+
+/*
+ * Configuration saved and restored around the self-test and the bias calibration
+ */
+typedef struct
+{
+    uint8_t divider;
+    uint8_t dlpf;
+    IAM20680HP_gyroConfig_t gyroConfig;
+    IAM20680HP_accelConfig_t accelConfig;
+    bool fifo[5];
+    IAM20680HP_userControl_t userControl;
+} IAM20680HP_savedConfig_t;
+
+static IAM20680HP_err_t iam20680hpSaveConfig(IAM20680HP_savedConfig_t *saved)
+{
+    IAM20680HP_err_t result;
+
+    memset(saved, 0, sizeof(*saved));
+
+    result = iam20680SampleRateDivider(&saved->divider, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    result = iam20680hpConfigDlpfCfg(&saved->dlpf, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    result = iam20680hpGyroConfig(&saved->gyroConfig, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    result = iam20680hpAccelConfig(&saved->accelConfig, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    result = iam20680hpFiFoEnable(&saved->fifo[0], &saved->fifo[1], &saved->fifo[2], &saved->fifo[3], &saved->fifo[4], false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    return iam20680hpUserControl(&saved->userControl, false);
+}
+
+static IAM20680HP_err_t iam20680hpRestoreConfig(IAM20680HP_savedConfig_t *saved)
+{
+    IAM20680HP_err_t result;
+
+    result = iam20680SampleRateDivider(&saved->divider, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    result = iam20680hpConfigDlpfCfg(&saved->dlpf, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    result = iam20680hpGyroConfig(&saved->gyroConfig, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    result = iam20680hpAccelConfig(&saved->accelConfig, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    result = iam20680hpFiFoEnable(&saved->fifo[0], &saved->fifo[1], &saved->fifo[2], &saved->fifo[3], &saved->fifo[4], true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    // The FiFo holds samples of the temporary configuration
+    saved->userControl.fifo_rst = 1;
+    saved->userControl.sig_cond_rst = 0;
+    return iam20680hpUserControl(&saved->userControl, true);
+}
+
+/*
+ * Sets 1kHz with DLPF (gyro 92Hz, accel 99Hz) without self-test, the full scale ranges are set to gyroFsSel and accelFsSel.
+ * Used for the FiFo captures: a drain every IAM20680HP_SELF_TEST_SETTLE_MS fits in the smallest FiFo.
+ */
+static IAM20680HP_err_t iam20680hpSetCaptureConfig(IAM20680HP_savedConfig_t *saved, uint8_t gyroFsSel, uint8_t accelFsSel)
+{
+    IAM20680HP_err_t result;
+
+    uint8_t divider = 0;
+    result = iam20680SampleRateDivider(&divider, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    uint8_t dlpf = 2;
+    result = iam20680hpConfigDlpfCfg(&dlpf, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    IAM20680HP_gyroConfig_t gyroConfig;
+    memset(&gyroConfig, 0, sizeof(gyroConfig));
+    gyroConfig.FS_Sel = gyroFsSel;
+    result = iam20680hpGyroConfig(&gyroConfig, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    IAM20680HP_accelConfig_t accelConfig = saved->accelConfig;
+    accelConfig.xAccelSelfTest = 0;
+    accelConfig.yAccelSelfTest = 0;
+    accelConfig.zAccelSelfTest = 0;
+    accelConfig.AFS_Sel = accelFsSel;
+    accelConfig.fifoSize = 0;
+    accelConfig.FChoice = 0;
+    accelConfig.dlpfCfg = 2;
+    result = iam20680hpAccelConfig(&accelConfig, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    iam20680hpBusDelay(IAM20680HP_SELF_TEST_SETTLE_MS);
+    return IAM20680HP_OK;
+}
+
+/*
+ * Averages samples frames of accel and gyro data from the FiFo (accel, temperature and gyro enabled). 
+ * The FiFo is reset at the start and drained every IAM20680HP_SELF_TEST_SETTLE_MS.
+ * 
+ * With rejected != NULL every drain is a chunk: chunks of which the mean of any axis deviates more than 
+ * IAM20680HP_CALIB_OUTLIER_MAD times the median absolute deviation from the median (e.g. a bump) are not used.
+ */
+static IAM20680HP_err_t iam20680hpFifoCaptureAverage(uint16_t samples, float *accel, float *gyro, uint8_t *rejected)
+{
+    IAM20680HP_err_t result;
+    IAM20680HP_fifoData_t frames[512 / IAM20680HP_FIFO_FRAME_SIZE];
+    int32_t chunkSum[IAM20680HP_CALIB_MAX_CHUNKS][6];
+    uint16_t chunkCount[IAM20680HP_CALIB_MAX_CHUNKS];
+    uint8_t chunks = 0;
+    uint16_t captured = 0;
+    uint16_t framesRead;
+
+    memset(chunkSum, 0, sizeof(chunkSum));
+    memset(chunkCount, 0, sizeof(chunkCount));
+
+    bool enable = true;
+    result = iam20680hpFiFoEnable(&enable, &enable, &enable, &enable, &enable, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    IAM20680HP_userControl_t userControl;
+    memset(&userControl, 0, sizeof(userControl));
+    result = iam20680hpUserControl(&userControl, false);
+    if (result != IAM20680HP_OK)
+        return result;
+    userControl.fifo_en = 1;
+    userControl.fifo_rst = 1;
+    userControl.sig_cond_rst = 0;
+    result = iam20680hpUserControl(&userControl, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    for (uint16_t attempt = 0; captured < samples; attempt++)
+    {
+        if (attempt > samples / 10 + 10)
+        {
+            return IAM20680HP_ERR_NOT_READY;
+        }
+
+        iam20680hpBusDelay(IAM20680HP_SELF_TEST_SETTLE_MS);
+        result = iam20680hpReadFifoBlock(frames, sizeof(frames) / sizeof(frames[0]), &framesRead);
+        if (result != IAM20680HP_OK)
+            return result;
+        if (framesRead == 0)
+            continue;
+
+        // The last chunk takes the rest when there are more drains than chunks
+        uint8_t chunk = chunks < IAM20680HP_CALIB_MAX_CHUNKS ? chunks++ : IAM20680HP_CALIB_MAX_CHUNKS - 1;
+
+        for (uint16_t i = 0; i < framesRead && captured < samples; i++, captured++)
+        {
+            chunkSum[chunk][0] += frames[i].accelData.xAccel;
+            chunkSum[chunk][1] += frames[i].accelData.yAccel;
+            chunkSum[chunk][2] += frames[i].accelData.zAccel;
+            chunkSum[chunk][3] += frames[i].gyroData.xGyro;
+            chunkSum[chunk][4] += frames[i].gyroData.yGyro;
+            chunkSum[chunk][5] += frames[i].gyroData.zGyro;
+            chunkCount[chunk]++;
+        }
+    }
+
+    enable = false;
+    result = iam20680hpFiFoEnable(&enable, &enable, &enable, &enable, &enable, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    bool useChunk[IAM20680HP_CALIB_MAX_CHUNKS];
+    memset(useChunk, 1, sizeof(useChunk));
+
+    if (rejected != NULL)
+    {
+        *rejected = 0;
+        for (uint8_t channel = 0; channel < 6 && chunks > 2; channel++)
+        {
+            float mean[IAM20680HP_CALIB_MAX_CHUNKS];
+            float sorted[IAM20680HP_CALIB_MAX_CHUNKS];
+
+            // Median and median absolute deviation of the chunk means (insertion sort, few chunks)
+            for (uint8_t i = 0; i < chunks; i++)
+            {
+                mean[i] = (float)chunkSum[i][channel] / chunkCount[i];
+                float value = mean[i];
+                int8_t j = (int8_t)i - 1;
+                for (; j >= 0 && sorted[j] > value; j--)
+                {
+                    sorted[j + 1] = sorted[j];
+                }
+                sorted[j + 1] = value;
+            }
+            float median = sorted[chunks / 2];
+
+            for (uint8_t i = 0; i < chunks; i++)
+            {
+                float value = mean[i] > median ? mean[i] - median : median - mean[i];
+                int8_t j = (int8_t)i - 1;
+                for (; j >= 0 && sorted[j] > value; j--)
+                {
+                    sorted[j + 1] = sorted[j];
+                }
+                sorted[j + 1] = value;
+            }
+            float limit = IAM20680HP_CALIB_OUTLIER_MAD * sorted[chunks / 2] + 1.0f;
+
+            for (uint8_t i = 0; i < chunks; i++)
+            {
+                float deviation = mean[i] > median ? mean[i] - median : median - mean[i];
+                if (deviation > limit && useChunk[i])
+                {
+                    useChunk[i] = false;
+                    (*rejected)++;
+                }
+            }
+        }
+    }
+
+    for (uint8_t channel = 0; channel < 6; channel++)
+    {
+        int32_t sum = 0;
+        uint32_t count = 0;
+        for (uint8_t i = 0; i < chunks; i++)
+        {
+            if (useChunk[i])
+            {
+                sum += chunkSum[i][channel];
+                count += chunkCount[i];
+            }
+        }
+        float average = count > 0 ? (float)sum / count : 0.0f;
+        if (channel < 3)
+        {
+            accel[channel] = average;
+        }
+        else
+        {
+            gyro[channel - 3] = average;
+        }
+    }
+
+    return IAM20680HP_OK;
+}
+
+/*
+ * Factory self-test value (LSB) of a self-test code, AN-000143: ST_OTP = (2620 / 2^FS) * 1.01^(code - 1), FS = 0
+ */
+static float iam20680hpSelfTestFactoryValue(uint8_t code)
+{
+    float value = 2620.0f;
+
+    if (code == 0)
+    {
+        return 0.0f;
+    }
+    for (uint8_t i = 1; i < code; i++)
+    {
+        value *= 1.01f;
+    }
+    return value;
+}
+
+/*
+ * Captures the normal output and the output with self-test excitation with the settings of AN-000143 (1kHz, gyro
+ * DLPF 92Hz, accel DLPF 99Hz, 250dps and 2g). The caller restores saved, also after an error.
+ */
+static IAM20680HP_err_t iam20680hpSelfTestCapture(IAM20680HP_savedConfig_t *saved, uint16_t samples, float *accelNormal, float *gyroNormal, float *accelSelfTest, float *gyroSelfTest)
+{
+    IAM20680HP_err_t result;
+
+    result = iam20680hpSetCaptureConfig(saved, 0, 0);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    // Normal output
+    result = iam20680hpFifoCaptureAverage(samples, accelNormal, gyroNormal, NULL);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    // Output with self-test excitation
+    IAM20680HP_gyroConfig_t gyroConfig;
+    memset(&gyroConfig, 0, sizeof(gyroConfig));
+    gyroConfig.xGyroSelfTest = 1;
+    gyroConfig.yGyroSelfTest = 1;
+    gyroConfig.zGyroSelfTest = 1;
+    result = iam20680hpGyroConfig(&gyroConfig, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    IAM20680HP_accelConfig_t accelConfig;
+    memset(&accelConfig, 0, sizeof(accelConfig));
+    result = iam20680hpAccelConfig(&accelConfig, false);
+    if (result != IAM20680HP_OK)
+        return result;
+    accelConfig.xAccelSelfTest = 1;
+    accelConfig.yAccelSelfTest = 1;
+    accelConfig.zAccelSelfTest = 1;
+    result = iam20680hpAccelConfig(&accelConfig, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    iam20680hpBusDelay(IAM20680HP_SELF_TEST_SETTLE_MS);
+
+    return iam20680hpFifoCaptureAverage(samples, accelSelfTest, gyroSelfTest, NULL);
+}
+
+IAM20680HP_err_t iam20680hpRunSelfTest(IAM20680HP_selfTestResult_t *selfTestResult, uint16_t samples)
+{
+    IAM20680HP_err_t result;
+
+    if (samples == 0)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+    memset(selfTestResult, 0, sizeof(*selfTestResult));
+
+    IAM20680HP_selfTest_t selfTest;
+    result = iam20680hpReadSelfTestRegisters(&selfTest);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    IAM20680HP_savedConfig_t saved;
+    result = iam20680hpSaveConfig(&saved);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    float accelNormal[3], gyroNormal[3], accelSelfTest[3], gyroSelfTest[3];
+    result = iam20680hpSelfTestCapture(&saved, samples, accelNormal, gyroNormal, accelSelfTest, gyroSelfTest);
+
+    // Restored after every capture, also after a failed one; the first error is returned
+    IAM20680HP_err_t restore = iam20680hpRestoreConfig(&saved);
+    if (result != IAM20680HP_OK)
+        return result;
+    if (restore != IAM20680HP_OK)
+        return restore;
+
+    // Pass/fail, AN-000143 (131 LSB/dps at 250dps, 16384 LSB/g at 2g)
+    const uint8_t gyroCodes[3] = {selfTest.selfTestXGyro, selfTest.selfTestYGyro, selfTest.selfTestZGyro};
+    const uint8_t accelCodes[3] = {selfTest.selfTestXAccel, selfTest.selfTestYAccel, selfTest.selfTestZAccel};
+
+    selfTestResult->pass = true;
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+        float gyroResponse = gyroSelfTest[axis] - gyroNormal[axis];
+        float gyroFactory = iam20680hpSelfTestFactoryValue(gyroCodes[axis]);
+        selfTestResult->gyroResponse[axis] = (int16_t)gyroResponse;
+        if (gyroFactory != 0.0f)
+        {
+            selfTestResult->gyroRatio[axis] = gyroResponse / gyroFactory;
+            selfTestResult->gyroPass[axis] = selfTestResult->gyroRatio[axis] > 0.5f;
+        }
+        else
+        {
+            selfTestResult->gyroPass[axis] = (gyroResponse < 0 ? -gyroResponse : gyroResponse) >= 60.0f * 131.0f;
+        }
+        if ((gyroNormal[axis] < 0 ? -gyroNormal[axis] : gyroNormal[axis]) > 20.0f * 131.0f)
+        {
+            selfTestResult->gyroPass[axis] = false;
+        }
+
+        float accelResponse = accelSelfTest[axis] - accelNormal[axis];
+        float accelFactory = iam20680hpSelfTestFactoryValue(accelCodes[axis]);
+        selfTestResult->accelResponse[axis] = (int16_t)accelResponse;
+        if (accelFactory != 0.0f)
+        {
+            selfTestResult->accelRatio[axis] = accelResponse / accelFactory;
+            selfTestResult->accelPass[axis] = selfTestResult->accelRatio[axis] > 0.5f && selfTestResult->accelRatio[axis] < 1.5f;
+        }
+        else
+        {
+            float absResponse = accelResponse < 0 ? -accelResponse : accelResponse;
+            selfTestResult->accelPass[axis] = absResponse >= 0.225f * 16384.0f && absResponse <= 0.675f * 16384.0f;
+        }
+
+        if (!selfTestResult->gyroPass[axis] || !selfTestResult->accelPass[axis])
+        {
+            selfTestResult->pass = false;
+        }
+    }
 
     return IAM20680HP_OK;
 }
@@ -126,8 +721,8 @@ IAM20680HP_err_t iam20680hpGyroOffsetAdjustment(IAM20680HP_gyroOffset_t *gyroOff
         data[5] = (uint8_t)(gyroOffset->offsetZGyro >> 8);
         data[6] = (uint8_t)(gyroOffset->offsetZGyro);
 
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 7, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 7);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
@@ -135,15 +730,15 @@ IAM20680HP_err_t iam20680hpGyroOffsetAdjustment(IAM20680HP_gyroOffset_t *gyroOff
     else
     {
         data[0] = IAM20680HP_XG_OFFS_USRH;
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
 
         memset(data, 0, 6);
-        status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 6, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusReceive(data, 6);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
@@ -163,8 +758,8 @@ IAM20680HP_err_t iam20680SampleRateDivider(uint8_t *sampleRateDivider, bool writ
         data[0] = IAM20680HP_SMPLRT_DIV;
         data[1] = *sampleRateDivider;
 
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 2, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 2);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
@@ -172,14 +767,14 @@ IAM20680HP_err_t iam20680SampleRateDivider(uint8_t *sampleRateDivider, bool writ
     else
     {
         data[0] = IAM20680HP_SMPLRT_DIV;
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
 
-        status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusReceive(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
@@ -196,15 +791,15 @@ IAM20680HP_err_t iam20680hpConfigFifo(bool *fifoEnabled, bool writeFifo)
     {
         data[0] = IAM20680HP_CONFIG;
 
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
 
         data[0] = 0;
-        status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusReceive(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
@@ -219,8 +814,8 @@ IAM20680HP_err_t iam20680hpConfigFifo(bool *fifoEnabled, bool writeFifo)
         }
 
         data[0] = IAM20680HP_CONFIG;
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 2, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 2);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
@@ -228,14 +823,14 @@ IAM20680HP_err_t iam20680hpConfigFifo(bool *fifoEnabled, bool writeFifo)
     else
     {
         data[0] = IAM20680HP_CONFIG;
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
 
-        status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusReceive(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
@@ -264,15 +859,15 @@ IAM20680HP_err_t iam20680hpConfigExtSync(uint8_t *extSyncSet, bool writeExtSyncS
     {
         data[0] = IAM20680HP_CONFIG;
 
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
 
         data[0] = 0;
-        status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusReceive(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
@@ -281,8 +876,8 @@ IAM20680HP_err_t iam20680hpConfigExtSync(uint8_t *extSyncSet, bool writeExtSyncS
         data[1] = data[0] | (*extSyncSet << 3);
 
         data[0] = IAM20680HP_CONFIG;
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 2, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 2);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
@@ -290,14 +885,14 @@ IAM20680HP_err_t iam20680hpConfigExtSync(uint8_t *extSyncSet, bool writeExtSyncS
     else
     {
         data[0] = IAM20680HP_CONFIG;
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
 
-        status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusReceive(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
@@ -319,15 +914,15 @@ IAM20680HP_err_t iam20680hpConfigDlpfCfg(uint8_t *dlpf, bool writeDlpf)
     {
         data[0] = IAM20680HP_CONFIG;
 
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
 
         data[0] = 0;
-        status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusReceive(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
@@ -335,8 +930,8 @@ IAM20680HP_err_t iam20680hpConfigDlpfCfg(uint8_t *dlpf, bool writeDlpf)
         data[0] = data[0] & 0xF8; // 0b11111000;
         data[1] = data[0] | *dlpf;
         data[0] = IAM20680HP_CONFIG;
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 2, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 2);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
@@ -344,14 +939,14 @@ IAM20680HP_err_t iam20680hpConfigDlpfCfg(uint8_t *dlpf, bool writeDlpf)
     else
     {
         data[0] = IAM20680HP_CONFIG;
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
 
-        status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusReceive(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
@@ -384,8 +979,8 @@ IAM20680HP_err_t iam20680hpGyroConfig(IAM20680HP_gyroConfig_t *gyro, bool writeC
         data[1] = data[1] | (gyro->FS_Sel << 3);
         data[1] = data[1] | (gyro->FChoice << 0);
 
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 2, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 2);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
@@ -393,15 +988,15 @@ IAM20680HP_err_t iam20680hpGyroConfig(IAM20680HP_gyroConfig_t *gyro, bool writeC
     else
     {
         data[0] = IAM20680HP_GYRO_CONFIG;
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
 
         data[0] = 0;
-        status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusReceive(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
@@ -444,8 +1039,8 @@ IAM20680HP_err_t iam20680hpAccelConfig(IAM20680HP_accelConfig_t *accel, bool wri
         data[1] = data[1] | (accel->zAccelSelfTest << 5);
         data[1] = data[1] | (accel->AFS_Sel << 3);
 
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 2, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 2);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
@@ -457,8 +1052,8 @@ IAM20680HP_err_t iam20680hpAccelConfig(IAM20680HP_accelConfig_t *accel, bool wri
         data[1] = data[1] | (accel->FChoice << 3);
         data[1] = data[1] | (accel->dlpfCfg << 0);
 
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 2, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 2);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
@@ -466,15 +1061,15 @@ IAM20680HP_err_t iam20680hpAccelConfig(IAM20680HP_accelConfig_t *accel, bool wri
     else
     {
         data[0] = IAM20680HP_ACCEL_CONFIG;
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
 
         data[0] = 0;
-        status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 2, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusReceive(data, 2);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
@@ -515,8 +1110,8 @@ IAM20680HP_err_t iam20680hpLowPowerMode(bool *enableLPM, uint8_t *avgFilterCfg,
         data[1] = data[1] | (*avgFilterCfg << 4);
         data[1] = data[1] | (*womMode << 0);
 
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 2, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 2);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
@@ -524,15 +1119,15 @@ IAM20680HP_err_t iam20680hpLowPowerMode(bool *enableLPM, uint8_t *avgFilterCfg,
     else
     {
         data[0] = IAM20680HP_LP_MODE_CFG;
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
 
         data[0] = 0;
-        status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 2, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusReceive(data, 2);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
@@ -545,572 +1140,1089 @@ IAM20680HP_err_t iam20680hpLowPowerMode(bool *enableLPM, uint8_t *avgFilterCfg,
     return IAM20680HP_OK;
 }
 
-IAM20680HP_err_t iam20680hpWakeOnMotionThreshold(uint8_t *womThreshold, bool writeWomThreshold)
+IAM20680HP_err_t iam20680hpWakeOnMotionThreshold(uint8_t *womThreshold, bool writeWomThreshold)
+{
+
+    if (writeWomThreshold)
+    {
+        data[0] = IAM20680HP_ACCEL_WOM_THR;
+        data[1] = *womThreshold;
+
+        iam20680hpStatus = iam20680hpBusTransmit(data, 2);
+        if (iam20680hpStatus != IAM20680HP_OK)
+        {
+            return IAM20680HP_ERR_I2C;
+        }
+    }
+    else
+    {
+        data[0] = IAM20680HP_ACCEL_WOM_THR;
+
+        iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
+        {
+            return IAM20680HP_ERR_I2C;
+        }
+
+        iam20680hpStatus = iam20680hpBusReceive(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
+        {
+            return IAM20680HP_ERR_I2C;
+        }
+
+        *womThreshold = data[0];
+    }
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpFiFoEnable(bool *tempFiFo, bool *gyroX, bool *gyroY, bool *gyroZ, bool *accel, bool writeFiFo)
+{
+    if (writeFiFo)
+    {
+        data[0] = IAM20680HP_FIFO_EN;
+        data[1] = 0;
+        data[1] = data[1] | (*tempFiFo << 7);
+        data[1] = data[1] | (*gyroX << 6);
+        data[1] = data[1] | (*gyroY << 5);
+        data[1] = data[1] | (*gyroZ << 4);
+        data[1] = data[1] | (*accel << 3);
+
+        iam20680hpStatus = iam20680hpBusTransmit(data, 2);
+        if (iam20680hpStatus != IAM20680HP_OK)
+        {
+            return IAM20680HP_ERR_I2C;
+        }
+    }
+    else
+    {
+        data[0] = IAM20680HP_FIFO_EN;
+        iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
+        {
+            return IAM20680HP_ERR_I2C;
+        }
+
+        iam20680hpStatus = iam20680hpBusReceive(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
+        {
+            return IAM20680HP_ERR_I2C;
+        }
+
+        *tempFiFo = (data[0] & 0x80) >> 7; // 0b10000000;
+        *gyroX = (data[0] & 0x40) >> 6;    // 0b01000000;
+        *gyroY = (data[0] & 0x20) >> 5;    // 0b00100000;
+        *gyroZ = (data[0] & 0x10) >> 4;    // 0b00010000;
+        *accel = (data[0] & 0x08) >> 3;    // 0b00001000;
+    }
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpReadFsyncInterruptStatus(bool *fsyncInt)
+{
+    data[0] = IAM20680HP_FSYNC_INT;
+
+    iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+    if (iam20680hpStatus != IAM20680HP_OK)
+    {
+        return IAM20680HP_ERR_I2C;
+    }
+
+    iam20680hpStatus = iam20680hpBusReceive(data, 1);
+    if (iam20680hpStatus != IAM20680HP_OK)
+    {
+        return IAM20680HP_ERR_I2C;
+    }
+
+    if (data[0] & 0x80)
+    {
+        *fsyncInt = true;
+    }
+    else
+    {
+        *fsyncInt = false;
+    }
+
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpIntConfig(IAM20680HP_intPinConfig_t *intPin, bool writeConfig)
+{
+    if (writeConfig)
+    {
+        data[0] = IAM20680HP_INT_PIN_CFG;
+        data[1] = 0;
+        data[1] = data[1] | (intPin->int_level << 7);
+        data[1] = data[1] | (intPin->int_open << 6);
+        data[1] = data[1] | (intPin->latch_int_en << 5);
+        data[1] = data[1] | (intPin->int_rd_clear << 4);
+        data[1] = data[1] | (intPin->fSync_int_level << 3);
+        data[1] = data[1] | (intPin->fSync_int_mode_en << 2);
+        data[2] = 0;
+        if (intPin->wom_int_en == 1)
+        {
+            data[2] = data[2] | 0xE0; // 0b11100000;
+        }
+        data[2] = data[2] | (intPin->fifo_oflow_en << 4);
+        data[2] = data[2] | (intPin->gdrive_int_en << 2);
+        data[2] = data[2] | (intPin->data_rdy_en << 0);
+
+        iam20680hpStatus = iam20680hpBusTransmit(data, 3);
+        if (iam20680hpStatus != IAM20680HP_OK)
+        {
+            return IAM20680HP_ERR_I2C;
+        }
+    }
+    else
+    {
+        data[0] = IAM20680HP_INT_PIN_CFG;
+
+        iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
+        {
+            return IAM20680HP_ERR_I2C;
+        }
+
+        iam20680hpStatus = iam20680hpBusReceive(data, 2);
+        if (iam20680hpStatus != IAM20680HP_OK)
+        {
+            return IAM20680HP_ERR_I2C;
+        }
+
+        intPin->int_level = (data[0] & 0x80) >> 7;         // 0b10000000;
+        intPin->int_open = (data[0] & 0x40) >> 6;          // 0b01000000;
+        intPin->latch_int_en = (data[0] & 0x20) >> 5;      // 0b00100000;
+        intPin->int_rd_clear = (data[0] & 0x10) >> 4;      // 0b00010000;
+        intPin->fSync_int_level = (data[0] & 0x08) >> 3;   // 0b00001000;
+        intPin->fSync_int_mode_en = (data[0] & 0x04) >> 2; // 0b00000100;
+
+        intPin->wom_int_en = data[1] & 0xE0;    // 0b11100000;
+        intPin->fifo_oflow_en = data[1] & 0x10; // 0b00010000;
+        intPin->gdrive_int_en = data[1] & 0x04; // 0b00000100;
+        intPin->data_rdy_en = data[1] & 0x01;   // 0b00000001;
+    }
+
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpIntStatus(IAM20680HP_intStatus_t *intStatus)
+{
+
+    data[0] = IAM20680HP_INT_STATUS;
+
+    iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+    if (iam20680hpStatus != IAM20680HP_OK)
+    {
+        return IAM20680HP_ERR_I2C;
+    }
+
+    iam20680hpStatus = iam20680hpBusReceive(data, 1);
+    if (iam20680hpStatus != IAM20680HP_OK)
+    {
+        return IAM20680HP_ERR_I2C;
+    }
+
+    intStatus->wom_int = (data[0] & 0xE0) >> 5;        // 0b11100000;
+    intStatus->fifo_oflow_int = (data[0] & 0x10) >> 4; // 0b00010000;
+    intStatus->gdrive_int = (data[0] & 0x04) >> 2;     // 0b00000100;
+    intStatus->data_rdy_int = (data[0] & 0x01);        // 0b00000001;
+
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpReadAccelData(IAM20680HP_accelData_t *accelData)
+{
+    data[0] = IAM20680HP_ACCEL_XOUT_H;
+
+    iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+    if (iam20680hpStatus != IAM20680HP_OK)
+    {
+        return IAM20680HP_ERR_I2C;
+    }
+
+    memset(data, 0, 6);
+    iam20680hpStatus = iam20680hpBusReceive(data, 6);
+    if (iam20680hpStatus != IAM20680HP_OK)
+    {
+        return IAM20680HP_ERR_I2C;
+    }
+
+    accelData->xAccel = (int16_t)(data[0] << 8 | data[1]);
+    accelData->yAccel = (int16_t)(data[2] << 8 | data[3]);
+    accelData->zAccel = (int16_t)(data[4] << 8 | data[5]);
+
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpReadTemperatureData(int16_t *temperature)
+{
+    data[0] = IAM20680HP_TEMP_OUT_H;
+
+    iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+    if (iam20680hpStatus != IAM20680HP_OK)
+    {
+        return IAM20680HP_ERR_I2C;
+    }
+
+    memset(data, 0, 2);
+    iam20680hpStatus = iam20680hpBusReceive(data, 2);
+    if (iam20680hpStatus != IAM20680HP_OK)
+    {
+        return IAM20680HP_ERR_I2C;
+    }
+
+    *temperature = (int16_t)(data[0] << 8 | data[1]);
+    *temperature = ((*temperature / 326.8) + 25) * 100;
+
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpReadGyroData(IAM20680HP_gyroData_t *gyroData)
+{
+    data[0] = IAM20680HP_GYRO_XOUT_H;
+
+    iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+    if (iam20680hpStatus != IAM20680HP_OK)
+    {
+        return IAM20680HP_ERR_I2C;
+    }
+
+    memset(data, 0, 6);
+    iam20680hpStatus = iam20680hpBusReceive(data, 6);
+    if (iam20680hpStatus != IAM20680HP_OK)
+    {
+        return IAM20680HP_ERR_I2C;
+    }
+
+    gyroData->xGyro = (int16_t)(data[0] << 8 | data[1]);
+    gyroData->yGyro = (int16_t)(data[2] << 8 | data[3]);
+    gyroData->zGyro = (int16_t)(data[4] << 8 | data[5]);
+
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpSignalPathReset(bool *accel, bool *temp, bool writeReset)
+{
+
+    if (writeReset)
+    {
+        data[0] = IAM20680HP_SIGNAL_PATH_RESET;
+        data[1] = 0;
+        data[1] = data[1] | (*accel << 1);
+        data[1] = data[1] | *temp;
+
+        iam20680hpStatus = iam20680hpBusTransmit(data, 2);
+        if (iam20680hpStatus != IAM20680HP_OK)
+        {
+            return IAM20680HP_ERR_I2C;
+        }
+    }
+    else
+    {
+        data[0] = IAM20680HP_SIGNAL_PATH_RESET;
+        iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
+        {
+            return IAM20680HP_ERR_I2C;
+        }
+
+        data[0] = 0;
+        iam20680hpStatus = iam20680hpBusReceive(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
+        {
+            return IAM20680HP_ERR_I2C;
+        }
+
+        *accel = (data[0] & 0x02) >> 1; // 0b00000010;
+        *temp = (data[0] & 0x01);       // 0b00000001;
+    }
+
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpIntelControl(bool *enable, bool *mode, bool writeConfig)
 {
-
-    if (writeWomThreshold)
+    if (writeConfig)
     {
-        data[0] = IAM20680HP_ACCEL_WOM_THR;
-        data[1] = *womThreshold;
+        data[0] = IAM20680HP_ACCEL_INTEL_CTRL;
+        data[1] = 0;
+        data[1] = data[1] | (*enable << 7);
+        data[1] = data[1] | (*mode << 6);
 
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 2, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 2);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
     }
     else
     {
-        data[0] = IAM20680HP_ACCEL_WOM_THR;
-
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        data[0] = IAM20680HP_ACCEL_INTEL_CTRL;
+        iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
 
-        status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        data[0] = 0;
+        iam20680hpStatus = iam20680hpBusReceive(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
 
-        *womThreshold = data[0];
+        *enable = (data[0] & 0x80) >> 7; // 0b10000000;
+        *mode = (data[0] & 0x40) >> 6;   // 0b01000000;
     }
+
     return IAM20680HP_OK;
 }
 
-IAM20680HP_err_t iam20680hpFiFoEnable(bool *tempFiFo, bool *gyroX, bool *gyroY, bool *gyroZ, bool *accel, bool writeFiFo)
+IAM20680HP_err_t iam20680hpUserControl(IAM20680HP_userControl_t *userControl, bool writeConfig)
 {
-    if (writeFiFo)
+    if (writeConfig)
     {
-        data[0] = IAM20680HP_FIFO_EN;
+        data[0] = IAM20680HP_USER_CTRL;
         data[1] = 0;
-        data[1] = data[1] | (*tempFiFo << 7);
-        data[1] = data[1] | (*gyroX << 6);
-        data[1] = data[1] | (*gyroY << 5);
-        data[1] = data[1] | (*gyroZ << 4);
-        data[1] = data[1] | (*accel << 3);
+        data[1] = data[1] | (userControl->fifo_en << 6);
+        data[1] = data[1] | (userControl->i2c_if_dis << 4);
+        data[1] = data[1] | (userControl->fifo_rst << 2);
+        data[1] = data[1] | (userControl->sig_cond_rst << 0);
 
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 2, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 2);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
     }
     else
     {
-        data[0] = IAM20680HP_FIFO_EN;
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        data[0] = IAM20680HP_USER_CTRL;
+
+        iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
 
-        status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        data[0] = 0;
+
+        iam20680hpStatus = iam20680hpBusReceive(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
 
-        *tempFiFo = (data[0] & 0x80) >> 7; // 0b10000000;
-        *gyroX = (data[0] & 0x40) >> 6;    // 0b01000000;
-        *gyroY = (data[0] & 0x20) >> 5;    // 0b00100000;
-        *gyroZ = (data[0] & 0x10) >> 4;    // 0b00010000;
-        *accel = (data[0] & 0x08) >> 3;    // 0b00001000;
+        userControl->fifo_en = (data[0] & 0x40) >> 6;    // 0b01000000;
+        userControl->i2c_if_dis = (data[0] & 0x10) >> 4; // 0b00010000;
+        userControl->fifo_rst = (data[0] & 0x04) >> 2;   // 0b00000100;
+        userControl->sig_cond_rst = (data[0] & 0x01);    // 0b00000001;
     }
+
     return IAM20680HP_OK;
 }
 
-IAM20680HP_err_t iam20680hpReadFsyncInterruptStatus(bool *fsyncInt)
+IAM20680HP_err_t iam20680hpPowerManagement(IAM20680HP_powerManagement_t *powerManagement, bool writeConfig)
 {
-    data[0] = IAM20680HP_FSYNC_INT;
-
-    status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-    if (status != HAL_OK)
-    {
-        return IAM20680HP_ERR_I2C;
-    }
-
-    status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-    if (status != HAL_OK)
-    {
-        return IAM20680HP_ERR_I2C;
-    }
-
-    if (data[0] & 0x80)
-    {
-        *fsyncInt = true;
-    }
-    else
+    if (powerManagement->clockSel > 7)
     {
-        *fsyncInt = false;
+        return IAM20680HP_ERR_INVALID_PARAM;
     }
 
-    return IAM20680HP_OK;
-}
-
-IAM20680HP_err_t iam20680hpIntConfig(IAM20680HP_intPinConfig_t *intPin, bool writeConfig)
-{
     if (writeConfig)
     {
-        data[0] = IAM20680HP_INT_PIN_CFG;
+        data[0] = IAM20680HP_PWR_MGMT_1;
         data[1] = 0;
-        data[1] = data[1] | (intPin->int_level << 7);
-        data[1] = data[1] | (intPin->int_open << 6);
-        data[1] = data[1] | (intPin->latch_int_en << 5);
-        data[1] = data[1] | (intPin->int_rd_clear << 4);
-        data[1] = data[1] | (intPin->fSync_int_level << 3);
-        data[1] = data[1] | (intPin->fSync_int_mode_en << 2);
+        data[1] = data[1] | (powerManagement->reset << 7);
+        data[1] = data[1] | (powerManagement->sleep << 6);
+        data[1] = data[1] | (powerManagement->accelCycle << 5);
+        data[1] = data[1] | (powerManagement->gyroStandby << 4);
+        data[1] = data[1] | (powerManagement->tempDis << 3);
+        data[1] = data[1] | (powerManagement->clockSel << 0);
         data[2] = 0;
-        if (intPin->wom_int_en == 1)
-        {
-            data[2] = data[2] | 0xE0; // 0b11100000;
-        }
-        data[2] = data[2] | (intPin->fifo_oflow_en << 4);
-        data[2] = data[2] | (intPin->gdrive_int_en << 2);
-        data[2] = data[2] | (intPin->data_rdy_en << 0);
+        data[2] = data[2] | (powerManagement->fifo_lp_en << 7);
+        data[2] = data[2] | (powerManagement->stby_xa << 5);
+        data[2] = data[2] | (powerManagement->stby_ya << 4);
+        data[2] = data[2] | (powerManagement->stby_za << 3);
+        data[2] = data[2] | (powerManagement->stby_xg << 2);
+        data[2] = data[2] | (powerManagement->stby_yg << 1);
+        data[2] = data[2] | (powerManagement->stby_zg << 0);
 
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 3, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 3);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
     }
     else
     {
-        data[0] = IAM20680HP_INT_PIN_CFG;
+        data[0] = IAM20680HP_PWR_MGMT_1;
 
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
 
-        status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 2, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        memset(data, 0, 2);
+        iam20680hpStatus = iam20680hpBusReceive(data, 2);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
 
-        intPin->int_level = (data[0] & 0x80) >> 7;         // 0b10000000;
-        intPin->int_open = (data[0] & 0x40) >> 6;          // 0b01000000;
-        intPin->latch_int_en = (data[0] & 0x20) >> 5;      // 0b00100000;
-        intPin->int_rd_clear = (data[0] & 0x10) >> 4;      // 0b00010000;
-        intPin->fSync_int_level = (data[0] & 0x08) >> 3;   // 0b00001000;
-        intPin->fSync_int_mode_en = (data[0] & 0x04) >> 2; // 0b00000100;
+        powerManagement->reset = (data[0] & 0x80) >> 7;       // 0b10000000;
+        powerManagement->sleep = (data[0] & 0x40) >> 6;       // 0b01000000;
+        powerManagement->accelCycle = (data[0] & 0x20) >> 5;  // 0b00100000;
+        powerManagement->gyroStandby = (data[0] & 0x10) >> 4; // 0b00010000;
+        powerManagement->tempDis = (data[0] & 0x08) >> 3;     // 0b00001000;
+        powerManagement->clockSel = (data[0] & 0x07);         // 0b00000111;
 
-        intPin->wom_int_en = data[1] & 0xE0;    // 0b11100000;
-        intPin->fifo_oflow_en = data[1] & 0x10; // 0b00010000;
-        intPin->gdrive_int_en = data[1] & 0x04; // 0b00000100;
-        intPin->data_rdy_en = data[1] & 0x01;   // 0b00000001;
+        powerManagement->fifo_lp_en = (data[1] & 0x80) >> 7; // 0b10000000;
+        powerManagement->stby_xa = (data[1] & 0x20) >> 5;    // 0b00100000;
+        powerManagement->stby_ya = (data[1] & 0x10) >> 4;    // 0b00010000;
+        powerManagement->stby_za = (data[1] & 0x08) >> 3;    // 0b00001000;
+        powerManagement->stby_xg = (data[1] & 0x04) >> 2;    // 0b00000100;
+        powerManagement->stby_yg = (data[1] & 0x02) >> 1;    // 0b00000010;
+        powerManagement->stby_zg = (data[1] & 0x01);         // 0b00000001;
     }
 
     return IAM20680HP_OK;
 }
 
-IAM20680HP_err_t iam20680hpIntStatus(IAM20680HP_intStatus_t *intStatus)
+IAM20680HP_err_t iam20680hpReadFifoCount(uint16_t *fifoCount)
 {
+    data[0] = IAM20680HP_FIFO_COUNTH;
 
-    data[0] = IAM20680HP_INT_STATUS;
-
-    status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-    if (status != HAL_OK)
+    iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+    if (iam20680hpStatus != IAM20680HP_OK)
     {
         return IAM20680HP_ERR_I2C;
     }
 
-    status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-    if (status != HAL_OK)
+    memset(data, 0, 2);
+    iam20680hpStatus = iam20680hpBusReceive(data, 2);
+    if (iam20680hpStatus != IAM20680HP_OK)
     {
         return IAM20680HP_ERR_I2C;
     }
 
-    intStatus->wom_int = (data[0] & 0xE0) >> 5;        // 0b11100000;
-    intStatus->fifo_oflow_int = (data[0] & 0x10) >> 4; // 0b00010000;
-    intStatus->gdrive_int = (data[0] & 0x04) >> 2;     // 0b00000100;
-    intStatus->data_rdy_int = (data[0] & 0x01);        // 0b00000001;
+    *fifoCount = (uint16_t)(data[0] << 8 | data[1]);
 
     return IAM20680HP_OK;
 }
 
-IAM20680HP_err_t iam20680hpReadAccelData(IAM20680HP_accelData_t *accelData)
+IAM20680HP_err_t iam20680hpReadFifoData(IAM20680HP_fifoData_t *fifoData)
 {
-    data[0] = IAM20680HP_ACCEL_XOUT_H;
+    data[0] = IAM20680HP_FIFO_R_W;
 
-    status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-    if (status != HAL_OK)
+    iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+    if (iam20680hpStatus != IAM20680HP_OK)
     {
         return IAM20680HP_ERR_I2C;
     }
 
-    memset(data, 0, 6);
-    status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 6, IAM20680HP_I2C_TIMEOUT);
-    if (status != HAL_OK)
+    memset(data, 0, 14);
+
+    iam20680hpStatus = iam20680hpBusReceive(data, 14);
+    if (iam20680hpStatus != IAM20680HP_OK)
     {
         return IAM20680HP_ERR_I2C;
     }
 
-    accelData->xAccel = (int16_t)(data[0] << 8 | data[1]);
-    accelData->yAccel = (int16_t)(data[2] << 8 | data[3]);
-    accelData->zAccel = (int16_t)(data[4] << 8 | data[5]);
+    // Data integrity check
+    for (size_t i = 0; i < 14; i++)
+    {
+        if (data[i] == 0x00)
+        {
+            return IAM20680HP_ERR_NOT_INITIALIZED;
+        }
+        if (data[i] == 0xFF)
+        {
+            return IAM20680HP_ERR_EOL;
+        }
+    }
+
+    iam20680hpDecodeFifoFrame(data, fifoData);
 
     return IAM20680HP_OK;
 }
 
-IAM20680HP_err_t iam20680hpReadTemperatureData(int16_t *temperature)
+/*
+ * Reads the complete frames of fifoCount (up to maxFrames) in one burst straight into the buffer of the caller,
+ * a raw frame has the same size as IAM20680HP_fifoData_t, and decodes them in place.
+ */
+static IAM20680HP_err_t iam20680hpReadFifoFrames(IAM20680HP_fifoData_t *fifoData, uint16_t fifoCount, uint16_t maxFrames, uint16_t *framesRead)
 {
-    data[0] = IAM20680HP_TEMP_OUT_H;
+    *framesRead = 0;
 
-    status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-    if (status != HAL_OK)
+    // Only complete frames, the rest stays in the FiFo for the next drain
+    uint16_t frames = fifoCount / IAM20680HP_FIFO_FRAME_SIZE;
+    if (frames > maxFrames)
+    {
+        frames = maxFrames;
+    }
+    if (frames == 0)
+    {
+        return IAM20680HP_OK;
+    }
+
+    data[0] = IAM20680HP_FIFO_R_W;
+    iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+    if (iam20680hpStatus != IAM20680HP_OK)
     {
         return IAM20680HP_ERR_I2C;
     }
 
-    memset(data, 0, 2);
-    status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 2, IAM20680HP_I2C_TIMEOUT);
-    if (status != HAL_OK)
+    uint8_t *raw = (uint8_t *)fifoData;
+    iam20680hpStatus = iam20680hpBusReceive(raw, (uint16_t)(frames * IAM20680HP_FIFO_FRAME_SIZE));
+    if (iam20680hpStatus != IAM20680HP_OK)
     {
         return IAM20680HP_ERR_I2C;
     }
 
-    *temperature = (int16_t)(data[0] << 8 | data[1]);
-    *temperature = ((*temperature / 326.8) + 25) * 100;
+    for (uint16_t i = 0; i < frames; i++)
+    {
+        iam20680hpDecodeFifoFrame(&raw[i * IAM20680HP_FIFO_FRAME_SIZE], &fifoData[i]);
+    }
 
+    *framesRead = frames;
     return IAM20680HP_OK;
 }
 
-IAM20680HP_err_t iam20680hpReadGyroData(IAM20680HP_gyroData_t *gyroData)
+IAM20680HP_err_t iam20680hpReadFifoBlock(IAM20680HP_fifoData_t *fifoData, uint16_t maxFrames, uint16_t *framesRead)
 {
-    data[0] = IAM20680HP_GYRO_XOUT_H;
+    uint16_t fifoCount;
 
-    status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-    if (status != HAL_OK)
+    return iam20680hpReadFifoBlockWithCount(fifoData, maxFrames, framesRead, &fifoCount);
+}
+
+IAM20680HP_err_t iam20680hpReadFifoBlockWithCount(IAM20680HP_fifoData_t *fifoData, uint16_t maxFrames, uint16_t *framesRead, uint16_t *fifoCount)
+{
+    IAM20680HP_err_t result;
+
+    *framesRead = 0;
+    *fifoCount = 0;
+
+    result = iam20680hpReadFifoCount(fifoCount);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    return iam20680hpReadFifoFrames(fifoData, *fifoCount, maxFrames, framesRead);
+}
+
+IAM20680HP_err_t iam20680hpReadFifoAccelBlock(IAM20680HP_accelData_t *accelData, uint16_t maxSamples, uint16_t *samplesRead)
+{
+    uint16_t fifoCount;
+
+    return iam20680hpReadFifoAccelBlockWithCount(accelData, maxSamples, samplesRead, &fifoCount);
+}
+
+IAM20680HP_err_t iam20680hpReadFifoAccelBlockWithCount(IAM20680HP_accelData_t *accelData, uint16_t maxSamples, uint16_t *samplesRead,
+                                                       uint16_t *fifoCount)
+{
+    IAM20680HP_err_t result;
+
+    *samplesRead = 0;
+    *fifoCount = 0;
+
+    result = iam20680hpReadFifoCount(fifoCount);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    uint16_t samples = *fifoCount / IAM20680HP_FIFO_ACCEL_FRAME_SIZE;
+    if (samples > maxSamples)
+    {
+        samples = maxSamples;
+    }
+    if (samples == 0)
+    {
+        return IAM20680HP_OK;
+    }
+
+    data[0] = IAM20680HP_FIFO_R_W;
+    iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+    if (iam20680hpStatus != IAM20680HP_OK)
     {
         return IAM20680HP_ERR_I2C;
     }
 
-    memset(data, 0, 6);
-    status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 6, IAM20680HP_I2C_TIMEOUT);
-    if (status != HAL_OK)
+    uint8_t *raw = (uint8_t *)accelData;
+    iam20680hpStatus = iam20680hpBusReceive(raw, (uint16_t)(samples * IAM20680HP_FIFO_ACCEL_FRAME_SIZE));
+    if (iam20680hpStatus != IAM20680HP_OK)
     {
         return IAM20680HP_ERR_I2C;
     }
 
-    gyroData->xGyro = (int16_t)(data[0] << 8 | data[1]);
-    gyroData->yGyro = (int16_t)(data[2] << 8 | data[3]);
-    gyroData->zGyro = (int16_t)(data[4] << 8 | data[5]);
+    // Big endian to host, in place
+    for (uint16_t i = 0; i < samples; i++)
+    {
+        const uint8_t *frame = &raw[i * IAM20680HP_FIFO_ACCEL_FRAME_SIZE];
+        int16_t xAccel = (int16_t)(frame[0] << 8 | frame[1]);
+        int16_t yAccel = (int16_t)(frame[2] << 8 | frame[3]);
+        int16_t zAccel = (int16_t)(frame[4] << 8 | frame[5]);
+        accelData[i].xAccel = xAccel;
+        accelData[i].yAccel = yAccel;
+        accelData[i].zAccel = zAccel;
+    }
 
+    *samplesRead = samples;
     return IAM20680HP_OK;
 }
 
-IAM20680HP_err_t iam20680hpSignalPathReset(bool *accel, bool *temp, bool writeReset)
+IAM20680HP_err_t iam20680hpFifoReset(void)
+{
+    IAM20680HP_err_t result;
+
+    IAM20680HP_userControl_t userControl;
+    memset(&userControl, 0, sizeof(userControl));
+    result = iam20680hpUserControl(&userControl, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    // FIFO_RST auto clears, FIFO_EN is kept
+    userControl.fifo_rst = 1;
+    userControl.sig_cond_rst = 0;
+    return iam20680hpUserControl(&userControl, true);
+}
+
+IAM20680HP_err_t iam20680hpReadFifoBlockWithGap(IAM20680HP_fifoData_t *fifoData, uint16_t maxFrames, uint16_t *framesRead,
+                                                uint16_t odrHz, uint32_t elapsedMs, IAM20680HP_fifoGap_t *gap)
 {
+    IAM20680HP_err_t result;
+    uint16_t fifoCount;
 
-    if (writeReset)
+    *framesRead = 0;
+    memset(gap, 0, sizeof(*gap));
+
+    IAM20680HP_intStatus_t intStatus;
+    result = iam20680hpIntStatus(&intStatus);
+    if (result != IAM20680HP_OK)
+        return result;
+    gap->intStatus = intStatus;
+
+    result = iam20680hpReadFifoCount(&fifoCount);
+    if (result != IAM20680HP_OK)
+        return result;
+    gap->fifoBytes = fifoCount;
+
+    uint16_t partial = fifoCount % IAM20680HP_FIFO_FRAME_SIZE;
+
+    if (intStatus.fifo_oflow_int)
     {
-        data[0] = IAM20680HP_SIGNAL_PATH_RESET;
-        data[1] = 0;
-        data[1] = data[1] | (*accel << 1);
-        data[1] = data[1] | *temp;
+        gap->overflow = true;
 
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 2, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
-        {
-            return IAM20680HP_ERR_I2C;
-        }
+        // Frames produced since the previous drain that are not in the FiFo anymore
+        uint32_t expected = elapsedMs * odrHz / 1000;
+        uint32_t kept = fifoCount / IAM20680HP_FIFO_FRAME_SIZE;
+        gap->lostFrames = expected > kept ? expected - kept : 1;
+
+#if IAM20680HP_FIFO_OVERFLOW_RESET
+        gap->lostFrames = expected > 0 ? expected : kept;
+        return iam20680hpFifoReset();
+#endif
     }
-    else
+
+    if (partial != 0)
     {
-        data[0] = IAM20680HP_SIGNAL_PATH_RESET;
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        // The oldest frame is partly overwritten, frames are written as a whole so the rest is aligned after 
+        // discarding the partial frame at the head of the FiFo
+        gap->misaligned = true;
+        if (!gap->overflow)
+        {
+            gap->lostFrames = 1;
+        }
+
+        data[0] = IAM20680HP_FIFO_R_W;
+        iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
 
-        data[0] = 0;
-        status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        iam20680hpStatus = iam20680hpBusReceive(data, partial);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
-
-        *accel = (data[0] & 0x02) >> 1; // 0b00000010;
-        *temp = (data[0] & 0x01);       // 0b00000001;
+        fifoCount -= partial;
     }
 
-    return IAM20680HP_OK;
+    return iam20680hpReadFifoFrames(fifoData, fifoCount, maxFrames, framesRead);
 }
 
-IAM20680HP_err_t iam20680hpIntelControl(bool *enable, bool *mode, bool writeConfig)
+IAM20680HP_err_t iam20680hpDrainSchedulerInit(IAM20680HP_drainScheduler_t *scheduler, uint16_t odrHz, uint16_t frameSize, uint16_t fifoSize, uint8_t targetFill)
 {
-    if (writeConfig)
+    if (odrHz == 0 || frameSize == 0 || fifoSize < frameSize)
     {
-        data[0] = IAM20680HP_ACCEL_INTEL_CTRL;
-        data[1] = 0;
-        data[1] = data[1] | (*enable << 7);
-        data[1] = data[1] | (*mode << 6);
-
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 2, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
-        {
-            return IAM20680HP_ERR_I2C;
-        }
+        return IAM20680HP_ERR_INVALID_PARAM;
     }
-    else
+    if (targetFill == 0 || targetFill > IAM20680HP_DRAIN_NEAR_OVERFLOW)
     {
-        data[0] = IAM20680HP_ACCEL_INTEL_CTRL;
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
-        {
-            return IAM20680HP_ERR_I2C;
-        }
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
 
-        data[0] = 0;
-        status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
-        {
-            return IAM20680HP_ERR_I2C;
-        }
+    memset(scheduler, 0, sizeof(*scheduler));
+    scheduler->fifoSize = fifoSize;
+    scheduler->targetBytes = (uint16_t)((uint32_t)fifoSize * targetFill / 100);
+    scheduler->fillRate = (uint32_t)odrHz * frameSize;
+    scheduler->minIntervalMs = IAM20680HP_DRAIN_MIN_INTERVAL;
+    scheduler->maxIntervalMs = IAM20680HP_DRAIN_MAX_INTERVAL;
 
-        *enable = (data[0] & 0x80) >> 7; // 0b10000000;
-        *mode = (data[0] & 0x40) >> 6;   // 0b01000000;
+    // Start halfway the target, the first drains correct the rate
+    scheduler->intervalMs = (uint32_t)scheduler->targetBytes * 1000 / scheduler->fillRate / 2;
+    if (scheduler->intervalMs < scheduler->minIntervalMs)
+    {
+        scheduler->intervalMs = scheduler->minIntervalMs;
     }
 
     return IAM20680HP_OK;
 }
 
-IAM20680HP_err_t iam20680hpUserControl(IAM20680HP_userControl_t *userControl, bool writeConfig)
+IAM20680HP_err_t iam20680hpDrainSchedulerInitFromDevice(IAM20680HP_drainScheduler_t *scheduler, uint8_t targetFill)
 {
-    if (writeConfig)
-    {
-        data[0] = IAM20680HP_USER_CTRL;
-        data[1] = 0;
-        data[1] = data[1] | (userControl->fifo_en << 6);
-        data[1] = data[1] | (userControl->i2c_if_dis << 4);
-        data[1] = data[1] | (userControl->fifo_rst << 2);
-        data[1] = data[1] | (userControl->sig_cond_rst << 0);
+    IAM20680HP_err_t result;
 
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 2, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
-        {
-            return IAM20680HP_ERR_I2C;
-        }
+    uint16_t odrHz;
+    result = iam20680hpReadOutputDataRate(&odrHz);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    IAM20680HP_accelConfig_t accelConfig;
+    memset(&accelConfig, 0, sizeof(accelConfig));
+    result = iam20680hpAccelConfig(&accelConfig, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    return iam20680hpDrainSchedulerInit(scheduler, odrHz, IAM20680HP_FIFO_FRAME_SIZE, (uint16_t)(512 << accelConfig.fifoSize), targetFill);
+}
+
+uint32_t iam20680hpDrainSchedulerUpdate(IAM20680HP_drainScheduler_t *scheduler, uint32_t fifoBytes, uint32_t readBytes, uint32_t elapsedMs)
+{
+    uint32_t interval;
+
+    scheduler->drains++;
+
+    // Bytes added since the previous drain: what the previous drain left in the FiFo was counted then
+    uint32_t addedBytes = fifoBytes > scheduler->remainingBytes ? fifoBytes - scheduler->remainingBytes : 0;
+    scheduler->remainingBytes = fifoBytes > readBytes ? fifoBytes - readBytes : 0;
+
+    if (fifoBytes == 0)
+    {
+        // Nothing yet (sensor in sleep/cycle or timer early), back off
+        scheduler->emptyDrains++;
+        interval = scheduler->intervalMs * 2;
     }
     else
     {
-        data[0] = IAM20680HP_USER_CTRL;
-
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        if (elapsedMs > 0)
         {
-            return IAM20680HP_ERR_I2C;
+            // Exponential average of the measured fill rate (1/4 new)
+            uint32_t measured = addedBytes * 1000 / elapsedMs;
+            scheduler->fillRate = (scheduler->fillRate * 3 + measured) / 4;
+            if (scheduler->fillRate == 0)
+            {
+                scheduler->fillRate = 1;
+            }
         }
 
-        data[0] = 0;
+        interval = (uint32_t)scheduler->targetBytes * 1000 / scheduler->fillRate;
 
-        status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        if (fifoBytes * 100 >= (uint32_t)scheduler->fifoSize * IAM20680HP_DRAIN_NEAR_OVERFLOW)
         {
-            return IAM20680HP_ERR_I2C;
+            // Too close to an overflow, tighten further than the rate alone suggests
+            scheduler->nearOverflows++;
+            if (interval > scheduler->intervalMs / 2)
+            {
+                interval = scheduler->intervalMs / 2;
+            }
         }
+    }
 
-        userControl->fifo_en = (data[0] & 0x40) >> 6;    // 0b01000000;
-        userControl->i2c_if_dis = (data[0] & 0x10) >> 4; // 0b00010000;
-        userControl->fifo_rst = (data[0] & 0x04) >> 2;   // 0b00000100;
-        userControl->sig_cond_rst = (data[0] & 0x01);    // 0b00000001;
+    if (interval < scheduler->minIntervalMs)
+    {
+        interval = scheduler->minIntervalMs;
+    }
+    if (interval > scheduler->maxIntervalMs)
+    {
+        interval = scheduler->maxIntervalMs;
     }
 
-    return IAM20680HP_OK;
+    scheduler->intervalMs = interval;
+    return interval;
 }
 
-IAM20680HP_err_t iam20680hpPowerManagement(IAM20680HP_powerManagement_t *powerManagement, bool writeConfig)
+uint32_t iam20680hpDrainSchedulerUpdateWithGap(IAM20680HP_drainScheduler_t *scheduler, const IAM20680HP_fifoGap_t *gap, uint16_t framesRead,
+                                               uint32_t elapsedMs)
 {
-    if (powerManagement->clockSel > 7)
+    uint32_t readBytes = (uint32_t)framesRead * IAM20680HP_FIFO_FRAME_SIZE + gap->fifoBytes % IAM20680HP_FIFO_FRAME_SIZE;
+#if IAM20680HP_FIFO_OVERFLOW_RESET
+    if (gap->overflow)
     {
-        return IAM20680HP_ERR_INVALID_PARAM;
+        readBytes = gap->fifoBytes;
     }
+#endif
+    return iam20680hpDrainSchedulerUpdate(scheduler, gap->fifoBytes, readBytes, elapsedMs);
+}
 
-    if (writeConfig)
+IAM20680HP_err_t iam20680hpDrainSchedulerDrain(IAM20680HP_drainScheduler_t *scheduler, IAM20680HP_fifoData_t *fifoData, uint16_t maxFrames,
+                                               uint32_t elapsedMs, uint16_t *framesRead, uint32_t *nextDrainMs)
+{
+    IAM20680HP_err_t result;
+    uint16_t fifoCount;
+
+    result = iam20680hpReadFifoBlockWithCount(fifoData, maxFrames, framesRead, &fifoCount);
+    if (result != IAM20680HP_OK)
     {
-        data[0] = IAM20680HP_PWR_MGMT_1;
-        data[1] = 0;
-        data[1] = data[1] | (powerManagement->reset << 7);
-        data[1] = data[1] | (powerManagement->sleep << 6);
-        data[1] = data[1] | (powerManagement->accelCycle << 5);
-        data[1] = data[1] | (powerManagement->gyroStandby << 4);
-        data[1] = data[1] | (powerManagement->tempDis << 3);
-        data[1] = data[1] | (powerManagement->clockSel << 0);
-        data[2] = 0;
-        data[2] = data[2] | (powerManagement->fifo_lp_en << 7);
-        data[2] = data[2] | (powerManagement->stby_xa << 5);
-        data[2] = data[2] | (powerManagement->stby_ya << 4);
-        data[2] = data[2] | (powerManagement->stby_za << 3);
-        data[2] = data[2] | (powerManagement->stby_xg << 2);
-        data[2] = data[2] | (powerManagement->stby_yg << 1);
-        data[2] = data[2] | (powerManagement->stby_zg << 0);
+        *nextDrainMs = scheduler->minIntervalMs;
+        return result;
+    }
 
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 3, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
-        {
-            return IAM20680HP_ERR_I2C;
-        }
+    *nextDrainMs = iam20680hpDrainSchedulerUpdate(scheduler, fifoCount, (uint32_t)*framesRead * IAM20680HP_FIFO_FRAME_SIZE, elapsedMs);
+    return IAM20680HP_OK;
+}
+
+/*
+ * Rounds and limits a register offset
+ */
+static int16_t iam20680hpOffsetRound(float value, int32_t min, int32_t max)
+{
+    int32_t rounded = (int32_t)(value + (value >= 0 ? 0.5f : -0.5f));
+    if (rounded < min)
+    {
+        rounded = min;
     }
-    else
+    if (rounded > max)
     {
-        data[0] = IAM20680HP_PWR_MGMT_1;
+        rounded = max;
+    }
+    return (int16_t)rounded;
+}
 
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
-        {
-            return IAM20680HP_ERR_I2C;
-        }
+/*
+ * Captures the bias, writes the offsets and verifies the residual bias (see iam20680hpCalibrateBias()). The offsets read 
+ * at the start are stored in gyroOriginal and accelOriginal, written is set once the offset registers are written. The 
+ * caller restores saved (and the offsets on an error), also after an error.
+ */
+static IAM20680HP_err_t iam20680hpBiasCapture(IAM20680HP_biasCalibration_t *calibration, IAM20680HP_savedConfig_t *saved, IAM20680HP_orientation_t orientation, uint16_t samples, IAM20680HP_gyroOffset_t *gyroOriginal, IAM20680HP_accelOffset_t *accelOriginal, bool *written)
+{
+    IAM20680HP_err_t result;
 
-        memset(data, 0, 2);
-        status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 2, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
-        {
-            return IAM20680HP_ERR_I2C;
-        }
+    uint8_t gyroFsSel = saved->gyroConfig.FS_Sel;
+    uint8_t accelFsSel = saved->accelConfig.AFS_Sel;
 
-        powerManagement->reset = (data[0] & 0x80) >> 7;       // 0b10000000;
-        powerManagement->sleep = (data[0] & 0x40) >> 6;       // 0b01000000;
-        powerManagement->accelCycle = (data[0] & 0x20) >> 5;  // 0b00100000;
-        powerManagement->gyroStandby = (data[0] & 0x10) >> 4; // 0b00010000;
-        powerManagement->tempDis = (data[0] & 0x08) >> 3;     // 0b00001000;
-        powerManagement->clockSel = (data[0] & 0x07);         // 0b00000111;
+    // 1g on the axis pointing up (or down) in the current full-scale
+    float gravity[3] = {0.0f, 0.0f, 0.0f};
+    gravity[orientation / 2] = (float)(16384 >> accelFsSel) * (orientation % 2 ? -1.0f : 1.0f);
 
-        powerManagement->fifo_lp_en = (data[1] & 0x80) >> 7; // 0b10000000;
-        powerManagement->stby_xa = (data[1] & 0x20) >> 5;    // 0b00100000;
-        powerManagement->stby_ya = (data[1] & 0x10) >> 4;    // 0b00010000;
-        powerManagement->stby_za = (data[1] & 0x08) >> 3;    // 0b00001000;
-        powerManagement->stby_xg = (data[1] & 0x04) >> 2;    // 0b00000100;
-        powerManagement->stby_yg = (data[1] & 0x02) >> 1;    // 0b00000010;
-        powerManagement->stby_zg = (data[1] & 0x01);         // 0b00000001;
+    result = iam20680hpSetCaptureConfig(saved, gyroFsSel, accelFsSel);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    float accel[3], gyro[3];
+    result = iam20680hpFifoCaptureAverage(samples, accel, gyro, &calibration->rejectedChunks);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    // The measured bias includes the current offset registers
+    result = iam20680hpGyroOffsetAdjustment(&calibration->gyroOffset, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    result = iam20680hpAccelerometerOffset(&calibration->accelOffset, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    *gyroOriginal = calibration->gyroOffset;
+    *accelOriginal = calibration->accelOffset;
+
+    // Gyro offset: 1 LSB = 4 / 2^FS_SEL output LSB. Accel offset: 0.98mg = 2^AFS_SEL / 16 output LSB (15 bit)
+    int16_t *gyroOffset[3] = {&calibration->gyroOffset.offsetXGyro, &calibration->gyroOffset.offsetYGyro, &calibration->gyroOffset.offsetZGyro};
+    int16_t *accelOffset[3] = {&calibration->accelOffset.offsetXAccel, &calibration->accelOffset.offsetYAccel, &calibration->accelOffset.offsetZAccel};
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+        *gyroOffset[axis] = iam20680hpOffsetRound(*gyroOffset[axis] - gyro[axis] * (1 << gyroFsSel) / 4.0f, INT16_MIN, INT16_MAX);
+        *accelOffset[axis] = iam20680hpOffsetRound(*accelOffset[axis] - (accel[axis] - gravity[axis]) * (1 << accelFsSel) / 16.0f, -16384, 16383);
+    }
+
+    *written = true;
+    result = iam20680hpGyroOffsetAdjustment(&calibration->gyroOffset, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    result = iam20680hpAccelerometerOffset(&calibration->accelOffset, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    // Verify with half the samples
+    uint8_t rejected;
+    result = iam20680hpFifoCaptureAverage(samples / 2 > 0 ? samples / 2 : 1, accel, gyro, &rejected);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+        calibration->gyroResidual[axis] = gyro[axis];
+        calibration->accelResidual[axis] = accel[axis] - gravity[axis];
     }
 
     return IAM20680HP_OK;
 }
 
-IAM20680HP_err_t iam20680hpReadFifoCount(uint16_t *fifoCount)
+IAM20680HP_err_t iam20680hpCalibrateBias(IAM20680HP_biasCalibration_t *calibration, IAM20680HP_orientation_t orientation, uint16_t samples)
 {
-    data[0] = IAM20680HP_FIFO_COUNTH;
+    IAM20680HP_err_t result;
 
-    status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-    if (status != HAL_OK)
+    if (samples == 0 || orientation > IAM20680HP_Z_DOWN)
     {
-        return IAM20680HP_ERR_I2C;
+        return IAM20680HP_ERR_INVALID_PARAM;
     }
+    memset(calibration, 0, sizeof(*calibration));
 
-    memset(data, 0, 2);
-    status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 2, IAM20680HP_I2C_TIMEOUT);
-    if (status != HAL_OK)
+    IAM20680HP_savedConfig_t saved;
+    result = iam20680hpSaveConfig(&saved);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    IAM20680HP_gyroOffset_t gyroOriginal;
+    IAM20680HP_accelOffset_t accelOriginal;
+    bool written = false;
+    result = iam20680hpBiasCapture(calibration, &saved, orientation, samples, &gyroOriginal, &accelOriginal, &written);
+
+    // A failed write or verification leaves the offsets of before the calibration, the first error is returned
+    IAM20680HP_err_t restore = IAM20680HP_OK;
+    if (result != IAM20680HP_OK && written)
     {
-        return IAM20680HP_ERR_I2C;
+        restore = iam20680hpGyroOffsetAdjustment(&gyroOriginal, true);
+        IAM20680HP_err_t accelRestore = iam20680hpAccelerometerOffset(&accelOriginal, true);
+        if (restore == IAM20680HP_OK)
+            restore = accelRestore;
     }
 
-    *fifoCount = (uint16_t)(data[0] << 8 | data[1]);
+    // The configuration is restored after every capture, also after an error
+    IAM20680HP_err_t configRestore = iam20680hpRestoreConfig(&saved);
+    if (restore == IAM20680HP_OK)
+        restore = configRestore;
 
-    return IAM20680HP_OK;
+    if (result != IAM20680HP_OK)
+        return result;
+    return restore;
 }
 
-IAM20680HP_err_t iam20680hpReadFifoData(IAM20680HP_fifoData_t *fifoData)
+IAM20680HP_err_t iam20680hpCaptureAverage(uint16_t samples, float *accel, float *gyro, uint8_t *rejectedChunks)
 {
-    data[0] = IAM20680HP_FIFO_R_W;
+    IAM20680HP_err_t result;
 
-    status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-    if (status != HAL_OK)
+    if (samples == 0)
     {
-        return IAM20680HP_ERR_I2C;
+        return IAM20680HP_ERR_INVALID_PARAM;
     }
 
-    memset(data, 0, 14);
+    IAM20680HP_savedConfig_t saved;
+    result = iam20680hpSaveConfig(&saved);
+    if (result != IAM20680HP_OK)
+        return result;
 
-    status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 14, IAM20680HP_I2C_TIMEOUT);
-    if (status != HAL_OK)
-    {
-        return IAM20680HP_ERR_I2C;
-    }
+    result = iam20680hpSetCaptureConfig(&saved, saved.gyroConfig.FS_Sel, saved.accelConfig.AFS_Sel);
+    if (result == IAM20680HP_OK)
+        result = iam20680hpFifoCaptureAverage(samples, accel, gyro, rejectedChunks);
 
-    // Data integrity check
-    for (size_t i = 0; i < 14; i++)
+    // Restored after every capture, also after a failed one; the first error is returned
+    IAM20680HP_err_t restore = iam20680hpRestoreConfig(&saved);
+    if (result != IAM20680HP_OK)
+        return result;
+    return restore;
+}
+
+uint16_t iam20680hpCrc16(const uint8_t *buffer, size_t size)
+{
+    // CRC-16/CCITT-FALSE, polynomial 0x1021, init 0xFFFF
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < size; i++)
     {
-        if (data[i] == 0x00)
+        crc ^= (uint16_t)(buffer[i] << 8);
+        for (uint8_t bit = 0; bit < 8; bit++)
         {
-            return IAM20680HP_ERR_NOT_INITIALIZED;
-        }
-        if (data[i] == 0xFF)
-        {
-            return IAM20680HP_ERR_EOL;
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
         }
     }
+    return crc;
+}
+
+IAM20680HP_err_t iam20680hpReadOutputDataRate(uint16_t *odrHz)
+{
+    IAM20680HP_err_t result;
+
+    uint8_t sampleRateDivider = 0;
+    result = iam20680SampleRateDivider(&sampleRateDivider, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    uint8_t dlpf = 0;
+    result = iam20680hpConfigDlpfCfg(&dlpf, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    IAM20680HP_gyroConfig_t gyroConfig;
+    memset(&gyroConfig, 0, sizeof(gyroConfig));
+    result = iam20680hpGyroConfig(&gyroConfig, false);
+    if (result != IAM20680HP_OK)
+        return result;
 
-    fifoData->accelData.xAccel = (int16_t)(data[0] << 8 | data[1]);
-    fifoData->accelData.yAccel = (int16_t)(data[2] << 8 | data[3]);
-    fifoData->accelData.zAccel = (int16_t)(data[4] << 8 | data[5]);
-    fifoData->temperature = (int16_t)(data[6] << 8 | data[7]);
-    fifoData->temperature = ((fifoData->temperature / 326.8) + 25) * 100;
-    fifoData->gyroData.xGyro = (int16_t)(data[8] << 8 | data[9]);
-    fifoData->gyroData.yGyro = (int16_t)(data[10] << 8 | data[11]);
-    fifoData->gyroData.zGyro = (int16_t)(data[12] << 8 | data[13]);
+    // Table 17 datasheet, the divider is only effective with the DLPF (FCHOICE_B 0 and 0 < DLPF_CFG < 7)
+    *odrHz = IAM20680HP_OUTPUT_DATA_RATE_HZ(sampleRateDivider, dlpf, gyroConfig.FChoice);
 
     return IAM20680HP_OK;
 }
 
 IAM20680HP_err_t iam20680hpAccelerometerOffset(IAM20680HP_accelOffset_t *offSet, bool writeConfig)
 {
-    if (writeConfig)
+    // XA_OFFSET_H/L, YA_OFFSET_H/L and ZA_OFFSET_H/L are not contiguous (0x79 and 0x7C in between), so the 8 registers 
+    // from XA_OFFSET_H are read in one burst. Bit 0 of the low registers is reserved and has to be preserved.
+    data[0] = IAM20680HP_XA_OFFSET_H;
+    iam20680hpStatus = iam20680hpBusTransmit(data, 1);
+    if (iam20680hpStatus != IAM20680HP_OK)
     {
-        memset(data, 0, 7);
-        data[0] = IAM20680HP_XA_OFFSET_H;
+        return IAM20680HP_ERR_I2C;
+    }
 
-        offSet->offsetXAccel <<= 1;
-        uint16_t tempData = (uint16_t)offSet->offsetXAccel;
+    memset(data, 0, 9);
+    iam20680hpStatus = iam20680hpBusReceive(&data[1], 8);
+    if (iam20680hpStatus != IAM20680HP_OK)
+    {
+        return IAM20680HP_ERR_I2C;
+    }
+
+    if (writeConfig)
+    {
+        // 15 bit offset in bit 15:1
+        uint16_t tempData = (uint16_t)(offSet->offsetXAccel << 1);
         data[1] = (uint8_t)(tempData >> 8);
-        data[2] = (uint8_t)(tempData & 0xFF);
+        data[2] = (uint8_t)(tempData & 0xFE) | (data[2] & 0x01);
 
-        offSet->offsetYAccel <<= 1;
-        tempData = (uint16_t)offSet->offsetYAccel;
-        data[3] = (uint8_t)(tempData >> 8);
-        data[4] = (uint8_t)(tempData & 0xFF);
+        tempData = (uint16_t)(offSet->offsetYAccel << 1);
+        data[4] = (uint8_t)(tempData >> 8);
+        data[5] = (uint8_t)(tempData & 0xFE) | (data[5] & 0x01);
 
-        offSet->offsetZAccel <<= 1;
-        tempData = (uint16_t)offSet->offsetZAccel;
-        data[5] = (uint8_t)(tempData >> 8);
-        data[6] = (uint8_t)(tempData & 0xFF);
+        tempData = (uint16_t)(offSet->offsetZAccel << 1);
+        data[7] = (uint8_t)(tempData >> 8);
+        data[8] = (uint8_t)(tempData & 0xFE) | (data[8] & 0x01);
 
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 7, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
+        data[0] = IAM20680HP_XA_OFFSET_H;
+        iam20680hpStatus = iam20680hpBusTransmit(data, 9);
+        if (iam20680hpStatus != IAM20680HP_OK)
         {
             return IAM20680HP_ERR_I2C;
         }
     }
     else
     {
-
-        data[0] = IAM20680HP_XA_OFFSET_H;
-        status = HAL_I2C_Master_Transmit(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 1, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
-        {
-            return IAM20680HP_ERR_I2C;
-        }
-
-        memset(data, 0, 6);
-        status = HAL_I2C_Master_Receive(&I2C_HANDLER, (uint16_t)(IAM20680HP_I2C_ADDRESS << 1), data, 6, IAM20680HP_I2C_TIMEOUT);
-        if (status != HAL_OK)
-        {
-            return IAM20680HP_ERR_I2C;
-        }
-
-        offSet->offsetXAccel = (int16_t)(data[0] << 8 | data[1]);
+        offSet->offsetXAccel = (int16_t)(data[1] << 8 | data[2]);
         offSet->offsetXAccel >>= 1;
 
-        offSet->offsetYAccel = (int16_t)(data[2] << 8 | data[3]);
+        offSet->offsetYAccel = (int16_t)(data[4] << 8 | data[5]);
         offSet->offsetYAccel >>= 1;
 
-        offSet->offsetZAccel = (int16_t)(data[4] << 8 | data[5]);
+        offSet->offsetZAccel = (int16_t)(data[7] << 8 | data[8]);
         offSet->offsetZAccel >>= 1;
     }
 
@@ -1139,35 +2251,12 @@ IAM20680HP_err_t iam20680hpInit()
             return result;
     } 
 
-    // Output data rate selection
-    uint8_t sampleRateDivider = SAMPLE_RATE_DIV;
-    result = iam20680SampleRateDivider(&sampleRateDivider, true); 
-    if (result != IAM20680HP_OK)
-        return result;
-
-    // Config dlpf low pass filter setting
-    uint8_t dlpf = LOW_PASS_FILTER_GYRO_DLPF_CFG;
-    result = iam20680hpConfigDlpfCfg(&dlpf, true);
-    if (result != IAM20680HP_OK)
-        return result;
-
-    // Standard settings for gyro and accelerometer
-    IAM20680HP_gyroConfig_t gyroConfig;
-    memset(&gyroConfig, 0, sizeof(gyroConfig));
-    iam20680hpGyroConfig(&gyroConfig, false);
-    gyroConfig.FS_Sel = GYRO_FS_SEL;
-    gyroConfig.FChoice = GYRO_FCHOICE;
-    iam20680hpGyroConfig(&gyroConfig, true);
-
-    IAM20680HP_accelConfig_t accelConfig;
-    memset(&accelConfig, 0, sizeof(accelConfig));
-    iam20680hpAccelConfig(&accelConfig, false);
-    accelConfig.AFS_Sel = ACCEL_FS_SEL;
-    accelConfig.FChoice = ACCEL_FCHOICE;
-    accelConfig.dlpfCfg = ACCEL_DLPF_CFG;
-    accelConfig.fifoSize = ACCEL_FIFO_SIZE;
-    accelConfig.dec2Cfg = ACCEL_DEC2_CFG;
-    iam20680hpAccelConfig(&accelConfig, true);
+    // Output data rate, dlpf, gyro and accelerometer settings in one burst (SMPLRT_DIV to ACCEL_CONFIG2). The bus 
+    // backend takes a writable buffer, so the table is copied to data[]
+    memcpy(data, initTable, sizeof(initTable));
+    iam20680hpStatus = iam20680hpBusTransmit(data, sizeof(initTable));
+    if (iam20680hpStatus != IAM20680HP_OK)
+        return IAM20680HP_ERR_I2C;
 
     if (!firstInitialized)
         firstInitialized = true;
@@ -1257,7 +2346,8 @@ IAM20680HP_err_t iam20680hpEnableWomModeFunction()
     if (result != IAM20680HP_OK)
         return result;
 
-    // Put accel cycle on in powermanagement, NOT into sleep mode
+    // Put accel cycle on in powermanagement, NOT into sleep mode (set by the reset of iam20680hpInit())
+    powerManagement.sleep = 0;
     powerManagement.accelCycle = 1;
     powerManagement.stby_xa = 0;
     powerManagement.stby_ya = 0;
@@ -1333,7 +2423,7 @@ IAM20680HP_err_t iam20680hpDisableWomModeFunction()
     if (result != IAM20680HP_OK)
         return result;
   
-    HAL_Delay(50);
+    iam20680hpBusDelay(50);
 
     return IAM20680HP_OK;
 }
@@ -0,0 +1,390 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Shared bus scheduler, see iam20680hp_bus.h.
+
+*/
+
+#include "iam20680hp_bus.h"
+
+static IAM20680HP_busScheduler_t *busAttached;
+
+IAM20680HP_err_t iam20680hpBusInit(IAM20680HP_busScheduler_t *scheduler, const IAM20680HP_busConfig_t *config)
+{
+    if (config->busHz == 0 || config->transfer == NULL || config->clockUs == NULL)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    memset(scheduler, 0, sizeof(*scheduler));
+    scheduler->config = *config;
+    return IAM20680HP_OK;
+}
+
+/*
+ * Lock hook of the settings, nothing without it
+ */
+static void iam20680hpBusLock(const IAM20680HP_busScheduler_t *scheduler, bool lock)
+{
+    if (scheduler->config.lock != NULL)
+    {
+        scheduler->config.lock(lock);
+    }
+}
+
+IAM20680HP_err_t iam20680hpBusSubmit(IAM20680HP_busScheduler_t *scheduler, IAM20680HP_busTransaction_t *transaction)
+{
+    if (transaction->size == 0)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    iam20680hpBusLock(scheduler, true);
+    if (scheduler->count >= IAM20680HP_BUS_QUEUE)
+    {
+        iam20680hpBusLock(scheduler, false);
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+    transaction->finished = false;
+    transaction->sequence = scheduler->sequence++;
+    scheduler->queue[scheduler->count++] = transaction;
+    iam20680hpBusLock(scheduler, false);
+    return IAM20680HP_OK;
+}
+
+uint32_t iam20680hpBusDuration(const IAM20680HP_busScheduler_t *scheduler, uint16_t size, bool read)
+{
+    // Register address byte, with a read the device address is sent again
+    uint32_t bits = IAM20680HP_BUS_OVERHEAD_BITS + (uint32_t)(size + 1 + read) * 9;
+    return (uint32_t)((uint64_t)bits * 1000000 / scheduler->config.busHz) + 1;
+}
+
+void iam20680hpBusReserveDrain(IAM20680HP_busScheduler_t *scheduler, uint8_t address, const IAM20680HP_drainScheduler_t *drain, 
+                               uint32_t lastDrainUs)
+{
+    uint32_t bytes = (uint32_t)drain->fifoSize * IAM20680HP_DRAIN_NEAR_OVERFLOW / 100;
+    uint32_t fillUs = (uint32_t)((uint64_t)bytes * 1000000 / (drain->fillRate > 0 ? drain->fillRate : 1));
+
+    // The drain has to start early enough to be done before the FiFo is near overflow
+    uint32_t drainUs = iam20680hpBusDuration(scheduler, (uint16_t)bytes, true);
+    iam20680hpBusLock(scheduler, true);
+    scheduler->reserveAddress = address;
+    scheduler->reserveUs = lastDrainUs + fillUs - drainUs;
+    scheduler->reserveEndUs = scheduler->reserveUs + drainUs;
+    scheduler->reserved = true;
+    iam20680hpBusLock(scheduler, false);
+}
+
+/*
+ * True if a goes before b: priority, deadline, submission
+ */
+static bool iam20680hpBusBefore(const IAM20680HP_busTransaction_t *a, const IAM20680HP_busTransaction_t *b)
+{
+    if (a->priority != b->priority)
+    {
+        return a->priority > b->priority;
+    }
+    if (a->hasDeadline != b->hasDeadline)
+    {
+        return a->hasDeadline;
+    }
+    if (a->hasDeadline && a->deadlineUs != b->deadlineUs)
+    {
+        return (int32_t)(a->deadlineUs - b->deadlineUs) < 0;
+    }
+    return (int32_t)(a->sequence - b->sequence) < 0;
+}
+
+static void iam20680hpBusRemove(IAM20680HP_busScheduler_t *scheduler, uint8_t index)
+{
+    scheduler->count--;
+    memmove(&scheduler->queue[index], &scheduler->queue[index + 1], (scheduler->count - index) * sizeof(scheduler->queue[0]));
+}
+
+/*
+ * Result of a transaction, the deadline is checked at the end of its transfer
+ */
+static void iam20680hpBusResult(IAM20680HP_busScheduler_t *scheduler, IAM20680HP_busTransaction_t *transaction, IAM20680HP_err_t result, 
+                                uint32_t nowUs)
+{
+    if (transaction->hasDeadline && (int32_t)(nowUs - transaction->deadlineUs) > 0)
+    {
+        scheduler->missedDeadlines++;
+    }
+    transaction->result = result;
+}
+
+/*
+ * Marks a transaction done, outside the lock so done may submit the next one
+ */
+static void iam20680hpBusFinish(IAM20680HP_busTransaction_t *transaction)
+{
+    transaction->finished = true;
+    if (transaction->done != NULL)
+    {
+        transaction->done(transaction, transaction->context);
+    }
+}
+
+/*
+ * Does one transaction (removed from the queue) together with the queued transactions it can be merged with, these are 
+ * stored in merged. Called with the lock, the transactions are finished by the caller.
+ */
+static uint8_t iam20680hpBusExecute(IAM20680HP_busScheduler_t *scheduler, IAM20680HP_busTransaction_t *transaction, 
+                                    IAM20680HP_busTransaction_t **merged)
+{
+    uint8_t mergedCount = 0;
+    uint8_t *buffer = transaction->buffer;
+    uint16_t size = transaction->size;
+
+    if (!transaction->read && size <= IAM20680HP_BUS_MERGE_SIZE)
+    {
+        // Writes that continue at the next register, in register order
+        bool found = true;
+        memcpy(scheduler->merge, transaction->buffer, size);
+        while (found)
+        {
+            found = false;
+            for (uint8_t i = 0; i < scheduler->count; i++)
+            {
+                IAM20680HP_busTransaction_t *next = scheduler->queue[i];
+                if (!next->read && next->address == transaction->address && next->reg == (uint8_t)(transaction->reg + size) &&
+                    size + next->size <= IAM20680HP_BUS_MERGE_SIZE)
+                {
+                    memcpy(&scheduler->merge[size], next->buffer, next->size);
+                    size += next->size;
+                    merged[mergedCount++] = next;
+                    iam20680hpBusRemove(scheduler, i);
+                    found = true;
+                    break;
+                }
+            }
+        }
+        buffer = mergedCount > 0 ? scheduler->merge : transaction->buffer;
+    }
+    else if (transaction->read && (transaction->flags & IAM20680HP_BUS_MERGE))
+    {
+        for (uint8_t i = 0; i < scheduler->count;)
+        {
+            IAM20680HP_busTransaction_t *same = scheduler->queue[i];
+            if (same->read && (same->flags & IAM20680HP_BUS_MERGE) && same->address == transaction->address &&
+                same->reg == transaction->reg && same->size == transaction->size)
+            {
+                merged[mergedCount++] = same;
+                iam20680hpBusRemove(scheduler, i);
+            }
+            else
+            {
+                i++;
+            }
+        }
+    }
+
+    uint32_t timeoutMs = iam20680hpBusDuration(scheduler, size, transaction->read) * 2 / 1000 + 1;
+    IAM20680HP_err_t result = scheduler->config.transfer(transaction->address, transaction->reg, buffer, size, transaction->read, timeoutMs,
+                                                         scheduler->config.context);
+    uint32_t nowUs = scheduler->config.clockUs();
+
+    scheduler->transfers++;
+    scheduler->merged += mergedCount;
+    if (transaction->priority >= IAM20680HP_BUS_PRIORITY_FIFO)
+    {
+        scheduler->reserved = false;
+    }
+
+    iam20680hpBusResult(scheduler, transaction, result, nowUs);
+    for (uint8_t i = 0; i < mergedCount; i++)
+    {
+        if (transaction->read)
+        {
+            memcpy(merged[i]->buffer, transaction->buffer, size);
+        }
+        iam20680hpBusResult(scheduler, merged[i], result, nowUs);
+    }
+    return mergedCount;
+}
+
+/*
+ * Runs until the queue is empty, a reserved drain is due or until is finished. until is done before a drain reserved for its 
+ * own device (the caller holds the driver, that drain can not start before it), not before the drain of an other device.
+ */
+static uint16_t iam20680hpBusRunUntil(IAM20680HP_busScheduler_t *scheduler, IAM20680HP_busTransaction_t *until)
+{
+    IAM20680HP_busTransaction_t *merged[IAM20680HP_BUS_QUEUE];
+    uint16_t transfers = 0;
+
+    while (true)
+    {
+        iam20680hpBusLock(scheduler, true);
+        if (scheduler->count == 0 || (until != NULL && until->finished))
+        {
+            iam20680hpBusLock(scheduler, false);
+            break;
+        }
+
+        uint8_t best = 0;
+        for (uint8_t i = 1; i < scheduler->count; i++)
+        {
+            if (iam20680hpBusBefore(scheduler->queue[i], scheduler->queue[best]))
+            {
+                best = i;
+            }
+        }
+
+        IAM20680HP_busTransaction_t *transaction = scheduler->queue[best];
+        if (scheduler->reserved && transaction->priority < IAM20680HP_BUS_PRIORITY_FIFO)
+        {
+            uint32_t nowUs = scheduler->config.clockUs();
+            uint32_t endUs = nowUs + iam20680hpBusDuration(scheduler, transaction->size, transaction->read);
+            if ((int32_t)(nowUs - scheduler->reserveEndUs) > 0)
+            {
+                // The drain did not come (e.g. the FiFo task stopped), the bus is not held back forever
+                scheduler->reserved = false;
+                scheduler->expired++;
+            }
+            else if ((int32_t)(endUs - scheduler->reserveUs) > 0)
+            {
+                scheduler->heldBack++;
+                bool own = false;
+                for (uint8_t i = 0; until != NULL && until->address == scheduler->reserveAddress && i < scheduler->count; i++)
+                {
+                    own |= scheduler->queue[i] == until;
+                }
+                if (!own)
+                {
+                    iam20680hpBusLock(scheduler, false);
+                    break;
+                }
+                transaction = until;
+                for (best = 0; scheduler->queue[best] != until; best++)
+                {
+                }
+            }
+        }
+
+        iam20680hpBusRemove(scheduler, best);
+        uint8_t mergedCount = iam20680hpBusExecute(scheduler, transaction, merged);
+        iam20680hpBusLock(scheduler, false);
+
+        iam20680hpBusFinish(transaction);
+        for (uint8_t i = 0; i < mergedCount; i++)
+        {
+            iam20680hpBusFinish(merged[i]);
+        }
+        transfers++;
+    }
+
+    return transfers;
+}
+
+uint16_t iam20680hpBusRun(IAM20680HP_busScheduler_t *scheduler)
+{
+    return iam20680hpBusRunUntil(scheduler, NULL);
+}
+
+void iam20680hpBusAttach(IAM20680HP_busScheduler_t *scheduler)
+{
+    busAttached = scheduler;
+}
+
+#if IAM20680HP_BUS_BACKEND && !IAM20680HP_USE_HAL
+static uint8_t busRegister;
+
+/*
+ * Driver access as a transaction, waits until it is done
+ */
+static IAM20680HP_err_t iam20680hpBusTransaction(uint8_t reg, uint8_t *buffer, uint16_t size, bool read)
+{
+    IAM20680HP_busTransaction_t transaction;
+
+    if (busAttached == NULL)
+    {
+        return IAM20680HP_ERR_I2C;
+    }
+
+    memset(&transaction, 0, sizeof(transaction));
+    transaction.address = iam20680hpSelectedDevice();
+    transaction.reg = reg;
+    transaction.buffer = buffer;
+    transaction.size = size;
+    transaction.read = read;
+    bool fifo = reg == IAM20680HP_FIFO_R_W || reg == IAM20680HP_FIFO_COUNTH;
+    transaction.priority = fifo ? IAM20680HP_BUS_PRIORITY_FIFO : IAM20680HP_BUS_PRIORITY_IMU;
+
+    IAM20680HP_err_t result = iam20680hpBusSubmit(busAttached, &transaction);
+    if (result != IAM20680HP_OK)
+    {
+        // Queue full, make room
+        iam20680hpBusRun(busAttached);
+        result = iam20680hpBusSubmit(busAttached, &transaction);
+        if (result != IAM20680HP_OK)
+            return IAM20680HP_ERR_I2C;
+    }
+
+    // Held back by the drain of an other device or done by an other task: wait until it is finished
+    while (!transaction.finished)
+    {
+        iam20680hpBusRunUntil(busAttached, &transaction);
+        if (!transaction.finished && busAttached->config.delayMs != NULL)
+        {
+            busAttached->config.delayMs(1);
+        }
+    }
+    return transaction.result == IAM20680HP_OK ? IAM20680HP_OK : IAM20680HP_ERR_I2C;
+}
+
+IAM20680HP_err_t iam20680hpBusTransmit(uint8_t *buffer, uint16_t size)
+{
+    if (size == 0)
+    {
+        return IAM20680HP_ERR_I2C;
+    }
+
+    // Register address only: the next iam20680hpBusReceive() reads from it
+    busRegister = buffer[0];
+    if (size == 1)
+    {
+        return IAM20680HP_OK;
+    }
+    IAM20680HP_err_t result = iam20680hpBusTransaction(buffer[0], &buffer[1], size - 1, false);
+    if (result == IAM20680HP_OK)
+    {
+        iam20680hpShadowRecord(buffer, size);
+    }
+    return result;
+}
+
+IAM20680HP_err_t iam20680hpBusReceive(uint8_t *buffer, uint16_t size)
+{
+    return iam20680hpBusTransaction(busRegister, buffer, size, true);
+}
+
+void iam20680hpBusDelay(uint32_t ms)
+{
+    if (busAttached != NULL && busAttached->config.delayMs != NULL)
+    {
+        busAttached->config.delayMs(ms);
+    }
+}
+#endif
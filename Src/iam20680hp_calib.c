@@ -0,0 +1,404 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Calibration record and its blob format, see iam20680hp_calib.h.
+
+*/
+
+#include "iam20680hp_calib.h"
+
+static const uint8_t calibMagic[4] = {'I', 'A', 'M', 'C'};
+
+
+static void iam20680hpCalibPut16(uint8_t **buffer, int16_t value)
+{
+    (*buffer)[0] = (uint8_t)(value);
+    (*buffer)[1] = (uint8_t)((uint16_t)value >> 8);
+    *buffer += 2;
+}
+
+static void iam20680hpCalibPut32(uint8_t **buffer, int32_t value)
+{
+    iam20680hpCalibPut16(buffer, (int16_t)(uint16_t)value);
+    iam20680hpCalibPut16(buffer, (int16_t)(uint16_t)((uint32_t)value >> 16));
+}
+
+static int16_t iam20680hpCalibGet16(const uint8_t **buffer)
+{
+    int16_t value = (int16_t)((*buffer)[0] | (*buffer)[1] << 8);
+    *buffer += 2;
+    return value;
+}
+
+static int32_t iam20680hpCalibGet32(const uint8_t **buffer)
+{
+    uint32_t low = (uint16_t)iam20680hpCalibGet16(buffer);
+    uint32_t high = (uint16_t)iam20680hpCalibGet16(buffer);
+    return (int32_t)(low | high << 16);
+}
+
+void iam20680hpCalibInit(IAM20680HP_calibration_t *calibration)
+{
+    memset(calibration, 0, sizeof(*calibration));
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+        calibration->accelMatrix[axis][axis] = IAM20680HP_CALIB_MATRIX_ONE;
+        calibration->gyroMatrix[axis][axis] = IAM20680HP_CALIB_MATRIX_ONE;
+    }
+}
+
+IAM20680HP_err_t iam20680hpCalibReadOffsets(IAM20680HP_calibration_t *calibration)
+{
+    IAM20680HP_err_t result;
+
+    result = iam20680hpGyroOffsetAdjustment(&calibration->gyroOffset, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    return iam20680hpAccelerometerOffset(&calibration->accelOffset, false);
+}
+
+IAM20680HP_err_t iam20680hpCalibRestore(const IAM20680HP_calibration_t *calibration)
+{
+    IAM20680HP_err_t result;
+
+    // The offset functions take non-const pointers
+    IAM20680HP_gyroOffset_t gyroOffset = calibration->gyroOffset;
+    result = iam20680hpGyroOffsetAdjustment(&gyroOffset, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    // Read-modify-write: the burst also writes 0x79, 0x7C and the reserved bit 0, which the record does not hold
+    IAM20680HP_accelOffset_t accelOffset = calibration->accelOffset;
+    return iam20680hpAccelerometerOffset(&accelOffset, true);
+}
+
+void iam20680hpCalibFromTempComp(IAM20680HP_calibration_t *calibration, const IAM20680HP_tempComp_t *model)
+{
+    memcpy(calibration->tempCoefficient, model->coefficient, sizeof(calibration->tempCoefficient));
+    calibration->tempReference = model->referenceTemperature;
+    calibration->tempOrder = model->order;
+    calibration->tempValid = model->valid;
+}
+
+void iam20680hpCalibToTempComp(const IAM20680HP_calibration_t *calibration, IAM20680HP_tempComp_t *model)
+{
+    iam20680hpTempCompInit(model, calibration->tempOrder <= 2 ? calibration->tempOrder : 2, calibration->tempReference);
+    memcpy(model->coefficient, calibration->tempCoefficient, sizeof(model->coefficient));
+    model->order = model->maxOrder;
+    model->valid = calibration->tempValid;
+}
+
+void iam20680hpCalibSerialize(const IAM20680HP_calibration_t *calibration, uint8_t *buffer)
+{
+    uint8_t *position = buffer;
+
+    memcpy(position, calibMagic, sizeof(calibMagic));
+    position += sizeof(calibMagic);
+    *position++ = IAM20680HP_CALIB_VERSION;
+    *position++ = calibration->tempOrder;
+    *position++ = calibration->tempValid;
+    *position++ = 0;
+
+    iam20680hpCalibPut16(&position, calibration->gyroOffset.offsetXGyro);
+    iam20680hpCalibPut16(&position, calibration->gyroOffset.offsetYGyro);
+    iam20680hpCalibPut16(&position, calibration->gyroOffset.offsetZGyro);
+    iam20680hpCalibPut16(&position, calibration->accelOffset.offsetXAccel);
+    iam20680hpCalibPut16(&position, calibration->accelOffset.offsetYAccel);
+    iam20680hpCalibPut16(&position, calibration->accelOffset.offsetZAccel);
+
+    for (uint8_t row = 0; row < 3; row++)
+    {
+        for (uint8_t column = 0; column < 3; column++)
+        {
+            iam20680hpCalibPut16(&position, calibration->accelMatrix[row][column]);
+        }
+    }
+    for (uint8_t row = 0; row < 3; row++)
+    {
+        for (uint8_t column = 0; column < 3; column++)
+        {
+            iam20680hpCalibPut16(&position, calibration->gyroMatrix[row][column]);
+        }
+    }
+
+    iam20680hpCalibPut16(&position, calibration->tempReference);
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+        for (uint8_t term = 0; term < 3; term++)
+        {
+            iam20680hpCalibPut32(&position, calibration->tempCoefficient[axis][term]);
+        }
+    }
+
+    uint16_t crc = iam20680hpCrc16(buffer, IAM20680HP_CALIB_BLOB_SIZE - 2);
+    iam20680hpCalibPut16(&position, (int16_t)crc);
+}
+
+IAM20680HP_err_t iam20680hpCalibDeserialize(const uint8_t *buffer, size_t size, IAM20680HP_calibration_t *calibration)
+{
+    IAM20680HP_calibration_t record;
+    const uint8_t *position = buffer;
+
+    if (size < IAM20680HP_CALIB_BLOB_SIZE)
+    {
+        return IAM20680HP_ERR_EOL;
+    }
+    if (memcmp(buffer, calibMagic, sizeof(calibMagic)) != 0 || buffer[4] != IAM20680HP_CALIB_VERSION)
+    {
+        return IAM20680HP_ERR_NOT_SUPPORTED;
+    }
+    if ((uint16_t)(buffer[IAM20680HP_CALIB_BLOB_SIZE - 2] | buffer[IAM20680HP_CALIB_BLOB_SIZE - 1] << 8) != iam20680hpCrc16(buffer, IAM20680HP_CALIB_BLOB_SIZE - 2))
+    {
+        return IAM20680HP_ERR_CRC;
+    }
+
+    position += sizeof(calibMagic) + 1;
+    record.tempOrder = *position++;
+    record.tempValid = *position++ != 0;
+    position++;
+
+    record.gyroOffset.offsetXGyro = iam20680hpCalibGet16(&position);
+    record.gyroOffset.offsetYGyro = iam20680hpCalibGet16(&position);
+    record.gyroOffset.offsetZGyro = iam20680hpCalibGet16(&position);
+    record.accelOffset.offsetXAccel = iam20680hpCalibGet16(&position);
+    record.accelOffset.offsetYAccel = iam20680hpCalibGet16(&position);
+    record.accelOffset.offsetZAccel = iam20680hpCalibGet16(&position);
+
+    for (uint8_t row = 0; row < 3; row++)
+    {
+        for (uint8_t column = 0; column < 3; column++)
+        {
+            record.accelMatrix[row][column] = iam20680hpCalibGet16(&position);
+        }
+    }
+    for (uint8_t row = 0; row < 3; row++)
+    {
+        for (uint8_t column = 0; column < 3; column++)
+        {
+            record.gyroMatrix[row][column] = iam20680hpCalibGet16(&position);
+        }
+    }
+
+    record.tempReference = iam20680hpCalibGet16(&position);
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+        for (uint8_t term = 0; term < 3; term++)
+        {
+            record.tempCoefficient[axis][term] = iam20680hpCalibGet32(&position);
+        }
+    }
+
+    *calibration = record;
+    return IAM20680HP_OK;
+}
+
+void iam20680hpCalibMatrixKernel(const int16_t matrix[3][3], int16_t *restrict x, int16_t *restrict y, int16_t *restrict z, uint16_t count)
+{
+    const int32_t m00 = matrix[0][0], m01 = matrix[0][1], m02 = matrix[0][2];
+    const int32_t m10 = matrix[1][0], m11 = matrix[1][1], m12 = matrix[1][2];
+    const int32_t m20 = matrix[2][0], m21 = matrix[2][1], m22 = matrix[2][2];
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        int32_t inX = x[i], inY = y[i], inZ = z[i];
+        int32_t outX = (m00 * inX + m01 * inY + m02 * inZ + (1 << 13)) >> 14;
+        int32_t outY = (m10 * inX + m11 * inY + m12 * inZ + (1 << 13)) >> 14;
+        int32_t outZ = (m20 * inX + m21 * inY + m22 * inZ + (1 << 13)) >> 14;
+
+        x[i] = (int16_t)(outX > INT16_MAX ? INT16_MAX : outX < INT16_MIN ? INT16_MIN : outX);
+        y[i] = (int16_t)(outY > INT16_MAX ? INT16_MAX : outY < INT16_MIN ? INT16_MIN : outY);
+        z[i] = (int16_t)(outZ > INT16_MAX ? INT16_MAX : outZ < INT16_MIN ? INT16_MIN : outZ);
+    }
+}
+
+void iam20680hpCalibApply(const IAM20680HP_calibration_t *calibration, IAM20680HP_fifoData_t *frames, uint16_t count)
+{
+    int16_t x[IAM20680HP_CALIB_BLOCK], y[IAM20680HP_CALIB_BLOCK], z[IAM20680HP_CALIB_BLOCK];
+
+    for (uint16_t start = 0; start < count; start += IAM20680HP_CALIB_BLOCK)
+    {
+        IAM20680HP_fifoData_t *block = &frames[start];
+        uint16_t size = count - start < IAM20680HP_CALIB_BLOCK ? count - start : IAM20680HP_CALIB_BLOCK;
+
+        for (uint16_t i = 0; i < size; i++)
+        {
+            x[i] = block[i].accelData.xAccel;
+            y[i] = block[i].accelData.yAccel;
+            z[i] = block[i].accelData.zAccel;
+        }
+        iam20680hpCalibMatrixKernel(calibration->accelMatrix, x, y, z, size);
+        for (uint16_t i = 0; i < size; i++)
+        {
+            block[i].accelData.xAccel = x[i];
+            block[i].accelData.yAccel = y[i];
+            block[i].accelData.zAccel = z[i];
+        }
+
+        for (uint16_t i = 0; i < size; i++)
+        {
+            x[i] = block[i].gyroData.xGyro;
+            y[i] = block[i].gyroData.yGyro;
+            z[i] = block[i].gyroData.zGyro;
+        }
+        iam20680hpCalibMatrixKernel(calibration->gyroMatrix, x, y, z, size);
+        for (uint16_t i = 0; i < size; i++)
+        {
+            block[i].gyroData.xGyro = x[i];
+            block[i].gyroData.yGyro = y[i];
+            block[i].gyroData.zGyro = z[i];
+        }
+    }
+}
+
+void iam20680hpCalibSixPositionInit(IAM20680HP_sixPosition_t *sixPosition)
+{
+    memset(sixPosition, 0, sizeof(*sixPosition));
+}
+
+IAM20680HP_err_t iam20680hpCalibSixPositionCapture(IAM20680HP_sixPosition_t *sixPosition, IAM20680HP_orientation_t orientation, uint16_t samples)
+{
+    IAM20680HP_err_t result;
+
+    if (orientation > IAM20680HP_Z_DOWN)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    IAM20680HP_accelConfig_t accelConfig;
+    memset(&accelConfig, 0, sizeof(accelConfig));
+    result = iam20680hpAccelConfig(&accelConfig, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    if (sixPosition->captured != 0 && accelConfig.AFS_Sel != sixPosition->accelFsSel)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    float accel[3], gyro[3];
+    uint8_t rejected;
+    result = iam20680hpCaptureAverage(samples, accel, gyro, &rejected);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    // The axis of the orientation must carry more than half of 1g with the expected sign
+    uint8_t axis = orientation / 2;
+    float gravity = (float)(16384 >> accelConfig.AFS_Sel) * (orientation % 2 ? -1.0f : 1.0f);
+    if (accel[axis] * gravity < 0.5f * gravity * gravity)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    result = iam20680hpAccelerometerOffset(&sixPosition->accelOffset, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    memcpy(sixPosition->accel[orientation], accel, sizeof(accel));
+    sixPosition->accelFsSel = accelConfig.AFS_Sel;
+    sixPosition->captured |= 1 << orientation;
+    sixPosition->rejectedChunks += rejected;
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpCalibSixPositionSolve(const IAM20680HP_sixPosition_t *sixPosition, IAM20680HP_calibration_t *calibration)
+{
+    float scale[3][3], inverse[3][3], bias[3];
+
+    if (sixPosition->captured != 0x3F)
+    {
+        return IAM20680HP_ERR_NOT_READY;
+    }
+
+    // Column j of S: response to +1g minus -1g on axis j. Bias: mean of the six positions
+    float gravity = (float)(16384 >> sixPosition->accelFsSel);
+    for (uint8_t row = 0; row < 3; row++)
+    {
+        bias[row] = 0.0f;
+        for (uint8_t position = 0; position < 6; position++)
+        {
+            bias[row] += sixPosition->accel[position][row] / 6.0f;
+        }
+        for (uint8_t column = 0; column < 3; column++)
+        {
+            scale[row][column] = (sixPosition->accel[2 * column][row] - sixPosition->accel[2 * column + 1][row]) / (2.0f * gravity);
+        }
+    }
+
+    // Inverse by the adjugate
+    float determinant = scale[0][0] * (scale[1][1] * scale[2][2] - scale[1][2] * scale[2][1])
+                      - scale[0][1] * (scale[1][0] * scale[2][2] - scale[1][2] * scale[2][0])
+                      + scale[0][2] * (scale[1][0] * scale[2][1] - scale[1][1] * scale[2][0]);
+    if (determinant < 0.5f || determinant > 2.0f)
+    {
+        return IAM20680HP_ERR_NOT_CALIBRATED;
+    }
+    for (uint8_t row = 0; row < 3; row++)
+    {
+        for (uint8_t column = 0; column < 3; column++)
+        {
+            uint8_t r0 = (column + 1) % 3, r1 = (column + 2) % 3;
+            uint8_t c0 = (row + 1) % 3, c1 = (row + 2) % 3;
+            inverse[row][column] = (scale[r0][c0] * scale[r1][c1] - scale[r0][c1] * scale[r1][c0]) / determinant;
+        }
+    }
+
+    // Q14 with the row limit of the kernel
+    int16_t matrix[3][3];
+    for (uint8_t row = 0; row < 3; row++)
+    {
+        int32_t rowSum = 0;
+        for (uint8_t column = 0; column < 3; column++)
+        {
+            float value = inverse[row][column] * IAM20680HP_CALIB_MATRIX_ONE;
+            int32_t rounded = (int32_t)(value + (value >= 0 ? 0.5f : -0.5f));
+            if (rounded > INT16_MAX || rounded < INT16_MIN)
+            {
+                return IAM20680HP_ERR_NOT_CALIBRATED;
+            }
+            matrix[row][column] = (int16_t)rounded;
+            rowSum += rounded >= 0 ? rounded : -rounded;
+        }
+        if (rowSum >= 2 * IAM20680HP_CALIB_MATRIX_ONE)
+        {
+            return IAM20680HP_ERR_NOT_CALIBRATED;
+        }
+    }
+
+    // Accel offset: 0.98mg = 2^AFS_SEL / 16 output LSB (15 bit), on top of the offsets during the captures
+    const int16_t captureOffset[3] = {sixPosition->accelOffset.offsetXAccel, sixPosition->accelOffset.offsetYAccel, sixPosition->accelOffset.offsetZAccel};
+    int16_t accelOffset[3];
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+        float value = captureOffset[axis] - bias[axis] * (1 << sixPosition->accelFsSel) / 16.0f;
+        int32_t rounded = (int32_t)(value + (value >= 0 ? 0.5f : -0.5f));
+        accelOffset[axis] = (int16_t)(rounded < -16384 ? -16384 : rounded > 16383 ? 16383 : rounded);
+    }
+
+    memcpy(calibration->accelMatrix, matrix, sizeof(matrix));
+    calibration->accelOffset.offsetXAccel = accelOffset[0];
+    calibration->accelOffset.offsetYAccel = accelOffset[1];
+    calibration->accelOffset.offsetZAccel = accelOffset[2];
+    return IAM20680HP_OK;
+}
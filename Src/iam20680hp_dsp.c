@@ -0,0 +1,335 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Multi-stage decimating filter, see iam20680hp_dsp.h.
+
+*/
+
+#include "iam20680hp_dsp.h"
+#include "math.h"
+
+#if IAM20680HP_DSP_SIMD
+#include "main.h"
+#endif
+
+#define IAM20680HP_DSP_PI 3.14159265f
+#define IAM20680HP_DSP_BIQUAD_FRACTION 8     //Bits below the output LSB in the biquad feedback state
+
+static int16_t iam20680hpDspSaturate(int64_t value)
+{
+    return (int16_t)(value > INT16_MAX ? INT16_MAX : value < INT16_MIN ? INT16_MIN : value);
+}
+
+void iam20680hpDspInit(IAM20680HP_dsp_t *filter)
+{
+    memset(filter, 0, sizeof(*filter));
+}
+
+void iam20680hpDspReset(IAM20680HP_dsp_t *filter)
+{
+    for (uint8_t i = 0; i < filter->numStages; i++)
+    {
+        IAM20680HP_dspStage_t *stage = &filter->stages[i];
+        stage->phase = 0;
+        stage->position = 0;
+        memset(stage->history, 0, sizeof(stage->history));
+        memset(stage->state, 0, sizeof(stage->state));
+    }
+}
+
+static IAM20680HP_err_t iam20680hpDspAddStage(IAM20680HP_dsp_t *filter, IAM20680HP_dspStageType_t type, const int16_t *taps, 
+                                              const int32_t *biquads, uint8_t length, uint8_t decimation)
+{
+    if (filter->numStages >= IAM20680HP_DSP_MAX_STAGES || (taps == NULL && biquads == NULL) || decimation == 0)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    IAM20680HP_dspStage_t *stage = &filter->stages[filter->numStages++];
+    memset(stage, 0, sizeof(*stage));
+    stage->type = type;
+    stage->taps = taps;
+    stage->biquads = biquads;
+    stage->length = length;
+    stage->decimation = decimation;
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpDspAddFir(IAM20680HP_dsp_t *filter, const int16_t *taps, uint8_t numTaps, uint8_t decimation)
+{
+    if (taps == NULL || numTaps == 0 || numTaps > IAM20680HP_DSP_MAX_TAPS)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    // The 32 bit accumulator can not overflow when the absolute taps sum below 2.0
+    int32_t sum = 0;
+    for (uint8_t i = 0; i < numTaps; i++)
+    {
+        sum += taps[i] >= 0 ? taps[i] : -taps[i];
+    }
+    if (sum >= 65536)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    return iam20680hpDspAddStage(filter, IAM20680HP_DSP_FIR, taps, NULL, numTaps, decimation);
+}
+
+IAM20680HP_err_t iam20680hpDspAddBiquad(IAM20680HP_dsp_t *filter, const int32_t *coefficients, uint8_t sections, uint8_t decimation)
+{
+    if (sections == 0 || sections > IAM20680HP_DSP_MAX_BIQUADS)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    return iam20680hpDspAddStage(filter, IAM20680HP_DSP_BIQUAD, NULL, coefficients, sections, decimation);
+}
+
+/*
+ * Dot product of the taps and the history window, 32 bit accumulate
+ */
+static int32_t iam20680hpDspDot(const int16_t *restrict taps, const int16_t *restrict window, uint8_t length)
+{
+    int32_t accumulator = 0;
+    uint8_t tap = 0;
+
+#if IAM20680HP_DSP_SIMD
+    // Two 16 x 16 products per instruction, the halves pair up as in the plain loop (unaligned word loads)
+    for (; tap + 1 < length; tap += 2)
+    {
+        uint32_t tapPair, samplePair;
+        memcpy(&tapPair, &taps[tap], sizeof(tapPair));
+        memcpy(&samplePair, &window[tap], sizeof(samplePair));
+        accumulator = (int32_t)__SMLAD(tapPair, samplePair, (uint32_t)accumulator);
+    }
+#endif
+    for (; tap < length; tap++)
+    {
+        accumulator += (int32_t)taps[tap] * window[tap];
+    }
+    return accumulator;
+}
+
+/*
+ * FIR decimator on one axis. The taps are applied newest sample first, output j is written over input j * decimation or 
+ * earlier, so in place is safe.
+ */
+static uint16_t iam20680hpDspFir(IAM20680HP_dspStage_t *stage, uint8_t axis, int16_t *samples, uint16_t count)
+{
+    const int16_t *taps = stage->taps;
+    int16_t *history = stage->history[axis];
+    uint8_t length = stage->length;
+    uint8_t position = stage->position;
+    uint8_t phase = stage->phase;
+    uint16_t outputs = 0;
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        // Newest sample at history[position], the previous ones follow it (doubled ring buffer)
+        position = position == 0 ? length - 1 : position - 1;
+        history[position] = samples[i];
+        history[position + length] = samples[i];
+
+        if (++phase < stage->decimation)
+        {
+            continue;
+        }
+        phase = 0;
+
+        int32_t accumulator = iam20680hpDspDot(taps, &history[position], length);
+        samples[outputs++] = iam20680hpDspSaturate((accumulator + (1 << 14)) >> 15);
+    }
+
+    // Every axis runs the same sequence, the last one stores the shared counters
+    if (axis == 2)
+    {
+        stage->position = position;
+        stage->phase = phase;
+    }
+    return outputs;
+}
+
+/*
+ * Biquad cascade (direct form I) on one axis, decimation of the output. The feedback state y1, y2 keeps 
+ * IAM20680HP_DSP_BIQUAD_FRACTION bits below the output LSB, the remainder of the rounded down state (Q30) is added to the 
+ * next one (first order error feedback).
+ */
+static uint16_t iam20680hpDspBiquad(IAM20680HP_dspStage_t *stage, uint8_t axis, int16_t *samples, uint16_t count)
+{
+    const int32_t limit = (int32_t)INT16_MAX << IAM20680HP_DSP_BIQUAD_FRACTION;
+    uint8_t phase = stage->phase;
+    uint16_t outputs = 0;
+
+    for (uint8_t section = 0; section < stage->length; section++)
+    {
+        const int32_t *c = &stage->biquads[5 * section];
+        int32_t *s = stage->state[axis][section];
+        int32_t x1 = s[0], x2 = s[1], y1 = s[2], y2 = s[3], error = s[4];
+
+        for (uint16_t i = 0; i < count; i++)
+        {
+            int32_t x0 = samples[i];
+            int64_t accumulator = (((int64_t)c[0] * x0 + (int64_t)c[1] * x1 + (int64_t)c[2] * x2) << IAM20680HP_DSP_BIQUAD_FRACTION) - 
+                                  (int64_t)c[3] * y1 - (int64_t)c[4] * y2 + error;
+            int64_t y0 = accumulator >> 30;
+            error = (int32_t)(accumulator - (y0 << 30));
+
+            // No feedback of a saturated output
+            if (y0 > limit || y0 < -limit)
+            {
+                y0 = y0 > limit ? limit : -limit;
+                error = 0;
+            }
+            x2 = x1;
+            x1 = x0;
+            y2 = y1;
+            y1 = (int32_t)y0;
+            samples[i] = (int16_t)((y0 + (1 << (IAM20680HP_DSP_BIQUAD_FRACTION - 1))) >> IAM20680HP_DSP_BIQUAD_FRACTION);
+        }
+
+        s[0] = x1;
+        s[1] = x2;
+        s[2] = y1;
+        s[3] = y2;
+        s[4] = error;
+    }
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        if (++phase >= stage->decimation)
+        {
+            phase = 0;
+            samples[outputs++] = samples[i];
+        }
+    }
+
+    if (axis == 2)
+    {
+        stage->phase = phase;
+    }
+    return outputs;
+}
+
+uint16_t iam20680hpDspProcess(IAM20680HP_dsp_t *filter, int16_t *x, int16_t *y, int16_t *z, uint16_t count)
+{
+    int16_t *axes[3] = {x, y, z};
+
+    for (uint8_t i = 0; i < filter->numStages; i++)
+    {
+        IAM20680HP_dspStage_t *stage = &filter->stages[i];
+        uint16_t outputs = 0;
+
+        for (uint8_t axis = 0; axis < 3; axis++)
+        {
+            if (stage->type == IAM20680HP_DSP_FIR)
+            {
+                outputs = iam20680hpDspFir(stage, axis, axes[axis], count);
+            }
+            else
+            {
+                outputs = iam20680hpDspBiquad(stage, axis, axes[axis], count);
+            }
+        }
+        count = outputs;
+    }
+    return count;
+}
+
+void iam20680hpDspSplitFrames(const IAM20680HP_fifoData_t *frames, uint16_t count, bool gyro, int16_t *x, int16_t *y, int16_t *z)
+{
+    for (uint16_t i = 0; i < count; i++)
+    {
+        x[i] = gyro ? frames[i].gyroData.xGyro : frames[i].accelData.xAccel;
+        y[i] = gyro ? frames[i].gyroData.yGyro : frames[i].accelData.yAccel;
+        z[i] = gyro ? frames[i].gyroData.zGyro : frames[i].accelData.zAccel;
+    }
+}
+
+IAM20680HP_err_t iam20680hpDspDesignFir(int16_t *taps, uint8_t numTaps, float cutoff)
+{
+    float window[IAM20680HP_DSP_MAX_TAPS];
+    float sum = 0.0f;
+
+    if (numTaps == 0 || numTaps > IAM20680HP_DSP_MAX_TAPS || cutoff <= 0.0f || cutoff > 0.5f)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    for (uint8_t i = 0; i < numTaps; i++)
+    {
+        float t = i - (numTaps - 1) / 2.0f;
+        float sinc = t == 0.0f ? 2.0f * cutoff : sinf(2.0f * IAM20680HP_DSP_PI * cutoff * t) / (IAM20680HP_DSP_PI * t);
+        float hamming = numTaps > 1 ? 0.54f - 0.46f * cosf(2.0f * IAM20680HP_DSP_PI * i / (numTaps - 1)) : 1.0f;
+        window[i] = sinc * hamming;
+        sum += window[i];
+    }
+
+    // Unity DC gain, the rounding error goes to the centre tap
+    int32_t total = 0;
+    for (uint8_t i = 0; i < numTaps; i++)
+    {
+        taps[i] = iam20680hpDspSaturate(lroundf(window[i] / sum * 32768.0f));
+        total += taps[i];
+    }
+    taps[numTaps / 2] = iam20680hpDspSaturate(taps[numTaps / 2] + (32768 - total));
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpDspDesignBiquad(int32_t *coefficients, float cutoff, float q)
+{
+    if (cutoff <= 0.0f || cutoff >= 0.5f || q <= 0.0f)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    // Double: 1 - cos(omega) of a low cut-off is below the resolution of float
+    double omega = 2.0 * IAM20680HP_DSP_PI * cutoff;
+    double alpha = sin(omega) / (2.0 * q);
+    double a0 = 1.0 + alpha;
+    double value[5] = {
+        (1.0 - cos(omega)) / 2.0 / a0,
+        (1.0 - cos(omega)) / a0,
+        (1.0 - cos(omega)) / 2.0 / a0,
+        -2.0 * cos(omega) / a0,
+        (1.0 - alpha) / a0,
+    };
+
+    for (uint8_t i = 0; i < 5; i++)
+    {
+        long long rounded = llround(value[i] * 1073741824.0);
+        if (rounded > INT32_MAX || rounded < INT32_MIN)
+        {
+            return IAM20680HP_ERR_INVALID_PARAM;
+        }
+        coefficients[i] = (int32_t)rounded;
+    }
+
+    // The cut-off is too low for Q30 when the numerator rounds to 0
+    if (coefficients[0] == 0)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+    return IAM20680HP_OK;
+}
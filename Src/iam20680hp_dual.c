@@ -0,0 +1,326 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Dual sensor acquisition on one bus, see iam20680hp_dual.h.
+
+*/
+
+#include "iam20680hp_dual.h"
+
+IAM20680HP_err_t iam20680hpDualInit(IAM20680HP_dual_t *dual, uint8_t addressA, uint8_t addressB, uint32_t busHz,
+                                    IAM20680HP_dualOutput_t output, void *context)
+{
+    IAM20680HP_err_t result;
+    uint16_t odrHz[2];
+
+    if (addressA == addressB || output == NULL)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    memset(dual, 0, sizeof(*dual));
+    dual->address[0] = addressA;
+    dual->address[1] = addressB;
+    dual->accelLimit = IAM20680HP_DUAL_ACCEL_LIMIT;
+    dual->gyroLimit = IAM20680HP_DUAL_GYRO_LIMIT;
+    dual->output = output;
+    dual->context = context;
+
+    for (uint8_t sensor = 0; sensor < 2; sensor++)
+    {
+        result = iam20680hpSelectDevice(dual->address[sensor]);
+        if (result != IAM20680HP_OK)
+            return result;
+
+        result = iam20680hpCheckDeviceID();
+        if (result != IAM20680HP_OK)
+            return result;
+
+        result = iam20680hpReadOutputDataRate(&odrHz[sensor]);
+        if (result != IAM20680HP_OK)
+            return result;
+
+        result = iam20680hpDrainSchedulerInitFromDevice(&dual->scheduler[sensor], IAM20680HP_DUAL_TARGET_FILL);
+        if (result != IAM20680HP_OK)
+            return result;
+
+        // The frames at the target fill must fit the queue, otherwise every drain leaves frames in the FiFo
+        if (dual->scheduler[sensor].targetBytes > IAM20680HP_DUAL_QUEUE * IAM20680HP_FIFO_FRAME_SIZE)
+        {
+            return IAM20680HP_ERR_INVALID_PARAM;
+        }
+
+        bool enable = true;
+        result = iam20680hpFiFoEnable(&enable, &enable, &enable, &enable, &enable, true);
+        if (result != IAM20680HP_OK)
+            return result;
+    }
+
+    // Both streams on the bus: 9 bits per byte (ACK), frames of both sensors
+    if (odrHz[0] != odrHz[1] || (uint64_t)odrHz[0] * 2 * IAM20680HP_FIFO_FRAME_SIZE * 9 * 100 > (uint64_t)busHz * IAM20680HP_DUAL_BUS_LOAD)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+    dual->odrHz = odrHz[0];
+    dual->periodUs = 1000000 / odrHz[0];
+
+    // FiFos reset back to back, the first frames are about at the same time
+    for (uint8_t sensor = 0; sensor < 2; sensor++)
+    {
+        result = iam20680hpSelectDevice(dual->address[sensor]);
+        if (result != IAM20680HP_OK)
+            return result;
+
+        IAM20680HP_userControl_t userControl;
+        memset(&userControl, 0, sizeof(userControl));
+        result = iam20680hpUserControl(&userControl, false);
+        if (result != IAM20680HP_OK)
+            return result;
+        userControl.fifo_en = 1;
+        userControl.fifo_rst = 1;
+        userControl.sig_cond_rst = 0;
+        result = iam20680hpUserControl(&userControl, true);
+        if (result != IAM20680HP_OK)
+            return result;
+    }
+
+    return IAM20680HP_OK;
+}
+
+/*
+ * A frame with a saturated axis is not used when the other sensor is fine
+ */
+static bool iam20680hpDualSaturated(const IAM20680HP_fifoData_t *frame)
+{
+    const int16_t *value = &frame->accelData.xAccel;
+
+    for (uint8_t i = 0; i < 7; i++)
+    {
+        if (i != 3 && (value[i] == INT16_MAX || value[i] == INT16_MIN))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void iam20680hpDualCombine(IAM20680HP_dual_t *dual, const IAM20680HP_fifoData_t *a, const IAM20680HP_fifoData_t *b, uint32_t timestampUs)
+{
+    IAM20680HP_dualSample_t sample;
+    bool saturatedA = iam20680hpDualSaturated(a);
+    bool saturatedB = iam20680hpDualSaturated(b);
+
+    sample.timestampUs = timestampUs;
+    sample.flags = 0;
+    if (saturatedA != saturatedB)
+    {
+        sample.frame = saturatedA ? *b : *a;
+        sample.flags = saturatedA ? IAM20680HP_DUAL_ONLY_B : IAM20680HP_DUAL_ONLY_A;
+    }
+    else
+    {
+        const int16_t *valueA = &a->accelData.xAccel;
+        const int16_t *valueB = &b->accelData.xAccel;
+        int16_t *value = &sample.frame.accelData.xAccel;
+
+        // Accel, temperature, gyro
+        for (uint8_t i = 0; i < 7; i++)
+        {
+            int32_t difference = (int32_t)valueA[i] - valueB[i];
+            int16_t limit = i < 3 ? dual->accelLimit : dual->gyroLimit;
+            if (i != 3 && (difference > limit || difference < -limit))
+            {
+                sample.flags = IAM20680HP_DUAL_FAULT;
+            }
+            value[i] = (int16_t)(((int32_t)valueA[i] + valueB[i]) >> 1);
+        }
+    }
+
+    dual->samples++;
+    if (sample.flags & IAM20680HP_DUAL_FAULT)
+    {
+        dual->faults++;
+    }
+    dual->output(&sample, dual->context);
+}
+
+/*
+ * Drops the oldest waiting frames of a sensor so count more frames fit
+ */
+static void iam20680hpDualMakeRoom(IAM20680HP_dual_t *dual, uint8_t sensor, uint16_t count)
+{
+    if (dual->fill[sensor] + count > IAM20680HP_DUAL_QUEUE)
+    {
+        uint16_t drop = dual->fill[sensor] + count - IAM20680HP_DUAL_QUEUE;
+        dual->unpaired += drop;
+        dual->fill[sensor] -= drop;
+        memmove(dual->queue[sensor], &dual->queue[sensor][drop], dual->fill[sensor] * sizeof(IAM20680HP_fifoData_t));
+        memmove(dual->queueUs[sensor], &dual->queueUs[sensor][drop], dual->fill[sensor] * sizeof(uint32_t));
+        memmove(dual->queueIndex[sensor], &dual->queueIndex[sensor][drop], dual->fill[sensor] * sizeof(uint32_t));
+    }
+}
+
+/*
+ * Tracks the time between the frames of a pair (alpha-beta filter of the offset and its change per frame), the mean 
+ * timestamp difference of the pairs of one drain is the measurement. The timestamps are late by the age of the newest 
+ * frame of their drain, on average the same for both sensors. The pairs move by a frame when they are more than half a 
+ * period (and a margin) apart.
+ */
+static void iam20680hpDualTrack(IAM20680HP_dual_t *dual, int32_t skewUs, uint32_t index)
+{
+    int32_t frames = (int32_t)(index - dual->trackIndex);
+    int32_t predictedQ8 = dual->offsetQ8 + dual->driftQ8 * frames;
+    int32_t errorQ8 = skewUs * 256 - predictedQ8;
+
+    dual->trackIndex = index;
+    dual->offsetQ8 = predictedQ8 + errorQ8 / IAM20680HP_DUAL_TRACK_ALPHA;
+    if (frames > 0)
+    {
+        dual->driftQ8 += errorQ8 / IAM20680HP_DUAL_TRACK_BETA / frames;
+    }
+
+    int32_t limitQ8 = ((int32_t)dual->periodUs / 2 + (int32_t)dual->periodUs / IAM20680HP_DUAL_SHIFT_MARGIN) * 256;
+    if (dual->offsetQ8 > limitQ8)
+    {
+        // The frames of A are later than their partners of B (clock of A slower): pair with the next frame of B
+        dual->shift++;
+        dual->offsetQ8 -= (int32_t)dual->periodUs * 256;
+    }
+    else if (dual->offsetQ8 < -limitQ8)
+    {
+        dual->shift--;
+        dual->offsetQ8 += (int32_t)dual->periodUs * 256;
+    }
+}
+
+/*
+ * Timestamps and numbers count new frames at the end of the queue and pairs the oldest frames of both sensors by index, a 
+ * frame without a partner is dropped
+ */
+static void iam20680hpDualPair(IAM20680HP_dual_t *dual, uint8_t sensor, uint16_t count, uint32_t timestampUs)
+{
+    for (uint16_t i = 0; i < count; i++)
+    {
+        dual->queueUs[sensor][dual->fill[sensor] + i] = timestampUs - (uint32_t)(count - 1 - i) * dual->periodUs;
+        dual->queueIndex[sensor][dual->fill[sensor] + i] = dual->nextIndex[sensor] + i;
+    }
+    dual->fill[sensor] += count;
+    dual->nextIndex[sensor] += count;
+
+    uint16_t heads[2] = {0, 0};
+    int32_t skewUs = 0;
+    uint16_t pairs = 0;
+    while (heads[0] < dual->fill[0] && heads[1] < dual->fill[1])
+    {
+        int32_t difference = (int32_t)(dual->queueIndex[0][heads[0]] + (uint32_t)dual->shift - dual->queueIndex[1][heads[1]]);
+        if (difference > 0)
+        {
+            heads[1]++;
+            dual->unpaired++;
+        }
+        else if (difference < 0)
+        {
+            heads[0]++;
+            dual->unpaired++;
+        }
+        else
+        {
+            int32_t pairDifference = (int32_t)(dual->queueUs[0][heads[0]] - dual->queueUs[1][heads[1]]);
+            uint32_t pairUs = dual->queueUs[1][heads[1]] + (uint32_t)(pairDifference / 2);
+            iam20680hpDualCombine(dual, &dual->queue[0][heads[0]], &dual->queue[1][heads[1]], pairUs);
+            skewUs += pairDifference;
+            pairs++;
+            heads[0]++;
+            heads[1]++;
+        }
+    }
+    if (pairs > 0)
+    {
+        iam20680hpDualTrack(dual, skewUs / pairs, dual->queueIndex[0][heads[0] - 1]);
+    }
+
+    for (uint8_t s = 0; s < 2; s++)
+    {
+        dual->fill[s] -= heads[s];
+        memmove(dual->queue[s], &dual->queue[s][heads[s]], dual->fill[s] * sizeof(IAM20680HP_fifoData_t));
+        memmove(dual->queueUs[s], &dual->queueUs[s][heads[s]], dual->fill[s] * sizeof(uint32_t));
+        memmove(dual->queueIndex[s], &dual->queueIndex[s][heads[s]], dual->fill[s] * sizeof(uint32_t));
+    }
+}
+
+void iam20680hpDualProcess(IAM20680HP_dual_t *dual, uint8_t sensor, const IAM20680HP_fifoData_t *frames, uint16_t count, uint32_t timestampUs)
+{
+    if (count > IAM20680HP_DUAL_QUEUE)
+    {
+        dual->unpaired += count - IAM20680HP_DUAL_QUEUE;
+        dual->nextIndex[sensor] += count - IAM20680HP_DUAL_QUEUE;
+        frames += count - IAM20680HP_DUAL_QUEUE;
+        count = IAM20680HP_DUAL_QUEUE;
+    }
+
+    iam20680hpDualMakeRoom(dual, sensor, count);
+    memcpy(&dual->queue[sensor][dual->fill[sensor]], frames, count * sizeof(IAM20680HP_fifoData_t));
+    iam20680hpDualPair(dual, sensor, count, timestampUs);
+}
+
+IAM20680HP_err_t iam20680hpDualDrain(IAM20680HP_dual_t *dual, uint32_t timestampUs, uint32_t *nextDrainMs)
+{
+    IAM20680HP_err_t result;
+    IAM20680HP_fifoGap_t gap;
+    uint16_t framesRead;
+    uint8_t sensor = dual->next;
+
+    *nextDrainMs = IAM20680HP_DRAIN_MIN_INTERVAL;
+    result = iam20680hpSelectDevice(dual->address[sensor]);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    // Room for a full FiFo (up to the queue size)
+    uint16_t fifoFrames = dual->scheduler[sensor].fifoSize / IAM20680HP_FIFO_FRAME_SIZE;
+    if (fifoFrames > IAM20680HP_DUAL_QUEUE)
+    {
+        fifoFrames = IAM20680HP_DUAL_QUEUE;
+    }
+    iam20680hpDualMakeRoom(dual, sensor, fifoFrames);
+
+    uint32_t elapsedMs = dual->lastDrainUs[sensor] != 0 ? (timestampUs - dual->lastDrainUs[sensor]) / 1000 : 0;
+    result = iam20680hpReadFifoBlockWithGap(&dual->queue[sensor][dual->fill[sensor]], fifoFrames, &framesRead, dual->odrHz, elapsedMs, &gap);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    // Frames left in the FiFo (queue full) are newer than the last frame read
+    uint32_t leftFrames = gap.fifoBytes / IAM20680HP_FIFO_FRAME_SIZE > framesRead ? gap.fifoBytes / IAM20680HP_FIFO_FRAME_SIZE - framesRead : 0;
+
+    dual->lastDrainUs[sensor] = timestampUs;
+    dual->lostFrames += gap.lostFrames;
+    dual->nextIndex[sensor] += gap.lostFrames;
+    iam20680hpDualPair(dual, sensor, framesRead, timestampUs - leftFrames * dual->periodUs);
+    iam20680hpDrainSchedulerUpdateWithGap(&dual->scheduler[sensor], &gap, framesRead, elapsedMs);
+
+    // The other sensor halfway the shorter interval
+    uint32_t intervalMs = dual->scheduler[0].intervalMs < dual->scheduler[1].intervalMs ? dual->scheduler[0].intervalMs : dual->scheduler[1].intervalMs;
+    *nextDrainMs = intervalMs / 2 > IAM20680HP_DRAIN_MIN_INTERVAL ? intervalMs / 2 : IAM20680HP_DRAIN_MIN_INTERVAL;
+    dual->next = sensor ^ 1;
+    return IAM20680HP_OK;
+}
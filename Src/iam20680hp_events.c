@@ -0,0 +1,344 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Software event detectors, see iam20680hp_events.h.
+
+*/
+
+#include "iam20680hp_events.h"
+#include "math.h"
+
+void iam20680hpEventsDefaultConfig(IAM20680HP_eventConfig_t *config)
+{
+    config->enable = IAM20680HP_EVENTS_ALL;
+    config->freeFallMg = IAM20680HP_EVENTS_FREE_FALL_MG;
+    config->freeFallMs = IAM20680HP_EVENTS_FREE_FALL_MS;
+    config->shockMg = IAM20680HP_EVENTS_SHOCK_MG;
+    config->shockHoldoffMs = IAM20680HP_EVENTS_SHOCK_HOLDOFF_MS;
+    config->stillGyroLsb = IAM20680HP_EVENTS_STILL_GYRO_LSB;
+    config->stillWindowMs = IAM20680HP_EVENTS_STILL_WINDOW_MS;
+    config->tapMg = IAM20680HP_EVENTS_TAP_MG;
+    config->tapDurationMs = IAM20680HP_EVENTS_TAP_DURATION_MS;
+    config->tapQuietMs = IAM20680HP_EVENTS_TAP_QUIET_MS;
+    config->tapWindowMs = IAM20680HP_EVENTS_TAP_WINDOW_MS;
+}
+
+/*
+ * Milliseconds to frames, at least 1
+ */
+static uint32_t iam20680hpEventsFrames(uint16_t ms, uint16_t odrHz)
+{
+    uint32_t frames = (uint32_t)ms * odrHz / 1000;
+    return frames > 0 ? frames : 1;
+}
+
+/*
+ * mg to LSB, squared and limited to the largest possible |a|^2
+ */
+static uint32_t iam20680hpEventsSquare(uint16_t mg, uint8_t accelFsSel)
+{
+    uint64_t lsb = ((uint64_t)mg * (16384 >> accelFsSel) + 500) / 1000;
+    uint64_t square = lsb * lsb;
+    return square > UINT32_MAX ? UINT32_MAX : (uint32_t)square;
+}
+
+IAM20680HP_err_t iam20680hpEventsInit(IAM20680HP_eventDetector_t *detector, const IAM20680HP_eventConfig_t *config, uint8_t accelFsSel, 
+                                      uint16_t odrHz, IAM20680HP_eventOutput_t output, void *context)
+{
+    if (accelFsSel > 3 || odrHz == 0 || output == NULL)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    memset(detector, 0, sizeof(*detector));
+    detector->config = *config;
+    detector->output = output;
+    detector->context = context;
+    detector->periodUs = 1000000UL / odrHz;
+    detector->mgPerLsb = 1000.0f / (16384 >> accelFsSel);
+
+    detector->freeFallLimit = iam20680hpEventsSquare(config->freeFallMg, accelFsSel);
+    detector->shockLimit = iam20680hpEventsSquare(config->shockMg, accelFsSel);
+    detector->tapLimit = (int32_t)(((uint32_t)config->tapMg * (16384 >> accelFsSel) + 500) / 1000);
+    detector->stillLimit = (int64_t)config->stillGyroLsb * config->stillGyroLsb;
+
+    detector->freeFallFrames = iam20680hpEventsFrames(config->freeFallMs, odrHz);
+    detector->shockHoldoffFrames = iam20680hpEventsFrames(config->shockHoldoffMs, odrHz);
+    detector->stillFrames = iam20680hpEventsFrames(config->stillWindowMs, odrHz);
+    detector->tapDurationFrames = iam20680hpEventsFrames(config->tapDurationMs, odrHz);
+    detector->tapQuietFrames = iam20680hpEventsFrames(config->tapQuietMs, odrHz);
+    detector->tapWindowFrames = iam20680hpEventsFrames(config->tapWindowMs, odrHz);
+
+    if ((config->enable & (1 << IAM20680HP_EVENT_STILL_START)) && detector->stillFrames > IAM20680HP_EVENTS_STILL_MAX_FRAMES)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+    return IAM20680HP_OK;
+}
+
+static void iam20680hpEventsEmit(IAM20680HP_eventDetector_t *detector, IAM20680HP_eventType_t type, int8_t axis, int32_t value, uint32_t timestampUs)
+{
+    IAM20680HP_event_t event;
+    event.type = type;
+    event.axis = axis;
+    event.value = value;
+    event.timestampUs = timestampUs;
+    detector->output(&event, detector->context);
+}
+
+static void iam20680hpEventsFreeFall(IAM20680HP_eventDetector_t *detector, uint32_t magnitude, uint32_t timestampUs)
+{
+    if (magnitude >= detector->freeFallLimit)
+    {
+        detector->freeFallCount = 0;
+        detector->freeFallReported = false;
+        return;
+    }
+
+    if (detector->freeFallCount++ == 0)
+    {
+        detector->freeFallStartUs = timestampUs;
+        detector->freeFallMinimum = magnitude;
+    }
+    if (magnitude < detector->freeFallMinimum)
+    {
+        detector->freeFallMinimum = magnitude;
+    }
+
+    // Reported as soon as the minimum duration is reached
+    if (!detector->freeFallReported && detector->freeFallCount >= detector->freeFallFrames)
+    {
+        detector->freeFallReported = true;
+        iam20680hpEventsEmit(detector, IAM20680HP_EVENT_FREE_FALL, -1, (int32_t)(sqrtf((float)detector->freeFallMinimum) * detector->mgPerLsb), 
+                             detector->freeFallStartUs);
+    }
+}
+
+static void iam20680hpEventsShock(IAM20680HP_eventDetector_t *detector, uint32_t magnitude, uint32_t timestampUs)
+{
+    if (magnitude > detector->shockLimit)
+    {
+        if (!detector->shockActive && (int32_t)(detector->frame - detector->shockEnd) >= 0)
+        {
+            detector->shockActive = true;
+            detector->shockStartUs = timestampUs;
+            detector->shockPeak = magnitude;
+        }
+        else if (detector->shockActive && magnitude > detector->shockPeak)
+        {
+            detector->shockPeak = magnitude;
+        }
+    }
+    else if (detector->shockActive)
+    {
+        // Reported when |a| is below the threshold again, with the peak
+        detector->shockActive = false;
+        detector->shockEnd = detector->frame + detector->shockHoldoffFrames;
+        iam20680hpEventsEmit(detector, IAM20680HP_EVENT_SHOCK, -1, (int32_t)(sqrtf((float)detector->shockPeak) * detector->mgPerLsb), 
+                             detector->shockStartUs);
+    }
+}
+
+static void iam20680hpEventsStill(IAM20680HP_eventDetector_t *detector, const IAM20680HP_gyroData_t *gyro, uint32_t timestampUs)
+{
+    const int16_t value[3] = {gyro->xGyro, gyro->yGyro, gyro->zGyro};
+
+    if (detector->stillCount == 0)
+    {
+        detector->stillStartUs = timestampUs;
+    }
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+        detector->stillSum[axis] += value[axis];
+        detector->stillSquares[axis] += (int32_t)value[axis] * value[axis];
+    }
+    if (++detector->stillCount < detector->stillFrames)
+    {
+        return;
+    }
+
+    // Largest variance of the axes: (n * sum(x^2) - sum(x)^2) / n^2, exact in int64 up to IAM20680HP_EVENTS_STILL_MAX_FRAMES
+    int64_t n = detector->stillCount;
+    int64_t variance = 0;
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+        int64_t axisVariance = (n * detector->stillSquares[axis] - detector->stillSum[axis] * detector->stillSum[axis]) / (n * n);
+        if (axisVariance > variance)
+        {
+            variance = axisVariance;
+        }
+        detector->stillSum[axis] = 0;
+        detector->stillSquares[axis] = 0;
+    }
+    detector->stillCount = 0;
+
+    bool still = variance <= detector->stillLimit;
+    if (still != detector->still)
+    {
+        detector->still = still;
+        iam20680hpEventsEmit(detector, still ? IAM20680HP_EVENT_STILL_START : IAM20680HP_EVENT_STILL_END, -1, 
+                             variance > INT32_MAX ? INT32_MAX : (int32_t)variance, detector->stillStartUs);
+    }
+}
+
+/*
+ * A tap is a sample to sample change above the threshold after which the signal returns to the level before the change 
+ * within the tap duration (a step, e.g. the start of a free-fall, is no tap). A shock is no tap.
+ */
+static void iam20680hpEventsTap(IAM20680HP_eventDetector_t *detector, const IAM20680HP_accelData_t *accel, bool shock, uint32_t timestampUs)
+{
+    const int16_t value[3] = {accel->xAccel, accel->yAccel, accel->zAccel};
+    int32_t peak = 0;
+    int32_t deviation = 0;
+    int8_t peakAxis = 0;
+
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+        int32_t change = value[axis] - detector->previous[axis];
+        change = change >= 0 ? change : -change;
+        if (change > peak)
+        {
+            peak = change;
+            peakAxis = (int8_t)axis;
+        }
+
+        int32_t distance = value[axis] - detector->tapBaseline[axis];
+        distance = distance >= 0 ? distance : -distance;
+        if (distance > deviation)
+        {
+            deviation = distance;
+        }
+    }
+    if (!detector->havePrevious)
+    {
+        detector->havePrevious = true;
+        memcpy(detector->previous, value, sizeof(value));
+        return;
+    }
+
+    if (detector->tapPending && detector->frame - detector->pendingFrame > detector->tapWindowFrames)
+    {
+        detector->tapPending = false;
+        if (detector->config.enable & (1 << IAM20680HP_EVENT_TAP))
+        {
+            detector->output(&detector->pendingTap, detector->context);
+        }
+    }
+
+    switch (detector->tapState)
+    {
+    case 0:
+        if (peak > detector->tapLimit && !shock)
+        {
+            memcpy(detector->tapBaseline, detector->previous, sizeof(detector->tapBaseline));
+            detector->tapState = 1;
+            detector->tapStart = detector->frame;
+            detector->tapStartUs = timestampUs;
+            detector->tapPeak = peak;
+            detector->tapAxis = peakAxis;
+        }
+        break;
+
+    case 1:
+        if (peak > detector->tapPeak)
+        {
+            detector->tapPeak = peak;
+            detector->tapAxis = peakAxis;
+        }
+        if (detector->frame - detector->tapStart > detector->tapDurationFrames || shock)
+        {
+            // Too long for a tap (motion) or a shock, wait for a quiet time
+            detector->tapState = 2;
+            detector->tapQuietEnd = detector->frame + detector->tapQuietFrames;
+            break;
+        }
+        if (deviation >= detector->tapLimit / 2)
+        {
+            break;
+        }
+
+        int32_t mg = (int32_t)(detector->tapPeak * detector->mgPerLsb);
+        if (detector->tapPending)
+        {
+            detector->tapPending = false;
+            if (detector->config.enable & (1 << IAM20680HP_EVENT_DOUBLE_TAP))
+            {
+                iam20680hpEventsEmit(detector, IAM20680HP_EVENT_DOUBLE_TAP, detector->tapAxis, mg, detector->pendingTap.timestampUs);
+            }
+        }
+        else
+        {
+            detector->tapPending = true;
+            detector->pendingFrame = detector->tapStart;
+            detector->pendingTap.type = IAM20680HP_EVENT_TAP;
+            detector->pendingTap.axis = detector->tapAxis;
+            detector->pendingTap.value = mg;
+            detector->pendingTap.timestampUs = detector->tapStartUs;
+        }
+        detector->tapState = 2;
+        detector->tapQuietEnd = detector->frame + detector->tapQuietFrames;
+        break;
+
+    default:
+        if ((int32_t)(detector->frame - detector->tapQuietEnd) >= 0)
+        {
+            detector->tapState = 0;
+        }
+        break;
+    }
+
+    memcpy(detector->previous, value, sizeof(value));
+}
+
+void iam20680hpEventsProcess(IAM20680HP_eventDetector_t *detector, const IAM20680HP_fifoData_t *frames, uint16_t count, uint32_t timestampUs)
+{
+    uint8_t enable = detector->config.enable;
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        const IAM20680HP_fifoData_t *frame = &frames[i];
+        uint32_t frameUs = timestampUs - (uint32_t)(count - 1 - i) * detector->periodUs;
+
+        int32_t ax = frame->accelData.xAccel, ay = frame->accelData.yAccel, az = frame->accelData.zAccel;
+        uint32_t magnitude = (uint32_t)(ax * ax) + (uint32_t)(ay * ay) + (uint32_t)(az * az);
+
+        if (enable & (1 << IAM20680HP_EVENT_FREE_FALL))
+        {
+            iam20680hpEventsFreeFall(detector, magnitude, frameUs);
+        }
+        if (enable & (1 << IAM20680HP_EVENT_SHOCK))
+        {
+            iam20680hpEventsShock(detector, magnitude, frameUs);
+        }
+        if (enable & (1 << IAM20680HP_EVENT_STILL_START))
+        {
+            iam20680hpEventsStill(detector, &frame->gyroData, frameUs);
+        }
+        if (enable & ((1 << IAM20680HP_EVENT_TAP) | (1 << IAM20680HP_EVENT_DOUBLE_TAP)))
+        {
+            iam20680hpEventsTap(detector, &frame->accelData, magnitude > detector->shockLimit, frameUs);
+        }
+        detector->frame++;
+    }
+}
@@ -0,0 +1,152 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+FSYNC tagging of FiFo frames, see iam20680hp_fsync.h.
+
+*/
+
+#include "iam20680hp_fsync.h"
+
+IAM20680HP_err_t iam20680hpFsyncStart(IAM20680HP_fsync_t *sync, uint8_t channel, IAM20680HP_fsyncOutput_t output, void *context)
+{
+    IAM20680HP_err_t result;
+
+    if (channel < 2 || channel > 7 || output == NULL)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    memset(sync, 0, sizeof(*sync));
+    sync->channel = channel;
+    sync->output = output;
+    sync->context = context;
+
+    uint16_t odrHz;
+    result = iam20680hpReadOutputDataRate(&odrHz);
+    if (result != IAM20680HP_OK)
+        return result;
+    sync->periodUs = 1000000 / odrHz;
+
+    return iam20680hpConfigExtSync(&channel, true);
+}
+
+void iam20680hpFsyncEvent(IAM20680HP_fsync_t *sync, uint32_t timestampUs)
+{
+    uint8_t head = sync->eventHead;
+
+    // Full: the oldest event is overwritten by iam20680hpFsyncProcess() as missed
+    sync->eventUs[head % IAM20680HP_FSYNC_EVENTS] = timestampUs;
+    sync->eventHead = head + 1;
+}
+
+/*
+ * Oldest event that can belong to a tag at frameUs, older events are missed
+ */
+static bool iam20680hpFsyncMatch(IAM20680HP_fsync_t *sync, uint32_t frameUs, uint32_t *eventUs)
+{
+    uint8_t head = sync->eventHead;
+
+    if ((uint8_t)(head - sync->eventTail) > IAM20680HP_FSYNC_EVENTS)
+    {
+        sync->missedEvents += (uint8_t)(head - sync->eventTail) - IAM20680HP_FSYNC_EVENTS;
+        sync->eventTail = head - IAM20680HP_FSYNC_EVENTS;
+    }
+
+    while (sync->eventTail != head)
+    {
+        uint32_t event = sync->eventUs[sync->eventTail % IAM20680HP_FSYNC_EVENTS];
+
+        // The edge is within one period before the tagged sample
+        int32_t age = (int32_t)(frameUs - event);
+        if (age > (int32_t)(sync->periodUs + IAM20680HP_FSYNC_TOLERANCE_US))
+        {
+            sync->missedEvents++;
+            sync->eventTail++;
+            continue;
+        }
+        if (age < -IAM20680HP_FSYNC_TOLERANCE_US)
+        {
+            return false;
+        }
+
+        sync->eventTail++;
+        *eventUs = event;
+        return true;
+    }
+    return false;
+}
+
+void iam20680hpFsyncProcess(IAM20680HP_fsync_t *sync, IAM20680HP_fifoData_t *frames, uint16_t count, uint32_t timestampUs)
+{
+    // EXT_SYNC_SET 2 - 4: gyro X - Z, 5 - 7: accel X - Z
+    uint8_t channel = sync->channel;
+    if (channel < 2)
+    {
+        return;
+    }
+
+    for (uint16_t i = 0; i < count; i++, sync->frames++)
+    {
+        int16_t *value = channel <= 4 ? &(&frames[i].gyroData.xGyro)[channel - 2] : &(&frames[i].accelData.xAccel)[channel - 5];
+        if ((*value & 0x01) == 0)
+        {
+            continue;
+        }
+        *value &= ~0x01;
+
+        IAM20680HP_fsyncTag_t tag;
+        tag.frame = sync->frames;
+        tag.index = i;
+        tag.frameUs = timestampUs - (uint32_t)(count - 1 - i) * sync->periodUs;
+        tag.eventUs = 0;
+        tag.matched = iam20680hpFsyncMatch(sync, tag.frameUs, &tag.eventUs);
+
+        sync->tags++;
+        if (!tag.matched)
+        {
+            sync->unmatchedTags++;
+        }
+        else if (!sync->started)
+        {
+            sync->started = true;
+            sync->firstFrame = tag.frame;
+            sync->firstEventUs = tag.eventUs;
+        }
+        else
+        {
+            // Frames between the first and the last event, the period follows from the clock of the events
+            sync->lastFrame = tag.frame;
+            sync->lastEventUs = tag.eventUs;
+            sync->measuredPeriodUs = (float)(sync->lastEventUs - sync->firstEventUs) / (sync->lastFrame - sync->firstFrame);
+        }
+        sync->output(&tag, sync->context);
+    }
+}
+
+IAM20680HP_err_t iam20680hpFsyncStop(IAM20680HP_fsync_t *sync)
+{
+    uint8_t channel = 0;
+    sync->channel = 0;
+    return iam20680hpConfigExtSync(&channel, true);
+}
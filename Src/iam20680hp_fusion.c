@@ -0,0 +1,332 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Attitude estimation from FiFo frames, see iam20680hp_fusion.h.
+
+*/
+
+#include "iam20680hp_fusion.h"
+#include "math.h"
+
+#define IAM20680HP_FUSION_GYRO_LSB_DPS 131.0f     //Gyro sensitivity at FS_SEL 0
+#define IAM20680HP_FUSION_DEG_TO_RAD 0.017453293f
+
+#if IAM20680HP_FUSION_PROFILE
+#include "main.h"
+
+#ifndef IAM20680HP_FUSION_CYCLES
+#define IAM20680HP_FUSION_CYCLES() (DWT->CYCCNT)  //Free running core cycle counter
+#endif
+#else
+#define IAM20680HP_FUSION_CYCLES() 0
+#endif
+
+/*
+ * Sample period of the frames in a block: from the previous block timestamp, the nominal period after a gap
+ */
+static uint32_t iam20680hpFusionPeriod(uint32_t *lastTimestampUs, bool *timestampValid, uint32_t samplePeriodUs, uint16_t count, uint32_t timestampUs)
+{
+    uint32_t elapsed = timestampUs - *lastTimestampUs;
+    uint32_t period = samplePeriodUs;
+
+    if (*timestampValid && elapsed > 0 && elapsed <= IAM20680HP_FUSION_MAX_GAP_US)
+    {
+        period = elapsed / count;
+    }
+    *lastTimestampUs = timestampUs;
+    *timestampValid = true;
+    return period;
+}
+
+#if IAM20680HP_FUSION_PROFILE
+void iam20680hpFusionProfileStart(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+#endif
+
+IAM20680HP_err_t iam20680hpFusionInit(IAM20680HP_fusion_t *fusion, IAM20680HP_fusionAlgorithm_t algorithm, uint8_t gyroFsSel, uint16_t odrHz)
+{
+    if (gyroFsSel > 3 || odrHz == 0 || algorithm > IAM20680HP_FUSION_MADGWICK)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    memset(fusion, 0, sizeof(*fusion));
+    fusion->q[0] = 1.0f;
+    fusion->kp = IAM20680HP_FUSION_MAHONY_KP;
+    fusion->ki = IAM20680HP_FUSION_MAHONY_KI;
+    fusion->beta = IAM20680HP_FUSION_MADGWICK_BETA;
+    fusion->gyroScale = IAM20680HP_FUSION_DEG_TO_RAD * (1 << gyroFsSel) / IAM20680HP_FUSION_GYRO_LSB_DPS;
+    fusion->samplePeriodUs = 1000000UL / odrHz;
+    fusion->algorithm = algorithm;
+    return IAM20680HP_OK;
+}
+
+/*
+ * Mahony: the cross product of measured and estimated gravity corrects the gyro rate (PI)
+ */
+static void iam20680hpFusionMahony(IAM20680HP_fusion_t *fusion, float gx, float gy, float gz, float ax, float ay, float az, float dt)
+{
+    float *q = fusion->q;
+    float norm = ax * ax + ay * ay + az * az;
+
+    if (norm > 0.0f)
+    {
+        norm = 1.0f / sqrtf(norm);
+        ax *= norm;
+        ay *= norm;
+        az *= norm;
+
+        float vx = 2.0f * (q[1] * q[3] - q[0] * q[2]);
+        float vy = 2.0f * (q[0] * q[1] + q[2] * q[3]);
+        float vz = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+
+        float ex = ay * vz - az * vy;
+        float ey = az * vx - ax * vz;
+        float ez = ax * vy - ay * vx;
+
+        fusion->integral[0] += fusion->ki * ex * dt;
+        fusion->integral[1] += fusion->ki * ey * dt;
+        fusion->integral[2] += fusion->ki * ez * dt;
+
+        gx += fusion->kp * ex + fusion->integral[0];
+        gy += fusion->kp * ey + fusion->integral[1];
+        gz += fusion->kp * ez + fusion->integral[2];
+    }
+
+    float h = 0.5f * dt;
+    float q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    q[0] += (-q1 * gx - q2 * gy - q3 * gz) * h;
+    q[1] += (q0 * gx + q2 * gz - q3 * gy) * h;
+    q[2] += (q0 * gy - q1 * gz + q3 * gx) * h;
+    q[3] += (q0 * gz + q1 * gy - q2 * gx) * h;
+}
+
+/*
+ * Madgwick: one gradient descent step towards measured gravity, subtracted from the gyro quaternion rate
+ */
+static void iam20680hpFusionMadgwick(IAM20680HP_fusion_t *fusion, float gx, float gy, float gz, float ax, float ay, float az, float dt)
+{
+    float *q = fusion->q;
+    float q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+
+    float qDot0 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
+    float qDot1 = 0.5f * (q0 * gx + q2 * gz - q3 * gy);
+    float qDot2 = 0.5f * (q0 * gy - q1 * gz + q3 * gx);
+    float qDot3 = 0.5f * (q0 * gz + q1 * gy - q2 * gx);
+
+    float norm = ax * ax + ay * ay + az * az;
+    if (norm > 0.0f)
+    {
+        norm = 1.0f / sqrtf(norm);
+        ax *= norm;
+        ay *= norm;
+        az *= norm;
+
+        // Objective function and its Jacobian (gravity only)
+        float f0 = 2.0f * (q1 * q3 - q0 * q2) - ax;
+        float f1 = 2.0f * (q0 * q1 + q2 * q3) - ay;
+        float f2 = 1.0f - 2.0f * (q1 * q1 + q2 * q2) - az;
+
+        float s0 = -2.0f * q2 * f0 + 2.0f * q1 * f1;
+        float s1 = 2.0f * q3 * f0 + 2.0f * q0 * f1 - 4.0f * q1 * f2;
+        float s2 = -2.0f * q0 * f0 + 2.0f * q3 * f1 - 4.0f * q2 * f2;
+        float s3 = 2.0f * q1 * f0 + 2.0f * q2 * f1;
+
+        norm = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+        if (norm > 0.0f)
+        {
+            norm = fusion->beta / sqrtf(norm);
+            qDot0 -= s0 * norm;
+            qDot1 -= s1 * norm;
+            qDot2 -= s2 * norm;
+            qDot3 -= s3 * norm;
+        }
+    }
+
+    q[0] += qDot0 * dt;
+    q[1] += qDot1 * dt;
+    q[2] += qDot2 * dt;
+    q[3] += qDot3 * dt;
+}
+
+void iam20680hpFusionUpdate(IAM20680HP_fusion_t *fusion, const IAM20680HP_fifoData_t *frames, uint16_t count, uint32_t timestampUs)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    uint32_t start = IAM20680HP_FUSION_CYCLES();
+    float dt = iam20680hpFusionPeriod(&fusion->lastTimestampUs, &fusion->timestampValid, fusion->samplePeriodUs, count, timestampUs) * 1e-6f;
+    float scale = fusion->gyroScale;
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        const IAM20680HP_fifoData_t *frame = &frames[i];
+        float gx = frame->gyroData.xGyro * scale;
+        float gy = frame->gyroData.yGyro * scale;
+        float gz = frame->gyroData.zGyro * scale;
+
+        if (fusion->algorithm == IAM20680HP_FUSION_MADGWICK)
+        {
+            iam20680hpFusionMadgwick(fusion, gx, gy, gz, frame->accelData.xAccel, frame->accelData.yAccel, frame->accelData.zAccel, dt);
+        }
+        else
+        {
+            iam20680hpFusionMahony(fusion, gx, gy, gz, frame->accelData.xAccel, frame->accelData.yAccel, frame->accelData.zAccel, dt);
+        }
+
+        float norm = 1.0f / sqrtf(fusion->q[0] * fusion->q[0] + fusion->q[1] * fusion->q[1] + fusion->q[2] * fusion->q[2] + fusion->q[3] * fusion->q[3]);
+        fusion->q[0] *= norm;
+        fusion->q[1] *= norm;
+        fusion->q[2] *= norm;
+        fusion->q[3] *= norm;
+    }
+    fusion->updates += count;
+    fusion->cycles += IAM20680HP_FUSION_CYCLES() - start;
+}
+
+IAM20680HP_err_t iam20680hpFusionFixedInit(IAM20680HP_fusionFixed_t *fusion, uint8_t gyroFsSel, uint16_t odrHz)
+{
+    if (gyroFsSel > 3 || odrHz == 0)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    memset(fusion, 0, sizeof(*fusion));
+    fusion->q[0] = IAM20680HP_FUSION_Q30;
+    fusion->kp = (int32_t)(IAM20680HP_FUSION_MAHONY_KP * 65536.0f);
+    fusion->ki = (int32_t)(IAM20680HP_FUSION_MAHONY_KI * 65536.0f);
+    fusion->gyroScale = (int32_t)(IAM20680HP_FUSION_DEG_TO_RAD * (1 << gyroFsSel) / IAM20680HP_FUSION_GYRO_LSB_DPS * 4294967296.0f + 0.5f);
+    fusion->samplePeriodUs = 1000000UL / odrHz;
+    return IAM20680HP_OK;
+}
+
+/*
+ * Integer square root (bitwise)
+ */
+static uint32_t iam20680hpFusionSqrt(uint32_t value)
+{
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+
+    while (bit > value)
+    {
+        bit >>= 2;
+    }
+    while (bit != 0)
+    {
+        if (value >= root + bit)
+        {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+void iam20680hpFusionFixedUpdate(IAM20680HP_fusionFixed_t *fusion, const IAM20680HP_fifoData_t *frames, uint16_t count, uint32_t timestampUs)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    uint32_t start = IAM20680HP_FUSION_CYCLES();
+
+    // Sample period in seconds * 2^24, once per block
+    uint32_t periodUs = iam20680hpFusionPeriod(&fusion->lastTimestampUs, &fusion->timestampValid, fusion->samplePeriodUs, count, timestampUs);
+    int64_t dt = ((int64_t)periodUs << 24) / 1000000;
+    int32_t *q = fusion->q;
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        const IAM20680HP_fifoData_t *frame = &frames[i];
+
+        // Gyro rad/s * 2^16
+        int32_t gx = (int32_t)(((int64_t)frame->gyroData.xGyro * fusion->gyroScale) >> 16);
+        int32_t gy = (int32_t)(((int64_t)frame->gyroData.yGyro * fusion->gyroScale) >> 16);
+        int32_t gz = (int32_t)(((int64_t)frame->gyroData.zGyro * fusion->gyroScale) >> 16);
+
+        int32_t ax = frame->accelData.xAccel, ay = frame->accelData.yAccel, az = frame->accelData.zAccel;
+        uint32_t norm = iam20680hpFusionSqrt((uint32_t)(ax * ax) + (uint32_t)(ay * ay) + (uint32_t)(az * az));
+        if (norm > 0)
+        {
+            // Measured and estimated gravity * 2^14 (multiplied, a left shift of a negative value is undefined)
+            ax = ax * 16384 / (int32_t)norm;
+            ay = ay * 16384 / (int32_t)norm;
+            az = az * 16384 / (int32_t)norm;
+
+            int32_t vx = (int32_t)((2 * ((int64_t)q[1] * q[3] - (int64_t)q[0] * q[2])) >> 46);
+            int32_t vy = (int32_t)((2 * ((int64_t)q[0] * q[1] + (int64_t)q[2] * q[3])) >> 46);
+            int32_t vz = (int32_t)(((int64_t)q[0] * q[0] - (int64_t)q[1] * q[1] - (int64_t)q[2] * q[2] + (int64_t)q[3] * q[3]) >> 46);
+
+            // Error * 2^14
+            int32_t ex = (ay * vz - az * vy) >> 14;
+            int32_t ey = (az * vx - ax * vz) >> 14;
+            int32_t ez = (ax * vy - ay * vx) >> 14;
+
+            if (fusion->ki != 0)
+            {
+                fusion->integral[0] += (int32_t)((((int64_t)fusion->ki * ex) >> 14) * dt >> 24);
+                fusion->integral[1] += (int32_t)((((int64_t)fusion->ki * ey) >> 14) * dt >> 24);
+                fusion->integral[2] += (int32_t)((((int64_t)fusion->ki * ez) >> 14) * dt >> 24);
+            }
+
+            gx += (int32_t)(((int64_t)fusion->kp * ex) >> 14) + fusion->integral[0];
+            gy += (int32_t)(((int64_t)fusion->kp * ey) >> 14) + fusion->integral[1];
+            gz += (int32_t)(((int64_t)fusion->kp * ez) >> 14) + fusion->integral[2];
+        }
+
+        // Half rotation angle * 2^30: (rad/s * 2^16) * (s * 2^24) / 2 >> 10
+        int32_t hx = (int32_t)((gx * dt) >> 11);
+        int32_t hy = (int32_t)((gy * dt) >> 11);
+        int32_t hz = (int32_t)((gz * dt) >> 11);
+
+        int64_t w = q[0], x = q[1], y = q[2], z = q[3];
+        int64_t q0 = w + ((-x * hx - y * hy - z * hz) >> 30);
+        int64_t q1 = x + ((w * hx + y * hz - z * hy) >> 30);
+        int64_t q2 = y + ((w * hy - x * hz + z * hx) >> 30);
+        int64_t q3 = z + ((w * hz + x * hy - y * hx) >> 30);
+
+        // Renormalise with one Newton step of 1/sqrt around 1: q * (3 - |q|^2) / 2
+        int64_t square = (q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3) >> 30;
+        int64_t factor = (3 * (int64_t)IAM20680HP_FUSION_Q30 - square) >> 1;
+        q[0] = (int32_t)((q0 * factor) >> 30);
+        q[1] = (int32_t)((q1 * factor) >> 30);
+        q[2] = (int32_t)((q2 * factor) >> 30);
+        q[3] = (int32_t)((q3 * factor) >> 30);
+    }
+    fusion->updates += count;
+    fusion->cycles += IAM20680HP_FUSION_CYCLES() - start;
+}
@@ -0,0 +1,328 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Compact streaming log of decoded FIFO frames, see iam20680hp_log.h for the format.
+
+*/
+
+#include "iam20680hp_log.h"
+
+static const uint8_t logMagic[4] = {'I', 'A', 'M', 'L'};
+
+
+static void iam20680hpLogPut16(uint8_t *buffer, uint16_t value)
+{
+    buffer[0] = (uint8_t)(value);
+    buffer[1] = (uint8_t)(value >> 8);
+}
+
+static uint16_t iam20680hpLogGet16(const uint8_t *buffer)
+{
+    return (uint16_t)(buffer[0] | buffer[1] << 8);
+}
+
+static void iam20680hpLogChannels(const IAM20680HP_fifoData_t *fifoData, int16_t *channels)
+{
+    channels[0] = fifoData->accelData.xAccel;
+    channels[1] = fifoData->accelData.yAccel;
+    channels[2] = fifoData->accelData.zAccel;
+    channels[3] = fifoData->temperature;
+    channels[4] = fifoData->gyroData.xGyro;
+    channels[5] = fifoData->gyroData.yGyro;
+    channels[6] = fifoData->gyroData.zGyro;
+}
+
+IAM20680HP_err_t iam20680hpLogReadHeaderFromDevice(IAM20680HP_logHeader_t *header)
+{
+    IAM20680HP_err_t result;
+
+    memset(header, 0, sizeof(*header));
+
+    result = iam20680hpReadOutputDataRate(&header->odrHz);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    IAM20680HP_gyroConfig_t gyroConfig;
+    memset(&gyroConfig, 0, sizeof(gyroConfig));
+    result = iam20680hpGyroConfig(&gyroConfig, false);
+    if (result != IAM20680HP_OK)
+        return result;
+    header->gyroFsSel = gyroConfig.FS_Sel;
+
+    IAM20680HP_accelConfig_t accelConfig;
+    memset(&accelConfig, 0, sizeof(accelConfig));
+    result = iam20680hpAccelConfig(&accelConfig, false);
+    if (result != IAM20680HP_OK)
+        return result;
+    header->accelFsSel = accelConfig.AFS_Sel;
+
+    bool tempFiFo, gyroX, gyroY, gyroZ, accel;
+    result = iam20680hpFiFoEnable(&tempFiFo, &gyroX, &gyroY, &gyroZ, &accel, false);
+    if (result != IAM20680HP_OK)
+        return result;
+    header->fifoEnable = (uint8_t)(tempFiFo << 7 | gyroX << 6 | gyroY << 5 | gyroZ << 4 | accel << 3);
+
+    result = iam20680hpGyroOffsetAdjustment(&header->gyroOffset, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    return iam20680hpAccelerometerOffset(&header->accelOffset, false);
+}
+
+void iam20680hpLogEncodeHeader(const IAM20680HP_logHeader_t *header, uint8_t *buffer)
+{
+    memcpy(buffer, logMagic, sizeof(logMagic));
+    buffer[4] = IAM20680HP_LOG_VERSION;
+    iam20680hpLogPut16(&buffer[5], header->odrHz);
+    buffer[7] = header->gyroFsSel;
+    buffer[8] = header->accelFsSel;
+    buffer[9] = header->fifoEnable;
+    iam20680hpLogPut16(&buffer[10], (uint16_t)header->gyroOffset.offsetXGyro);
+    iam20680hpLogPut16(&buffer[12], (uint16_t)header->gyroOffset.offsetYGyro);
+    iam20680hpLogPut16(&buffer[14], (uint16_t)header->gyroOffset.offsetZGyro);
+    iam20680hpLogPut16(&buffer[16], (uint16_t)header->accelOffset.offsetXAccel);
+    iam20680hpLogPut16(&buffer[18], (uint16_t)header->accelOffset.offsetYAccel);
+    iam20680hpLogPut16(&buffer[20], (uint16_t)header->accelOffset.offsetZAccel);
+    iam20680hpLogPut16(&buffer[22], iam20680hpCrc16(buffer, 22));
+}
+
+IAM20680HP_err_t iam20680hpLogDecodeHeader(const uint8_t *buffer, size_t size, IAM20680HP_logHeader_t *header)
+{
+    if (size < IAM20680HP_LOG_HEADER_SIZE)
+    {
+        return IAM20680HP_ERR_EOL;
+    }
+    if (memcmp(buffer, logMagic, sizeof(logMagic)) != 0 || buffer[4] != IAM20680HP_LOG_VERSION)
+    {
+        return IAM20680HP_ERR_NOT_SUPPORTED;
+    }
+    if (iam20680hpLogGet16(&buffer[22]) != iam20680hpCrc16(buffer, 22))
+    {
+        return IAM20680HP_ERR_CRC;
+    }
+
+    header->odrHz = iam20680hpLogGet16(&buffer[5]);
+    header->gyroFsSel = buffer[7];
+    header->accelFsSel = buffer[8];
+    header->fifoEnable = buffer[9];
+    header->gyroOffset.offsetXGyro = (int16_t)iam20680hpLogGet16(&buffer[10]);
+    header->gyroOffset.offsetYGyro = (int16_t)iam20680hpLogGet16(&buffer[12]);
+    header->gyroOffset.offsetZGyro = (int16_t)iam20680hpLogGet16(&buffer[14]);
+    header->accelOffset.offsetXAccel = (int16_t)iam20680hpLogGet16(&buffer[16]);
+    header->accelOffset.offsetYAccel = (int16_t)iam20680hpLogGet16(&buffer[18]);
+    header->accelOffset.offsetZAccel = (int16_t)iam20680hpLogGet16(&buffer[20]);
+
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpLogEncodeBlock(const IAM20680HP_fifoData_t *fifoData, uint16_t frames, uint32_t timestamp, 
+                                          uint8_t *buffer, size_t bufferSize, size_t *written)
+{
+    int16_t previous[IAM20680HP_LOG_CHANNELS] = {0};
+    int16_t channels[IAM20680HP_LOG_CHANNELS];
+    size_t position = 10;
+
+    *written = 0;
+    if (bufferSize < IAM20680HP_LOG_BLOCK_OVERHEAD || frames > IAM20680HP_LOG_MAX_FRAMES)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    for (uint16_t frame = 0; frame < frames; frame++)
+    {
+        iam20680hpLogChannels(&fifoData[frame], channels);
+
+        // Worst case 3 bytes per channel and the CRC
+        if (bufferSize - position < IAM20680HP_LOG_CHANNELS * 3 + 2)
+        {
+            return IAM20680HP_ERR_INVALID_PARAM;
+        }
+
+        for (uint8_t channel = 0; channel < IAM20680HP_LOG_CHANNELS; channel++)
+        {
+            int32_t delta = (int32_t)channels[channel] - previous[channel];
+            uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+            while (zigzag >= 0x80)
+            {
+                buffer[position++] = (uint8_t)(zigzag | 0x80);
+                zigzag >>= 7;
+            }
+            buffer[position++] = (uint8_t)zigzag;
+            previous[channel] = channels[channel];
+        }
+    }
+
+    buffer[0] = 0xA5;
+    buffer[1] = 0x5A;
+    iam20680hpLogPut16(&buffer[2], frames);
+    iam20680hpLogPut16(&buffer[4], (uint16_t)timestamp);
+    iam20680hpLogPut16(&buffer[6], (uint16_t)(timestamp >> 16));
+    iam20680hpLogPut16(&buffer[8], (uint16_t)(position - 10));
+    iam20680hpLogPut16(&buffer[position], iam20680hpCrc16(&buffer[2], position - 2));
+
+    *written = position + 2;
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpLogDecodeBlock(const uint8_t *buffer, size_t size, IAM20680HP_fifoData_t *fifoData, uint16_t maxFrames,
+                                          uint16_t *frames, uint32_t *timestamp, size_t *consumed)
+{
+    *frames = 0;
+    *consumed = 0;
+
+    if (size < 2)
+    {
+        return IAM20680HP_ERR_EOL;
+    }
+    if (buffer[0] != 0xA5 || buffer[1] != 0x5A)
+    {
+        return IAM20680HP_ERR_NOT_SUPPORTED;
+    }
+    if (size < IAM20680HP_LOG_BLOCK_OVERHEAD)
+    {
+        return IAM20680HP_ERR_EOL;
+    }
+
+    uint16_t count = iam20680hpLogGet16(&buffer[2]);
+    size_t length = iam20680hpLogGet16(&buffer[8]);
+    if (size < length + IAM20680HP_LOG_BLOCK_OVERHEAD)
+    {
+        return IAM20680HP_ERR_EOL;
+    }
+    if (iam20680hpLogGet16(&buffer[10 + length]) != iam20680hpCrc16(&buffer[2], length + 8))
+    {
+        return IAM20680HP_ERR_CRC;
+    }
+    if (count > maxFrames)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    const uint8_t *payload = &buffer[10];
+    size_t position = 0;
+    int16_t channels[IAM20680HP_LOG_CHANNELS] = {0};
+
+    for (uint16_t frame = 0; frame < count; frame++)
+    {
+        for (uint8_t channel = 0; channel < IAM20680HP_LOG_CHANNELS; channel++)
+        {
+            uint32_t zigzag = 0;
+            uint8_t shift = 0;
+            uint8_t byte;
+            do
+            {
+                if (position >= length || shift > 14)
+                {
+                    return IAM20680HP_ERR_CRC;
+                }
+                byte = payload[position++];
+                zigzag |= (uint32_t)(byte & 0x7F) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+
+            int32_t delta = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+            channels[channel] = (int16_t)(channels[channel] + delta);
+        }
+
+        fifoData[frame].accelData.xAccel = channels[0];
+        fifoData[frame].accelData.yAccel = channels[1];
+        fifoData[frame].accelData.zAccel = channels[2];
+        fifoData[frame].temperature = channels[3];
+        fifoData[frame].gyroData.xGyro = channels[4];
+        fifoData[frame].gyroData.yGyro = channels[5];
+        fifoData[frame].gyroData.zGyro = channels[6];
+    }
+
+    *frames = count;
+    *timestamp = (uint32_t)iam20680hpLogGet16(&buffer[4]) | (uint32_t)iam20680hpLogGet16(&buffer[6]) << 16;
+    *consumed = length + IAM20680HP_LOG_BLOCK_OVERHEAD;
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpLogWriterInit(IAM20680HP_logWriter_t *writer, const IAM20680HP_logHeader_t *header, IAM20680HP_logOutput_t output, 
+                                         void *context, uint8_t *buffer, size_t bufferSize)
+{
+    memset(writer, 0, sizeof(*writer));
+    writer->output = output;
+    writer->context = context;
+    writer->buffer = buffer;
+    writer->bufferSize = bufferSize;
+
+    if (bufferSize < IAM20680HP_LOG_HEADER_SIZE)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    iam20680hpLogEncodeHeader(header, buffer);
+    if (!output(context, buffer, IAM20680HP_LOG_HEADER_SIZE))
+    {
+        return IAM20680HP_ERR_BUSY;
+    }
+    writer->bytes = IAM20680HP_LOG_HEADER_SIZE;
+
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpLogWriteBlock(IAM20680HP_logWriter_t *writer, const IAM20680HP_fifoData_t *fifoData, uint16_t frames, uint32_t timestamp)
+{
+    IAM20680HP_err_t result;
+    size_t written;
+
+    if (frames == 0)
+    {
+        return IAM20680HP_OK;
+    }
+
+    result = iam20680hpLogEncodeBlock(fifoData, frames, timestamp, writer->buffer, writer->bufferSize, &written);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    if (!writer->output(writer->context, writer->buffer, written))
+    {
+        return IAM20680HP_ERR_BUSY;
+    }
+
+    writer->blocks++;
+    writer->frames += frames;
+    writer->bytes += written;
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpLogDrainFifo(IAM20680HP_logWriter_t *writer, IAM20680HP_fifoData_t *fifoData, uint16_t maxFrames, 
+                                        uint32_t timestamp, uint16_t *frames)
+{
+    IAM20680HP_err_t result;
+
+    // One block per drain, the rest stays in the FiFo
+    if (maxFrames > IAM20680HP_LOG_MAX_FRAMES)
+    {
+        maxFrames = IAM20680HP_LOG_MAX_FRAMES;
+    }
+
+    result = iam20680hpReadFifoBlock(fifoData, maxFrames, frames);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    return iam20680hpLogWriteBlock(writer, fifoData, *frames, timestamp);
+}
@@ -0,0 +1,188 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Low power accelerometer streaming through the FiFo, see iam20680hp_lpaccel.h.
+
+*/
+
+#include "iam20680hp_lpaccel.h"
+
+/*
+ * Writes the low power settings: rate first, then DEC2 averaging (ACCEL_FCHOICE_B 0) and the accel-only FiFo, ACCEL_CYCLE last
+ */
+static IAM20680HP_err_t iam20680hpLpAccelConfigure(IAM20680HP_lpAccel_t *lpAccel, uint8_t rate, uint8_t dec2Cfg)
+{
+    IAM20680HP_err_t result;
+
+    bool gyroCycle = false;
+    uint8_t avgCfg = ACCEL_AVG_CFG;
+    result = iam20680hpLowPowerMode(&gyroCycle, &avgCfg, &rate, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    IAM20680HP_accelConfig_t accelConfig = lpAccel->savedAccelConfig;
+    accelConfig.xAccelSelfTest = 0;
+    accelConfig.yAccelSelfTest = 0;
+    accelConfig.zAccelSelfTest = 0;
+    accelConfig.FChoice = 0;
+    accelConfig.dec2Cfg = dec2Cfg;
+    result = iam20680hpAccelConfig(&accelConfig, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    bool enable = true, disable = false;
+    result = iam20680hpFiFoEnable(&disable, &disable, &disable, &disable, &enable, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    IAM20680HP_userControl_t userControl = lpAccel->savedUserControl;
+    userControl.fifo_en = 1;
+    userControl.fifo_rst = 1;
+    userControl.sig_cond_rst = 0;
+    result = iam20680hpUserControl(&userControl, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    IAM20680HP_powerManagement_t powerManagement = lpAccel->savedPowerManagement;
+    powerManagement.reset = 0;
+    powerManagement.sleep = 0;
+    powerManagement.accelCycle = 1;
+    powerManagement.gyroStandby = 0;
+    powerManagement.fifo_lp_en = 1;
+    powerManagement.stby_xa = 0;
+    powerManagement.stby_ya = 0;
+    powerManagement.stby_za = 0;
+    powerManagement.stby_xg = 1;
+    powerManagement.stby_yg = 1;
+    powerManagement.stby_zg = 1;
+    return iam20680hpPowerManagement(&powerManagement, true);
+}
+
+IAM20680HP_err_t iam20680hpLpAccelStart(IAM20680HP_lpAccel_t *lpAccel, uint8_t rate, uint8_t dec2Cfg, uint8_t targetFill)
+{
+    IAM20680HP_err_t result;
+
+    if (rate < 4 || rate > 11 || dec2Cfg > 3)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    memset(lpAccel, 0, sizeof(*lpAccel));
+    result = iam20680hpPowerManagement(&lpAccel->savedPowerManagement, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    result = iam20680hpAccelConfig(&lpAccel->savedAccelConfig, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    result = iam20680hpLowPowerMode(&lpAccel->savedGyroCycle, &lpAccel->savedAvgCfg, &lpAccel->savedRate, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    bool *fifoEnable = lpAccel->savedFifoEnable;
+    result = iam20680hpFiFoEnable(&fifoEnable[0], &fifoEnable[1], &fifoEnable[2], &fifoEnable[3], &fifoEnable[4], false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    result = iam20680hpUserControl(&lpAccel->savedUserControl, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    // 3.9Hz at rate 4, doubling per step. The scheduler learns the exact rate
+    uint16_t odrHz = (uint16_t)((15625u << (rate - 4)) / 4000);
+    result = iam20680hpDrainSchedulerInit(&lpAccel->scheduler, odrHz > 0 ? odrHz : 1, IAM20680HP_FIFO_ACCEL_FRAME_SIZE, 
+                                          (uint16_t)(512 << lpAccel->savedAccelConfig.fifoSize), targetFill);
+    if (result != IAM20680HP_OK)
+        return result;
+    lpAccel->scheduler.maxIntervalMs = IAM20680HP_LPACCEL_MAX_INTERVAL;
+
+    // A failed write leaves the device with the settings of before
+    result = iam20680hpLpAccelConfigure(lpAccel, rate, dec2Cfg);
+    if (result != IAM20680HP_OK)
+    {
+        iam20680hpLpAccelStop(lpAccel);
+    }
+    return result;
+}
+
+IAM20680HP_err_t iam20680hpLpAccelDrain(IAM20680HP_lpAccel_t *lpAccel, IAM20680HP_accelData_t *samples, uint16_t maxSamples, uint32_t elapsedMs,
+                                        uint16_t *samplesRead, uint32_t *nextDrainMs)
+{
+    IAM20680HP_err_t result;
+    IAM20680HP_lpAccelReport_t *report = &lpAccel->report;
+
+    *nextDrainMs = lpAccel->scheduler.minIntervalMs;
+
+    uint16_t fifoCount;
+    result = iam20680hpReadFifoAccelBlockWithCount(samples, maxSamples, samplesRead, &fifoCount);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    // FIFO_COUNT (1 + 2 bytes) and FIFO_R_W (1 + 6 per sample)
+    report->wakeups++;
+    report->busBytes += 3 + (*samplesRead > 0 ? 1 + (uint32_t)*samplesRead * IAM20680HP_FIFO_ACCEL_FRAME_SIZE : 0);
+
+    if (fifoCount >= lpAccel->scheduler.fifoSize || fifoCount % IAM20680HP_FIFO_ACCEL_FRAME_SIZE != 0)
+    {
+        // Full or not whole samples: samples are lost and the frames may be misaligned, the scheduler tightens
+        report->overflows++;
+        *samplesRead = 0;
+        *nextDrainMs = iam20680hpDrainSchedulerUpdate(&lpAccel->scheduler, lpAccel->scheduler.fifoSize, lpAccel->scheduler.fifoSize, elapsedMs);
+        return iam20680hpFifoReset();
+    }
+
+    report->samples += *samplesRead;
+    report->samplesPerWakeup = (float)report->samples / report->wakeups;
+
+    *nextDrainMs = iam20680hpDrainSchedulerUpdate(&lpAccel->scheduler, fifoCount, (uint32_t)*samplesRead * IAM20680HP_FIFO_ACCEL_FRAME_SIZE, elapsedMs);
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpLpAccelStop(IAM20680HP_lpAccel_t *lpAccel)
+{
+    IAM20680HP_err_t result;
+
+    result = iam20680hpPowerManagement(&lpAccel->savedPowerManagement, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    result = iam20680hpLowPowerMode(&lpAccel->savedGyroCycle, &lpAccel->savedAvgCfg, &lpAccel->savedRate, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    result = iam20680hpAccelConfig(&lpAccel->savedAccelConfig, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    bool *fifoEnable = lpAccel->savedFifoEnable;
+    result = iam20680hpFiFoEnable(&fifoEnable[0], &fifoEnable[1], &fifoEnable[2], &fifoEnable[3], &fifoEnable[4], true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    IAM20680HP_userControl_t userControl = lpAccel->savedUserControl;
+    userControl.fifo_rst = 1;
+    userControl.sig_cond_rst = 0;
+    return iam20680hpUserControl(&userControl, true);
+}
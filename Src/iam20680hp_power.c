@@ -0,0 +1,393 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Power manager, see iam20680hp_power.h.
+
+*/
+
+#include "iam20680hp_power.h"
+
+void iam20680hpPowerDefaultConfig(IAM20680HP_powerConfig_t *config)
+{
+    config->quietMg = IAM20680HP_POWER_QUIET_MG;
+    config->standbyMg = IAM20680HP_POWER_STANDBY_MG;
+    config->fullMg = IAM20680HP_POWER_FULL_MG;
+    config->hysteresisMg = IAM20680HP_POWER_HYSTERESIS_MG;
+    config->dwellMs = IAM20680HP_POWER_DWELL_MS;
+    config->currentUa[IAM20680HP_POWER_WOM] = IAM20680HP_POWER_WOM_UA;
+    config->currentUa[IAM20680HP_POWER_LP_ACCEL] = IAM20680HP_POWER_LP_ACCEL_UA;
+    config->currentUa[IAM20680HP_POWER_GYRO_STANDBY] = IAM20680HP_POWER_GYRO_STANDBY_UA;
+    config->currentUa[IAM20680HP_POWER_FULL] = IAM20680HP_POWER_FULL_UA;
+    config->budgetUa = 0;
+    config->dec2Cfg = ACCEL_DEC2_CFG;
+    config->lowPowerRate = ACCEL_FREQ_WAKEUP;
+}
+
+/*
+ * Writes PWR_MGMT_1 / PWR_MGMT_2 for a state with data (not WoM)
+ */
+static IAM20680HP_err_t iam20680hpPowerWriteState(const IAM20680HP_power_t *power, IAM20680HP_powerState_t state)
+{
+    IAM20680HP_err_t result;
+
+    if (state == IAM20680HP_POWER_LP_ACCEL)
+    {
+        // Low power accel: rate and DEC2 averaging first, then ACCEL_CYCLE
+        bool gyroCycle = false;
+        uint8_t avgCfg = ACCEL_AVG_CFG;
+        uint8_t rate = power->config.lowPowerRate;
+        result = iam20680hpLowPowerMode(&gyroCycle, &avgCfg, &rate, true);
+        if (result != IAM20680HP_OK)
+            return result;
+
+        IAM20680HP_accelConfig_t accelConfig;
+        memset(&accelConfig, 0, sizeof(accelConfig));
+        result = iam20680hpAccelConfig(&accelConfig, false);
+        if (result != IAM20680HP_OK)
+            return result;
+
+        accelConfig.dec2Cfg = power->config.dec2Cfg;
+        result = iam20680hpAccelConfig(&accelConfig, true);
+        if (result != IAM20680HP_OK)
+            return result;
+    }
+
+    IAM20680HP_powerManagement_t powerManagement;
+    memset(&powerManagement, 0, sizeof(powerManagement));
+    result = iam20680hpPowerManagement(&powerManagement, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    bool gyroOff = state == IAM20680HP_POWER_LP_ACCEL;
+    powerManagement.sleep = 0;
+    powerManagement.accelCycle = state == IAM20680HP_POWER_LP_ACCEL;
+    powerManagement.gyroStandby = state == IAM20680HP_POWER_GYRO_STANDBY;
+    powerManagement.stby_xa = 0;
+    powerManagement.stby_ya = 0;
+    powerManagement.stby_za = 0;
+    powerManagement.stby_xg = gyroOff;
+    powerManagement.stby_yg = gyroOff;
+    powerManagement.stby_zg = gyroOff;
+    return iam20680hpPowerManagement(&powerManagement, true);
+}
+
+static IAM20680HP_err_t iam20680hpPowerEnter(IAM20680HP_power_t *power, IAM20680HP_powerState_t state)
+{
+    IAM20680HP_err_t result;
+
+    if (state == IAM20680HP_POWER_WOM)
+    {
+        result = iam20680hpEnableWomModeFunction();
+    }
+    else
+    {
+        if (power->state == IAM20680HP_POWER_WOM)
+        {
+            result = iam20680hpDisableWomModeFunction();
+            if (result != IAM20680HP_OK)
+                return result;
+        }
+        result = iam20680hpPowerWriteState(power, state);
+    }
+    if (result != IAM20680HP_OK)
+        return result;
+
+    if (state != power->state)
+    {
+        power->report.transitions++;
+    }
+    power->state = state;
+    power->belowMs = 0;
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpPowerInit(IAM20680HP_power_t *power, const IAM20680HP_powerConfig_t *config, IAM20680HP_powerState_t state)
+{
+    if (state > IAM20680HP_POWER_FULL || config->lowPowerRate < 4 || config->lowPowerRate > 11 || config->dec2Cfg > 3 ||
+        config->quietMg > config->standbyMg || config->standbyMg > config->fullMg)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    memset(power, 0, sizeof(*power));
+    power->config = *config;
+    power->state = IAM20680HP_POWER_FULL;
+    power->report.recentUa = config->currentUa[state];
+
+    IAM20680HP_err_t result = iam20680hpPowerEnter(power, state);
+    power->report.transitions = 0;
+    return result;
+}
+
+/*
+ * State that the activity asks for
+ */
+static IAM20680HP_powerState_t iam20680hpPowerLevel(const IAM20680HP_powerConfig_t *config, uint32_t activityMg)
+{
+    if (activityMg >= config->fullMg)
+    {
+        return IAM20680HP_POWER_FULL;
+    }
+    if (activityMg >= config->standbyMg)
+    {
+        return IAM20680HP_POWER_GYRO_STANDBY;
+    }
+    if (activityMg >= config->quietMg)
+    {
+        return IAM20680HP_POWER_LP_ACCEL;
+    }
+    return IAM20680HP_POWER_WOM;
+}
+
+IAM20680HP_err_t iam20680hpPowerUpdate(IAM20680HP_power_t *power, uint16_t activityMg, uint32_t elapsedMs)
+{
+    IAM20680HP_err_t result;
+    const IAM20680HP_powerConfig_t *config = &power->config;
+
+    // Statistics of the time in the current state
+    uint16_t current = config->currentUa[power->state];
+    power->report.timeMs[power->state] += elapsedMs;
+    power->chargeUaMs += (uint64_t)current * elapsedMs;
+    float weight = elapsedMs < IAM20680HP_POWER_AVERAGE_MS ? (float)elapsedMs / IAM20680HP_POWER_AVERAGE_MS : 1.0f;
+    power->report.recentUa += (current - power->report.recentUa) * weight;
+
+    if (power->state == IAM20680HP_POWER_WOM)
+    {
+        IAM20680HP_intStatus_t intStatus;
+        result = iam20680hpIntStatus(&intStatus);
+        if (result != IAM20680HP_OK)
+            return result;
+
+        return intStatus.wom_int ? iam20680hpPowerEnter(power, IAM20680HP_POWER_LP_ACCEL) : IAM20680HP_OK;
+    }
+
+    IAM20680HP_powerState_t target = iam20680hpPowerLevel(config, activityMg);
+    IAM20680HP_powerState_t highest = IAM20680HP_POWER_FULL;
+    if (config->budgetUa != 0 && power->report.recentUa > config->budgetUa)
+    {
+        highest = IAM20680HP_POWER_LP_ACCEL;
+    }
+    if (target > highest)
+    {
+        target = highest;
+    }
+
+    if (target > power->state)
+    {
+        return iam20680hpPowerEnter(power, target);
+    }
+
+    // Down one state after dwellMs below the threshold minus the hysteresis (or above the budget)
+    if (iam20680hpPowerLevel(config, (uint32_t)activityMg + config->hysteresisMg) < power->state || power->state > highest)
+    {
+        power->belowMs += elapsedMs;
+        if (power->belowMs >= config->dwellMs)
+        {
+            return iam20680hpPowerEnter(power, power->state - 1);
+        }
+    }
+    else
+    {
+        power->belowMs = 0;
+    }
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpPowerSetState(IAM20680HP_power_t *power, IAM20680HP_powerState_t state)
+{
+    if (state > IAM20680HP_POWER_FULL)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+    return iam20680hpPowerEnter(power, state);
+}
+
+void iam20680hpPowerGetReport(const IAM20680HP_power_t *power, IAM20680HP_powerReport_t *report)
+{
+    uint64_t totalMs = 0;
+
+    *report = power->report;
+    for (uint8_t state = 0; state < 4; state++)
+    {
+        totalMs += report->timeMs[state];
+    }
+    report->averageUa = totalMs > 0 ? (float)power->chargeUaMs / totalMs : power->report.recentUa;
+}
+
+/*
+ * Largest peak to peak of the axes, samples at samples[i * stride + axis]
+ */
+static uint16_t iam20680hpPowerPeakToPeak(const int16_t *samples, uint16_t count, uint8_t stride, uint8_t accelFsSel)
+{
+    int32_t largest = 0;
+
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+        const int16_t *value = &samples[axis];
+        int16_t minimum = INT16_MAX, maximum = INT16_MIN;
+        for (uint16_t i = 0; i < count; i++, value += stride)
+        {
+            minimum = *value < minimum ? *value : minimum;
+            maximum = *value > maximum ? *value : maximum;
+        }
+        if (count > 0 && maximum - minimum > largest)
+        {
+            largest = maximum - minimum;
+        }
+    }
+
+    uint32_t mg = (uint32_t)largest * 1000 / (16384 >> accelFsSel);
+    return mg > UINT16_MAX ? UINT16_MAX : (uint16_t)mg;
+}
+
+uint16_t iam20680hpPowerActivity(const IAM20680HP_fifoData_t *frames, uint16_t count, uint8_t accelFsSel)
+{
+    return iam20680hpPowerPeakToPeak(&frames[0].accelData.xAccel, count, sizeof(IAM20680HP_fifoData_t) / sizeof(int16_t), accelFsSel);
+}
+
+uint16_t iam20680hpPowerActivityAccel(const IAM20680HP_accelData_t *accelData, uint16_t count, uint8_t accelFsSel)
+{
+    return iam20680hpPowerPeakToPeak(&accelData[0].xAccel, count, sizeof(IAM20680HP_accelData_t) / sizeof(int16_t), accelFsSel);
+}
+
+// Gyro DLPF group delay (us) per DLPF_CFG with FCHOICE_B 0, datasheet table 17
+static const uint16_t gyroGroupDelayUs[8] = {970, 2900, 3900, 5900, 9900, 17850, 33480, 170};
+
+static IAM20680HP_err_t iam20680hpGyroWakeWrite(uint8_t pwrMgmt1)
+{
+    uint8_t buffer[2] = {IAM20680HP_PWR_MGMT_1, pwrMgmt1};
+
+    if (iam20680hpBusTransmit(buffer, 2) != IAM20680HP_OK)
+    {
+        return IAM20680HP_ERR_I2C;
+    }
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpGyroWakeInit(IAM20680HP_gyroWake_t *wake, bool gyroX, bool gyroY, bool gyroZ)
+{
+    IAM20680HP_err_t result;
+
+    memset(wake, 0, sizeof(*wake));
+    result = iam20680hpReadOutputDataRate(&wake->odrHz);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    uint8_t dlpf = 0;
+    result = iam20680hpConfigDlpfCfg(&dlpf, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    IAM20680HP_gyroConfig_t gyroConfig;
+    memset(&gyroConfig, 0, sizeof(gyroConfig));
+    result = iam20680hpGyroConfig(&gyroConfig, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    // FCHOICE_B x1: 64us, 10: 110us (DLPF bypassed)
+    if (gyroConfig.FChoice != 0)
+    {
+        wake->groupDelayUs = (gyroConfig.FChoice & 0x01) ? 64 : 110;
+    }
+    else
+    {
+        wake->groupDelayUs = gyroGroupDelayUs[dlpf];
+    }
+
+    // Samples within the group delay plus the one that straddles the wake
+    uint64_t settleUs = (uint64_t)wake->groupDelayUs + IAM20680HP_GYRO_WAKE_SETTLE_US;
+    wake->discardSamples = (uint16_t)((settleUs * wake->odrHz + 999999) / 1000000 + 1);
+
+    IAM20680HP_powerManagement_t powerManagement;
+    memset(&powerManagement, 0, sizeof(powerManagement));
+    result = iam20680hpPowerManagement(&powerManagement, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    powerManagement.gyroStandby = 0;
+    powerManagement.stby_xg = !gyroX;
+    powerManagement.stby_yg = !gyroY;
+    powerManagement.stby_zg = !gyroZ;
+    result = iam20680hpPowerManagement(&powerManagement, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    wake->pwrMgmt1 = (uint8_t)(powerManagement.sleep << 6 | powerManagement.accelCycle << 5 | powerManagement.tempDis << 3 |
+                               powerManagement.clockSel);
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpGyroWakeStandby(IAM20680HP_gyroWake_t *wake)
+{
+    IAM20680HP_err_t result = iam20680hpGyroWakeWrite(wake->pwrMgmt1 | 0x10);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    wake->standby = true;
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpGyroWake(IAM20680HP_gyroWake_t *wake, uint32_t timestampUs)
+{
+    IAM20680HP_err_t result = iam20680hpGyroWakeWrite(wake->pwrMgmt1);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    wake->standby = false;
+    wake->pending = wake->discardSamples;
+    wake->waiting = true;
+    wake->wakeUs = timestampUs;
+    wake->firstValidUs = 0;
+    return IAM20680HP_OK;
+}
+
+uint16_t iam20680hpGyroWakeDiscard(IAM20680HP_gyroWake_t *wake, uint16_t count, uint32_t timestampUs)
+{
+    if (!wake->waiting)
+    {
+        return 0;
+    }
+
+    uint16_t discard = count < wake->pending ? count : wake->pending;
+    wake->pending -= discard;
+    if (discard < count)
+    {
+        // Time of the first valid sample, counted back from the last sample
+        uint32_t firstUs = timestampUs - (uint32_t)(count - 1 - discard) * (1000000 / wake->odrHz);
+        wake->firstValidUs = firstUs - wake->wakeUs;
+        wake->waiting = false;
+    }
+    return discard;
+}
+
+uint16_t iam20680hpGyroWakeFilter(IAM20680HP_gyroWake_t *wake, IAM20680HP_fifoData_t *frames, uint16_t count, uint32_t timestampUs)
+{
+    uint16_t discard = iam20680hpGyroWakeDiscard(wake, count, timestampUs);
+
+    if (discard > 0 && discard < count)
+    {
+        memmove(frames, &frames[discard], (size_t)(count - discard) * sizeof(IAM20680HP_fifoData_t));
+    }
+    return count - discard;
+}
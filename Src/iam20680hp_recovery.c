@@ -0,0 +1,299 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Bus error recovery and configuration restore from the register shadow, see iam20680hp_recovery.h.
+
+*/
+
+#include "iam20680hp_recovery.h"
+
+#if IAM20680HP_USE_HAL
+#include "main.h"
+
+extern I2C_HandleTypeDef I2C_HANDLER;
+#endif
+
+static IAM20680HP_recoveryStats_t recoveryStats;
+
+// A transfer failed after all retries, the HAL backend runs iam20680hpRecoveryCheck() before the next transfer
+static bool recoveryDue;
+
+// Registers compared by the health check: SMPLRT_DIV - ACCEL_CONFIG2, PWR_MGMT_1 - PWR_MGMT_2
+static const uint8_t checkFirst[2] = {0x19, IAM20680HP_PWR_MGMT_1};
+static const uint8_t checkSize[2] = {5, 2};
+
+// Ranges of the scrubber: SMPLRT_DIV - ACCEL_WOM_THR, INT_PIN_CFG - INT_ENABLE, USER_CTRL - PWR_MGMT_2. Not one burst 
+// over 0x19 - 0x38: reading 0x36 clears FSYNC_INT
+static const uint8_t scrubFirst[3] = {0x19, 0x37, IAM20680HP_USER_CTRL};
+static const uint8_t scrubSize[3] = {7, 2, 3};
+
+bool iam20680hpRecoveryRetry(uint8_t attempt)
+{
+    if (attempt >= IAM20680HP_I2C_RETRIES)
+    {
+        recoveryStats.failures++;
+        recoveryDue = true;
+        return false;
+    }
+
+    // The first retry right away (a glitch), then the bus is un-jammed
+    recoveryStats.retries++;
+    if (attempt > 0)
+    {
+        iam20680hpRecoveryUnjam();
+    }
+    return true;
+}
+
+bool iam20680hpRecoveryDue(void)
+{
+    bool due = recoveryDue;
+    recoveryDue = false;
+    return due;
+}
+
+#if IAM20680HP_USE_HAL && defined(IAM20680HP_SCL_PIN)
+static void iam20680hpRecoveryHalfClock(void)
+{
+    for (volatile uint32_t i = 0; i < IAM20680HP_RECOVERY_HALF_CLOCK; i++)
+    {
+    }
+}
+#endif
+
+void iam20680hpRecoveryUnjam(void)
+{
+    recoveryStats.unjams++;
+
+#if IAM20680HP_USE_HAL
+    HAL_I2C_DeInit(&I2C_HANDLER);
+
+#ifdef IAM20680HP_SCL_PIN
+    GPIO_InitTypeDef gpio = {0};
+    gpio.Pin = IAM20680HP_SCL_PIN;
+    gpio.Mode = GPIO_MODE_OUTPUT_OD;
+    gpio.Pull = GPIO_NOPULL;
+    gpio.Speed = GPIO_SPEED_FREQ_HIGH;
+    HAL_GPIO_WritePin(IAM20680HP_SCL_PORT, IAM20680HP_SCL_PIN, GPIO_PIN_SET);
+    HAL_GPIO_Init(IAM20680HP_SCL_PORT, &gpio);
+    gpio.Pin = IAM20680HP_SDA_PIN;
+    HAL_GPIO_WritePin(IAM20680HP_SDA_PORT, IAM20680HP_SDA_PIN, GPIO_PIN_SET);
+    HAL_GPIO_Init(IAM20680HP_SDA_PORT, &gpio);
+
+    // A device in the middle of a read holds SDA low until it has clocked out its byte
+    for (uint8_t i = 0; i < 9 && HAL_GPIO_ReadPin(IAM20680HP_SDA_PORT, IAM20680HP_SDA_PIN) == GPIO_PIN_RESET; i++)
+    {
+        HAL_GPIO_WritePin(IAM20680HP_SCL_PORT, IAM20680HP_SCL_PIN, GPIO_PIN_RESET);
+        iam20680hpRecoveryHalfClock();
+        HAL_GPIO_WritePin(IAM20680HP_SCL_PORT, IAM20680HP_SCL_PIN, GPIO_PIN_SET);
+        iam20680hpRecoveryHalfClock();
+    }
+
+    // STOP: SDA low to high while SCL is high
+    HAL_GPIO_WritePin(IAM20680HP_SCL_PORT, IAM20680HP_SCL_PIN, GPIO_PIN_RESET);
+    iam20680hpRecoveryHalfClock();
+    HAL_GPIO_WritePin(IAM20680HP_SDA_PORT, IAM20680HP_SDA_PIN, GPIO_PIN_RESET);
+    iam20680hpRecoveryHalfClock();
+    HAL_GPIO_WritePin(IAM20680HP_SCL_PORT, IAM20680HP_SCL_PIN, GPIO_PIN_SET);
+    iam20680hpRecoveryHalfClock();
+    HAL_GPIO_WritePin(IAM20680HP_SDA_PORT, IAM20680HP_SDA_PIN, GPIO_PIN_SET);
+    iam20680hpRecoveryHalfClock();
+#endif
+
+    // HAL_I2C_Init() configures the pins for I2C again (HAL_I2C_MspInit())
+    HAL_I2C_Init(&I2C_HANDLER);
+#endif
+}
+
+/*
+ * Writes one register from the shadow, nothing when it is not shadowed
+ */
+static IAM20680HP_err_t iam20680hpRecoveryWrite(uint8_t reg)
+{
+    uint8_t buffer[2] = {reg, 0};
+
+    if (!iam20680hpShadowGet(reg, &buffer[1]))
+    {
+        return IAM20680HP_OK;
+    }
+    return iam20680hpBusTransmit(buffer, 2);
+}
+
+IAM20680HP_err_t iam20680hpRecoveryRestore(void)
+{
+    IAM20680HP_err_t result;
+
+    recoveryStats.restores++;
+
+    // Clock and wake up first, the standby bits last
+    result = iam20680hpRecoveryWrite(IAM20680HP_PWR_MGMT_1);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    for (uint8_t reg = 0; reg < 0x80; reg++)
+    {
+        if (reg == IAM20680HP_PWR_MGMT_1 || reg == IAM20680HP_PWR_MGMT_2)
+        {
+            continue;
+        }
+        result = iam20680hpRecoveryWrite(reg);
+        if (result != IAM20680HP_OK)
+            return result;
+    }
+
+    result = iam20680hpRecoveryWrite(IAM20680HP_PWR_MGMT_2);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    // The FiFo content is not valid anymore
+    return iam20680hpFifoReset();
+}
+
+IAM20680HP_err_t iam20680hpRecoveryCheck(bool *restored)
+{
+    IAM20680HP_err_t result;
+    uint8_t values[5];
+
+    *restored = false;
+    recoveryStats.checks++;
+
+    result = iam20680hpCheckDeviceID();
+    if (result == IAM20680HP_ERR_I2C)
+    {
+        // No answer (brown-out, stuck bus): un-jam and give the device its start-up time
+        iam20680hpRecoveryUnjam();
+        iam20680hpBusDelay(IAM20680HP_RECOVERY_STARTUP_MS);
+        result = iam20680hpCheckDeviceID();
+    }
+    if (result != IAM20680HP_OK)
+        return result;
+
+    for (uint8_t block = 0; block < 2; block++)
+    {
+        uint8_t reg = checkFirst[block];
+        if (iam20680hpBusTransmit(&reg, 1) != IAM20680HP_OK || iam20680hpBusReceive(values, checkSize[block]) != IAM20680HP_OK)
+        {
+            return IAM20680HP_ERR_I2C;
+        }
+
+        for (uint8_t i = 0; i < checkSize[block]; i++)
+        {
+            uint8_t shadow;
+            if (iam20680hpShadowGet(checkFirst[block] + i, &shadow) && shadow != values[i])
+            {
+                *restored = true;
+            }
+        }
+    }
+
+    if (*restored)
+    {
+        return iam20680hpRecoveryRestore();
+    }
+    return IAM20680HP_OK;
+}
+
+void iam20680hpScrubberInit(IAM20680HP_scrubber_t *scrubber, uint32_t periodMs)
+{
+    memset(scrubber, 0, sizeof(*scrubber));
+    scrubber->address = iam20680hpSelectedDevice();
+    scrubber->periodMs = periodMs;
+}
+
+IAM20680HP_err_t iam20680hpScrubberUpdate(IAM20680HP_scrubber_t *scrubber, uint32_t elapsedMs)
+{
+    scrubber->elapsedMs += elapsedMs;
+    if (scrubber->elapsedMs < scrubber->periodMs)
+    {
+        return IAM20680HP_OK;
+    }
+
+    scrubber->elapsedMs = 0;
+    return iam20680hpScrub(scrubber);
+}
+
+IAM20680HP_err_t iam20680hpScrub(IAM20680HP_scrubber_t *scrubber)
+{
+    IAM20680HP_err_t result;
+    uint8_t values[3][7];
+
+    scrubber->scrubs++;
+    result = iam20680hpSelectDevice(scrubber->address);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    for (uint8_t range = 0; range < 3; range++)
+    {
+        uint8_t reg = scrubFirst[range];
+        if (iam20680hpBusTransmit(&reg, 1) != IAM20680HP_OK || iam20680hpBusReceive(values[range], scrubSize[range]) != IAM20680HP_OK)
+        {
+            scrubber->errors++;
+            return IAM20680HP_ERR_I2C;
+        }
+    }
+
+    // SLEEP set in PWR_MGMT_1 (reset value 0x41) while the shadow has it cleared: the device was reset
+    uint8_t shadow;
+    uint8_t pwrMgmt1 = values[2][IAM20680HP_PWR_MGMT_1 - IAM20680HP_USER_CTRL];
+    if ((pwrMgmt1 & 0x40) && iam20680hpShadowGet(IAM20680HP_PWR_MGMT_1, &shadow) && !(shadow & 0x40))
+    {
+        scrubber->resets++;
+        result = iam20680hpRecoveryRestore();
+        if (result != IAM20680HP_OK)
+            scrubber->errors++;
+        return result;
+    }
+
+    for (uint8_t range = 0; range < 3; range++)
+    {
+        for (uint8_t i = 0; i < scrubSize[range]; i++)
+        {
+            uint8_t buffer[2] = {(uint8_t)(scrubFirst[range] + i), 0};
+            uint8_t value = values[range][i];
+            if (buffer[0] == IAM20680HP_USER_CTRL)
+            {
+                value &= (uint8_t)~0x05; // Self clearing reset bits, not held in the shadow
+            }
+            if (!iam20680hpShadowGet(buffer[0], &buffer[1]) || buffer[1] == value)
+            {
+                continue;
+            }
+
+            scrubber->mismatches++;
+            if (iam20680hpBusTransmit(buffer, 2) != IAM20680HP_OK)
+            {
+                scrubber->errors++;
+                return IAM20680HP_ERR_I2C;
+            }
+            scrubber->repairs++;
+        }
+    }
+
+    return IAM20680HP_OK;
+}
+
+void iam20680hpRecoveryGetStats(IAM20680HP_recoveryStats_t *stats)
+{
+    *stats = recoveryStats;
+}
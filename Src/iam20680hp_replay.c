@@ -0,0 +1,325 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Replay backend for host builds (POSIX). Build with IAM20680HP_USE_HAL set to 0.
+
+*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "iam20680hp_replay.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const uint8_t *replayMap = NULL;
+static size_t replaySize = 0;
+static size_t replayPosition = 0;
+static IAM20680HP_replayFormat_t replayFormat = IAM20680HP_REPLAY_RAW_FIFO;
+
+static uint8_t replayRegisters[128];
+static uint8_t replayRegister = 0;
+static IAM20680HP_replayStats_t replayStats;
+static uint32_t replayErrorCountdown = 0;
+
+
+static void iam20680hpReplayResetShadow(void)
+{
+    memset(replayRegisters, 0, sizeof(replayRegisters));
+    replayRegisters[IAM20680HP_PWR_MGMT_1] = 0x41;
+    replayRegisters[IAM20680HP_WHO_AM_I] = IAM20680HP_DEVICE_ID;
+}
+
+static size_t iam20680hpReplayRemaining(void)
+{
+    return replaySize - replayPosition;
+}
+
+static uint16_t iam20680hpReplayFifoSize(void)
+{
+    // ACCEL_CONFIG2 FIFO_SIZE: 0 = 512byte, 1 = 1kByte, 2 = 2kByte, 3 = 4kByte
+    return (uint16_t)(512 << ((replayRegisters[IAM20680HP_ACCEL_CONFIG2] & 0xC0) >> 6));
+}
+
+static uint16_t iam20680hpReplayFifoCount(size_t remaining)
+{
+    // A dump holds whole frames without overflow: report whole frames of FIFO_EN (temperature, gyro axes 2, accel 6 bytes)
+    uint8_t fifoEnable = replayRegisters[IAM20680HP_FIFO_EN];
+    uint16_t frameSize = (uint16_t)(2 * (((fifoEnable >> 7) & 1) + ((fifoEnable >> 6) & 1) + ((fifoEnable >> 5) & 1) + ((fifoEnable >> 4) & 1)) + 
+                                    6 * ((fifoEnable >> 3) & 1));
+    uint16_t fifoSize = iam20680hpReplayFifoSize();
+
+    if (remaining <= fifoSize)
+    {
+        return (uint16_t)remaining;
+    }
+    return frameSize > 0 ? (uint16_t)(fifoSize - fifoSize % frameSize) : fifoSize;
+}
+
+static void iam20680hpReplayShadowRead(uint8_t *buffer, uint16_t size)
+{
+    for (uint16_t i = 0; i < size; i++)
+    {
+        buffer[i] = replayRegisters[(replayRegister + i) & 0x7F];
+    }
+    replayStats.shadowReads++;
+}
+
+static void iam20680hpReplayRawReceive(uint8_t *buffer, uint16_t size)
+{
+    size_t remaining = iam20680hpReplayRemaining();
+
+    if (replayRegister == IAM20680HP_FIFO_COUNTH)
+    {
+        uint16_t fifoCount = iam20680hpReplayFifoCount(remaining);
+        replayRegisters[IAM20680HP_FIFO_COUNTH] = (uint8_t)(fifoCount >> 8);
+        replayRegisters[IAM20680HP_FIFO_COUNTL] = (uint8_t)(fifoCount);
+        iam20680hpReplayShadowRead(buffer, size);
+        return;
+    }
+
+    if (replayRegister == IAM20680HP_FIFO_R_W)
+    {
+        // FIFO_R_W does not auto increment, an empty FIFO reads 0xFF
+        size_t length = remaining < size ? remaining : size;
+        memcpy(buffer, replayMap + replayPosition, length);
+        memset(buffer + length, 0xFF, size - length);
+        replayPosition += length;
+        replayStats.fifoBytes += length;
+        return;
+    }
+
+    iam20680hpReplayShadowRead(buffer, size);
+}
+
+static void iam20680hpReplayTraceReceive(uint8_t *buffer, uint16_t size)
+{
+    size_t position = replayPosition;
+
+    for (uint16_t record = 0; record < IAM20680HP_REPLAY_SEARCH_WINDOW; record++)
+    {
+        if (replaySize - position < 4)
+            break;
+
+        uint8_t type = replayMap[position];
+        uint8_t reg = replayMap[position + 1];
+        uint16_t length = (uint16_t)(replayMap[position + 2] | replayMap[position + 3] << 8);
+        const uint8_t *payload = replayMap + position + 4;
+
+        if (replaySize - position - 4 < length)
+            break;
+        position += 4 + length;
+
+        if (type != IAM20680HP_REPLAY_TRACE_READ || reg != replayRegister)
+            continue;
+
+        uint16_t copy = length < size ? length : size;
+        memcpy(buffer, payload, copy);
+        if (reg == IAM20680HP_FIFO_R_W)
+        {
+            memset(buffer + copy, 0xFF, size - copy);
+            replayStats.fifoBytes += copy;
+        }
+        else
+        {
+            // Keep the shadow consistent for reads which are not in the trace
+            for (uint16_t i = 0; i < copy; i++)
+            {
+                replayRegisters[(reg + i) & 0x7F] = payload[i];
+            }
+            for (uint16_t i = copy; i < size; i++)
+            {
+                buffer[i] = replayRegisters[(reg + i) & 0x7F];
+            }
+        }
+        replayPosition = position;
+        return;
+    }
+
+    // Not recorded (anymore): an empty FIFO or the register shadow
+    if (replayRegister == IAM20680HP_FIFO_COUNTH)
+    {
+        replayRegisters[IAM20680HP_FIFO_COUNTH] = 0;
+        replayRegisters[IAM20680HP_FIFO_COUNTL] = 0;
+    }
+    if (replayRegister == IAM20680HP_FIFO_R_W)
+    {
+        memset(buffer, 0xFF, size);
+        return;
+    }
+    iam20680hpReplayShadowRead(buffer, size);
+}
+
+IAM20680HP_err_t iam20680hpReplayOpen(const char *path, IAM20680HP_replayFormat_t format)
+{
+    iam20680hpReplayClose();
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return IAM20680HP_ERR_DEVICE_NOT_FOUND;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        close(fd);
+        return IAM20680HP_ERR_DEVICE_NOT_FOUND;
+    }
+
+    // The mapping stays valid after closing the file descriptor, pages are loaded on access
+    void *map = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return IAM20680HP_ERR_DEVICE_NOT_FOUND;
+    }
+    posix_madvise(map, (size_t)fileStat.st_size, POSIX_MADV_SEQUENTIAL);
+
+    replayMap = (const uint8_t *)map;
+    replaySize = (size_t)fileStat.st_size;
+    replayFormat = format;
+
+    if (format == IAM20680HP_REPLAY_TRACE)
+    {
+        if (replaySize < 4 || memcmp(replayMap, IAM20680HP_REPLAY_TRACE_MAGIC, 4) != 0)
+        {
+            iam20680hpReplayClose();
+            return IAM20680HP_ERR_INVALID_PARAM;
+        }
+    }
+
+    iam20680hpReplayRewind();
+    return IAM20680HP_OK;
+}
+
+void iam20680hpReplayClose(void)
+{
+    if (replayMap != NULL)
+    {
+        munmap((void *)replayMap, replaySize);
+    }
+    replayMap = NULL;
+    replaySize = 0;
+    replayPosition = 0;
+}
+
+void iam20680hpReplayRewind(void)
+{
+    replayPosition = replayFormat == IAM20680HP_REPLAY_TRACE ? 4 : 0;
+    replayRegister = 0;
+    memset(&replayStats, 0, sizeof(replayStats));
+    replayErrorCountdown = 0;
+    iam20680hpReplayResetShadow();
+}
+
+void iam20680hpReplayGetStats(IAM20680HP_replayStats_t *stats)
+{
+    *stats = replayStats;
+    stats->fileSize = replaySize;
+    stats->position = replayPosition;
+}
+
+bool iam20680hpReplayFinished(void)
+{
+    return replayMap == NULL || replayPosition >= replaySize;
+}
+
+void iam20680hpReplayInjectReset(void)
+{
+    iam20680hpReplayResetShadow();
+}
+
+void iam20680hpReplayInjectError(uint32_t transfer)
+{
+    replayErrorCountdown = transfer;
+}
+
+/*
+ * Counts down to an injected bus error
+ */
+static bool iam20680hpReplayError(void)
+{
+    return replayErrorCountdown > 0 && --replayErrorCountdown == 0;
+}
+
+IAM20680HP_err_t iam20680hpBusTransmit(uint8_t *buffer, uint16_t size)
+{
+    if (replayMap == NULL || size == 0 || iam20680hpReplayError())
+    {
+        return IAM20680HP_ERR_I2C;
+    }
+
+    replayStats.transmits++;
+    replayStats.busBytes += size;
+    replayRegister = buffer[0] & 0x7F;
+
+    if (size > 1 && (replayRegister == IAM20680HP_PWR_MGMT_1) && (buffer[1] & 0x80))
+    {
+        // Device reset restores the default register values
+        iam20680hpReplayResetShadow();
+        iam20680hpShadowRecord(buffer, size);
+        return IAM20680HP_OK;
+    }
+
+    for (uint16_t i = 1; i < size; i++)
+    {
+        replayRegisters[(replayRegister + i - 1) & 0x7F] = buffer[i];
+    }
+    replayRegisters[IAM20680HP_WHO_AM_I] = IAM20680HP_DEVICE_ID;
+    replayRegisters[IAM20680HP_USER_CTRL] &= (uint8_t)~0x05; // FIFO_RST and SIG_COND_RST clear themselves
+
+    // Driver register shadow as with the hardware backends (recovery, scrubber)
+    iam20680hpShadowRecord(buffer, size);
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpBusReceive(uint8_t *buffer, uint16_t size)
+{
+    if (replayMap == NULL || iam20680hpReplayError())
+    {
+        return IAM20680HP_ERR_I2C;
+    }
+
+    replayStats.receives++;
+    replayStats.busBytes += size;
+    if (replayFormat == IAM20680HP_REPLAY_TRACE)
+    {
+        iam20680hpReplayTraceReceive(buffer, size);
+    }
+    else
+    {
+        iam20680hpReplayRawReceive(buffer, size);
+    }
+
+    return IAM20680HP_OK;
+}
+
+void iam20680hpBusDelay(uint32_t ms)
+{
+    // Replay as fast as possible
+    (void)ms;
+}
@@ -0,0 +1,507 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+RTOS layer with a CMSIS-RTOS2 and a POSIX threads port, see iam20680hp_rtos.h.
+
+*/
+
+#include "iam20680hp_rtos.h"
+
+#if IAM20680HP_RTOS
+
+static void iam20680hpRtosTask(IAM20680HP_rtos_t *rtos);
+
+#if IAM20680HP_RTOS == 1
+// CMSIS-RTOS2 port
+
+static osMutexId_t driverMutex;
+static osMutexId_t deviceMutex[2];
+static osMutexId_t busMutex;
+
+static uint32_t iam20680hpRtosTicks(uint32_t ms)
+{
+    return (uint32_t)((uint64_t)ms * osKernelGetTickFreq() / 1000);
+}
+
+static bool iam20680hpRtosPortInit(void)
+{
+    driverMutex = osMutexNew(NULL);
+    deviceMutex[0] = osMutexNew(NULL);
+    deviceMutex[1] = osMutexNew(NULL);
+    busMutex = osMutexNew(NULL);
+    return driverMutex != NULL && deviceMutex[0] != NULL && deviceMutex[1] != NULL && busMutex != NULL;
+}
+
+static void iam20680hpRtosPortBusLock(bool lock)
+{
+    if (lock)
+    {
+        osMutexAcquire(busMutex, osWaitForever);
+    }
+    else
+    {
+        osMutexRelease(busMutex);
+    }
+}
+
+static void iam20680hpRtosPortLock(uint8_t device, bool lock)
+{
+    if (lock)
+    {
+        osMutexAcquire(deviceMutex[device], osWaitForever);
+        osMutexAcquire(driverMutex, osWaitForever);
+    }
+    else
+    {
+        osMutexRelease(driverMutex);
+        osMutexRelease(deviceMutex[device]);
+    }
+}
+
+void iam20680hpRtosDelay(uint32_t ms)
+{
+    uint32_t ticks = iam20680hpRtosTicks(ms);
+    osDelay(ticks > 0 ? ticks : 1);
+}
+
+static uint32_t iam20680hpRtosNowMs(void)
+{
+    return (uint32_t)((uint64_t)osKernelGetTickCount() * 1000 / osKernelGetTickFreq());
+}
+
+static bool iam20680hpRtosQueueInit(IAM20680HP_rtosQueue_t *queue)
+{
+    queue->queue = osMessageQueueNew(IAM20680HP_RTOS_BLOCKS, sizeof(IAM20680HP_rtosBlock_t *), NULL);
+    return queue->queue != NULL;
+}
+
+static void iam20680hpRtosQueueFree(IAM20680HP_rtosQueue_t *queue)
+{
+    if (queue->queue != NULL)
+    {
+        osMessageQueueDelete(queue->queue);
+        queue->queue = NULL;
+    }
+}
+
+static void iam20680hpRtosQueuePut(IAM20680HP_rtosQueue_t *queue, IAM20680HP_rtosBlock_t *block)
+{
+    // Never full, there are only IAM20680HP_RTOS_BLOCKS blocks
+    osMessageQueuePut(queue->queue, &block, 0, 0);
+}
+
+static IAM20680HP_rtosBlock_t *iam20680hpRtosQueueGet(IAM20680HP_rtosQueue_t *queue, uint32_t timeoutMs)
+{
+    IAM20680HP_rtosBlock_t *block = NULL;
+    if (osMessageQueueGet(queue->queue, &block, NULL, iam20680hpRtosTicks(timeoutMs)) != osOK)
+    {
+        return NULL;
+    }
+    return block;
+}
+
+static bool iam20680hpRtosWait(IAM20680HP_rtos_t *rtos, uint32_t timeoutMs)
+{
+    (void)rtos;
+    uint32_t flags = osThreadFlagsWait(0x01, osFlagsWaitAny, iam20680hpRtosTicks(timeoutMs));
+    return (flags & osFlagsError) == 0;
+}
+
+void iam20680hpRtosNotifyFromIsr(IAM20680HP_rtos_t *rtos)
+{
+    osThreadFlagsSet(rtos->thread, 0x01);
+}
+
+static void iam20680hpRtosThread(void *argument)
+{
+    IAM20680HP_rtos_t *rtos = argument;
+    iam20680hpRtosTask(rtos);
+    rtos->stopped = true;
+    osThreadExit();
+}
+
+static bool iam20680hpRtosThreadStart(IAM20680HP_rtos_t *rtos)
+{
+    const osThreadAttr_t attributes = {.name = "iam20680hp", .stack_size = IAM20680HP_RTOS_STACK_SIZE, .priority = osPriorityHigh};
+
+    rtos->stopped = false;
+    rtos->thread = osThreadNew(iam20680hpRtosThread, rtos, &attributes);
+    return rtos->thread != NULL;
+}
+
+static void iam20680hpRtosThreadJoin(IAM20680HP_rtos_t *rtos)
+{
+    while (!rtos->stopped)
+    {
+        iam20680hpRtosDelay(1);
+    }
+}
+
+static void iam20680hpRtosThreadFree(IAM20680HP_rtos_t *rtos)
+{
+    // The task ended with osThreadExit(), nothing else was created for it
+    rtos->thread = NULL;
+}
+
+#elif IAM20680HP_RTOS == 2
+// POSIX threads port
+
+#include "time.h"
+
+static pthread_mutex_t driverMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t deviceMutex[2] = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER};
+static pthread_mutex_t busMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static bool iam20680hpRtosPortInit(void)
+{
+    return true;
+}
+
+static void iam20680hpRtosPortBusLock(bool lock)
+{
+    if (lock)
+    {
+        pthread_mutex_lock(&busMutex);
+    }
+    else
+    {
+        pthread_mutex_unlock(&busMutex);
+    }
+}
+
+static void iam20680hpRtosPortLock(uint8_t device, bool lock)
+{
+    if (lock)
+    {
+        pthread_mutex_lock(&deviceMutex[device]);
+        pthread_mutex_lock(&driverMutex);
+    }
+    else
+    {
+        pthread_mutex_unlock(&driverMutex);
+        pthread_mutex_unlock(&deviceMutex[device]);
+    }
+}
+
+void iam20680hpRtosDelay(uint32_t ms)
+{
+    struct timespec delay = {(time_t)(ms / 1000), (long)(ms % 1000) * 1000000};
+    nanosleep(&delay, NULL);
+}
+
+static uint32_t iam20680hpRtosNowMs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000);
+}
+
+/*
+ * Absolute time timeoutMs from now for pthread_cond_timedwait (CLOCK_REALTIME)
+ */
+static struct timespec iam20680hpRtosDeadline(uint32_t timeoutMs)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeoutMs / 1000;
+    deadline.tv_nsec += (long)(timeoutMs % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    return deadline;
+}
+
+static bool iam20680hpRtosQueueInit(IAM20680HP_rtosQueue_t *queue)
+{
+    queue->head = 0;
+    queue->count = 0;
+    queue->created = pthread_mutex_init(&queue->mutex, NULL) == 0;
+    if (queue->created && pthread_cond_init(&queue->changed, NULL) != 0)
+    {
+        pthread_mutex_destroy(&queue->mutex);
+        queue->created = false;
+    }
+    return queue->created;
+}
+
+static void iam20680hpRtosQueueFree(IAM20680HP_rtosQueue_t *queue)
+{
+    if (queue->created)
+    {
+        pthread_cond_destroy(&queue->changed);
+        pthread_mutex_destroy(&queue->mutex);
+        queue->created = false;
+    }
+}
+
+static void iam20680hpRtosQueuePut(IAM20680HP_rtosQueue_t *queue, IAM20680HP_rtosBlock_t *block)
+{
+    pthread_mutex_lock(&queue->mutex);
+    queue->ring[(queue->head + queue->count) % IAM20680HP_RTOS_BLOCKS] = block;
+    queue->count++;
+    pthread_cond_signal(&queue->changed);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+static IAM20680HP_rtosBlock_t *iam20680hpRtosQueueGet(IAM20680HP_rtosQueue_t *queue, uint32_t timeoutMs)
+{
+    IAM20680HP_rtosBlock_t *block = NULL;
+    struct timespec deadline = iam20680hpRtosDeadline(timeoutMs);
+
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->count == 0 && timeoutMs > 0)
+    {
+        if (pthread_cond_timedwait(&queue->changed, &queue->mutex, &deadline) != 0)
+        {
+            break;
+        }
+    }
+    if (queue->count > 0)
+    {
+        block = queue->ring[queue->head];
+        queue->head = (queue->head + 1) % IAM20680HP_RTOS_BLOCKS;
+        queue->count--;
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    return block;
+}
+
+static bool iam20680hpRtosWait(IAM20680HP_rtos_t *rtos, uint32_t timeoutMs)
+{
+    struct timespec deadline = iam20680hpRtosDeadline(timeoutMs);
+
+    pthread_mutex_lock(&rtos->mutex);
+    while (!rtos->pending)
+    {
+        if (pthread_cond_timedwait(&rtos->notify, &rtos->mutex, &deadline) != 0)
+        {
+            break;
+        }
+    }
+    bool notified = rtos->pending;
+    rtos->pending = false;
+    pthread_mutex_unlock(&rtos->mutex);
+    return notified;
+}
+
+void iam20680hpRtosNotifyFromIsr(IAM20680HP_rtos_t *rtos)
+{
+    pthread_mutex_lock(&rtos->mutex);
+    rtos->pending = true;
+    pthread_cond_signal(&rtos->notify);
+    pthread_mutex_unlock(&rtos->mutex);
+}
+
+static void *iam20680hpRtosThread(void *argument)
+{
+    iam20680hpRtosTask(argument);
+    return NULL;
+}
+
+static bool iam20680hpRtosThreadStart(IAM20680HP_rtos_t *rtos)
+{
+    rtos->pending = false;
+    if (pthread_mutex_init(&rtos->mutex, NULL) != 0)
+    {
+        return false;
+    }
+    if (pthread_cond_init(&rtos->notify, NULL) != 0)
+    {
+        pthread_mutex_destroy(&rtos->mutex);
+        return false;
+    }
+    if (pthread_create(&rtos->thread, NULL, iam20680hpRtosThread, rtos) != 0)
+    {
+        pthread_cond_destroy(&rtos->notify);
+        pthread_mutex_destroy(&rtos->mutex);
+        return false;
+    }
+    return true;
+}
+
+static void iam20680hpRtosThreadJoin(IAM20680HP_rtos_t *rtos)
+{
+    pthread_join(rtos->thread, NULL);
+}
+
+static void iam20680hpRtosThreadFree(IAM20680HP_rtos_t *rtos)
+{
+    pthread_cond_destroy(&rtos->notify);
+    pthread_mutex_destroy(&rtos->mutex);
+}
+
+#else
+#error "IAM20680HP_RTOS: 1 CMSIS-RTOS2, 2 POSIX threads"
+#endif
+
+// Common part
+
+IAM20680HP_err_t iam20680hpRtosInit(void)
+{
+    return iam20680hpRtosPortInit() ? IAM20680HP_OK : IAM20680HP_ERR_INVALID_PARAM;
+}
+
+void iam20680hpRtosLock(uint8_t address)
+{
+    iam20680hpRtosPortLock(address & 0x01, true);
+    iam20680hpSelectDevice(address);
+}
+
+void iam20680hpRtosUnlock(uint8_t address)
+{
+    iam20680hpRtosPortLock(address & 0x01, false);
+}
+
+void iam20680hpRtosBusLock(bool lock)
+{
+    iam20680hpRtosPortBusLock(lock);
+}
+
+IAM20680HP_err_t iam20680hpRtosStart(IAM20680HP_rtos_t *rtos, uint8_t address)
+{
+    IAM20680HP_err_t result;
+
+    memset(rtos, 0, sizeof(*rtos));
+    rtos->address = address;
+
+    iam20680hpRtosLock(address);
+    result = iam20680hpReadOutputDataRate(&rtos->odrHz);
+    if (result == IAM20680HP_OK)
+    {
+        result = iam20680hpDrainSchedulerInitFromDevice(&rtos->scheduler, IAM20680HP_RTOS_TARGET_FILL);
+    }
+    iam20680hpRtosUnlock(address);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    // The frames at the target fill must fit a block, otherwise every drain leaves frames in the FiFo
+    if (rtos->scheduler.targetBytes > IAM20680HP_RTOS_BLOCK_FRAMES * IAM20680HP_FIFO_FRAME_SIZE)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    if (!iam20680hpRtosQueueInit(&rtos->free) || !iam20680hpRtosQueueInit(&rtos->full))
+    {
+        iam20680hpRtosQueueFree(&rtos->free);
+        iam20680hpRtosQueueFree(&rtos->full);
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+    for (uint8_t i = 0; i < IAM20680HP_RTOS_BLOCKS; i++)
+    {
+        iam20680hpRtosQueuePut(&rtos->free, &rtos->blocks[i]);
+    }
+
+    rtos->running = true;
+    rtos->lastDrainMs = iam20680hpRtosNowMs();
+    if (!iam20680hpRtosThreadStart(rtos))
+    {
+        rtos->running = false;
+        iam20680hpRtosQueueFree(&rtos->free);
+        iam20680hpRtosQueueFree(&rtos->full);
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+    return IAM20680HP_OK;
+}
+
+void iam20680hpRtosStop(IAM20680HP_rtos_t *rtos)
+{
+    rtos->running = false;
+    iam20680hpRtosNotifyFromIsr(rtos);
+    iam20680hpRtosThreadJoin(rtos);
+
+    // The RTOS objects of this start, blocks still at the consumer are not valid anymore
+    iam20680hpRtosThreadFree(rtos);
+    iam20680hpRtosQueueFree(&rtos->free);
+    iam20680hpRtosQueueFree(&rtos->full);
+}
+
+/*
+ * Sensor task: waits for a notification or the drain interval, drains the FiFo into a free block
+ */
+static void iam20680hpRtosTask(IAM20680HP_rtos_t *rtos)
+{
+    uint32_t intervalMs = rtos->scheduler.intervalMs;
+
+    while (rtos->running)
+    {
+        if (iam20680hpRtosWait(rtos, intervalMs))
+        {
+            rtos->notifications++;
+        }
+        if (!rtos->running)
+        {
+            break;
+        }
+
+        IAM20680HP_rtosBlock_t *block = iam20680hpRtosQueueGet(&rtos->free, 0);
+        if (block == NULL)
+        {
+            // The frames stay in the FiFo until the consumer gives a block back
+            rtos->noFreeBlock++;
+            intervalMs = rtos->scheduler.minIntervalMs;
+            continue;
+        }
+
+        uint32_t nowMs = iam20680hpRtosNowMs();
+        uint32_t elapsedMs = nowMs - rtos->lastDrainMs;
+
+        iam20680hpRtosLock(rtos->address);
+        IAM20680HP_err_t result = iam20680hpReadFifoBlockWithGap(block->frames, IAM20680HP_RTOS_BLOCK_FRAMES, &block->count, rtos->odrHz,
+                                                                 elapsedMs, &block->gap);
+        iam20680hpRtosUnlock(rtos->address);
+
+        rtos->drains++;
+        if (result != IAM20680HP_OK)
+        {
+            // Not an empty FiFo: the interval stays, the next drain counts the frames since the last good one
+            rtos->errors++;
+            iam20680hpRtosQueuePut(&rtos->free, block);
+            continue;
+        }
+        intervalMs = iam20680hpDrainSchedulerUpdateWithGap(&rtos->scheduler, &block->gap, block->count, elapsedMs);
+        if (block->count == 0)
+        {
+            iam20680hpRtosQueuePut(&rtos->free, block);
+            continue;
+        }
+
+        block->timestampMs = nowMs;
+        rtos->lastDrainMs = nowMs;
+        iam20680hpRtosQueuePut(&rtos->full, block);
+    }
+}
+
+IAM20680HP_rtosBlock_t *iam20680hpRtosReceive(IAM20680HP_rtos_t *rtos, uint32_t timeoutMs)
+{
+    return iam20680hpRtosQueueGet(&rtos->full, timeoutMs);
+}
+
+void iam20680hpRtosRelease(IAM20680HP_rtos_t *rtos, IAM20680HP_rtosBlock_t *block)
+{
+    iam20680hpRtosQueuePut(&rtos->free, block);
+}
+
+#endif
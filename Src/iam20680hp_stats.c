@@ -0,0 +1,317 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Streaming statistics per axis, see iam20680hp_stats.h.
+
+*/
+
+#include "iam20680hp_stats.h"
+#include "math.h"
+
+static void iam20680hpStatsClearSlot(IAM20680HP_statsSlot_t *slot)
+{
+    memset(slot, 0, sizeof(*slot));
+}
+
+IAM20680HP_err_t iam20680hpStatsInit(IAM20680HP_stats_t *stats, IAM20680HP_statsMode_t mode, uint32_t length, IAM20680HP_statsOutput_t output, void *context)
+{
+    switch (mode)
+    {
+    case IAM20680HP_STATS_TUMBLING:
+        if (length == 0 || length > IAM20680HP_STATS_MAX_LENGTH)
+        {
+            return IAM20680HP_ERR_INVALID_PARAM;
+        }
+        break;
+    case IAM20680HP_STATS_SLIDING:
+        if (length < IAM20680HP_STATS_SLOTS || length % IAM20680HP_STATS_SLOTS != 0 || length > IAM20680HP_STATS_MAX_LENGTH)
+        {
+            return IAM20680HP_ERR_INVALID_PARAM;
+        }
+        break;
+    case IAM20680HP_STATS_EWMA:
+        if (length == 0 || length > 16)
+        {
+            return IAM20680HP_ERR_INVALID_PARAM;
+        }
+        break;
+    default:
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    stats->mode = mode;
+    stats->slotLength = mode == IAM20680HP_STATS_SLIDING ? length / IAM20680HP_STATS_SLOTS : length;
+    stats->shift = mode == IAM20680HP_STATS_EWMA ? (uint8_t)length : 0;
+    stats->output = output;
+    stats->context = context;
+    return IAM20680HP_OK;
+}
+
+void iam20680hpStatsReset(IAM20680HP_stats_t *stats)
+{
+    for (uint8_t i = 0; i < IAM20680HP_STATS_SLOTS; i++)
+    {
+        iam20680hpStatsClearSlot(&stats->slots[i]);
+    }
+    memset(stats->mean, 0, sizeof(stats->mean));
+    memset(stats->variance, 0, sizeof(stats->variance));
+    memset(&stats->last, 0, sizeof(stats->last));
+    stats->current = 0;
+    stats->fullSlots = 0;
+}
+
+/*
+ * Statistics of all slots with samples. The sums are moved to the offset of the first slot (exact, int64), 
+ * the division is in double once per result.
+ */
+static IAM20680HP_err_t iam20680hpStatsCombine(const IAM20680HP_stats_t *stats, IAM20680HP_statsResult_t *result)
+{
+    const IAM20680HP_statsSlot_t *reference = NULL;
+    int64_t sum[3] = {0, 0, 0}, sumSquares[3] = {0, 0, 0};
+    uint32_t count = 0;
+
+    memset(result, 0, sizeof(*result));
+    for (uint8_t i = 0; i < IAM20680HP_STATS_SLOTS; i++)
+    {
+        const IAM20680HP_statsSlot_t *slot = &stats->slots[i];
+        if (slot->count == 0)
+        {
+            continue;
+        }
+        if (reference == NULL)
+        {
+            reference = slot;
+            memcpy(result->minimum, slot->minimum, sizeof(result->minimum));
+            memcpy(result->maximum, slot->maximum, sizeof(result->maximum));
+        }
+
+        for (uint8_t axis = 0; axis < 3; axis++)
+        {
+            int64_t delta = slot->offset[axis] - reference->offset[axis];
+            sum[axis] += slot->sum[axis] + delta * slot->count;
+            sumSquares[axis] += slot->sumSquares[axis] + 2 * delta * slot->sum[axis] + delta * delta * slot->count;
+            if (slot->minimum[axis] < result->minimum[axis])
+            {
+                result->minimum[axis] = slot->minimum[axis];
+            }
+            if (slot->maximum[axis] > result->maximum[axis])
+            {
+                result->maximum[axis] = slot->maximum[axis];
+            }
+        }
+        count += slot->count;
+    }
+
+    if (reference == NULL)
+    {
+        return IAM20680HP_ERR_NOT_READY;
+    }
+
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+        double mean = (double)sum[axis] / count;
+        double variance = (double)sumSquares[axis] / count - mean * mean;
+        result->mean[axis] = (float)(reference->offset[axis] + mean);
+        result->variance[axis] = variance > 0.0 ? (float)variance : 0.0f;
+        result->rms[axis] = sqrtf(result->variance[axis] + result->mean[axis] * result->mean[axis]);
+    }
+    result->count = count;
+    return IAM20680HP_OK;
+}
+
+/*
+ * Adds count samples (X, Y, Z at samples[i * stride + axis]) to a slot, one pass per axis
+ */
+static void iam20680hpStatsAccumulate(IAM20680HP_statsSlot_t *slot, const int16_t *samples, uint32_t count, uint8_t stride)
+{
+    if (slot->count == 0)
+    {
+        for (uint8_t axis = 0; axis < 3; axis++)
+        {
+            slot->offset[axis] = samples[axis];
+            slot->minimum[axis] = samples[axis];
+            slot->maximum[axis] = samples[axis];
+        }
+    }
+
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+        const int16_t *value = &samples[axis];
+        int32_t offset = slot->offset[axis];
+        int16_t minimum = slot->minimum[axis], maximum = slot->maximum[axis];
+        int64_t sum = 0, sumSquares = 0;
+
+        for (uint32_t i = 0; i < count; i++, value += stride)
+        {
+            int32_t difference = *value - offset;
+            sum += difference;
+            sumSquares += (int64_t)difference * difference;
+            minimum = *value < minimum ? *value : minimum;
+            maximum = *value > maximum ? *value : maximum;
+        }
+
+        slot->sum[axis] += sum;
+        slot->sumSquares[axis] += sumSquares;
+        slot->minimum[axis] = minimum;
+        slot->maximum[axis] = maximum;
+    }
+    slot->count += count;
+}
+
+/*
+ * EWMA (fixed-point, alpha = 2^-shift): mean += d * alpha, variance = (1 - alpha) * (variance + alpha * d^2)
+ */
+static void iam20680hpStatsEwma(IAM20680HP_stats_t *stats, const int16_t *samples, uint32_t count, uint8_t stride)
+{
+    IAM20680HP_statsSlot_t *slot = &stats->slots[0];
+
+    for (uint32_t i = 0; i < count; i++, samples += stride)
+    {
+        for (uint8_t axis = 0; axis < 3; axis++)
+        {
+            int64_t value = (int64_t)samples[axis] << 16;
+            if (slot->count == 0)
+            {
+                stats->mean[axis] = value;
+                stats->variance[axis] = 0;
+                slot->minimum[axis] = samples[axis];
+                slot->maximum[axis] = samples[axis];
+                continue;
+            }
+
+            // The difference in LSB * 2^8 keeps the square in 64 bit
+            int64_t difference = (value - stats->mean[axis]) >> 8;
+            stats->mean[axis] += (value - stats->mean[axis]) >> stats->shift;
+            int64_t variance = stats->variance[axis] + ((difference * difference) >> stats->shift);
+            stats->variance[axis] = variance - (variance >> stats->shift);
+
+            slot->minimum[axis] = samples[axis] < slot->minimum[axis] ? samples[axis] : slot->minimum[axis];
+            slot->maximum[axis] = samples[axis] > slot->maximum[axis] ? samples[axis] : slot->maximum[axis];
+        }
+        slot->count++;
+    }
+}
+
+static void iam20680hpStatsUpdate(IAM20680HP_stats_t *stats, const int16_t *samples, uint32_t count, uint8_t stride)
+{
+    if (stats->mode == IAM20680HP_STATS_EWMA)
+    {
+        iam20680hpStatsEwma(stats, samples, count, stride);
+        return;
+    }
+
+    while (count > 0)
+    {
+        IAM20680HP_statsSlot_t *slot = &stats->slots[stats->current];
+        uint32_t run = stats->slotLength - slot->count;
+        if (run > count)
+        {
+            run = count;
+        }
+
+        iam20680hpStatsAccumulate(slot, samples, run, stride);
+        samples += run * stride;
+        count -= run;
+
+        if (slot->count < stats->slotLength)
+        {
+            break;
+        }
+
+        if (stats->mode == IAM20680HP_STATS_TUMBLING)
+        {
+            iam20680hpStatsCombine(stats, &stats->last);
+            iam20680hpStatsClearSlot(slot);
+            if (stats->output != NULL)
+            {
+                stats->output(&stats->last, stats->context);
+            }
+        }
+        else
+        {
+            // The oldest slot is reused
+            stats->current = (stats->current + 1) % IAM20680HP_STATS_SLOTS;
+            iam20680hpStatsClearSlot(&stats->slots[stats->current]);
+            if (stats->fullSlots < IAM20680HP_STATS_SLOTS - 1)
+            {
+                stats->fullSlots++;
+            }
+        }
+    }
+}
+
+void iam20680hpStatsUpdateFrames(IAM20680HP_stats_t *stats, const IAM20680HP_fifoData_t *frames, uint16_t count, bool gyro)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    iam20680hpStatsUpdate(stats, gyro ? &frames[0].gyroData.xGyro : &frames[0].accelData.xAccel, count, sizeof(IAM20680HP_fifoData_t) / sizeof(int16_t));
+}
+
+void iam20680hpStatsUpdateAccel(IAM20680HP_stats_t *stats, const IAM20680HP_accelData_t *accelData, uint16_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    iam20680hpStatsUpdate(stats, &accelData[0].xAccel, count, sizeof(IAM20680HP_accelData_t) / sizeof(int16_t));
+}
+
+IAM20680HP_err_t iam20680hpStatsResult(const IAM20680HP_stats_t *stats, IAM20680HP_statsResult_t *result)
+{
+    switch (stats->mode)
+    {
+    case IAM20680HP_STATS_TUMBLING:
+        if (stats->last.count == 0)
+        {
+            return IAM20680HP_ERR_NOT_READY;
+        }
+        *result = stats->last;
+        return IAM20680HP_OK;
+
+    case IAM20680HP_STATS_SLIDING:
+        return iam20680hpStatsCombine(stats, result);
+
+    default:
+        break;
+    }
+
+    const IAM20680HP_statsSlot_t *slot = &stats->slots[0];
+    if (slot->count == 0)
+    {
+        return IAM20680HP_ERR_NOT_READY;
+    }
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+        result->mean[axis] = stats->mean[axis] / 65536.0f;
+        result->variance[axis] = stats->variance[axis] / 65536.0f;
+        result->rms[axis] = sqrtf(result->variance[axis] + result->mean[axis] * result->mean[axis]);
+        result->minimum[axis] = slot->minimum[axis];
+        result->maximum[axis] = slot->maximum[axis];
+    }
+    result->count = slot->count;
+    return IAM20680HP_OK;
+}
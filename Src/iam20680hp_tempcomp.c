@@ -0,0 +1,265 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Temperature compensation of the gyro bias, see iam20680hp_tempcomp.h.
+
+*/
+
+#include "iam20680hp_tempcomp.h"
+
+
+/*
+ * Limits a fitted coefficient to int32_t
+ */
+static int32_t iam20680hpTempCompFixed(float value)
+{
+    if (value > 2147483000.0f)
+    {
+        return INT32_MAX;
+    }
+    if (value < -2147483000.0f)
+    {
+        return INT32_MIN;
+    }
+    return (int32_t)(value + (value >= 0 ? 0.5f : -0.5f));
+}
+
+/*
+ * Weighted least squares fit of the bins (only after a bin update, not per sample), solved with Gaussian elimination
+ */
+static void iam20680hpTempCompFit(IAM20680HP_tempComp_t *model)
+{
+    uint8_t filled = 0;
+    for (uint8_t bin = 0; bin < IAM20680HP_TEMPCOMP_BINS; bin++)
+    {
+        if (model->bins[bin].count > 0)
+        {
+            filled++;
+        }
+    }
+    if (filled == 0)
+    {
+        return;
+    }
+
+    // Solved into locals, a singular system keeps the previous fit
+    uint8_t order = filled - 1 < model->maxOrder ? filled - 1 : model->maxOrder;
+    uint8_t terms = order + 1;
+    int32_t coefficient[3][3];
+
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+        float matrix[3][4];
+        memset(matrix, 0, sizeof(matrix));
+
+        for (uint8_t bin = 0; bin < IAM20680HP_TEMPCOMP_BINS; bin++)
+        {
+            const IAM20680HP_tempCompBin_t *tempCompBin = &model->bins[bin];
+            if (tempCompBin->count == 0)
+                continue;
+
+            float weight = tempCompBin->count < IAM20680HP_TEMPCOMP_BIN_WEIGHT ? tempCompBin->count : IAM20680HP_TEMPCOMP_BIN_WEIGHT;
+            float x = (tempCompBin->temperature - model->referenceTemperature) / 100.0f;
+            float y = tempCompBin->bias[axis] / 16.0f;
+            float power[5] = {1.0f, x, x * x, x * x * x, x * x * x * x};
+
+            for (uint8_t row = 0; row < terms; row++)
+            {
+                for (uint8_t column = 0; column < terms; column++)
+                {
+                    matrix[row][column] += weight * power[row + column];
+                }
+                matrix[row][3] += weight * y * power[row];
+            }
+        }
+
+        for (uint8_t pivot = 0; pivot < terms; pivot++)
+        {
+            if (matrix[pivot][pivot] == 0.0f)
+            {
+                return;
+            }
+            for (uint8_t row = 0; row < terms; row++)
+            {
+                if (row == pivot)
+                    continue;
+                float factor = matrix[row][pivot] / matrix[pivot][pivot];
+                for (uint8_t column = pivot; column < 4; column++)
+                {
+                    matrix[row][column] -= factor * matrix[pivot][column];
+                }
+            }
+        }
+
+        // Per celcius to per 0.01 celcius and to fixed-point, see IAM20680HP_tempComp_t
+        float solution[3] = {0.0f, 0.0f, 0.0f};
+        for (uint8_t term = 0; term < terms; term++)
+        {
+            solution[term] = matrix[term][3] / matrix[term][term];
+        }
+        coefficient[axis][0] = iam20680hpTempCompFixed(solution[0] * 256.0f);
+        coefficient[axis][1] = iam20680hpTempCompFixed(solution[1] / 100.0f * 1048576.0f);
+        coefficient[axis][2] = iam20680hpTempCompFixed(solution[2] / 10000.0f * 4294967296.0f);
+    }
+
+    memcpy(model->coefficient, coefficient, sizeof(model->coefficient));
+    model->order = order;
+    model->valid = true;
+}
+
+IAM20680HP_err_t iam20680hpTempCompInit(IAM20680HP_tempComp_t *model, uint8_t order, int16_t referenceTemperature)
+{
+    if (order > 2)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    memset(model, 0, sizeof(*model));
+    model->maxOrder = order;
+    model->referenceTemperature = referenceTemperature;
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpTempCompAddBias(IAM20680HP_tempComp_t *model, int16_t temperature, const int32_t *gyroBias)
+{
+    int32_t index = (temperature - IAM20680HP_TEMPCOMP_MIN_TEMP) / IAM20680HP_TEMPCOMP_BIN_WIDTH;
+    if (temperature < IAM20680HP_TEMPCOMP_MIN_TEMP || index >= IAM20680HP_TEMPCOMP_BINS)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    // Running average over the first updates, then exponential (1 / IAM20680HP_TEMPCOMP_BIN_WEIGHT)
+    IAM20680HP_tempCompBin_t *bin = &model->bins[index];
+    if (bin->count < UINT16_MAX)
+    {
+        bin->count++;
+    }
+    int32_t weight = bin->count < IAM20680HP_TEMPCOMP_BIN_WEIGHT ? bin->count : IAM20680HP_TEMPCOMP_BIN_WEIGHT;
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+        bin->bias[axis] += (gyroBias[axis] - bin->bias[axis]) / weight;
+    }
+    bin->temperature += (temperature - bin->temperature) / weight;
+
+    model->updates++;
+    iam20680hpTempCompFit(model);
+    return IAM20680HP_OK;
+}
+
+bool iam20680hpTempCompUpdate(IAM20680HP_tempComp_t *model, const IAM20680HP_fifoData_t *fifoData, uint16_t frames)
+{
+    if (frames < IAM20680HP_TEMPCOMP_MIN_FRAMES)
+    {
+        return false;
+    }
+
+    int16_t minimum[6], maximum[6];
+    int32_t gyroSum[3] = {0, 0, 0};
+    int32_t temperatureSum = 0;
+
+    for (uint16_t frame = 0; frame < frames; frame++)
+    {
+        const int16_t sample[6] = {fifoData[frame].gyroData.xGyro, fifoData[frame].gyroData.yGyro, fifoData[frame].gyroData.zGyro,
+                                   fifoData[frame].accelData.xAccel, fifoData[frame].accelData.yAccel, fifoData[frame].accelData.zAccel};
+        for (uint8_t channel = 0; channel < 6; channel++)
+        {
+            if (frame == 0 || sample[channel] < minimum[channel])
+            {
+                minimum[channel] = sample[channel];
+            }
+            if (frame == 0 || sample[channel] > maximum[channel])
+            {
+                maximum[channel] = sample[channel];
+            }
+        }
+        gyroSum[0] += sample[0];
+        gyroSum[1] += sample[1];
+        gyroSum[2] += sample[2];
+        temperatureSum += fifoData[frame].temperature;
+    }
+
+    for (uint8_t channel = 0; channel < 6; channel++)
+    {
+        int32_t limit = channel < 3 ? IAM20680HP_TEMPCOMP_STILL_GYRO : IAM20680HP_TEMPCOMP_STILL_ACCEL;
+        if (maximum[channel] - minimum[channel] > limit)
+        {
+            return false;
+        }
+    }
+
+    int32_t gyroBias[3];
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+        gyroBias[axis] = gyroSum[axis] * 16 / frames;
+    }
+
+    return iam20680hpTempCompAddBias(model, (int16_t)(temperatureSum / frames), gyroBias) == IAM20680HP_OK;
+}
+
+void iam20680hpTempCompBias(const IAM20680HP_tempComp_t *model, int16_t temperature, int32_t *gyroBias)
+{
+    int32_t x = temperature - model->referenceTemperature;
+
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+        const int32_t *coefficient = model->coefficient[axis];
+        gyroBias[axis] = coefficient[0] + (int32_t)(((int64_t)coefficient[1] * x) >> 12) + (int32_t)(((int64_t)coefficient[2] * x * x) >> 24);
+    }
+}
+
+void iam20680hpTempCompApply(const IAM20680HP_tempComp_t *model, IAM20680HP_fifoData_t *fifoData, uint16_t frames)
+{
+    int32_t gyroBias[3];
+    int16_t lastTemperature = 0;
+
+    if (!model->valid)
+    {
+        return;
+    }
+
+    for (uint16_t frame = 0; frame < frames; frame++)
+    {
+        // Temperature changes slowly, the polynomial is only evaluated when it changes
+        if (frame == 0 || fifoData[frame].temperature != lastTemperature)
+        {
+            lastTemperature = fifoData[frame].temperature;
+            iam20680hpTempCompBias(model, lastTemperature, gyroBias);
+        }
+
+        int16_t *gyro[3] = {&fifoData[frame].gyroData.xGyro, &fifoData[frame].gyroData.yGyro, &fifoData[frame].gyroData.zGyro};
+        for (uint8_t axis = 0; axis < 3; axis++)
+        {
+            int32_t value = *gyro[axis] - ((gyroBias[axis] + 128) >> 8);
+            if (value > INT16_MAX)
+            {
+                value = INT16_MAX;
+            }
+            if (value < INT16_MIN)
+            {
+                value = INT16_MIN;
+            }
+            *gyro[axis] = (int16_t)value;
+        }
+    }
+}
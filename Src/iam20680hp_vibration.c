@@ -0,0 +1,444 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Vibration analysis on the accelerometer FiFo stream, see iam20680hp_vibration.h.
+
+*/
+
+#include "iam20680hp_vibration.h"
+#include "math.h"
+
+#define IAM20680HP_VIBRATION_PI 3.14159265f
+
+_Static_assert((IAM20680HP_VIBRATION_FFT_SIZE & (IAM20680HP_VIBRATION_FFT_SIZE - 1)) == 0, "FFT size must be a power of 2");
+
+IAM20680HP_err_t iam20680hpVibrationInit(IAM20680HP_vibration_t *vibration, uint16_t sampleRate, uint8_t decimation, uint16_t averages,
+                                         IAM20680HP_vibrationOutput_t output, void *context)
+{
+    if (sampleRate == 0 || decimation == 0 || averages == 0 || output == NULL)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    // The saved configuration is kept, iam20680hpVibrationStart() calls this after saving
+    memset(vibration->samples, 0, sizeof(vibration->samples));
+    memset(vibration->power, 0, sizeof(vibration->power));
+    for (uint16_t i = 0; i < IAM20680HP_VIBRATION_FFT_SIZE; i++)
+    {
+        vibration->window[i] = 0.5f - 0.5f * cosf(2.0f * IAM20680HP_VIBRATION_PI * i / IAM20680HP_VIBRATION_FFT_SIZE);
+    }
+    for (uint16_t i = 0; i < IAM20680HP_VIBRATION_FFT_SIZE / 2; i++)
+    {
+        vibration->cosine[i] = cosf(2.0f * IAM20680HP_VIBRATION_PI * i / IAM20680HP_VIBRATION_FFT_SIZE);
+        vibration->sine[i] = -sinf(2.0f * IAM20680HP_VIBRATION_PI * i / IAM20680HP_VIBRATION_FFT_SIZE);
+    }
+
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+        vibration->sum[axis] = 0;
+        vibration->sumSquares[axis] = 0;
+        vibration->minimum[axis] = INT16_MAX;
+        vibration->maximum[axis] = INT16_MIN;
+    }
+    vibration->count = 0;
+    vibration->lostSamples = 0;
+    vibration->fill = 0;
+    vibration->windows = 0;
+    vibration->averages = averages;
+    vibration->sampleRate = sampleRate;
+    vibration->decimation = decimation;
+    vibration->phase = 0;
+    vibration->output = output;
+    vibration->context = context;
+    return IAM20680HP_OK;
+}
+
+/*
+ * In place radix-2 FFT of real / imaginary
+ */
+static void iam20680hpVibrationFft(IAM20680HP_vibration_t *vibration)
+{
+    float *re = vibration->real;
+    float *im = vibration->imaginary;
+    const uint16_t n = IAM20680HP_VIBRATION_FFT_SIZE;
+
+    // Bit reversal
+    for (uint16_t i = 1, j = 0; i < n; i++)
+    {
+        uint16_t bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+        {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j)
+        {
+            float t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+
+    for (uint16_t length = 2; length <= n; length <<= 1)
+    {
+        uint16_t half = length >> 1;
+        uint16_t step = n / length;
+        for (uint16_t start = 0; start < n; start += length)
+        {
+            for (uint16_t k = 0; k < half; k++)
+            {
+                float wr = vibration->cosine[k * step];
+                float wi = vibration->sine[k * step];
+                uint16_t a = start + k;
+                uint16_t b = a + half;
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+/*
+ * Spectrum of the full input window per axis (mean removed), added to the power sums
+ */
+static void iam20680hpVibrationWindow(IAM20680HP_vibration_t *vibration)
+{
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+        const int16_t *samples = vibration->samples[axis];
+        int32_t sum = 0;
+        for (uint16_t i = 0; i < IAM20680HP_VIBRATION_FFT_SIZE; i++)
+        {
+            sum += samples[i];
+        }
+        float mean = (float)sum / IAM20680HP_VIBRATION_FFT_SIZE;
+
+        for (uint16_t i = 0; i < IAM20680HP_VIBRATION_FFT_SIZE; i++)
+        {
+            vibration->real[i] = (samples[i] - mean) * vibration->window[i];
+            vibration->imaginary[i] = 0.0f;
+        }
+        iam20680hpVibrationFft(vibration);
+
+        for (uint16_t k = 0; k < IAM20680HP_VIBRATION_FFT_SIZE / 2; k++)
+        {
+            vibration->power[axis][k] += vibration->real[k] * vibration->real[k] + vibration->imaginary[k] * vibration->imaginary[k];
+        }
+    }
+    vibration->windows++;
+}
+
+/*
+ * Feature vector from the sums, then the sums are cleared
+ */
+static void iam20680hpVibrationFeatures(IAM20680HP_vibration_t *vibration)
+{
+    IAM20680HP_vibrationFeatures_t features;
+    const float n = IAM20680HP_VIBRATION_FFT_SIZE;
+    const uint16_t bins = IAM20680HP_VIBRATION_FFT_SIZE / 2;
+
+    memset(&features, 0, sizeof(features));
+    features.sampleRate = vibration->sampleRate;
+    features.windows = vibration->windows;
+    features.lostSamples = vibration->lostSamples;
+
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+        float mean = (float)vibration->sum[axis] / vibration->count;
+        float variance = (float)vibration->sumSquares[axis] / vibration->count - mean * mean;
+        features.rms[axis] = variance > 0.0f ? sqrtf(variance) : 0.0f;
+        features.peak[axis] = fmaxf(vibration->maximum[axis] - mean, mean - vibration->minimum[axis]);
+        features.crestFactor[axis] = features.rms[axis] > 0.0f ? features.peak[axis] / features.rms[axis] : 0.0f;
+
+        const float *power = vibration->power[axis];
+        float scale = 1.0f / vibration->windows;
+
+        // Hann: amplitude = 4 |X| / N, mean square per bin = 16 |X|^2 / (3 N^2)
+        for (uint16_t k = 1; k < bins; k++)
+        {
+            uint8_t band = (uint8_t)((uint32_t)(k - 1) * IAM20680HP_VIBRATION_BANDS / (bins - 1));
+            features.bandRms[axis][band] += power[k] * scale * 16.0f / (3.0f * n * n);
+
+            // Local maximum, sorted into the largest peaks
+            float amplitude = 4.0f * sqrtf(power[k] * scale) / n;
+            if (power[k] < power[k - 1] || (k + 1 < bins && power[k] <= power[k + 1]))
+            {
+                continue;
+            }
+            for (uint8_t p = 0; p < IAM20680HP_VIBRATION_PEAKS; p++)
+            {
+                if (amplitude > features.peakAmplitude[axis][p])
+                {
+                    for (uint8_t q = IAM20680HP_VIBRATION_PEAKS - 1; q > p; q--)
+                    {
+                        features.peakAmplitude[axis][q] = features.peakAmplitude[axis][q - 1];
+                        features.peakFrequency[axis][q] = features.peakFrequency[axis][q - 1];
+                    }
+                    features.peakAmplitude[axis][p] = amplitude;
+                    features.peakFrequency[axis][p] = (float)k * vibration->sampleRate / n;
+                    break;
+                }
+            }
+        }
+        for (uint8_t band = 0; band < IAM20680HP_VIBRATION_BANDS; band++)
+        {
+            features.bandRms[axis][band] = sqrtf(features.bandRms[axis][band]);
+        }
+
+        vibration->sum[axis] = 0;
+        vibration->sumSquares[axis] = 0;
+        vibration->minimum[axis] = INT16_MAX;
+        vibration->maximum[axis] = INT16_MIN;
+    }
+
+    memset(vibration->power, 0, sizeof(vibration->power));
+    vibration->count = 0;
+    vibration->windows = 0;
+    vibration->lostSamples = 0;
+
+    vibration->output(&features, vibration->context);
+}
+
+void iam20680hpVibrationProcess(IAM20680HP_vibration_t *vibration, const IAM20680HP_accelData_t *samples, uint16_t count)
+{
+    for (uint16_t i = 0; i < count; i++)
+    {
+        if (++vibration->phase < vibration->decimation)
+        {
+            continue;
+        }
+        vibration->phase = 0;
+
+        const int16_t value[3] = {samples[i].xAccel, samples[i].yAccel, samples[i].zAccel};
+        for (uint8_t axis = 0; axis < 3; axis++)
+        {
+            vibration->samples[axis][vibration->fill] = value[axis];
+            vibration->sum[axis] += value[axis];
+            vibration->sumSquares[axis] += (int32_t)value[axis] * value[axis];
+            if (value[axis] < vibration->minimum[axis])
+            {
+                vibration->minimum[axis] = value[axis];
+            }
+            if (value[axis] > vibration->maximum[axis])
+            {
+                vibration->maximum[axis] = value[axis];
+            }
+        }
+        vibration->count++;
+
+        if (++vibration->fill < IAM20680HP_VIBRATION_FFT_SIZE)
+        {
+            continue;
+        }
+
+        iam20680hpVibrationWindow(vibration);
+
+        // 50% overlap: the second half is the start of the next window
+        for (uint8_t axis = 0; axis < 3; axis++)
+        {
+            memmove(vibration->samples[axis], &vibration->samples[axis][IAM20680HP_VIBRATION_FFT_SIZE / 2], 
+                    IAM20680HP_VIBRATION_FFT_SIZE / 2 * sizeof(int16_t));
+        }
+        vibration->fill = IAM20680HP_VIBRATION_FFT_SIZE / 2;
+
+        if (vibration->windows >= vibration->averages)
+        {
+            iam20680hpVibrationFeatures(vibration);
+        }
+    }
+}
+
+/*
+ * Writes the settings of the analysis and starts the accelerometer FiFo stream
+ */
+static IAM20680HP_err_t iam20680hpVibrationConfigure(IAM20680HP_vibration_t *vibration, IAM20680HP_vibrationRate_t rate)
+{
+    IAM20680HP_err_t result;
+
+    uint8_t divider = 0;
+    result = iam20680SampleRateDivider(&divider, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    uint8_t dlpf = rate == IAM20680HP_VIBRATION_4KHZ ? 0 : 1;
+    result = iam20680hpConfigDlpfCfg(&dlpf, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    IAM20680HP_gyroConfig_t gyroConfig = vibration->savedGyroConfig;
+    gyroConfig.xGyroSelfTest = 0;
+    gyroConfig.yGyroSelfTest = 0;
+    gyroConfig.zGyroSelfTest = 0;
+    gyroConfig.FChoice = 0;
+    result = iam20680hpGyroConfig(&gyroConfig, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    IAM20680HP_accelConfig_t accelConfig = vibration->savedAccelConfig;
+    accelConfig.xAccelSelfTest = 0;
+    accelConfig.yAccelSelfTest = 0;
+    accelConfig.zAccelSelfTest = 0;
+    accelConfig.FChoice = rate == IAM20680HP_VIBRATION_4KHZ;
+    accelConfig.dlpfCfg = 7;
+    result = iam20680hpAccelConfig(&accelConfig, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    bool enable = true, disable = false;
+    result = iam20680hpFiFoEnable(&disable, &disable, &disable, &disable, &enable, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    IAM20680HP_userControl_t userControl = vibration->savedUserControl;
+    userControl.fifo_en = 1;
+    userControl.fifo_rst = 1;
+    userControl.sig_cond_rst = 0;
+    return iam20680hpUserControl(&userControl, true);
+}
+
+IAM20680HP_err_t iam20680hpVibrationStart(IAM20680HP_vibration_t *vibration, IAM20680HP_vibrationRate_t rate, uint16_t averages,
+                                          IAM20680HP_vibrationOutput_t output, void *context)
+{
+    IAM20680HP_err_t result;
+
+    if (rate > IAM20680HP_VIBRATION_4KHZ)
+    {
+        return IAM20680HP_ERR_INVALID_PARAM;
+    }
+
+    // 4kHz: the FiFo runs at 8kHz (gyro DLPF_CFG 0), every accel sample is stored twice
+    result = iam20680hpVibrationInit(vibration, rate == IAM20680HP_VIBRATION_4KHZ ? 4000 : 1000, 
+                                     rate == IAM20680HP_VIBRATION_4KHZ ? 2 : 1, averages, output, context);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    memset(&vibration->savedAccelConfig, 0, sizeof(vibration->savedAccelConfig));
+    result = iam20680hpAccelConfig(&vibration->savedAccelConfig, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    memset(&vibration->savedGyroConfig, 0, sizeof(vibration->savedGyroConfig));
+    result = iam20680hpGyroConfig(&vibration->savedGyroConfig, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    result = iam20680hpConfigDlpfCfg(&vibration->savedDlpf, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    result = iam20680SampleRateDivider(&vibration->savedDivider, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    bool *fifoEnable = vibration->savedFifoEnable;
+    result = iam20680hpFiFoEnable(&fifoEnable[0], &fifoEnable[1], &fifoEnable[2], &fifoEnable[3], &fifoEnable[4], false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    memset(&vibration->savedUserControl, 0, sizeof(vibration->savedUserControl));
+    result = iam20680hpUserControl(&vibration->savedUserControl, false);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    // A failed write leaves the device with the settings of before
+    result = iam20680hpVibrationConfigure(vibration, rate);
+    if (result != IAM20680HP_OK)
+    {
+        iam20680hpVibrationStop(vibration);
+    }
+    return result;
+}
+
+IAM20680HP_err_t iam20680hpVibrationDrain(IAM20680HP_vibration_t *vibration)
+{
+    IAM20680HP_err_t result;
+    IAM20680HP_accelData_t samples[512 / IAM20680HP_FIFO_ACCEL_FRAME_SIZE];
+    uint16_t samplesRead;
+
+    // Overflow from FIFO_COUNT, not from INT_STATUS: reading INT_STATUS would clear the interrupts of the application. 
+    // A full FiFo or a count that is no multiple of the sample size has lost samples
+    uint16_t fifoCount;
+    result = iam20680hpReadFifoCount(&fifoCount);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    if (fifoCount >= (512 << vibration->savedAccelConfig.fifoSize) || fifoCount % IAM20680HP_FIFO_ACCEL_FRAME_SIZE != 0)
+    {
+        // The window would contain a jump, start a new one
+        vibration->lostSamples += vibration->fill;
+        vibration->fill = 0;
+        vibration->phase = 0;
+        return iam20680hpFifoReset();
+    }
+
+    do
+    {
+        result = iam20680hpReadFifoAccelBlock(samples, sizeof(samples) / sizeof(samples[0]), &samplesRead);
+        if (result != IAM20680HP_OK)
+            return result;
+
+        iam20680hpVibrationProcess(vibration, samples, samplesRead);
+    } while (samplesRead == sizeof(samples) / sizeof(samples[0]));
+
+    return IAM20680HP_OK;
+}
+
+IAM20680HP_err_t iam20680hpVibrationStop(IAM20680HP_vibration_t *vibration)
+{
+    IAM20680HP_err_t result;
+
+    bool *fifoEnable = vibration->savedFifoEnable;
+    result = iam20680hpFiFoEnable(&fifoEnable[0], &fifoEnable[1], &fifoEnable[2], &fifoEnable[3], &fifoEnable[4], true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    result = iam20680SampleRateDivider(&vibration->savedDivider, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    result = iam20680hpConfigDlpfCfg(&vibration->savedDlpf, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    result = iam20680hpGyroConfig(&vibration->savedGyroConfig, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    result = iam20680hpAccelConfig(&vibration->savedAccelConfig, true);
+    if (result != IAM20680HP_OK)
+        return result;
+
+    // FIFO_EN of before, the FiFo is reset
+    IAM20680HP_userControl_t userControl = vibration->savedUserControl;
+    userControl.fifo_rst = 1;
+    userControl.sig_cond_rst = 0;
+    return iam20680hpUserControl(&userControl, true);
+}
@@ -0,0 +1,95 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host benchmark of the attitude estimation: updates per second of the float (Mahony, Madgwick) and fixed-point filters.
+Run with make -C Test bench, on the target use IAM20680HP_FUSION_PROFILE 1 (cycle counter).
+
+*/
+
+#include "iam20680hp_fusion.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#define BLOCK 36
+#define BLOCKS 20000
+#define ODR_HZ 1000
+
+static IAM20680HP_fifoData_t frames[BLOCK];
+
+static double benchSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void benchFloat(const char *name, IAM20680HP_fusionAlgorithm_t algorithm)
+{
+    IAM20680HP_fusion_t fusion;
+
+    iam20680hpFusionInit(&fusion, algorithm, 0, ODR_HZ);
+    double start = benchSeconds();
+    for (uint32_t block = 1; block <= BLOCKS; block++)
+    {
+        iam20680hpFusionUpdate(&fusion, frames, BLOCK, block * BLOCK * (1000000 / ODR_HZ));
+    }
+    double seconds = benchSeconds() - start;
+    printf("%-10s %12.0f updates/s (q0 %f)\n", name, fusion.updates / seconds, fusion.q[0]);
+}
+
+static void benchFixed(void)
+{
+    IAM20680HP_fusionFixed_t fusion;
+
+    iam20680hpFusionFixedInit(&fusion, 0, ODR_HZ);
+    double start = benchSeconds();
+    for (uint32_t block = 1; block <= BLOCKS; block++)
+    {
+        iam20680hpFusionFixedUpdate(&fusion, frames, BLOCK, block * BLOCK * (1000000 / ODR_HZ));
+    }
+    double seconds = benchSeconds() - start;
+    printf("%-10s %12.0f updates/s (q0 %f)\n", "Q30", fusion.updates / seconds, fusion.q[0] / (double)IAM20680HP_FUSION_Q30);
+}
+
+int main(void)
+{
+    // Tilted and turning, so the accel correction runs on every frame
+    uint32_t seed = 1;
+    for (uint16_t i = 0; i < BLOCK; i++)
+    {
+        seed = seed * 1664525 + 1013904223;
+        frames[i].accelData.xAccel = (int16_t)(-4900 + (int32_t)((seed >> 16) % 41) - 20);
+        frames[i].accelData.yAccel = -6500;
+        frames[i].accelData.zAccel = 14100;
+        frames[i].gyroData.xGyro = -790;
+        frames[i].gyroData.yGyro = -1050;
+        frames[i].gyroData.zGyro = 2270;
+    }
+
+    benchFloat("Mahony", IAM20680HP_FUSION_MAHONY);
+    benchFloat("Madgwick", IAM20680HP_FUSION_MADGWICK);
+    benchFixed();
+    return 0;
+}
@@ -0,0 +1,100 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Minimal assertions for the host tests.
+
+*/
+
+#ifndef IAM20680HP_TEST_H_
+#define IAM20680HP_TEST_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int testFailures;
+
+#define TEST_ASSERT(condition)                                                              \
+    do                                                                                      \
+    {                                                                                       \
+        if (!(condition))                                                                   \
+        {                                                                                   \
+            printf("%s:%d: %s\n", __FILE__, __LINE__, #condition);                          \
+            testFailures++;                                                                 \
+        }                                                                                   \
+    } while (0)
+
+#define TEST_EQUAL(expected, actual)                                                        \
+    do                                                                                      \
+    {                                                                                       \
+        long long expectedValue = (long long)(expected);                                    \
+        long long actualValue = (long long)(actual);                                        \
+        if (expectedValue != actualValue)                                                   \
+        {                                                                                   \
+            printf("%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual,       \
+                   actualValue, expectedValue);                                             \
+            testFailures++;                                                                 \
+        }                                                                                   \
+    } while (0)
+
+#define TEST_NEAR(expected, actual, tolerance)                                              \
+    do                                                                                      \
+    {                                                                                       \
+        double expectedValue = (double)(expected);                                          \
+        double actualValue = (double)(actual);                                              \
+        if (actualValue < expectedValue - (tolerance) || actualValue > expectedValue + (tolerance)) \
+        {                                                                                   \
+            printf("%s:%d: %s is %g, expected %g +- %g\n", __FILE__, __LINE__, #actual,     \
+                   actualValue, expectedValue, (double)(tolerance));                        \
+            testFailures++;                                                                 \
+        }                                                                                   \
+    } while (0)
+
+/*
+ * Writes a fixture to a new temporary file, path receives the name (at least 32 bytes). Remove it with unlink().
+ */
+static inline int testWriteFixture(char *path, const void *content, size_t size)
+{
+    strcpy(path, "/tmp/iam20680hp_test_XXXXXX");
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    ssize_t written = write(fd, content, size);
+    close(fd);
+    return written == (ssize_t)size ? 0 : -1;
+}
+
+/*
+ * Exit code of the test program
+ */
+static inline int testResult(const char *name)
+{
+    printf("%s: %s\n", name, testFailures == 0 ? "passed" : "FAILED");
+    return testFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif // IAM20680HP_TEST_H_
@@ -0,0 +1,311 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host test of the shared bus scheduler against a recording transfer function and a simulated clock: priority and deadline
+order, missed deadlines, merged writes and reads, drain reservations (also for driver access) and the lock hook.
+
+*/
+
+#include "test.h"
+#include "iam20680hp_bus.h"
+
+#define RECORDS 32
+
+typedef struct
+{
+    uint8_t address;
+    uint8_t reg;
+    uint16_t size;
+    bool read;
+    uint8_t bytes[8];
+    uint32_t startUs;
+} testRecord_t;
+
+static IAM20680HP_busScheduler_t bus;
+static testRecord_t records[RECORDS];
+static uint8_t recordCount;
+static uint32_t nowUs;
+static uint32_t delays;
+static int lockDepth;
+static uint32_t locks;
+static int doneDepth;
+
+static uint32_t testClockUs(void)
+{
+    return nowUs;
+}
+
+static void testDelayMs(uint32_t ms)
+{
+    delays++;
+    nowUs += ms * 1000;
+}
+
+static void testLock(bool lock)
+{
+    TEST_EQUAL(lock ? 0 : 1, lockDepth);
+    lockDepth += lock ? 1 : -1;
+    locks += lock;
+}
+
+/*
+ * Records the transfer, a read returns reg + index, the clock advances by the transfer time
+ */
+static IAM20680HP_err_t testTransfer(uint8_t address, uint8_t reg, uint8_t *buffer, uint16_t size, bool read, uint32_t timeoutMs, 
+                                     void *context)
+{
+    (void)timeoutMs;
+    (void)context;
+    TEST_EQUAL(1, lockDepth);
+    TEST_ASSERT(recordCount < RECORDS);
+
+    testRecord_t *record = &records[recordCount++];
+    record->address = address;
+    record->reg = reg;
+    record->size = size;
+    record->read = read;
+    record->startUs = nowUs;
+    for (uint16_t i = 0; i < size; i++)
+    {
+        if (read)
+        {
+            buffer[i] = (uint8_t)(reg + i);
+        }
+        else if (i < sizeof(record->bytes))
+        {
+            record->bytes[i] = buffer[i];
+        }
+    }
+    nowUs += iam20680hpBusDuration(&bus, size, read);
+    return IAM20680HP_OK;
+}
+
+static void testDone(IAM20680HP_busTransaction_t *transaction, void *context)
+{
+    (void)transaction;
+    doneDepth = lockDepth;
+    (*(uint8_t *)context)++;
+}
+
+static void testInit(void)
+{
+    IAM20680HP_busConfig_t config = {400000, testTransfer, testClockUs, testDelayMs, NULL, testLock};
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpBusInit(&bus, &config));
+    iam20680hpBusAttach(&bus);
+    recordCount = 0;
+    nowUs = 1000;
+    delays = 0;
+    doneDepth = -1;
+}
+
+static void testSubmit(IAM20680HP_busTransaction_t *transaction, uint8_t address, uint8_t reg, uint8_t *buffer, uint16_t size, 
+                       bool read, uint8_t priority)
+{
+    memset(transaction, 0, sizeof(*transaction));
+    transaction->address = address;
+    transaction->reg = reg;
+    transaction->buffer = buffer;
+    transaction->size = size;
+    transaction->read = read;
+    transaction->priority = priority;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpBusSubmit(&bus, transaction));
+}
+
+/*
+ * Priority first, then the earliest deadline (before none), then the order of submission
+ */
+static void testOrder(void)
+{
+    IAM20680HP_busTransaction_t transactions[6];
+    uint8_t buffer[6][2];
+    uint8_t done = 0;
+
+    testInit();
+    testSubmit(&transactions[0], 0x50, 0x00, buffer[0], 2, true, 1);
+    testSubmit(&transactions[1], 0x50, 0x10, buffer[1], 2, true, 3);
+    testSubmit(&transactions[2], 0x50, 0x20, buffer[2], 2, true, 3);
+    transactions[2].hasDeadline = true;
+    transactions[2].deadlineUs = nowUs + 20000;
+    testSubmit(&transactions[3], 0x50, 0x30, buffer[3], 2, true, 3);
+    transactions[3].hasDeadline = true;
+    transactions[3].deadlineUs = nowUs + 10000;
+    testSubmit(&transactions[4], 0x68, IAM20680HP_FIFO_R_W, buffer[4], 2, true, IAM20680HP_BUS_PRIORITY_FIFO);
+    testSubmit(&transactions[5], 0x50, 0x50, buffer[5], 2, true, 3);
+    transactions[5].done = testDone;
+    transactions[5].context = &done;
+
+    TEST_EQUAL(6, iam20680hpBusRun(&bus));
+    static const uint8_t order[] = {IAM20680HP_FIFO_R_W, 0x30, 0x20, 0x10, 0x50, 0x00};
+    TEST_EQUAL(sizeof(order), recordCount);
+    for (uint8_t i = 0; i < sizeof(order) && i < recordCount; i++)
+    {
+        TEST_EQUAL(order[i], records[i].reg);
+    }
+    for (uint8_t i = 0; i < 6; i++)
+    {
+        TEST_ASSERT(transactions[i].finished);
+        TEST_EQUAL(IAM20680HP_OK, transactions[i].result);
+    }
+    TEST_EQUAL(0x21, buffer[2][1]);
+    TEST_EQUAL(1, done);
+    TEST_EQUAL(0, bus.missedDeadlines);
+    TEST_EQUAL(0, bus.count);
+}
+
+/*
+ * A deadline counts as missed when the transfer ends after it
+ */
+static void testDeadline(void)
+{
+    IAM20680HP_busTransaction_t fifo, late, inTime;
+    uint8_t fifoBuffer[240], lateBuffer[2], inTimeBuffer[2];
+
+    testInit();
+    testSubmit(&fifo, 0x68, IAM20680HP_FIFO_R_W, fifoBuffer, sizeof(fifoBuffer), true, IAM20680HP_BUS_PRIORITY_FIFO);
+    testSubmit(&late, 0x50, 0x00, lateBuffer, 2, true, 3);
+    late.hasDeadline = true;
+    late.deadlineUs = nowUs + iam20680hpBusDuration(&bus, sizeof(fifoBuffer), true);
+    testSubmit(&inTime, 0x50, 0x10, inTimeBuffer, 2, true, 3);
+    inTime.hasDeadline = true;
+    inTime.deadlineUs = nowUs + 3 * iam20680hpBusDuration(&bus, sizeof(fifoBuffer), true);
+
+    TEST_EQUAL(3, iam20680hpBusRun(&bus));
+    TEST_EQUAL(1, bus.missedDeadlines);
+    TEST_ASSERT(late.finished && inTime.finished);
+}
+
+/*
+ * Writes that continue at the next register of the same device become one transfer, identical merge reads are done once
+ */
+static void testMerge(void)
+{
+    IAM20680HP_busTransaction_t writes[4], reads[3];
+    uint8_t divider = 0x09, config[2] = {0x01, 0x18}, accel = 0x10, other = 0x77;
+    uint8_t readBuffer[3][4];
+    uint8_t done = 0;
+
+    testInit();
+    testSubmit(&writes[0], 0x68, IAM20680HP_SMPLRT_DIV, &divider, 1, false, IAM20680HP_BUS_PRIORITY_IMU);
+    testSubmit(&writes[1], 0x68, IAM20680HP_ACCEL_CONFIG, &accel, 1, false, IAM20680HP_BUS_PRIORITY_IMU);
+    testSubmit(&writes[2], 0x69, IAM20680HP_CONFIG, &other, 1, false, IAM20680HP_BUS_PRIORITY_IMU);
+    testSubmit(&writes[3], 0x68, IAM20680HP_CONFIG, config, 2, false, IAM20680HP_BUS_PRIORITY_IMU);
+    writes[3].done = testDone;
+    writes[3].context = &done;
+
+    TEST_EQUAL(2, iam20680hpBusRun(&bus));
+    TEST_EQUAL(2, recordCount);
+    TEST_EQUAL(0x68, records[0].address);
+    TEST_EQUAL(IAM20680HP_SMPLRT_DIV, records[0].reg);
+    TEST_EQUAL(4, records[0].size);
+    static const uint8_t burst[] = {0x09, 0x01, 0x18, 0x10};
+    TEST_ASSERT(memcmp(burst, records[0].bytes, sizeof(burst)) == 0);
+    TEST_EQUAL(0x69, records[1].address);
+    TEST_EQUAL(1, records[1].size);
+    TEST_EQUAL(2, bus.merged);
+    TEST_EQUAL(1, done);
+    TEST_EQUAL(0, doneDepth);
+
+    // Reads are only merged with the flag, size and register equal
+    testInit();
+    testSubmit(&reads[0], 0x68, IAM20680HP_ACCEL_XOUT_H, readBuffer[0], 4, true, IAM20680HP_BUS_PRIORITY_IMU);
+    reads[0].flags = IAM20680HP_BUS_MERGE;
+    testSubmit(&reads[1], 0x68, IAM20680HP_ACCEL_XOUT_H, readBuffer[1], 4, true, IAM20680HP_BUS_PRIORITY_IMU);
+    reads[1].flags = IAM20680HP_BUS_MERGE;
+    testSubmit(&reads[2], 0x68, IAM20680HP_ACCEL_XOUT_H, readBuffer[2], 2, true, IAM20680HP_BUS_PRIORITY_IMU);
+    reads[2].flags = IAM20680HP_BUS_MERGE;
+
+    TEST_EQUAL(2, iam20680hpBusRun(&bus));
+    TEST_EQUAL(1, bus.merged);
+    TEST_ASSERT(memcmp(readBuffer[0], readBuffer[1], 4) == 0);
+    TEST_EQUAL(IAM20680HP_ACCEL_XOUT_H + 3, readBuffer[1][3]);
+    TEST_ASSERT(reads[1].finished && reads[2].finished);
+}
+
+/*
+ * Reserves the drain of device 0x68 so that a short transfer from now on would overlap it
+ */
+static void testReserve(void)
+{
+    IAM20680HP_drainScheduler_t drain = {.fifoSize = 512, .fillRate = 12000};
+
+    iam20680hpBusReserveDrain(&bus, 0x68, &drain, nowUs);
+    nowUs = bus.reserveUs - 10;
+}
+
+/*
+ * A reservation holds back lower priority transactions until the drain, driver access of the reserved device still runs, 
+ * driver access of an other device waits for the drain or for the reservation to expire
+ */
+static void testReservation(void)
+{
+    IAM20680HP_busTransaction_t other, drainRead;
+    uint8_t otherBuffer[2], drainBuffer[12];
+    int16_t temperature;
+
+    testInit();
+    testReserve();
+    testSubmit(&other, 0x50, 0x00, otherBuffer, 2, true, 6);
+    TEST_EQUAL(0, iam20680hpBusRun(&bus));
+    TEST_EQUAL(1, bus.heldBack);
+    TEST_ASSERT(!other.finished);
+
+    // Driver access of the reserved device: the drain waits for the driver anyway
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpSelectDevice(0x68));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpReadTemperatureData(&temperature));
+    TEST_EQUAL(1, recordCount);
+    TEST_EQUAL(IAM20680HP_TEMP_OUT_H, records[0].reg);
+    TEST_EQUAL(0, delays);
+    TEST_ASSERT(!other.finished);
+
+    // The drain ends the reservation, then the other device goes
+    testSubmit(&drainRead, 0x68, IAM20680HP_FIFO_R_W, drainBuffer, sizeof(drainBuffer), true, IAM20680HP_BUS_PRIORITY_FIFO);
+    TEST_EQUAL(2, iam20680hpBusRun(&bus));
+    TEST_EQUAL(IAM20680HP_FIFO_R_W, records[1].reg);
+    TEST_EQUAL(0x50, records[2].address);
+    TEST_ASSERT(!bus.reserved);
+
+    // Driver access of the other IMU waits until the reservation expires
+    testInit();
+    testReserve();
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpSelectDevice(0x69));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpReadTemperatureData(&temperature));
+    TEST_EQUAL(1, recordCount);
+    TEST_EQUAL(0x69, records[0].address);
+    TEST_ASSERT(delays > 0);
+    TEST_ASSERT((int32_t)(records[0].startUs - bus.reserveEndUs) > 0);
+    TEST_EQUAL(1, bus.expired);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpSelectDevice(0x68));
+}
+
+int main(void)
+{
+    testOrder();
+    testDeadline();
+    testMerge();
+    testReservation();
+
+    TEST_EQUAL(0, lockDepth);
+    TEST_ASSERT(locks > 0);
+    return testResult("test_bus");
+}
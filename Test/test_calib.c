@@ -0,0 +1,212 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host test of the calibration record: blob round trip, CRC and version checks, offset registers and the Q14 matrix kernel.
+
+*/
+
+#include "test.h"
+#include "iam20680hp_calib.h"
+#include "iam20680hp_replay.h"
+
+static void testRecord(IAM20680HP_calibration_t *calibration)
+{
+    iam20680hpCalibInit(calibration);
+    calibration->gyroOffset.offsetXGyro = -1234;
+    calibration->gyroOffset.offsetYGyro = 56;
+    calibration->gyroOffset.offsetZGyro = INT16_MAX;
+    calibration->accelOffset.offsetXAccel = -2000;
+    calibration->accelOffset.offsetYAccel = 1500;
+    calibration->accelOffset.offsetZAccel = -16384;
+    calibration->accelMatrix[0][1] = -120;
+    calibration->accelMatrix[2][2] = 16500;
+    calibration->gyroMatrix[1][0] = 33;
+    calibration->tempCoefficient[0][0] = -123456;
+    calibration->tempCoefficient[1][2] = INT32_MIN;
+    calibration->tempCoefficient[2][1] = INT32_MAX;
+    calibration->tempReference = 2500;
+    calibration->tempOrder = 2;
+    calibration->tempValid = true;
+}
+
+static void testBlob(void)
+{
+    IAM20680HP_calibration_t calibration, decoded;
+    uint8_t blob[IAM20680HP_CALIB_BLOB_SIZE];
+
+    testRecord(&calibration);
+    iam20680hpCalibSerialize(&calibration, blob);
+    TEST_EQUAL(IAM20680HP_CALIB_VERSION, blob[4]);
+
+    memset(&decoded, 0, sizeof(decoded));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpCalibDeserialize(blob, sizeof(blob), &decoded));
+    TEST_EQUAL(0, memcmp(&calibration.gyroOffset, &decoded.gyroOffset, sizeof(decoded.gyroOffset)));
+    TEST_EQUAL(0, memcmp(&calibration.accelOffset, &decoded.accelOffset, sizeof(decoded.accelOffset)));
+    TEST_EQUAL(0, memcmp(calibration.accelMatrix, decoded.accelMatrix, sizeof(decoded.accelMatrix)));
+    TEST_EQUAL(0, memcmp(calibration.gyroMatrix, decoded.gyroMatrix, sizeof(decoded.gyroMatrix)));
+    TEST_EQUAL(0, memcmp(calibration.tempCoefficient, decoded.tempCoefficient, sizeof(decoded.tempCoefficient)));
+    TEST_EQUAL(2500, decoded.tempReference);
+    TEST_EQUAL(2, decoded.tempOrder);
+    TEST_EQUAL(true, decoded.tempValid);
+
+    // The record is not changed on an error
+    memset(&decoded, 0x5A, sizeof(decoded));
+    TEST_EQUAL(IAM20680HP_ERR_EOL, iam20680hpCalibDeserialize(blob, sizeof(blob) - 1, &decoded));
+
+    // Every single bit error in the payload or the CRC is detected
+    for (uint16_t bit = 5 * 8; bit < IAM20680HP_CALIB_BLOB_SIZE * 8; bit++)
+    {
+        blob[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+        if (iam20680hpCalibDeserialize(blob, sizeof(blob), &decoded) != IAM20680HP_ERR_CRC)
+        {
+            printf("bit %u not detected\n", bit);
+            testFailures++;
+        }
+        blob[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+    }
+    TEST_EQUAL(0x5A, ((uint8_t *)&decoded)[0]);
+
+    // Another version or erased flash is not supported, also with a valid CRC
+    blob[4] = IAM20680HP_CALIB_VERSION + 1;
+    uint16_t crc = iam20680hpCrc16(blob, IAM20680HP_CALIB_BLOB_SIZE - 2);
+    blob[IAM20680HP_CALIB_BLOB_SIZE - 2] = (uint8_t)crc;
+    blob[IAM20680HP_CALIB_BLOB_SIZE - 1] = (uint8_t)(crc >> 8);
+    TEST_EQUAL(IAM20680HP_ERR_NOT_SUPPORTED, iam20680hpCalibDeserialize(blob, sizeof(blob), &decoded));
+    memset(blob, 0xFF, sizeof(blob));
+    TEST_EQUAL(IAM20680HP_ERR_NOT_SUPPORTED, iam20680hpCalibDeserialize(blob, sizeof(blob), &decoded));
+}
+
+/*
+ * Offsets written to and read back from the register shadow of the replay backend
+ */
+static void testOffsets(void)
+{
+    static const uint8_t fifo[IAM20680HP_FIFO_FRAME_SIZE];
+    IAM20680HP_calibration_t calibration, readBack;
+    IAM20680HP_replayStats_t before, after;
+    uint8_t accelRegisters[9] = {IAM20680HP_XA_OFFSET_H, 0x00, 0x01, 0x5A, 0x00, 0x01, 0xA5, 0x00, 0x01};
+    char path[32];
+
+    TEST_EQUAL(0, testWriteFixture(path, fifo, sizeof(fifo)));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpReplayOpen(path, IAM20680HP_REPLAY_RAW_FIFO));
+
+    // Reserved bit 0 of the low registers and the reserved 0x79 and 0x7C set
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpBusTransmit(accelRegisters, sizeof(accelRegisters)));
+
+    // One gyro burst, the accel read (address and burst) and the accel burst
+    testRecord(&calibration);
+    iam20680hpReplayGetStats(&before);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpCalibRestore(&calibration));
+    iam20680hpReplayGetStats(&after);
+    TEST_EQUAL(3, after.transmits - before.transmits);
+    TEST_EQUAL(1, after.receives - before.receives);
+
+    uint8_t address = IAM20680HP_XA_OFFSET_H;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpBusTransmit(&address, 1));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpBusReceive(&accelRegisters[1], 8));
+    TEST_EQUAL(0x01, accelRegisters[2] & 0x01);
+    TEST_EQUAL(0x5A, accelRegisters[3]);
+    TEST_EQUAL(0x01, accelRegisters[5] & 0x01);
+    TEST_EQUAL(0xA5, accelRegisters[6]);
+    TEST_EQUAL(0x01, accelRegisters[8] & 0x01);
+
+    iam20680hpCalibInit(&readBack);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpCalibReadOffsets(&readBack));
+    TEST_EQUAL(0, memcmp(&calibration.gyroOffset, &readBack.gyroOffset, sizeof(readBack.gyroOffset)));
+    TEST_EQUAL(0, memcmp(&calibration.accelOffset, &readBack.accelOffset, sizeof(readBack.accelOffset)));
+
+    iam20680hpReplayClose();
+    unlink(path);
+}
+
+static void testMatrixKernel(void)
+{
+    int16_t matrix[3][3] = {{IAM20680HP_CALIB_MATRIX_ONE, 0, 0}, {0, IAM20680HP_CALIB_MATRIX_ONE, 0}, {0, 0, IAM20680HP_CALIB_MATRIX_ONE}};
+    int16_t x[4] = {100, -100, INT16_MAX, INT16_MIN};
+    int16_t y[4] = {0, 1, 2, 3};
+    int16_t z[4] = {-5, 5, 0, 0};
+
+    // Identity
+    iam20680hpCalibMatrixKernel(matrix, x, y, z, 4);
+    TEST_EQUAL(100, x[0]);
+    TEST_EQUAL(INT16_MIN, x[3]);
+    TEST_EQUAL(3, y[3]);
+    TEST_EQUAL(5, z[1]);
+
+    // Scale 1.5 with rounding and saturation, cross-axis term of 0.5
+    matrix[0][0] = IAM20680HP_CALIB_MATRIX_ONE * 3 / 2;
+    matrix[1][0] = IAM20680HP_CALIB_MATRIX_ONE / 2;
+    iam20680hpCalibMatrixKernel(matrix, x, y, z, 4);
+    TEST_EQUAL(150, x[0]);
+    TEST_EQUAL(-150, x[1]);
+    TEST_EQUAL(INT16_MAX, x[2]);
+    TEST_EQUAL(INT16_MIN, x[3]);
+    TEST_EQUAL(50, y[0]);
+    TEST_EQUAL(-49, y[1]);
+    TEST_EQUAL(16386, y[2]);
+    TEST_EQUAL(-5, z[0]);
+}
+
+/*
+ * A singular fit keeps the previous polynomial and order
+ */
+static void testTempCompFit(void)
+{
+    IAM20680HP_tempComp_t model;
+    const int32_t bias[3] = {160, 0, -160};
+    int32_t coefficient[3][3];
+
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpTempCompInit(&model, 2, 2500));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpTempCompAddBias(&model, 2500, bias));
+    TEST_EQUAL(true, model.valid);
+    TEST_EQUAL(0, model.order);
+    TEST_EQUAL(2560, model.coefficient[0][0]);
+    memcpy(coefficient, model.coefficient, sizeof(coefficient));
+
+    // Second bin at the reference temperature as well: zero pivot for the first order term
+    model.bins[14].temperature = 2500;
+    model.bins[14].count = 1;
+    memcpy(model.bins[14].bias, bias, sizeof(bias));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpTempCompAddBias(&model, 2500, bias));
+    TEST_EQUAL(true, model.valid);
+    TEST_EQUAL(0, model.order);
+    TEST_EQUAL(0, memcmp(coefficient, model.coefficient, sizeof(coefficient)));
+
+    // 10 LSB more at 35C: 1 LSB per celcius
+    const int32_t warmBias[3] = {320, 0, -320};
+    model.bins[14].count = 0;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpTempCompAddBias(&model, 3500, warmBias));
+    TEST_EQUAL(1, model.order);
+    TEST_EQUAL(2560, model.coefficient[0][0]);
+    TEST_EQUAL(10486, model.coefficient[0][1]);
+}
+
+int main(void)
+{
+    testBlob();
+    testOffsets();
+    testMatrixKernel();
+    testTempCompFit();
+    return testResult("test_calib");
+}
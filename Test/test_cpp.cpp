@@ -0,0 +1,245 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host test of the C++ layer: the bus traffic and the decoded data equal those of the C functions, without allocations.
+
+*/
+
+#include "test.h"
+#include "iam20680hp.hpp"
+
+#include <array>
+#include <cstdlib>
+#include <new>
+
+#define MAX_RECORDS 64
+#define RECORD_BYTES 24
+
+using namespace iam20680hp;
+
+/*
+ * Recording bus backend: a register file, FIFO_R_W serves a byte pattern of fifoCount bytes. Every transaction is 
+ * recorded with its first RECORD_BYTES bytes (writes) or its size (reads and delays).
+ */
+struct Record
+{
+    char type;
+    uint16_t size;
+    uint8_t bytes[RECORD_BYTES];
+};
+
+static uint8_t registers[128];
+static uint8_t selected;
+static uint16_t fifoCount;
+static uint16_t fifoPosition;
+static Record records[MAX_RECORDS];
+static uint16_t recordCount;
+static int allocations;
+
+static void testRecord(char type, const uint8_t *buffer, uint16_t size)
+{
+    if (recordCount >= MAX_RECORDS)
+    {
+        testFailures++;
+        return;
+    }
+    Record &record = records[recordCount++];
+    memset(&record, 0, sizeof(record));
+    record.type = type;
+    record.size = size;
+    if (buffer != NULL)
+    {
+        memcpy(record.bytes, buffer, size < RECORD_BYTES ? size : RECORD_BYTES);
+    }
+}
+
+extern "C" IAM20680HP_err_t iam20680hpBusTransmit(uint8_t *buffer, uint16_t size)
+{
+    testRecord('W', buffer, size);
+    selected = buffer[0] & 0x7F;
+    for (uint16_t i = 1; i < size; i++)
+    {
+        registers[(selected + i - 1) & 0x7F] = buffer[i];
+    }
+    return IAM20680HP_OK;
+}
+
+extern "C" IAM20680HP_err_t iam20680hpBusReceive(uint8_t *buffer, uint16_t size)
+{
+    testRecord('R', NULL, size);
+    registers[IAM20680HP_WHO_AM_I] = IAM20680HP_DEVICE_ID;
+    registers[IAM20680HP_FIFO_COUNTH] = static_cast<uint8_t>(fifoCount >> 8);
+    registers[IAM20680HP_FIFO_COUNTL] = static_cast<uint8_t>(fifoCount);
+    for (uint16_t i = 0; i < size; i++)
+    {
+        buffer[i] = selected == IAM20680HP_FIFO_R_W ? static_cast<uint8_t>(fifoPosition++ * 37 + 11) : registers[(selected + i) & 0x7F];
+    }
+    return IAM20680HP_OK;
+}
+
+extern "C" void iam20680hpBusDelay(uint32_t ms)
+{
+    testRecord('D', NULL, static_cast<uint16_t>(ms));
+}
+
+void *operator new(size_t size)
+{
+    allocations++;
+    void *pointer = std::malloc(size);
+    if (pointer == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+
+/*
+ * Starts a recording with a fresh FIFO of count bytes
+ */
+static void testStart(uint16_t count)
+{
+    recordCount = 0;
+    fifoCount = count;
+    fifoPosition = 0;
+}
+
+/*
+ * The recording since testStart(), to compare with the next one
+ */
+static uint16_t testTake(Record *copy)
+{
+    memcpy(copy, records, sizeof(records));
+    return recordCount;
+}
+
+static bool testSameTraffic(const Record *c, uint16_t cCount, const Record *cpp, uint16_t cppCount)
+{
+    return cCount > 0 && cCount == cppCount && memcmp(c, cpp, cCount * sizeof(Record)) == 0;
+}
+
+static void testTraffic(void)
+{
+    static Record cRecords[MAX_RECORDS];
+    uint16_t cCount;
+    BusTransport transport;
+    Iam20680hp<BusTransport> imu(transport);
+    int before;
+
+    // Init: reset, WHO_AM_I and the configuration burst (the C driver checks the ID on the first init)
+    memset(registers, 0, sizeof(registers));
+    testStart(0);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpInit());
+    cCount = testTake(cRecords);
+    std::array<uint8_t, 128> cRegisters;
+    memcpy(cRegisters.data(), registers, sizeof(registers));
+    memset(registers, 0, sizeof(registers));
+    testStart(0);
+    before = allocations;
+    TEST_EQUAL(IAM20680HP_OK, imu.init());
+    TEST_EQUAL(0, allocations - before);
+    TEST_ASSERT(testSameTraffic(cRecords, cCount, records, recordCount));
+    TEST_EQUAL(0, memcmp(cRegisters.data(), registers, sizeof(registers)));
+
+    // Field read-modify-write
+    uint8_t dlpf = 3;
+    testStart(0);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpConfigDlpfCfg(&dlpf, true));
+    cCount = testTake(cRecords);
+    testStart(0);
+    before = allocations;
+    TEST_EQUAL(IAM20680HP_OK, imu.set<reg::Config::DlpfCfg>(3));
+    TEST_EQUAL(0, allocations - before);
+    TEST_ASSERT(testSameTraffic(cRecords, cCount, records, recordCount));
+    TEST_EQUAL(3, registers[IAM20680HP_CONFIG] & 0x07);
+
+    // A value outside the field is rejected without bus traffic
+    testStart(0);
+    TEST_EQUAL(IAM20680HP_ERR_INVALID_PARAM, imu.set<reg::GyroConfig::FsSel>(4));
+    TEST_EQUAL(0, recordCount);
+    uint8_t fsSel = 0;
+    TEST_EQUAL(IAM20680HP_OK, imu.set<reg::GyroConfig::FsSel>(2));
+    TEST_EQUAL(IAM20680HP_OK, imu.get<reg::GyroConfig::FsSel>(fsSel));
+    TEST_EQUAL(2, fsSel);
+}
+
+static void testFifo(void)
+{
+    static Record cRecords[MAX_RECORDS];
+    uint16_t cCount;
+    BusTransport transport;
+    Iam20680hp<BusTransport> imu(transport);
+    int before;
+
+    // 25 frames and a partial one, read into a buffer of 20 frames
+    IAM20680HP_fifoData_t cFrames[20];
+    std::array<IAM20680HP_fifoData_t, 20> cppFrames;
+    uint16_t cRead, cppRead;
+    testStart(25 * IAM20680HP_FIFO_FRAME_SIZE + 3);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpReadFifoBlock(cFrames, 20, &cRead));
+    cCount = testTake(cRecords);
+    testStart(25 * IAM20680HP_FIFO_FRAME_SIZE + 3);
+    before = allocations;
+    TEST_EQUAL(IAM20680HP_OK, imu.readFifo(cppFrames, cppRead));
+    TEST_EQUAL(0, allocations - before);
+    TEST_ASSERT(testSameTraffic(cRecords, cCount, records, recordCount));
+    TEST_EQUAL(20, cRead);
+    TEST_EQUAL(cRead, cppRead);
+    TEST_EQUAL(0, memcmp(cFrames, cppFrames.data(), sizeof(cFrames)));
+
+    // Accelerometer only FIFO: 5 frames and a partial one
+    IAM20680HP_accelData_t cSamples[10], cppSamples[10];
+    testStart(5 * IAM20680HP_FIFO_ACCEL_FRAME_SIZE + 1);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpReadFifoAccelBlock(cSamples, 10, &cRead));
+    cCount = testTake(cRecords);
+    testStart(5 * IAM20680HP_FIFO_ACCEL_FRAME_SIZE + 1);
+    before = allocations;
+    TEST_EQUAL(IAM20680HP_OK, imu.readFifoAccel(cppSamples, cppRead));
+    TEST_EQUAL(0, allocations - before);
+    TEST_ASSERT(testSameTraffic(cRecords, cCount, records, recordCount));
+    TEST_EQUAL(5, cppRead);
+    TEST_EQUAL(0, memcmp(cSamples, cppSamples, 5 * sizeof(cSamples[0])));
+
+    // An empty FIFO reads only the count
+    testStart(0);
+    TEST_EQUAL(IAM20680HP_OK, imu.readFifo(cppFrames, cppRead));
+    TEST_EQUAL(0, cppRead);
+    TEST_EQUAL(2, recordCount);
+}
+
+int main(void)
+{
+    testTraffic();
+    testFifo();
+    return testResult("test_cpp");
+}
@@ -0,0 +1,126 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+Host test of the adaptive FiFo drain scheduler: the learned fill rate with drains truncated by the buffer size, the back-off 
+after an empty drain, the tightening near an overflow and the bytes taken out by a drain with a gap marker.
+
+*/
+
+#include "test.h"
+#include "iam20680hp_replay.h"
+
+static void testInit(void)
+{
+    IAM20680HP_drainScheduler_t scheduler;
+
+    // 1kHz, 512 byte FiFo drained at half: 256 bytes, first interval halfway
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpDrainSchedulerInit(&scheduler, 1000, IAM20680HP_FIFO_FRAME_SIZE, 512, 50));
+    TEST_EQUAL(256, scheduler.targetBytes);
+    TEST_EQUAL(14000, scheduler.fillRate);
+    TEST_EQUAL(9, scheduler.intervalMs);
+
+    TEST_EQUAL(IAM20680HP_ERR_INVALID_PARAM, iam20680hpDrainSchedulerInit(&scheduler, 0, IAM20680HP_FIFO_FRAME_SIZE, 512, 50));
+    TEST_EQUAL(IAM20680HP_ERR_INVALID_PARAM, iam20680hpDrainSchedulerInit(&scheduler, 1000, IAM20680HP_FIFO_FRAME_SIZE, 512, 0));
+    TEST_EQUAL(IAM20680HP_ERR_INVALID_PARAM, iam20680hpDrainSchedulerInit(&scheduler, 1000, IAM20680HP_FIFO_FRAME_SIZE, 512, 
+                                                                          IAM20680HP_DRAIN_NEAR_OVERFLOW + 1));
+}
+
+static void testTruncatedDrains(void)
+{
+    IAM20680HP_drainScheduler_t scheduler;
+    uint32_t fifoBytes = 0;
+
+    // 10 frames per 10ms, the buffer takes 4: the FiFo fills up, the learned rate stays at the 14000 bytes per second
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpDrainSchedulerInit(&scheduler, 1000, IAM20680HP_FIFO_FRAME_SIZE, 512, 50));
+    for (uint8_t drain = 0; drain < 5; drain++)
+    {
+        fifoBytes += 10 * IAM20680HP_FIFO_FRAME_SIZE;
+        uint32_t readBytes = 4 * IAM20680HP_FIFO_FRAME_SIZE;
+        iam20680hpDrainSchedulerUpdate(&scheduler, fifoBytes, readBytes, 10);
+        fifoBytes -= readBytes;
+        TEST_EQUAL(14000, scheduler.fillRate);
+        TEST_EQUAL(fifoBytes, scheduler.remainingBytes);
+    }
+    TEST_EQUAL(5, scheduler.drains);
+    TEST_EQUAL(0, scheduler.emptyDrains);
+}
+
+static void testBackOff(void)
+{
+    IAM20680HP_drainScheduler_t scheduler;
+
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpDrainSchedulerInit(&scheduler, 1000, IAM20680HP_FIFO_FRAME_SIZE, 512, 50));
+
+    // Empty: twice the interval, the learned rate is kept
+    TEST_EQUAL(18, iam20680hpDrainSchedulerUpdate(&scheduler, 0, 0, 9));
+    TEST_EQUAL(36, iam20680hpDrainSchedulerUpdate(&scheduler, 0, 0, 18));
+    TEST_EQUAL(2, scheduler.emptyDrains);
+    TEST_EQUAL(14000, scheduler.fillRate);
+
+    // 36ms at 14000 bytes per second is 504 bytes, near overflow: at most half the previous interval
+    TEST_EQUAL(18, iam20680hpDrainSchedulerUpdate(&scheduler, 504, 504, 36));
+    TEST_EQUAL(1, scheduler.nearOverflows);
+
+    // The limits
+    for (uint8_t drain = 0; drain < 10; drain++)
+    {
+        iam20680hpDrainSchedulerUpdate(&scheduler, 0, 0, 0);
+    }
+    TEST_EQUAL(IAM20680HP_DRAIN_MAX_INTERVAL, scheduler.intervalMs);
+    for (uint8_t drain = 0; drain < 12; drain++)
+    {
+        iam20680hpDrainSchedulerUpdate(&scheduler, 512, 512, 1);
+    }
+    TEST_EQUAL(IAM20680HP_DRAIN_MIN_INTERVAL, scheduler.intervalMs);
+}
+
+static void testGap(void)
+{
+    IAM20680HP_drainScheduler_t scheduler;
+    IAM20680HP_fifoGap_t gap;
+
+    // 10 frames and the discarded 4 bytes of a partial frame are out of the FiFo, 2 frames are left
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpDrainSchedulerInit(&scheduler, 1000, IAM20680HP_FIFO_FRAME_SIZE, 512, 50));
+    memset(&gap, 0, sizeof(gap));
+    gap.fifoBytes = 12 * IAM20680HP_FIFO_FRAME_SIZE + 4;
+    gap.misaligned = true;
+    iam20680hpDrainSchedulerUpdateWithGap(&scheduler, &gap, 10, 12);
+    TEST_EQUAL(2 * IAM20680HP_FIFO_FRAME_SIZE, scheduler.remainingBytes);
+
+    // The 2 frames left are not counted again: 140 new bytes in 10ms
+    gap.fifoBytes = 12 * IAM20680HP_FIFO_FRAME_SIZE;
+    gap.misaligned = false;
+    uint32_t fillRate = scheduler.fillRate;
+    iam20680hpDrainSchedulerUpdateWithGap(&scheduler, &gap, 12, 10);
+    TEST_EQUAL((fillRate * 3 + 14000) / 4, scheduler.fillRate);
+    TEST_EQUAL(0, scheduler.remainingBytes);
+}
+
+int main(void)
+{
+    testInit();
+    testTruncatedDrains();
+    testBackOff();
+    testGap();
+    return testResult("test_drain");
+}
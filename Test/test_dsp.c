@@ -0,0 +1,194 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host test of the decimating filter: FIR outputs and decimation phase against a reference, the same output for any block
+split, and the biquad error against a double reference. Built twice, the second time with the SIMD FIR (IAM20680HP_DSP_SIMD).
+
+*/
+
+#include "test.h"
+#include "iam20680hp_dsp.h"
+
+#include <math.h>
+
+#define SAMPLES 4800
+
+static int16_t input[SAMPLES];
+
+/*
+ * Sine of 0.01 cycles per sample plus uniform noise (fixed seed)
+ */
+static void testSignal(int16_t amplitude, int16_t noise)
+{
+    uint32_t seed = 7;
+    for (uint32_t i = 0; i < SAMPLES; i++)
+    {
+        seed = seed * 1664525 + 1013904223;
+        input[i] = (int16_t)lround(amplitude * sin(2 * M_PI * 0.01 * i) + (int32_t)((seed >> 16) % (2 * noise + 1)) - noise);
+    }
+}
+
+static void testFir(void)
+{
+    IAM20680HP_dsp_t filter;
+    int16_t taps[31];
+    static int16_t x[SAMPLES], y[SAMPLES], z[SAMPLES];
+
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpDspDesignFir(taps, 31, 0.1f));
+    iam20680hpDspInit(&filter);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpDspAddFir(&filter, taps, 31, 4));
+
+    testSignal(12000, 3000);
+    for (uint32_t i = 0; i < SAMPLES; i++)
+    {
+        x[i] = input[i];
+        y[i] = (int16_t)-input[i];
+        z[i] = (int16_t)(input[i] / 2);
+    }
+    TEST_EQUAL(SAMPLES / 4, iam20680hpDspProcess(&filter, x, y, z, SAMPLES));
+
+    // Output k is the convolution at input 4k + 3 (zero history before the first sample), rounded
+    for (uint32_t k = 0; k < SAMPLES / 4; k++)
+    {
+        int64_t sum[3] = {0, 0, 0};
+        for (uint8_t tap = 0; tap < 31 && tap <= 4 * k + 3; tap++)
+        {
+            int16_t sample = input[4 * k + 3 - tap];
+            sum[0] += (int64_t)taps[tap] * sample;
+            sum[1] += (int64_t)taps[tap] * (int16_t)-sample;
+            sum[2] += (int64_t)taps[tap] * (int16_t)(sample / 2);
+        }
+        TEST_EQUAL((sum[0] + 16384) >> 15, x[k]);
+        TEST_EQUAL((sum[1] + 16384) >> 15, y[k]);
+        TEST_EQUAL((sum[2] + 16384) >> 15, z[k]);
+    }
+}
+
+/*
+ * FIR decimating by 4 and a biquad cascade decimating by 3: any split of the input into blocks gives the same output
+ */
+static void testBlocks(void)
+{
+    IAM20680HP_dsp_t whole, split;
+    int16_t taps[32];
+    int32_t biquads[10];
+    static int16_t x[SAMPLES], y[SAMPLES], z[SAMPLES];
+    static int16_t expected[SAMPLES];
+
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpDspDesignFir(taps, 32, 0.0625f));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpDspDesignBiquad(&biquads[0], 0.1f, 0.7071f));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpDspDesignBiquad(&biquads[5], 0.1f, 0.7071f));
+    iam20680hpDspInit(&whole);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpDspAddFir(&whole, taps, 32, 4));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpDspAddBiquad(&whole, biquads, 2, 3));
+    split = whole;
+
+    testSignal(10000, 2000);
+    memcpy(x, input, sizeof(input));
+    memcpy(y, input, sizeof(input));
+    memcpy(z, input, sizeof(input));
+    TEST_EQUAL(SAMPLES / 12, iam20680hpDspProcess(&whole, x, y, z, SAMPLES));
+    memcpy(expected, x, SAMPLES / 12 * sizeof(int16_t));
+
+    uint32_t position = 0, outputs = 0;
+    uint16_t block = 1;
+    while (position < SAMPLES)
+    {
+        uint16_t count = (uint16_t)(SAMPLES - position < block ? SAMPLES - position : block);
+        memcpy(x, &input[position], count * sizeof(int16_t));
+        memcpy(y, &input[position], count * sizeof(int16_t));
+        memcpy(z, &input[position], count * sizeof(int16_t));
+        uint16_t produced = iam20680hpDspProcess(&split, x, y, z, count);
+        for (uint16_t i = 0; i < produced; i++)
+        {
+            TEST_EQUAL(expected[outputs + i], x[i]);
+            TEST_EQUAL(expected[outputs + i], z[i]);
+        }
+        outputs += produced;
+        position += count;
+        block = (uint16_t)(block % 37 + 5);
+    }
+    TEST_EQUAL(SAMPLES / 12, outputs);
+
+    // After a reset the filter starts as new
+    iam20680hpDspReset(&split);
+    memcpy(x, input, 24 * sizeof(int16_t));
+    memcpy(y, input, 24 * sizeof(int16_t));
+    memcpy(z, input, 24 * sizeof(int16_t));
+    TEST_EQUAL(2, iam20680hpDspProcess(&split, x, y, z, 24));
+    TEST_EQUAL(expected[0], x[0]);
+    TEST_EQUAL(expected[1], x[1]);
+}
+
+/*
+ * Low cut-off biquad cascade (poles close to 1) against the same coefficients in double
+ */
+static void testBiquad(void)
+{
+    IAM20680HP_dsp_t filter;
+    int32_t biquads[10];
+    static int16_t x[SAMPLES], y[SAMPLES], z[SAMPLES];
+    double state[2][4] = {{0}};
+    double maxError = 0;
+
+    TEST_EQUAL(IAM20680HP_ERR_INVALID_PARAM, iam20680hpDspDesignBiquad(biquads, 0.5f, 0.7071f));
+    TEST_EQUAL(IAM20680HP_ERR_INVALID_PARAM, iam20680hpDspDesignBiquad(biquads, 0.000001f, 0.7071f));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpDspDesignBiquad(&biquads[0], 0.002f, 0.5412f));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpDspDesignBiquad(&biquads[5], 0.002f, 1.3066f));
+    iam20680hpDspInit(&filter);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpDspAddBiquad(&filter, biquads, 2, 1));
+
+    testSignal(8000, 4000);
+    memcpy(x, input, sizeof(input));
+    memcpy(y, input, sizeof(input));
+    memcpy(z, input, sizeof(input));
+    TEST_EQUAL(SAMPLES, iam20680hpDspProcess(&filter, x, y, z, SAMPLES));
+
+    for (uint32_t i = 0; i < SAMPLES; i++)
+    {
+        double value = input[i];
+        for (uint8_t section = 0; section < 2; section++)
+        {
+            const int32_t *c = &biquads[5 * section];
+            double *s = state[section];
+            double output = (c[0] * value + c[1] * s[0] + c[2] * s[1] - c[3] * s[2] - c[4] * s[3]) / 1073741824.0;
+            s[1] = s[0];
+            s[0] = value;
+            s[3] = s[2];
+            s[2] = output;
+            value = output;
+        }
+        double error = fabs(x[i] - value);
+        maxError = error > maxError ? error : maxError;
+    }
+    TEST_NEAR(0, maxError, 0.75);
+}
+
+int main(void)
+{
+    testFir();
+    testBlocks();
+    testBiquad();
+    return testResult(IAM20680HP_DSP_SIMD ? "test_dsp (SIMD)" : "test_dsp");
+}
@@ -0,0 +1,236 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host test of the dual sensor pairing on scripted drains: sensors with the same and with drifting clocks drained at
+jittered times, the fallback to the other sensor when one is saturated and the fault flag.
+
+*/
+
+#include "test.h"
+#include "iam20680hp_dual.h"
+
+#define SAMPLES 4000
+
+typedef struct
+{
+    int16_t indexA;
+    int16_t indexB;
+    uint8_t flags;
+} testOutput_t;
+
+static testOutput_t outputs[SAMPLES];
+static uint16_t outputCount;
+static IAM20680HP_dualSample_t lastSample;
+static uint32_t seed = 1;
+
+static uint32_t testRandom(uint32_t range)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % range;
+}
+
+static void testOutput(const IAM20680HP_dualSample_t *sample, void *context)
+{
+    (void)context;
+    lastSample = *sample;
+    if (outputCount < SAMPLES)
+    {
+        outputs[outputCount].indexA = sample->frame.accelData.xAccel;
+        outputs[outputCount].indexB = sample->frame.accelData.yAccel;
+        outputs[outputCount].flags = sample->flags;
+        outputCount++;
+    }
+}
+
+static void testDual(IAM20680HP_dual_t *dual, uint16_t odrHz)
+{
+    memset(dual, 0, sizeof(*dual));
+    dual->address[0] = 0x68;
+    dual->address[1] = 0x69;
+    dual->odrHz = odrHz;
+    dual->periodUs = 1000000 / odrHz;
+    dual->accelLimit = IAM20680HP_DUAL_ACCEL_LIMIT;
+    dual->gyroLimit = IAM20680HP_DUAL_GYRO_LIMIT;
+    dual->output = testOutput;
+    outputCount = 0;
+}
+
+/*
+ * Drains both sensors in turns at jittered times, the frames of sensor A carry their index in xAccel, those of sensor B in 
+ * yAccel (twice the index, the combined sample is the average)
+ */
+static void testDrains(IAM20680HP_dual_t *dual, const uint32_t periodUs[2])
+{
+    static IAM20680HP_fifoData_t frames[IAM20680HP_DUAL_QUEUE];
+    uint32_t delivered[2] = {0, 0};
+    uint32_t nowUs = 0;
+    uint8_t sensor = 0;
+
+    dual->accelLimit = INT16_MAX;
+    while (delivered[0] < SAMPLES)
+    {
+        nowUs += 5000 + testRandom(3000);
+        uint32_t available = nowUs / periodUs[sensor] + 1;
+        uint16_t count = 0;
+        for (; delivered[sensor] < available && count < IAM20680HP_DUAL_QUEUE; delivered[sensor]++, count++)
+        {
+            memset(&frames[count], 0, sizeof(frames[count]));
+            if (sensor == 0)
+            {
+                frames[count].accelData.xAccel = (int16_t)(delivered[sensor] * 2);
+            }
+            else
+            {
+                frames[count].accelData.yAccel = (int16_t)(delivered[sensor] * 2);
+            }
+        }
+        iam20680hpDualProcess(dual, sensor, frames, count, nowUs);
+        sensor ^= 1;
+    }
+}
+
+/*
+ * Same clocks: the drain times differ by up to a period from the sample times, every sample still pairs with its partner
+ */
+static void testPairing(void)
+{
+    static IAM20680HP_dual_t dual;
+    const uint32_t periodUs[2] = {1000, 1000};
+
+    testDual(&dual, 1000);
+    testDrains(&dual, periodUs);
+
+    TEST_ASSERT(outputCount > SAMPLES - IAM20680HP_DUAL_QUEUE);
+    uint16_t wrong = 0;
+    for (uint16_t i = 0; i < outputCount; i++)
+    {
+        wrong += outputs[i].indexA != outputs[i].indexB || outputs[i].indexA != i;
+    }
+    TEST_EQUAL(0, wrong);
+    TEST_EQUAL(0, dual.unpaired);
+    TEST_EQUAL(0, dual.shift);
+    TEST_EQUAL(0, dual.faults);
+}
+
+/*
+ * Sensor B 0.5% faster: the pairs follow the drift, on average the frames of a pair are close (uniform within 
+ * +-(period / 2 + margin)), near a move of the pairs about a period apart at most
+ */
+static void testDrift(void)
+{
+    static IAM20680HP_dual_t dual;
+    const uint32_t periodUs[2] = {1000, 995};
+
+    testDual(&dual, 1000);
+    testDrains(&dual, periodUs);
+
+    TEST_ASSERT(outputCount > SAMPLES - 2 * IAM20680HP_DUAL_QUEUE);
+    int32_t largestUs = 0;
+    int64_t sumUs = 0;
+    for (uint16_t i = 0; i < outputCount; i++)
+    {
+        int32_t differenceUs = (int32_t)(outputs[i].indexA * periodUs[0]) - (int32_t)(outputs[i].indexB * periodUs[1]);
+        differenceUs = differenceUs < 0 ? -differenceUs : differenceUs;
+        largestUs = differenceUs > largestUs ? differenceUs : largestUs;
+        sumUs += differenceUs;
+    }
+    TEST_ASSERT(largestUs < (int32_t)periodUs[0] * 5 / 4);
+    TEST_ASSERT(sumUs / outputCount < (int32_t)periodUs[0] / 3);
+    TEST_NEAR(SAMPLES * 5 / 1000, dual.shift, 2);
+    TEST_NEAR(dual.shift, dual.unpaired, 2);
+}
+
+/*
+ * Single pairs: a saturated sensor is left out, a difference above the limit is flagged
+ */
+static void testCombine(void)
+{
+    static IAM20680HP_dual_t dual;
+    IAM20680HP_fifoData_t a, b;
+
+    testDual(&dual, 1000);
+    memset(&a, 0, sizeof(a));
+    a.accelData.xAccel = 100;
+    a.accelData.zAccel = 16384;
+    a.gyroData.xGyro = -40;
+    b = a;
+    b.accelData.xAccel = 120;
+    b.gyroData.xGyro = -60;
+
+    iam20680hpDualProcess(&dual, 0, &a, 1, 1000);
+    iam20680hpDualProcess(&dual, 1, &b, 1, 1000);
+    TEST_EQUAL(1, outputCount);
+    TEST_EQUAL(0, lastSample.flags);
+    TEST_EQUAL(110, lastSample.frame.accelData.xAccel);
+    TEST_EQUAL(-50, lastSample.frame.gyroData.xGyro);
+
+    // Accel of A saturated: sensor B
+    a.accelData.yAccel = INT16_MAX;
+    iam20680hpDualProcess(&dual, 0, &a, 1, 2000);
+    iam20680hpDualProcess(&dual, 1, &b, 1, 2000);
+    TEST_EQUAL(IAM20680HP_DUAL_ONLY_B, lastSample.flags);
+    TEST_EQUAL(120, lastSample.frame.accelData.xAccel);
+    TEST_EQUAL(0, lastSample.frame.accelData.yAccel);
+
+    // Gyro of B saturated: sensor A
+    a.accelData.yAccel = 0;
+    b.gyroData.zGyro = INT16_MIN;
+    iam20680hpDualProcess(&dual, 0, &a, 1, 3000);
+    iam20680hpDualProcess(&dual, 1, &b, 1, 3000);
+    TEST_EQUAL(IAM20680HP_DUAL_ONLY_A, lastSample.flags);
+    TEST_EQUAL(100, lastSample.frame.accelData.xAccel);
+    TEST_EQUAL(0, lastSample.frame.gyroData.zGyro);
+
+    // Both saturated: the average
+    a.gyroData.zGyro = INT16_MIN;
+    iam20680hpDualProcess(&dual, 0, &a, 1, 4000);
+    iam20680hpDualProcess(&dual, 1, &b, 1, 4000);
+    TEST_EQUAL(0, lastSample.flags);
+    TEST_EQUAL(INT16_MIN, lastSample.frame.gyroData.zGyro);
+    TEST_EQUAL(0, dual.faults);
+
+    // Gyro at the limit is fine, above it a fault, the temperature does not count
+    a.gyroData.zGyro = 0;
+    b.gyroData.zGyro = IAM20680HP_DUAL_GYRO_LIMIT;
+    a.temperature = -3000;
+    iam20680hpDualProcess(&dual, 0, &a, 1, 5000);
+    iam20680hpDualProcess(&dual, 1, &b, 1, 5000);
+    TEST_EQUAL(0, lastSample.flags);
+    b.gyroData.zGyro = IAM20680HP_DUAL_GYRO_LIMIT + 1;
+    iam20680hpDualProcess(&dual, 0, &a, 1, 6000);
+    iam20680hpDualProcess(&dual, 1, &b, 1, 6000);
+    TEST_EQUAL(IAM20680HP_DUAL_FAULT, lastSample.flags);
+    TEST_EQUAL((IAM20680HP_DUAL_GYRO_LIMIT + 1) / 2, lastSample.frame.gyroData.zGyro);
+    TEST_EQUAL(1, dual.faults);
+    TEST_EQUAL(6, dual.samples);
+    TEST_EQUAL(0, dual.unpaired);
+}
+
+int main(void)
+{
+    testPairing();
+    testDrift();
+    testCombine();
+    return testResult("test_dual");
+}
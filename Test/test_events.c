@@ -0,0 +1,160 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host test of the event detectors: a scripted 6s capture with stillness, taps, a free-fall and a shock.
+
+*/
+
+#include "test.h"
+#include "iam20680hp_events.h"
+
+#define FRAMES 6000                             //6s at 1kHz
+#define BLOCK 50
+#define ONE_G 16384                             //LSB at ACCEL_FS_SEL 0
+
+static IAM20680HP_fifoData_t frames[FRAMES];
+static IAM20680HP_event_t events[16];
+static uint8_t eventCount;
+
+static void testOutput(const IAM20680HP_event_t *event, void *context)
+{
+    (void)context;
+    if (eventCount < 16)
+    {
+        events[eventCount] = *event;
+    }
+    eventCount++;
+}
+
+/*
+ * At rest with 1g on Z and a gyro noise of +-7 LSB (variance 49), +-9 LSB (variance 81) from 5s.
+ * Single tap at 1s, double tap at 2s and 2.1s, free-fall from 3s to 3.1s, shock at 4s.
+ */
+static void testCapture(void)
+{
+    memset(frames, 0, sizeof(frames));
+    for (uint16_t i = 0; i < FRAMES; i++)
+    {
+        int16_t noise = i < 5000 ? 7 : 9;
+        frames[i].accelData.zAccel = ONE_G;
+        frames[i].gyroData.xGyro = (int16_t)(100 + (i % 2 ? noise : -noise));
+        frames[i].gyroData.yGyro = -20;
+    }
+    frames[1000].accelData.zAccel = ONE_G + 8000;
+    frames[2000].accelData.zAccel = ONE_G + 8000;
+    frames[2100].accelData.zAccel = ONE_G + 9000;
+    for (uint16_t i = 3000; i < 3100; i++)
+    {
+        frames[i].accelData.zAccel = 0;
+    }
+    frames[4000].accelData.zAccel = 30000;
+}
+
+static void testEvent(uint8_t index, IAM20680HP_eventType_t type, uint32_t timestampUs, int32_t value)
+{
+    if (index >= eventCount)
+    {
+        printf("event %u missing\n", index);
+        testFailures++;
+        return;
+    }
+    TEST_EQUAL(type, events[index].type);
+    TEST_EQUAL(timestampUs, events[index].timestampUs);
+    TEST_NEAR(value, events[index].value, 1);
+}
+
+static void testDetectors(void)
+{
+    IAM20680HP_eventConfig_t config;
+    IAM20680HP_eventDetector_t detector;
+
+    iam20680hpEventsDefaultConfig(&config);
+    TEST_EQUAL(IAM20680HP_EVENTS_ALL, config.enable);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpEventsInit(&detector, &config, 0, 1000, testOutput, NULL));
+
+    // Blocks of 50 frames, timestamp of the last frame of a block
+    eventCount = 0;
+    for (uint16_t start = 0; start < FRAMES; start += BLOCK)
+    {
+        iam20680hpEventsProcess(&detector, &frames[start], BLOCK, (uint32_t)(start + BLOCK - 1) * 1000);
+    }
+
+    TEST_EQUAL(6, eventCount);
+    testEvent(0, IAM20680HP_EVENT_STILL_START, 0, 49);
+    testEvent(1, IAM20680HP_EVENT_TAP, 1000000, 8000 * 1000 / ONE_G);
+    TEST_EQUAL(2, events[1].axis);
+    testEvent(2, IAM20680HP_EVENT_DOUBLE_TAP, 2000000, 9000 * 1000 / ONE_G);
+    testEvent(3, IAM20680HP_EVENT_FREE_FALL, 3000000, 0);
+    testEvent(4, IAM20680HP_EVENT_SHOCK, 4000000, 30000 * 1000 / ONE_G);
+    testEvent(5, IAM20680HP_EVENT_STILL_END, 5000000, 81);
+    TEST_EQUAL(-1, events[5].axis);
+}
+
+static void testEnable(void)
+{
+    IAM20680HP_eventConfig_t config;
+    IAM20680HP_eventDetector_t detector;
+
+    // Only the shock detector
+    iam20680hpEventsDefaultConfig(&config);
+    config.enable = 1 << IAM20680HP_EVENT_SHOCK;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpEventsInit(&detector, &config, 0, 1000, testOutput, NULL));
+    eventCount = 0;
+    iam20680hpEventsProcess(&detector, frames, FRAMES, (FRAMES - 1) * 1000);
+    TEST_EQUAL(1, eventCount);
+    TEST_EQUAL(IAM20680HP_EVENT_SHOCK, events[0].type);
+
+    // A free-fall shorter than the minimum duration
+    config.enable = 1 << IAM20680HP_EVENT_FREE_FALL;
+    config.freeFallMs = 120;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpEventsInit(&detector, &config, 0, 1000, testOutput, NULL));
+    eventCount = 0;
+    iam20680hpEventsProcess(&detector, frames, FRAMES, (FRAMES - 1) * 1000);
+    TEST_EQUAL(0, eventCount);
+}
+
+static void testStillWindow(void)
+{
+    IAM20680HP_eventConfig_t config;
+    IAM20680HP_eventDetector_t detector;
+
+    // 3s at 32kHz exceeds IAM20680HP_EVENTS_STILL_MAX_FRAMES, without the stillness detector it is not used
+    iam20680hpEventsDefaultConfig(&config);
+    config.stillWindowMs = 3000;
+    TEST_EQUAL(IAM20680HP_ERR_INVALID_PARAM, iam20680hpEventsInit(&detector, &config, 0, 32000, testOutput, NULL));
+    config.enable &= (uint8_t)~((1 << IAM20680HP_EVENT_STILL_START) | (1 << IAM20680HP_EVENT_STILL_END));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpEventsInit(&detector, &config, 0, 32000, testOutput, NULL));
+    config.stillWindowMs = 2000;
+    config.enable = IAM20680HP_EVENTS_ALL;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpEventsInit(&detector, &config, 0, 32000, testOutput, NULL));
+}
+
+int main(void)
+{
+    testCapture();
+    testDetectors();
+    testEnable();
+    testStillWindow();
+    return testResult("test_events");
+}
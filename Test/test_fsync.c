@@ -0,0 +1,298 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host test of the FSYNC tagging: the field of each EXT_SYNC_SET channel and the cleared tag bit, a scripted capture
+through the replay backend (camera events from a host clock, an IMU clock 0.2% slow, a lost tag and a spurious one)
+and the event ring of the ISR (overflow and wrap of the 8 bit head).
+
+*/
+
+#include "test.h"
+#include "math.h"
+#include "iam20680hp_fsync.h"
+#include "iam20680hp_replay.h"
+
+#define FRAMES 1200
+#define BLOCK 50
+#define CAMERA_US 33333
+#define LOST_EVENT 5                            //Event without tag
+#define SPURIOUS_FRAME 717                      //Tag without event
+
+static IAM20680HP_fsyncTag_t tags[64];
+static uint16_t tagCount;
+
+static void testOutput(const IAM20680HP_fsyncTag_t *tag, void *context)
+{
+    (void)context;
+    if (tagCount < 64)
+    {
+        tags[tagCount++] = *tag;
+    }
+}
+
+static uint8_t testRegister(uint8_t reg)
+{
+    uint8_t value = 0;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpBusTransmit(&reg, 1));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpBusReceive(&value, 1));
+    return value;
+}
+
+/*
+ * EXT_SYNC_SET 2 - 4 tag gyro X - Z, 5 - 7 accel X - Z: only that field is tagged and cleared
+ */
+static void testChannels(void)
+{
+    IAM20680HP_fsync_t sync;
+    IAM20680HP_fifoData_t frame;
+
+    TEST_EQUAL(IAM20680HP_ERR_INVALID_PARAM, iam20680hpFsyncStart(&sync, 1, testOutput, NULL));
+    TEST_EQUAL(IAM20680HP_ERR_INVALID_PARAM, iam20680hpFsyncStart(&sync, 8, testOutput, NULL));
+    for (uint8_t channel = 2; channel <= 7; channel++)
+    {
+        TEST_EQUAL(IAM20680HP_OK, iam20680hpFsyncStart(&sync, channel, testOutput, NULL));
+        TEST_EQUAL(channel << 3, testRegister(IAM20680HP_CONFIG) & 0x38);
+
+        int16_t *field[6] = {&frame.gyroData.xGyro, &frame.gyroData.yGyro, &frame.gyroData.zGyro,
+                             &frame.accelData.xAccel, &frame.accelData.yAccel, &frame.accelData.zAccel};
+        frame.temperature = 1;
+        for (uint8_t i = 0; i < 6; i++)
+        {
+            *field[i] = (int16_t)(-101 + 2 * i);
+        }
+
+        tagCount = 0;
+        iam20680hpFsyncProcess(&sync, &frame, 1, 1000);
+        TEST_EQUAL(1, tagCount);
+        for (uint8_t i = 0; i < 6; i++)
+        {
+            TEST_EQUAL(i == channel - 2 ? -102 + 2 * i : -101 + 2 * i, *field[i]);
+        }
+        TEST_EQUAL(1, frame.temperature);
+
+        // The cleared frame has no tag anymore
+        iam20680hpFsyncProcess(&sync, &frame, 1, 2000);
+        TEST_EQUAL(1, tagCount);
+        TEST_EQUAL(2, sync.frames);
+    }
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpFsyncStop(&sync));
+    TEST_EQUAL(0, testRegister(IAM20680HP_CONFIG) & 0x38);
+}
+
+/*
+ * Camera edge k (host clock) and the frame of the first sample at or after it, the IMU samples frame i at i * periodUs
+ */
+static uint32_t testEdgeUs(uint32_t k)
+{
+    return k * CAMERA_US + 500;
+}
+
+static uint32_t testTaggedFrame(uint32_t k, double periodUs)
+{
+    return (uint32_t)ceil(testEdgeUs(k) / periodUs);
+}
+
+/*
+ * Frames with the tag in the LSB of ACCEL_YOUT (EXT_SYNC_SET 6), the other values odd
+ */
+static void testRecord(uint8_t *raw, double periodUs)
+{
+    for (uint32_t i = 0; i < FRAMES; i++)
+    {
+        int16_t value[7] = {-3, 4, 16383, 0, 7, -9, 11};
+        for (uint32_t k = 0; testTaggedFrame(k, periodUs) <= i; k++)
+        {
+            value[1] |= testTaggedFrame(k, periodUs) == i && k != LOST_EVENT;
+        }
+        value[1] |= i == SPURIOUS_FRAME;
+        for (uint8_t j = 0; j < 7; j++)
+        {
+            raw[i * IAM20680HP_FIFO_FRAME_SIZE + 2 * j] = (uint8_t)((uint16_t)value[j] >> 8);
+            raw[i * IAM20680HP_FIFO_FRAME_SIZE + 2 * j + 1] = (uint8_t)value[j];
+        }
+    }
+}
+
+/*
+ * Drains in blocks (up to the frames in the FiFo), the events of the camera ISR up to the drain come first: one event 
+ * without its tag, one tag without an event
+ */
+static void testCapture(double periodUs)
+{
+    IAM20680HP_fsync_t sync;
+    static IAM20680HP_fifoData_t frames[BLOCK];
+    uint16_t framesRead;
+    uint32_t total = 0;
+    uint32_t events = 0;
+
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpInit());
+    IAM20680HP_powerManagement_t powerManagement = {.clockSel = 1};
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerManagement(&powerManagement, true));
+    uint8_t dlpf = 1;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpConfigDlpfCfg(&dlpf, true));
+    uint8_t divider = 0;
+    TEST_EQUAL(IAM20680HP_OK, iam20680SampleRateDivider(&divider, true));
+    bool enable = true;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpFiFoEnable(&enable, &enable, &enable, &enable, &enable, true));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpFsyncStart(&sync, 6, testOutput, NULL));
+    TEST_EQUAL(1000, sync.periodUs);
+
+    tagCount = 0;
+    do
+    {
+        TEST_EQUAL(IAM20680HP_OK, iam20680hpReadFifoBlock(frames, BLOCK, &framesRead));
+        if (framesRead == 0)
+        {
+            break;
+        }
+        uint32_t drainUs = (uint32_t)lround((total + framesRead - 1) * periodUs);
+        while (testEdgeUs(events) <= drainUs)
+        {
+            iam20680hpFsyncEvent(&sync, testEdgeUs(events++));
+        }
+        uint16_t first = tagCount;
+        iam20680hpFsyncProcess(&sync, frames, framesRead, drainUs);
+        for (uint16_t i = first; i < tagCount; i++)
+        {
+            TEST_EQUAL(tags[i].frame - total, tags[i].index);
+        }
+        for (uint16_t i = 0; i < framesRead; i++)
+        {
+            TEST_EQUAL(4, frames[i].accelData.yAccel);
+            TEST_EQUAL(-3, frames[i].accelData.xAccel);
+            TEST_EQUAL(7, frames[i].gyroData.xGyro);
+        }
+        total += framesRead;
+    } while (true);
+
+    TEST_EQUAL(FRAMES, total);
+    TEST_EQUAL(FRAMES, sync.frames);
+    TEST_EQUAL(events, sync.tags);
+    TEST_EQUAL(1, sync.unmatchedTags);
+    TEST_EQUAL(1, sync.missedEvents);
+    TEST_EQUAL(sync.tags, tagCount);
+
+    // Every camera frame gets the IMU frame of its edge
+    uint32_t k = 0;
+    for (uint16_t i = 0; i < tagCount; i++)
+    {
+        if (tags[i].frame == SPURIOUS_FRAME)
+        {
+            TEST_ASSERT(!tags[i].matched);
+            continue;
+        }
+        k += k == LOST_EVENT;
+        TEST_ASSERT(tags[i].matched);
+        TEST_EQUAL(testTaggedFrame(k, periodUs), tags[i].frame);
+        TEST_EQUAL(testEdgeUs(k), tags[i].eventUs);
+        k++;
+    }
+    TEST_EQUAL(events, k);
+
+    // IMU period in the host clock: within a period over the frames between the first and last tag
+    TEST_EQUAL(testTaggedFrame(0, periodUs), sync.firstFrame);
+    TEST_NEAR(periodUs, sync.measuredPeriodUs, periodUs / (sync.lastFrame - sync.firstFrame));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpFsyncStop(&sync));
+}
+
+/*
+ * Ring of the ISR: more than IAM20680HP_FSYNC_EVENTS events and events older than a period are missed, the 8 bit head wraps
+ */
+static void testEvents(void)
+{
+    IAM20680HP_fsync_t sync;
+    IAM20680HP_fifoData_t frame;
+
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpFsyncStart(&sync, 6, testOutput, NULL));
+    memset(&frame, 0, sizeof(frame));
+
+    // Events 0 and 1 overwritten, 2 - 6 too old (more than a period and the tolerance), 7 belongs to the tag
+    tagCount = 0;
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        iam20680hpFsyncEvent(&sync, i * 1000);
+    }
+    frame.accelData.yAccel = 1;
+    iam20680hpFsyncProcess(&sync, &frame, 1, 9500);
+    TEST_ASSERT(tags[0].matched);
+    TEST_EQUAL(7000, tags[0].eventUs);
+    TEST_EQUAL(7, sync.missedEvents);
+
+    // A later tag: 8 and 9 are missed, the tag has no event
+    frame.accelData.yAccel = 1;
+    iam20680hpFsyncProcess(&sync, &frame, 1, 30000);
+    TEST_ASSERT(!tags[1].matched);
+    TEST_EQUAL(9, sync.missedEvents);
+    TEST_EQUAL(1, sync.unmatchedTags);
+
+    // An event after the tag (beyond the tolerance) waits for the next tag
+    iam20680hpFsyncEvent(&sync, 40000);
+    frame.accelData.yAccel = 1;
+    iam20680hpFsyncProcess(&sync, &frame, 1, 37000);
+    TEST_ASSERT(!tags[2].matched);
+    frame.accelData.yAccel = 1;
+    iam20680hpFsyncProcess(&sync, &frame, 1, 40300);
+    TEST_ASSERT(tags[3].matched);
+    TEST_EQUAL(40000, tags[3].eventUs);
+
+    // Within the tolerance of the frame time an event after it still belongs to the tag
+    iam20680hpFsyncEvent(&sync, 50000);
+    frame.accelData.yAccel = 1;
+    iam20680hpFsyncProcess(&sync, &frame, 1, 50000 - IAM20680HP_FSYNC_TOLERANCE_US / 2);
+    TEST_ASSERT(tags[4].matched);
+    TEST_EQUAL(50000, tags[4].eventUs);
+
+    // 300 events one by one: the head wraps, all match
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpFsyncStart(&sync, 6, testOutput, NULL));
+    for (uint32_t i = 0; i < 300; i++)
+    {
+        tagCount = 0;
+        iam20680hpFsyncEvent(&sync, 100000 + i * 5000);
+        frame.accelData.yAccel = 1;
+        iam20680hpFsyncProcess(&sync, &frame, 1, 100000 + i * 5000 + 300);
+        TEST_ASSERT(tagCount == 1 && tags[0].matched);
+    }
+    TEST_EQUAL((uint8_t)300, sync.eventHead);
+    TEST_EQUAL(0, sync.missedEvents);
+    TEST_EQUAL(0, sync.unmatchedTags);
+    TEST_NEAR(5000, sync.measuredPeriodUs, 0.01f);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpFsyncStop(&sync));
+}
+
+int main(void)
+{
+    static uint8_t raw[FRAMES * IAM20680HP_FIFO_FRAME_SIZE];
+    const double periodUs = 1002;
+    char path[32];
+
+    testRecord(raw, periodUs);
+    TEST_EQUAL(0, testWriteFixture(path, raw, sizeof(raw)));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpReplayOpen(path, IAM20680HP_REPLAY_RAW_FIFO));
+    testChannels();
+    testCapture(periodUs);
+    testEvents();
+    iam20680hpReplayClose();
+    unlink(path);
+    return testResult("test_fsync");
+}
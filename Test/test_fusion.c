@@ -0,0 +1,149 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host test of the attitude estimation: the fixed-point Mahony filter against the float filter on a block recording read
+through the replay backend (built with the undefined behaviour sanitizer).
+
+*/
+
+#include "test.h"
+#include "iam20680hp_fusion.h"
+#include "iam20680hp_replay.h"
+
+#include <math.h>
+
+#define FRAMES 4000
+#define ODR_HZ 1000
+
+// Gravity in the sensor frame (x and y negative), the sensor turns around it at 20 dps
+static const double gravity[3] = {-0.3, -0.4, 0.866};
+
+/*
+ * Raw FIFO frames: gravity at 2g full-scale and the rotation at 250 dps full-scale, with deterministic noise
+ */
+static void testRecord(uint8_t *raw)
+{
+    double norm = sqrt(gravity[0] * gravity[0] + gravity[1] * gravity[1] + gravity[2] * gravity[2]);
+    uint32_t seed = 1;
+
+    for (uint32_t i = 0; i < FRAMES; i++)
+    {
+        int16_t value[7];
+        for (uint8_t axis = 0; axis < 3; axis++)
+        {
+            seed = seed * 1664525 + 1013904223;
+            value[axis] = (int16_t)lround(16384 * gravity[axis] / norm + (int32_t)((seed >> 16) % 41) - 20);
+            seed = seed * 1664525 + 1013904223;
+            value[4 + axis] = (int16_t)lround(131 * 20 * gravity[axis] / norm + (int32_t)((seed >> 16) % 7) - 3);
+        }
+        value[3] = 0;
+        for (uint8_t j = 0; j < 7; j++)
+        {
+            raw[i * IAM20680HP_FIFO_FRAME_SIZE + 2 * j] = (uint8_t)((uint16_t)value[j] >> 8);
+            raw[i * IAM20680HP_FIFO_FRAME_SIZE + 2 * j + 1] = (uint8_t)value[j];
+        }
+    }
+}
+
+/*
+ * Estimated gravity of a quaternion, as the filters compute it
+ */
+static void testGravity(const double *q, double *v)
+{
+    v[0] = 2 * (q[1] * q[3] - q[0] * q[2]);
+    v[1] = 2 * (q[0] * q[1] + q[2] * q[3]);
+    v[2] = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+}
+
+static void testFixedAgainstFloat(void)
+{
+    IAM20680HP_fusion_t fusion;
+    IAM20680HP_fusionFixed_t fixed;
+    static IAM20680HP_fifoData_t frames[64];
+    uint16_t framesRead;
+    uint32_t timestampUs = 0;
+    uint32_t total = 0;
+    double maxDifference = 0;
+
+    TEST_EQUAL(IAM20680HP_ERR_INVALID_PARAM, iam20680hpFusionFixedInit(&fixed, 4, ODR_HZ));
+    TEST_EQUAL(IAM20680HP_ERR_INVALID_PARAM, iam20680hpFusionFixedInit(&fixed, 0, 0));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpFusionInit(&fusion, IAM20680HP_FUSION_MAHONY, 0, ODR_HZ));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpFusionFixedInit(&fixed, 0, ODR_HZ));
+
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpInit());
+    bool enable = true;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpFiFoEnable(&enable, &enable, &enable, &enable, &enable, true));
+    do
+    {
+        TEST_EQUAL(IAM20680HP_OK, iam20680hpReadFifoBlock(frames, 64, &framesRead));
+        timestampUs += framesRead * (1000000 / ODR_HZ);
+        iam20680hpFusionUpdate(&fusion, frames, framesRead, timestampUs);
+        iam20680hpFusionFixedUpdate(&fixed, frames, framesRead, timestampUs);
+        total += framesRead;
+
+        for (uint8_t i = 0; i < 4 && total > 0; i++)
+        {
+            double difference = fabs(fixed.q[i] / (double)IAM20680HP_FUSION_Q30 - fusion.q[i]);
+            maxDifference = difference > maxDifference ? difference : maxDifference;
+        }
+    } while (framesRead > 0);
+
+    TEST_EQUAL(FRAMES, total);
+    TEST_EQUAL(FRAMES, fusion.updates);
+    TEST_EQUAL(FRAMES, fixed.updates);
+    TEST_NEAR(0, maxDifference, 2e-3);
+
+    // Both converge to the measured gravity, the fixed-point quaternion stays normalised
+    double qFloat[4], qFixed[4], vFloat[3], vFixed[3];
+    double norm = sqrt(gravity[0] * gravity[0] + gravity[1] * gravity[1] + gravity[2] * gravity[2]);
+    double square = 0;
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        qFloat[i] = fusion.q[i];
+        qFixed[i] = fixed.q[i] / (double)IAM20680HP_FUSION_Q30;
+        square += qFixed[i] * qFixed[i];
+    }
+    TEST_NEAR(1.0, square, 1e-4);
+    testGravity(qFloat, vFloat);
+    testGravity(qFixed, vFixed);
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+        TEST_NEAR(gravity[axis] / norm, vFloat[axis], 0.01);
+        TEST_NEAR(gravity[axis] / norm, vFixed[axis], 0.01);
+    }
+}
+
+int main(void)
+{
+    static uint8_t raw[FRAMES * IAM20680HP_FIFO_FRAME_SIZE];
+    char path[32];
+
+    testRecord(raw);
+    TEST_EQUAL(0, testWriteFixture(path, raw, sizeof(raw)));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpReplayOpen(path, IAM20680HP_REPLAY_RAW_FIFO));
+    testFixedAgainstFloat();
+    iam20680hpReplayClose();
+    unlink(path);
+    return testResult("test_fusion");
+}
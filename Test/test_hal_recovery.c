@@ -0,0 +1,209 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host test of the HAL backend with bus recovery (IAM20680HP_RECOVERY 1) on a simulated I2C bus: timeouts scaled with the transfer size, retries and the deferred re-initialisation.
+
+*/
+
+#include "test.h"
+#include "main.h"
+#include "iam20680hp_recovery.h"
+
+#define BUS_HZ 400000
+
+I2C_HandleTypeDef I2C_HANDLER;
+
+static uint8_t registers[128];
+static uint8_t selected;
+static uint16_t fifoCount;
+static uint8_t failures;
+static uint32_t timeouts;
+
+/*
+ * A transfer fails when its timeout is shorter than its duration at 400kHz (start, address, stop and 9 bit times per byte)
+ */
+static bool testInTime(uint16_t size, uint32_t timeout)
+{
+    uint32_t durationUs = (30 + ((uint32_t)size + 1) * 9) * 1000000UL / BUS_HZ;
+    if (timeout * 1000 < durationUs)
+    {
+        timeouts++;
+        return false;
+    }
+    return true;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c, uint16_t address, uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    (void)hi2c;
+    (void)address;
+    if (failures > 0)
+    {
+        failures--;
+        return HAL_ERROR;
+    }
+    if (!testInTime(size, timeout))
+    {
+        return HAL_TIMEOUT;
+    }
+
+    selected = data[0] & 0x7F;
+    for (uint16_t i = 1; i < size; i++)
+    {
+        registers[(selected + i - 1) & 0x7F] = data[i];
+    }
+    if (size > 1 && selected == IAM20680HP_PWR_MGMT_1 && (data[1] & 0x80))
+    {
+        memset(registers, 0, sizeof(registers));
+        registers[IAM20680HP_PWR_MGMT_1] = 0x41;
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive(I2C_HandleTypeDef *hi2c, uint16_t address, uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    (void)hi2c;
+    (void)address;
+    if (failures > 0)
+    {
+        failures--;
+        return HAL_ERROR;
+    }
+    if (!testInTime(size, timeout))
+    {
+        return HAL_TIMEOUT;
+    }
+
+    registers[IAM20680HP_WHO_AM_I] = IAM20680HP_DEVICE_ID;
+    registers[IAM20680HP_FIFO_COUNTH] = (uint8_t)(fifoCount >> 8);
+    registers[IAM20680HP_FIFO_COUNTL] = (uint8_t)fifoCount;
+    for (uint16_t i = 0; i < size; i++)
+    {
+        data[i] = selected == IAM20680HP_FIFO_R_W ? (uint8_t)i : registers[(selected + i) & 0x7F];
+    }
+    if (selected == IAM20680HP_FIFO_R_W)
+    {
+        fifoCount = (uint16_t)(fifoCount - (size < fifoCount ? size : fifoCount));
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c)
+{
+    (void)hi2c;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c)
+{
+    (void)hi2c;
+    return HAL_OK;
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef *port, GPIO_InitTypeDef *init)
+{
+    (void)port;
+    (void)init;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state)
+{
+    (void)port;
+    (void)pin;
+    (void)state;
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *port, uint16_t pin)
+{
+    (void)port;
+    (void)pin;
+    return GPIO_PIN_SET;
+}
+
+void HAL_Delay(uint32_t ms)
+{
+    (void)ms;
+}
+
+uint32_t HAL_GetTick(void)
+{
+    return 0;
+}
+
+static void testFullDrain(void)
+{
+    IAM20680HP_fifoData_t frames[512 / IAM20680HP_FIFO_FRAME_SIZE];
+    IAM20680HP_recoveryStats_t stats;
+    uint16_t framesRead;
+
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpInit());
+
+    // A full 512 byte FiFo in one burst (11.4ms at 400kHz)
+    fifoCount = 36 * IAM20680HP_FIFO_FRAME_SIZE + 8;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpReadFifoBlock(frames, 36, &framesRead));
+    TEST_EQUAL(36, framesRead);
+    TEST_EQUAL(0, timeouts);
+    iam20680hpRecoveryGetStats(&stats);
+    TEST_EQUAL(0, stats.retries);
+    TEST_EQUAL(0, stats.failures);
+
+    // A glitch is retried
+    fifoCount = 10 * IAM20680HP_FIFO_FRAME_SIZE;
+    failures = 1;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpReadFifoBlock(frames, 36, &framesRead));
+    TEST_EQUAL(10, framesRead);
+    iam20680hpRecoveryGetStats(&stats);
+    TEST_EQUAL(1, stats.retries);
+}
+
+static void testDeferredRestore(void)
+{
+    IAM20680HP_recoveryStats_t stats;
+    uint8_t divider = 9;
+
+    TEST_EQUAL(IAM20680HP_OK, iam20680SampleRateDivider(&divider, true));
+
+    // Power glitch: the device lost its configuration, the transfer fails after all retries
+    memset(registers, 0, sizeof(registers));
+    registers[IAM20680HP_PWR_MGMT_1] = 0x41;
+    failures = IAM20680HP_I2C_RETRIES + 1;
+    TEST_EQUAL(IAM20680HP_ERR_I2C, iam20680SampleRateDivider(&divider, false));
+
+    // The next transfer checks the device first and writes the configuration again
+    uint8_t dlpf;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpConfigDlpfCfg(&dlpf, false));
+    iam20680hpRecoveryGetStats(&stats);
+    TEST_EQUAL(1, stats.failures);
+    TEST_EQUAL(1, stats.checks);
+    TEST_EQUAL(1, stats.restores);
+    TEST_EQUAL(9, registers[IAM20680HP_SMPLRT_DIV]);
+    TEST_EQUAL(0, timeouts);
+}
+
+int main(void)
+{
+    testFullDrain();
+    testDeferredRestore();
+    return testResult("test_hal_recovery");
+}
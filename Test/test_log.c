@@ -0,0 +1,227 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host test of the binary log: header and block round trip, corruption and resynchronisation, compression of a stationary capture.
+
+*/
+
+#include "test.h"
+#include "iam20680hp_log.h"
+#include "iam20680hp_replay.h"
+
+#define FRAMES 2000
+#define DRAIN_FRAMES 64
+
+static uint8_t logFile[FRAMES * IAM20680HP_FIFO_FRAME_SIZE];
+static size_t logSize;
+
+static bool testOutput(void *context, const uint8_t *buffer, size_t size)
+{
+    (void)context;
+    if (logSize + size > sizeof(logFile))
+    {
+        return false;
+    }
+    memcpy(&logFile[logSize], buffer, size);
+    logSize += size;
+    return true;
+}
+
+/*
+ * Noise with a standard deviation of about sigma (sum of 4 uniform values, fixed seed)
+ */
+static int16_t testNoise(uint32_t *seed, int16_t sigma)
+{
+    int32_t sum = 0;
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        *seed = *seed * 1664525 + 1013904223;
+        sum += (int32_t)(*seed >> 16) - 32768;
+    }
+    // Uniform [-32768, 32767] has sigma 18919, the sum of 4 twice that
+    return (int16_t)(sum * sigma / 37838);
+}
+
+static void testHeader(void)
+{
+    IAM20680HP_logHeader_t header, decoded;
+    uint8_t buffer[IAM20680HP_LOG_HEADER_SIZE];
+
+    memset(&header, 0, sizeof(header));
+    header.odrHz = 1000;
+    header.gyroFsSel = 1;
+    header.accelFsSel = 2;
+    header.fifoEnable = 0xF8;
+    header.gyroOffset.offsetXGyro = -12;
+    header.accelOffset.offsetZAccel = 1234;
+    iam20680hpLogEncodeHeader(&header, buffer);
+
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpLogDecodeHeader(buffer, sizeof(buffer), &decoded));
+    TEST_EQUAL(1000, decoded.odrHz);
+    TEST_EQUAL(1, decoded.gyroFsSel);
+    TEST_EQUAL(2, decoded.accelFsSel);
+    TEST_EQUAL(0xF8, decoded.fifoEnable);
+    TEST_EQUAL(-12, decoded.gyroOffset.offsetXGyro);
+    TEST_EQUAL(1234, decoded.accelOffset.offsetZAccel);
+
+    // The return codes before IAM20680HP_ERR_CRC keep their values
+    TEST_EQUAL(11, IAM20680HP_ERR_EOL);
+    TEST_EQUAL(12, IAM20680HP_ERR_CRC);
+
+    TEST_EQUAL(IAM20680HP_ERR_EOL, iam20680hpLogDecodeHeader(buffer, sizeof(buffer) - 1, &decoded));
+    buffer[6] ^= 0x01;
+    TEST_EQUAL(IAM20680HP_ERR_CRC, iam20680hpLogDecodeHeader(buffer, sizeof(buffer), &decoded));
+    buffer[0] = 'X';
+    TEST_EQUAL(IAM20680HP_ERR_NOT_SUPPORTED, iam20680hpLogDecodeHeader(buffer, sizeof(buffer), &decoded));
+}
+
+static void testBlocks(void)
+{
+    static IAM20680HP_fifoData_t frames[IAM20680HP_LOG_MAX_FRAMES + 1], decoded[8];
+    static uint8_t buffer[IAM20680HP_LOG_MAX_BLOCK_SIZE(IAM20680HP_LOG_MAX_FRAMES) + 1];
+    size_t written, consumed;
+    uint16_t count;
+    uint32_t timestamp;
+
+    // Extreme steps between frames (full int16 range)
+    for (uint16_t i = 0; i < 8; i++)
+    {
+        frames[i].accelData.xAccel = i % 2 ? INT16_MAX : INT16_MIN;
+        frames[i].accelData.yAccel = (int16_t)(i * 1000);
+        frames[i].accelData.zAccel = -1;
+        frames[i].temperature = 2500;
+        frames[i].gyroData.xGyro = i % 2 ? INT16_MIN : INT16_MAX;
+        frames[i].gyroData.yGyro = 0;
+        frames[i].gyroData.zGyro = (int16_t)-i;
+    }
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpLogEncodeBlock(frames, 8, 123456, buffer, IAM20680HP_LOG_MAX_BLOCK_SIZE(8), &written));
+    TEST_ASSERT(written <= IAM20680HP_LOG_MAX_BLOCK_SIZE(8));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpLogDecodeBlock(buffer, written, decoded, 8, &count, &timestamp, &consumed));
+    TEST_EQUAL(8, count);
+    TEST_EQUAL(123456, timestamp);
+    TEST_EQUAL(written, consumed);
+    TEST_EQUAL(0, memcmp(frames, decoded, 8 * sizeof(frames[0])));
+
+    // Truncated and corrupted blocks, a decoder resynchronises by skipping a byte
+    TEST_EQUAL(IAM20680HP_ERR_EOL, iam20680hpLogDecodeBlock(buffer, written - 1, decoded, 8, &count, &timestamp, &consumed));
+    TEST_EQUAL(IAM20680HP_ERR_INVALID_PARAM, iam20680hpLogDecodeBlock(buffer, written, decoded, 7, &count, &timestamp, &consumed));
+    buffer[written / 2] ^= 0x10;
+    TEST_EQUAL(IAM20680HP_ERR_CRC, iam20680hpLogDecodeBlock(buffer, written, decoded, 8, &count, &timestamp, &consumed));
+    TEST_EQUAL(IAM20680HP_ERR_NOT_SUPPORTED, iam20680hpLogDecodeBlock(buffer + 1, written - 1, decoded, 8, &count, &timestamp, &consumed));
+
+    // The worst case block fits the uint16 payload length, one frame more is rejected
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpLogEncodeBlock(frames, IAM20680HP_LOG_MAX_FRAMES, 0, buffer, sizeof(buffer), &written));
+    TEST_EQUAL(IAM20680HP_ERR_INVALID_PARAM, iam20680hpLogEncodeBlock(frames, IAM20680HP_LOG_MAX_FRAMES + 1, 0, buffer, sizeof(buffer), &written));
+}
+
+/*
+ * Stationary capture (accel noise 20 LSB, gyro noise 10 LSB at 2g and 250dps, about 1kHz with a 100Hz bandwidth), 
+ * replayed through the FIFO and logged with a drain of up to 64 frames
+ */
+static void testCompression(void)
+{
+    static uint8_t raw[FRAMES * IAM20680HP_FIFO_FRAME_SIZE];
+    static IAM20680HP_fifoData_t expected[FRAMES];
+    static uint8_t blockBuffer[IAM20680HP_LOG_MAX_BLOCK_SIZE(DRAIN_FRAMES)];
+    uint32_t seed = 1;
+    char path[32];
+
+    for (uint16_t i = 0; i < FRAMES; i++)
+    {
+        const int16_t value[7] = {testNoise(&seed, 20), (int16_t)(150 + testNoise(&seed, 20)), (int16_t)(16384 + testNoise(&seed, 20)), 
+                                  (int16_t)(1600 + testNoise(&seed, 2)), testNoise(&seed, 10), (int16_t)(-25 + testNoise(&seed, 10)), 
+                                  (int16_t)(8 + testNoise(&seed, 10))};
+        for (uint8_t j = 0; j < 7; j++)
+        {
+            raw[i * IAM20680HP_FIFO_FRAME_SIZE + 2 * j] = (uint8_t)((uint16_t)value[j] >> 8);
+            raw[i * IAM20680HP_FIFO_FRAME_SIZE + 2 * j + 1] = (uint8_t)value[j];
+        }
+        expected[i].accelData.xAccel = value[0];
+        expected[i].accelData.yAccel = value[1];
+        expected[i].accelData.zAccel = value[2];
+        expected[i].gyroData.xGyro = value[4];
+        expected[i].gyroData.yGyro = value[5];
+        expected[i].gyroData.zGyro = value[6];
+    }
+
+    TEST_EQUAL(0, testWriteFixture(path, raw, sizeof(raw)));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpReplayOpen(path, IAM20680HP_REPLAY_RAW_FIFO));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpInit());
+
+    IAM20680HP_logHeader_t header;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpLogReadHeaderFromDevice(&header));
+    IAM20680HP_logWriter_t writer;
+    logSize = 0;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpLogWriterInit(&writer, &header, testOutput, NULL, blockBuffer, sizeof(blockBuffer)));
+
+    IAM20680HP_fifoData_t frames[DRAIN_FRAMES];
+    uint16_t count;
+    uint32_t drain = 0;
+    do
+    {
+        TEST_EQUAL(IAM20680HP_OK, iam20680hpLogDrainFifo(&writer, frames, DRAIN_FRAMES, drain * 20, &count));
+        drain++;
+    } while (count > 0 && drain < FRAMES);
+    TEST_EQUAL(FRAMES, writer.frames);
+    iam20680hpReplayClose();
+    unlink(path);
+
+    // Read back: every frame as captured
+    IAM20680HP_logHeader_t decodedHeader;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpLogDecodeHeader(logFile, logSize, &decodedHeader));
+    size_t position = IAM20680HP_LOG_HEADER_SIZE;
+    uint16_t frame = 0;
+    while (position < logSize)
+    {
+        size_t consumed;
+        uint32_t timestamp;
+        if (iam20680hpLogDecodeBlock(&logFile[position], logSize - position, frames, DRAIN_FRAMES, &count, &timestamp, &consumed) != IAM20680HP_OK)
+        {
+            TEST_ASSERT(false);
+            break;
+        }
+        for (uint16_t i = 0; i < count && frame < FRAMES; i++, frame++)
+        {
+            TEST_EQUAL(expected[frame].accelData.xAccel, frames[i].accelData.xAccel);
+            TEST_EQUAL(expected[frame].accelData.zAccel, frames[i].accelData.zAccel);
+            TEST_EQUAL(expected[frame].gyroData.yGyro, frames[i].gyroData.yGyro);
+            TEST_EQUAL(expected[frame].gyroData.zGyro, frames[i].gyroData.zGyro);
+        }
+        position += consumed;
+    }
+    TEST_EQUAL(FRAMES, frame);
+
+    // Header and block overhead included
+    double ratio = (double)logSize / sizeof(raw);
+    printf("log of a stationary capture: %zu of %zu bytes (%.1f%% of raw)\n", logSize, sizeof(raw), 100.0 * ratio);
+    TEST_ASSERT(ratio < 0.60);
+}
+
+int main(void)
+{
+    testHeader();
+    testBlocks();
+    testCompression();
+    return testResult("test_log");
+}
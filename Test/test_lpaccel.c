@@ -0,0 +1,180 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host test of the low power accel streaming through the replay backend: the bus transfers of the FiFo drains against polled
+reads of the same samples, and the restored settings after a stop and after a failed start.
+
+*/
+
+#include "test.h"
+#include "iam20680hp_lpaccel.h"
+#include "iam20680hp_replay.h"
+
+#define SAMPLES 2000
+
+static const uint8_t settingRegisters[] = {IAM20680HP_ACCEL_CONFIG2, IAM20680HP_LP_MODE_CFG, IAM20680HP_FIFO_EN,
+                                           IAM20680HP_USER_CTRL, IAM20680HP_PWR_MGMT_1, IAM20680HP_PWR_MGMT_2};
+
+static uint8_t testRegister(uint8_t reg)
+{
+    uint8_t value = 0;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpBusTransmit(&reg, 1));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpBusReceive(&value, 1));
+    return value;
+}
+
+/*
+ * Awake device streaming accel and gyro frames, FIFO_EN in USER_CTRL off
+ */
+static void testConfigure(uint8_t *settings)
+{
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpInit());
+    IAM20680HP_powerManagement_t powerManagement = {.clockSel = 1};
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerManagement(&powerManagement, true));
+    bool enable = true;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpFiFoEnable(&enable, &enable, &enable, &enable, &enable, true));
+
+    for (uint8_t i = 0; i < sizeof(settingRegisters); i++)
+    {
+        settings[i] = testRegister(settingRegisters[i]);
+    }
+}
+
+static void testSettings(const uint8_t *settings)
+{
+    for (uint8_t i = 0; i < sizeof(settingRegisters); i++)
+    {
+        TEST_EQUAL(settings[i], testRegister(settingRegisters[i]));
+    }
+}
+
+static void testStream(void)
+{
+    IAM20680HP_lpAccel_t lpAccel;
+    IAM20680HP_replayStats_t before, after;
+    static IAM20680HP_accelData_t samples[512 / IAM20680HP_FIFO_ACCEL_FRAME_SIZE];
+    uint8_t settings[sizeof(settingRegisters)];
+    uint16_t count;
+    uint32_t nextDrainMs;
+    uint32_t total = 0;
+
+    testConfigure(settings);
+    TEST_EQUAL(IAM20680HP_ERR_INVALID_PARAM, iam20680hpLpAccelStart(&lpAccel, 3, 1, IAM20680HP_LPACCEL_TARGET_FILL));
+    TEST_EQUAL(IAM20680HP_ERR_INVALID_PARAM, iam20680hpLpAccelStart(&lpAccel, 7, 4, IAM20680HP_LPACCEL_TARGET_FILL));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpLpAccelStart(&lpAccel, 7, 1, IAM20680HP_LPACCEL_TARGET_FILL));
+
+    // Accel cycle mode with the gyro off, accel-only FiFo with FIFO_LP_EN
+    TEST_EQUAL(0x20, testRegister(IAM20680HP_PWR_MGMT_1) & 0x60);
+    TEST_EQUAL(0x87, testRegister(IAM20680HP_PWR_MGMT_2) & 0xBF);
+    TEST_EQUAL(0x08, testRegister(IAM20680HP_FIFO_EN));
+    TEST_EQUAL(0x40, testRegister(IAM20680HP_USER_CTRL) & 0x40);
+    TEST_EQUAL(7, testRegister(IAM20680HP_LP_MODE_CFG) & 0x0F);
+
+    // Each drain is one FIFO_COUNT read and one burst, the report counts the bytes of the bus calls
+    iam20680hpReplayGetStats(&before);
+    do
+    {
+        TEST_EQUAL(IAM20680HP_OK, iam20680hpLpAccelDrain(&lpAccel, samples, 85, 2000, &count, &nextDrainMs));
+        for (uint16_t i = 0; i < count; i++, total++)
+        {
+            TEST_EQUAL((int16_t)total, samples[i].xAccel);
+            TEST_EQUAL(-(int16_t)total, samples[i].yAccel);
+        }
+    } while (count > 0);
+    iam20680hpReplayGetStats(&after);
+
+    uint32_t drainTransfers = (after.transmits - before.transmits) + (after.receives - before.receives);
+    TEST_EQUAL(SAMPLES, total);
+    TEST_EQUAL(SAMPLES, lpAccel.report.samples);
+    TEST_EQUAL(0, lpAccel.report.overflows);
+    TEST_EQUAL(after.busBytes - before.busBytes, lpAccel.report.busBytes);
+    TEST_EQUAL(2 * lpAccel.report.wakeups + 2 * (lpAccel.report.wakeups - 1), drainTransfers);
+    TEST_ASSERT(lpAccel.report.samplesPerWakeup > 75);
+
+    // Polled: one ACCEL_XOUT_H read (and MCU wakeup) per sample
+    IAM20680HP_accelData_t accelData;
+    iam20680hpReplayGetStats(&before);
+    for (uint32_t i = 0; i < total; i++)
+    {
+        TEST_EQUAL(IAM20680HP_OK, iam20680hpReadAccelData(&accelData));
+    }
+    iam20680hpReplayGetStats(&after);
+
+    uint32_t polledTransfers = (after.transmits - before.transmits) + (after.receives - before.receives);
+    TEST_EQUAL(2 * SAMPLES, polledTransfers);
+    TEST_EQUAL(7 * SAMPLES, after.busBytes - before.busBytes);
+    TEST_ASSERT(polledTransfers > 40 * drainTransfers);
+    TEST_ASSERT(lpAccel.report.busBytes < 7 * SAMPLES);
+
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpLpAccelStop(&lpAccel));
+    testSettings(settings);
+}
+
+static void testFailedStart(void)
+{
+    IAM20680HP_lpAccel_t lpAccel;
+    uint8_t settings[sizeof(settingRegisters)];
+    IAM20680HP_err_t result;
+    uint32_t transfer = 0;
+
+    // Every bus call of the start fails once in turn: the settings of before are kept
+    do
+    {
+        testConfigure(settings);
+        iam20680hpReplayInjectError(++transfer);
+        result = iam20680hpLpAccelStart(&lpAccel, 7, 1, IAM20680HP_LPACCEL_TARGET_FILL);
+        iam20680hpReplayInjectError(0);
+        if (result != IAM20680HP_OK)
+        {
+            TEST_EQUAL(IAM20680HP_ERR_I2C, result);
+            testSettings(settings);
+        }
+    } while (result != IAM20680HP_OK && transfer < 100);
+    TEST_ASSERT(transfer > 12);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpLpAccelStop(&lpAccel));
+}
+
+int main(void)
+{
+    static uint8_t raw[SAMPLES * IAM20680HP_FIFO_ACCEL_FRAME_SIZE];
+    char path[32];
+
+    // Accel samples (i, -i, 16384)
+    for (uint32_t i = 0; i < SAMPLES; i++)
+    {
+        const int16_t value[3] = {(int16_t)i, (int16_t)-i, 16384};
+        for (uint8_t j = 0; j < 3; j++)
+        {
+            raw[i * IAM20680HP_FIFO_ACCEL_FRAME_SIZE + 2 * j] = (uint8_t)((uint16_t)value[j] >> 8);
+            raw[i * IAM20680HP_FIFO_ACCEL_FRAME_SIZE + 2 * j + 1] = (uint8_t)value[j];
+        }
+    }
+    TEST_EQUAL(0, testWriteFixture(path, raw, sizeof(raw)));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpReplayOpen(path, IAM20680HP_REPLAY_RAW_FIFO));
+    testStream();
+    testFailedStart();
+    iam20680hpReplayClose();
+    unlink(path);
+    return testResult("test_lpaccel");
+}
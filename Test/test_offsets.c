@@ -0,0 +1,158 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host test of the bias calibration through the replay backend: unit conversion to the offset registers, rounding, limits and the reserved bit.
+
+*/
+
+#include "test.h"
+#include "iam20680hp_replay.h"
+
+#define FRAMES 1000
+#define SAMPLES 250
+
+/*
+ * Replays FRAMES constant raw FIFO frames (accel, temperature, gyro) and sets the full-scale of the device
+ */
+static void testOpen(char *path, const int16_t accel[3], const int16_t gyro[3], uint8_t gyroFsSel, uint8_t accelFsSel)
+{
+    static uint8_t raw[FRAMES * IAM20680HP_FIFO_FRAME_SIZE];
+    const int16_t value[7] = {accel[0], accel[1], accel[2], 0, gyro[0], gyro[1], gyro[2]};
+
+    for (uint16_t i = 0; i < FRAMES; i++)
+    {
+        for (uint8_t j = 0; j < 7; j++)
+        {
+            raw[i * IAM20680HP_FIFO_FRAME_SIZE + 2 * j] = (uint8_t)((uint16_t)value[j] >> 8);
+            raw[i * IAM20680HP_FIFO_FRAME_SIZE + 2 * j + 1] = (uint8_t)value[j];
+        }
+    }
+    TEST_EQUAL(0, testWriteFixture(path, raw, sizeof(raw)));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpReplayOpen(path, IAM20680HP_REPLAY_RAW_FIFO));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpInit());
+
+    IAM20680HP_gyroConfig_t gyroConfig;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpGyroConfig(&gyroConfig, false));
+    gyroConfig.FS_Sel = gyroFsSel;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpGyroConfig(&gyroConfig, true));
+
+    IAM20680HP_accelConfig_t accelConfig;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpAccelConfig(&accelConfig, false));
+    accelConfig.AFS_Sel = accelFsSel;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpAccelConfig(&accelConfig, true));
+}
+
+static void testClose(const char *path)
+{
+    iam20680hpReplayClose();
+    unlink(path);
+}
+
+/*
+ * Gyro offset: 1 LSB = 4 / 2^FS_SEL output LSB, accel offset: 1 LSB = 2^AFS_SEL / 16 output LSB, rounded half away from zero
+ */
+static void testConversion(void)
+{
+    // 500dps and 8g (4096 LSB/g), Z up
+    const int16_t accel[3] = {80, -10, 4096 + 6};
+    const int16_t gyro[3] = {-40, 33, 0};
+    IAM20680HP_biasCalibration_t calibration;
+    char path[32];
+
+    testOpen(path, accel, gyro, 1, 2);
+
+    // Offsets of before the calibration and the reserved bit 0 of XA_OFFSET_L
+    IAM20680HP_gyroOffset_t gyroOffset = {100, 0, -7};
+    IAM20680HP_accelOffset_t accelOffset = {200, 0, -300};
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpGyroOffsetAdjustment(&gyroOffset, true));
+    uint8_t reserved[2] = {IAM20680HP_XA_OFFSET_L, 0x01};
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpBusTransmit(reserved, 2));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpAccelerometerOffset(&accelOffset, true));
+
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpCalibrateBias(&calibration, IAM20680HP_Z_UP, SAMPLES));
+    TEST_EQUAL(100 + 20, calibration.gyroOffset.offsetXGyro);
+    TEST_EQUAL(-17, calibration.gyroOffset.offsetYGyro);
+    TEST_EQUAL(-7, calibration.gyroOffset.offsetZGyro);
+    TEST_EQUAL(200 - 20, calibration.accelOffset.offsetXAccel);
+    TEST_EQUAL(3, calibration.accelOffset.offsetYAccel);
+    TEST_EQUAL(-300 - 2, calibration.accelOffset.offsetZAccel);
+
+    // The replay does not apply the offsets, the residual is the bias
+    TEST_NEAR(-40, calibration.gyroResidual[0], 0.01);
+    TEST_NEAR(6, calibration.accelResidual[2], 0.01);
+    TEST_EQUAL(0, calibration.rejectedChunks);
+
+    // Written to the registers, the reserved bit and the full-scale are kept
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpGyroOffsetAdjustment(&gyroOffset, false));
+    TEST_EQUAL(0, memcmp(&calibration.gyroOffset, &gyroOffset, sizeof(gyroOffset)));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpAccelerometerOffset(&accelOffset, false));
+    TEST_EQUAL(0, memcmp(&calibration.accelOffset, &accelOffset, sizeof(accelOffset)));
+
+    uint8_t reg = IAM20680HP_XA_OFFSET_L, value = 0;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpBusTransmit(&reg, 1));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpBusReceive(&value, 1));
+    TEST_EQUAL(0x01, value & 0x01);
+
+    IAM20680HP_gyroConfig_t gyroConfig;
+    IAM20680HP_accelConfig_t accelConfig;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpGyroConfig(&gyroConfig, false));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpAccelConfig(&accelConfig, false));
+    TEST_EQUAL(1, gyroConfig.FS_Sel);
+    TEST_EQUAL(2, accelConfig.AFS_Sel);
+
+    testClose(path);
+}
+
+static void testLimits(void)
+{
+    // 2000dps and 16g (2048 LSB/g), X down: the offsets are limited to int16 and 15 bit
+    const int16_t accel[3] = {-2048 - 2000, 0, 0};
+    const int16_t gyro[3] = {10000, -10000, 0};
+    IAM20680HP_biasCalibration_t calibration;
+    char path[32];
+
+    testOpen(path, accel, gyro, 3, 3);
+
+    IAM20680HP_gyroOffset_t gyroOffset = {-32000, 32000, 0};
+    IAM20680HP_accelOffset_t accelOffset = {16000, 0, 0};
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpGyroOffsetAdjustment(&gyroOffset, true));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpAccelerometerOffset(&accelOffset, true));
+
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpCalibrateBias(&calibration, IAM20680HP_X_DOWN, SAMPLES));
+    TEST_EQUAL(INT16_MIN, calibration.gyroOffset.offsetXGyro);
+    TEST_EQUAL(INT16_MAX, calibration.gyroOffset.offsetYGyro);
+    TEST_EQUAL(16383, calibration.accelOffset.offsetXAccel);
+
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpAccelerometerOffset(&accelOffset, false));
+    TEST_EQUAL(16383, accelOffset.offsetXAccel);
+
+    testClose(path);
+}
+
+int main(void)
+{
+    testConversion();
+    testLimits();
+    return testResult("test_offsets");
+}
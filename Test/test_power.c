@@ -0,0 +1,266 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host test of the power manager through the replay backend: state changes with hysteresis, dwell and current budget,
+the current estimate, the single write standby and wake of the gyro and the discarded settling samples.
+
+*/
+
+#include "test.h"
+#include "iam20680hp_power.h"
+#include "iam20680hp_replay.h"
+
+static uint8_t testRegister(uint8_t reg)
+{
+    uint8_t value = 0;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpBusTransmit(&reg, 1));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpBusReceive(&value, 1));
+    return value;
+}
+
+static void testConfigure(IAM20680HP_powerConfig_t *config)
+{
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpInit());
+    IAM20680HP_powerManagement_t powerManagement = {.clockSel = 1};
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerManagement(&powerManagement, true));
+
+    iam20680hpPowerDefaultConfig(config);
+    config->dec2Cfg = 2;
+    config->lowPowerRate = 9;
+}
+
+/*
+ * Registers of a state: accel cycle, gyro standby and gyro off in PWR_MGMT_1 / PWR_MGMT_2
+ */
+static void testState(IAM20680HP_powerState_t state)
+{
+    uint8_t pwrMgmt1 = testRegister(IAM20680HP_PWR_MGMT_1);
+    uint8_t pwrMgmt2 = testRegister(IAM20680HP_PWR_MGMT_2);
+
+    TEST_EQUAL(0, pwrMgmt1 & 0x40);
+    TEST_EQUAL(state == IAM20680HP_POWER_LP_ACCEL || state == IAM20680HP_POWER_WOM ? 0x20 : 0, pwrMgmt1 & 0x20);
+    TEST_EQUAL(state == IAM20680HP_POWER_GYRO_STANDBY ? 0x10 : 0, pwrMgmt1 & 0x10);
+    TEST_EQUAL(state == IAM20680HP_POWER_LP_ACCEL || state == IAM20680HP_POWER_WOM ? 0x07 : 0, pwrMgmt2 & 0x07);
+    TEST_EQUAL(0, pwrMgmt2 & 0x38);
+}
+
+/*
+ * Up at once, down one state per dwell below the threshold minus the hysteresis, wake on motion left by the interrupt
+ */
+static void testStateMachine(void)
+{
+    IAM20680HP_powerConfig_t config;
+    IAM20680HP_power_t power;
+
+    testConfigure(&config);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerInit(&power, &config, IAM20680HP_POWER_LP_ACCEL));
+    testState(IAM20680HP_POWER_LP_ACCEL);
+    TEST_EQUAL(0x20, testRegister(IAM20680HP_ACCEL_CONFIG2) & 0x30);
+    TEST_EQUAL(9, testRegister(IAM20680HP_LP_MODE_CFG) & 0x0F);
+
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerUpdate(&power, IAM20680HP_POWER_FULL_MG, 100));
+    TEST_EQUAL(IAM20680HP_POWER_FULL, power.state);
+    testState(IAM20680HP_POWER_FULL);
+    TEST_EQUAL(1, power.report.transitions);
+
+    // Within the hysteresis: no dwell
+    for (uint8_t i = 0; i < 10; i++)
+    {
+        TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerUpdate(&power, IAM20680HP_POWER_FULL_MG - IAM20680HP_POWER_HYSTERESIS_MG, 1000));
+    }
+    TEST_EQUAL(IAM20680HP_POWER_FULL, power.state);
+    TEST_EQUAL(0, power.belowMs);
+
+    // Below it: down after the dwell
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerUpdate(&power, IAM20680HP_POWER_FULL_MG - IAM20680HP_POWER_HYSTERESIS_MG - 1, 1000));
+    TEST_EQUAL(IAM20680HP_POWER_FULL, power.state);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerUpdate(&power, IAM20680HP_POWER_FULL_MG - IAM20680HP_POWER_HYSTERESIS_MG - 1, 1000));
+    TEST_EQUAL(IAM20680HP_POWER_GYRO_STANDBY, power.state);
+    testState(IAM20680HP_POWER_GYRO_STANDBY);
+
+    // An interruption of the quiet period restarts the dwell
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerUpdate(&power, 0, 1500));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerUpdate(&power, IAM20680HP_POWER_STANDBY_MG, 100));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerUpdate(&power, 0, 1500));
+    TEST_EQUAL(IAM20680HP_POWER_GYRO_STANDBY, power.state);
+
+    // Quiet: one state per dwell, not at once to wake on motion
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerUpdate(&power, 0, 500));
+    TEST_EQUAL(IAM20680HP_POWER_LP_ACCEL, power.state);
+    testState(IAM20680HP_POWER_LP_ACCEL);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerUpdate(&power, 0, 1999));
+    TEST_EQUAL(IAM20680HP_POWER_LP_ACCEL, power.state);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerUpdate(&power, 0, 1));
+    TEST_EQUAL(IAM20680HP_POWER_WOM, power.state);
+    testState(IAM20680HP_POWER_WOM);
+    TEST_EQUAL(0xE0, testRegister(IAM20680HP_INT_ENABLE) & 0xE0);
+    TEST_EQUAL(0x80, testRegister(IAM20680HP_ACCEL_INTEL_CTRL) & 0x80);
+
+    // Wake on motion: the activity is ignored, the WoM interrupt goes up
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerUpdate(&power, IAM20680HP_POWER_FULL_MG, 1000));
+    TEST_EQUAL(IAM20680HP_POWER_WOM, power.state);
+    uint8_t intStatus[2] = {IAM20680HP_INT_STATUS, 0x20};
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpBusTransmit(intStatus, 2));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerUpdate(&power, 0, 1000));
+    TEST_EQUAL(IAM20680HP_POWER_LP_ACCEL, power.state);
+    testState(IAM20680HP_POWER_LP_ACCEL);
+    TEST_EQUAL(0, testRegister(IAM20680HP_INT_ENABLE) & 0xE0);
+    TEST_EQUAL(5, power.report.transitions);
+}
+
+/*
+ * Above the budget the gyro states are left and not entered, below it full rate is allowed again
+ */
+static void testBudget(void)
+{
+    IAM20680HP_powerConfig_t config;
+    IAM20680HP_power_t power;
+
+    testConfigure(&config);
+    config.budgetUa = 1000;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerInit(&power, &config, IAM20680HP_POWER_FULL));
+
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerUpdate(&power, 500, 1000));
+    TEST_EQUAL(IAM20680HP_POWER_FULL, power.state);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerUpdate(&power, 500, 1000));
+    TEST_EQUAL(IAM20680HP_POWER_GYRO_STANDBY, power.state);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerUpdate(&power, 500, 2000));
+    TEST_EQUAL(IAM20680HP_POWER_LP_ACCEL, power.state);
+
+    // Stays in low power accel until the recent average is below the budget
+    uint32_t timeMs = 0;
+    while (power.state == IAM20680HP_POWER_LP_ACCEL && timeMs < 600000)
+    {
+        TEST_ASSERT(power.report.recentUa > config.budgetUa);
+        TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerUpdate(&power, 500, 1000));
+        timeMs += 1000;
+    }
+    TEST_EQUAL(IAM20680HP_POWER_FULL, power.state);
+    TEST_ASSERT(power.report.recentUa <= config.budgetUa);
+    TEST_ASSERT(timeMs > 10000);
+}
+
+/*
+ * Time per state, charge average and recent average
+ */
+static void testCurrent(void)
+{
+    IAM20680HP_powerConfig_t config;
+    IAM20680HP_power_t power;
+    IAM20680HP_powerReport_t report;
+
+    testConfigure(&config);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerInit(&power, &config, IAM20680HP_POWER_FULL));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerUpdate(&power, IAM20680HP_POWER_FULL_MG, 1000));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerSetState(&power, IAM20680HP_POWER_LP_ACCEL));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerUpdate(&power, IAM20680HP_POWER_QUIET_MG, 3000));
+    TEST_EQUAL(IAM20680HP_ERR_INVALID_PARAM, iam20680hpPowerSetState(&power, IAM20680HP_POWER_FULL + 1));
+
+    iam20680hpPowerGetReport(&power, &report);
+    TEST_EQUAL(1000, report.timeMs[IAM20680HP_POWER_FULL]);
+    TEST_EQUAL(3000, report.timeMs[IAM20680HP_POWER_LP_ACCEL]);
+    TEST_EQUAL(0, report.timeMs[IAM20680HP_POWER_GYRO_STANDBY]);
+    TEST_NEAR((IAM20680HP_POWER_FULL_UA * 1000.0f + IAM20680HP_POWER_LP_ACCEL_UA * 3000.0f) / 4000, report.averageUa, 0.01f);
+    float recentUa = IAM20680HP_POWER_FULL_UA + (IAM20680HP_POWER_LP_ACCEL_UA - IAM20680HP_POWER_FULL_UA) * 3000.0f / IAM20680HP_POWER_AVERAGE_MS;
+    TEST_NEAR(recentUa, report.recentUa, 0.01f);
+    TEST_EQUAL(1, report.transitions);
+}
+
+/*
+ * Standby and wake are one write each, the samples within the DLPF group delay are discarded
+ */
+static void testGyroWake(void)
+{
+    IAM20680HP_powerConfig_t config;
+    IAM20680HP_gyroWake_t wake;
+    IAM20680HP_replayStats_t before, after;
+    IAM20680HP_fifoData_t frames[5];
+
+    // 1 kHz with DLPF_CFG 1 (2.9 ms group delay): 3 samples and the one of the wake
+    testConfigure(&config);
+    uint8_t dlpf = 1;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpConfigDlpfCfg(&dlpf, true));
+    uint8_t divider = 0;
+    TEST_EQUAL(IAM20680HP_OK, iam20680SampleRateDivider(&divider, true));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpGyroWakeInit(&wake, true, true, false));
+    TEST_EQUAL(1000, wake.odrHz);
+    TEST_EQUAL(2900, wake.groupDelayUs);
+    TEST_EQUAL(4, wake.discardSamples);
+    TEST_EQUAL(0x01, testRegister(IAM20680HP_PWR_MGMT_2) & 0x07);
+
+    iam20680hpReplayGetStats(&before);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpGyroWakeStandby(&wake));
+    iam20680hpReplayGetStats(&after);
+    TEST_EQUAL(1, after.transmits - before.transmits);
+    TEST_EQUAL(0, after.receives - before.receives);
+    TEST_EQUAL(0x11, testRegister(IAM20680HP_PWR_MGMT_1));
+    TEST_ASSERT(wake.standby);
+
+    iam20680hpReplayGetStats(&before);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpGyroWake(&wake, 100000));
+    iam20680hpReplayGetStats(&after);
+    TEST_EQUAL(1, after.transmits - before.transmits);
+    TEST_EQUAL(0, after.receives - before.receives);
+    TEST_EQUAL(0x01, testRegister(IAM20680HP_PWR_MGMT_1));
+    TEST_EQUAL(0x01, testRegister(IAM20680HP_PWR_MGMT_2) & 0x07);
+
+    // 3 samples, then 5 of which the first is discarded and the others move to the start
+    for (uint8_t i = 0; i < 5; i++)
+    {
+        memset(&frames[i], 0, sizeof(frames[i]));
+        frames[i].gyroData.xGyro = i;
+    }
+    TEST_EQUAL(0, iam20680hpGyroWakeFilter(&wake, frames, 3, 102000));
+    TEST_EQUAL(4, iam20680hpGyroWakeFilter(&wake, frames, 5, 107000));
+    TEST_EQUAL(1, frames[0].gyroData.xGyro);
+    TEST_EQUAL(4, frames[3].gyroData.xGyro);
+    TEST_EQUAL(4000, wake.firstValidUs);
+    TEST_EQUAL(5, iam20680hpGyroWakeFilter(&wake, frames, 5, 112000));
+
+    // DLPF bypassed (FCHOICE_B 2): 110 us at 8 kHz
+    IAM20680HP_gyroConfig_t gyroConfig;
+    memset(&gyroConfig, 0, sizeof(gyroConfig));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpGyroConfig(&gyroConfig, false));
+    gyroConfig.FChoice = 2;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpGyroConfig(&gyroConfig, true));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpGyroWakeInit(&wake, true, true, true));
+    TEST_EQUAL(110, wake.groupDelayUs);
+    TEST_EQUAL((110 * wake.odrHz + 999999) / 1000000 + 1, wake.discardSamples);
+}
+
+int main(void)
+{
+    static const uint8_t fifo[IAM20680HP_FIFO_FRAME_SIZE];
+    char path[32];
+
+    TEST_EQUAL(0, testWriteFixture(path, fifo, sizeof(fifo)));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpReplayOpen(path, IAM20680HP_REPLAY_RAW_FIFO));
+    testStateMachine();
+    testBudget();
+    testCurrent();
+    testGyroWake();
+    iam20680hpReplayClose();
+    unlink(path);
+    return testResult("test_power");
+}
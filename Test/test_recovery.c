@@ -0,0 +1,132 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host test of the health check and the scrubber through the replay backend: a device reset is found and the whole configuration is written again.
+
+*/
+
+#include "test.h"
+#include "iam20680hp_recovery.h"
+#include "iam20680hp_replay.h"
+
+static uint8_t testRegister(uint8_t reg)
+{
+    uint8_t value = 0;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpBusTransmit(&reg, 1));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpBusReceive(&value, 1));
+    return value;
+}
+
+/*
+ * Awake device, with configuration outside the scrub ranges as well: offsets (0x13 - 0x18) and FIFO_EN (0x23)
+ */
+static void testConfigure(void)
+{
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpInit());
+    IAM20680HP_powerManagement_t powerManagement = {.clockSel = 1};
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpPowerManagement(&powerManagement, true));
+    uint8_t divider = 9;
+    TEST_EQUAL(IAM20680HP_OK, iam20680SampleRateDivider(&divider, true));
+    IAM20680HP_gyroOffset_t gyroOffset = {-100, 200, 300};
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpGyroOffsetAdjustment(&gyroOffset, true));
+    bool enable = true;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpFiFoEnable(&enable, &enable, &enable, &enable, &enable, true));
+}
+
+static void testConfigured(void)
+{
+    IAM20680HP_gyroOffset_t gyroOffset;
+
+    TEST_EQUAL(9, testRegister(IAM20680HP_SMPLRT_DIV));
+    TEST_EQUAL(0xF8, testRegister(IAM20680HP_FIFO_EN));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpGyroOffsetAdjustment(&gyroOffset, false));
+    TEST_EQUAL(-100, gyroOffset.offsetXGyro);
+    TEST_EQUAL(300, gyroOffset.offsetZGyro);
+
+    uint8_t shadow = 0;
+    TEST_ASSERT(iam20680hpShadowGet(IAM20680HP_PWR_MGMT_1, &shadow));
+    TEST_EQUAL(shadow, testRegister(IAM20680HP_PWR_MGMT_1));
+    TEST_EQUAL(0, shadow & 0x40);
+}
+
+static void testScrubber(void)
+{
+    IAM20680HP_scrubber_t scrubber;
+
+    testConfigure();
+    iam20680hpScrubberInit(&scrubber, 1000);
+
+    // Not due yet, then a scrub of a healthy device
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpScrubberUpdate(&scrubber, 500));
+    TEST_EQUAL(0, scrubber.scrubs);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpScrubberUpdate(&scrubber, 500));
+    TEST_EQUAL(1, scrubber.scrubs);
+    TEST_EQUAL(0, scrubber.mismatches);
+
+    // A reset (PWR_MGMT_1 0x41) is found by one scrub and the whole configuration is written again
+    iam20680hpReplayInjectReset();
+    TEST_EQUAL(0x41, testRegister(IAM20680HP_PWR_MGMT_1));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpScrubberUpdate(&scrubber, 1000));
+    TEST_EQUAL(2, scrubber.scrubs);
+    TEST_EQUAL(1, scrubber.resets);
+    TEST_EQUAL(0, scrubber.errors);
+    testConfigured();
+
+    // And then healthy again
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpScrub(&scrubber));
+    TEST_EQUAL(1, scrubber.resets);
+    TEST_EQUAL(0, scrubber.mismatches);
+}
+
+static void testCheck(void)
+{
+    IAM20680HP_recoveryStats_t before, after;
+    bool restored;
+
+    testConfigure();
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpRecoveryCheck(&restored));
+    TEST_EQUAL(false, restored);
+
+    iam20680hpRecoveryGetStats(&before);
+    iam20680hpReplayInjectReset();
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpRecoveryCheck(&restored));
+    TEST_EQUAL(true, restored);
+    iam20680hpRecoveryGetStats(&after);
+    TEST_EQUAL(before.restores + 1, after.restores);
+    testConfigured();
+}
+
+int main(void)
+{
+    static const uint8_t fifo[IAM20680HP_FIFO_FRAME_SIZE];
+    char path[32];
+
+    TEST_EQUAL(0, testWriteFixture(path, fifo, sizeof(fifo)));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpReplayOpen(path, IAM20680HP_REPLAY_RAW_FIFO));
+    testScrubber();
+    testCheck();
+    iam20680hpReplayClose();
+    unlink(path);
+    return testResult("test_recovery");
+}
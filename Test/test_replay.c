@@ -0,0 +1,185 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host test of the replay backend: raw FIFO dump and trace through the unchanged driver functions.
+
+*/
+
+#include "test.h"
+#include "iam20680hp_replay.h"
+
+#define FRAMES 300
+
+/*
+ * Raw FIFO frame i: accel (i, -i, 1000 + i), temperature 0 (25 degrees), gyro (2i, -2i, 7)
+ */
+static void testEncodeFrame(uint8_t *raw, int16_t i)
+{
+    const int16_t value[7] = {i, (int16_t)-i, (int16_t)(1000 + i), 0, (int16_t)(2 * i), (int16_t)(-2 * i), 7};
+    for (uint8_t j = 0; j < 7; j++)
+    {
+        raw[2 * j] = (uint8_t)((uint16_t)value[j] >> 8);
+        raw[2 * j + 1] = (uint8_t)value[j];
+    }
+}
+
+static void testCheckFrame(const IAM20680HP_fifoData_t *frame, int16_t i)
+{
+    TEST_EQUAL(i, frame->accelData.xAccel);
+    TEST_EQUAL(-i, frame->accelData.yAccel);
+    TEST_EQUAL(1000 + i, frame->accelData.zAccel);
+    TEST_EQUAL(2500, frame->temperature);
+    TEST_EQUAL(2 * i, frame->gyroData.xGyro);
+    TEST_EQUAL(-2 * i, frame->gyroData.yGyro);
+    TEST_EQUAL(7, frame->gyroData.zGyro);
+}
+
+static void testRawFifo(void)
+{
+    static uint8_t raw[FRAMES * IAM20680HP_FIFO_FRAME_SIZE];
+    char path[32];
+
+    for (int16_t i = 0; i < FRAMES; i++)
+    {
+        testEncodeFrame(&raw[i * IAM20680HP_FIFO_FRAME_SIZE], i);
+    }
+    TEST_EQUAL(0, testWriteFixture(path, raw, sizeof(raw)));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpReplayOpen(path, IAM20680HP_REPLAY_RAW_FIFO));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpInit());
+    bool enable = true;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpFiFoEnable(&enable, &enable, &enable, &enable, &enable, true));
+
+    // The FIFO count is limited to the whole frames in 512 bytes, the gap check sees no overflow or misalignment
+    IAM20680HP_fifoData_t frames[64];
+    IAM20680HP_fifoGap_t gap;
+    uint16_t framesRead;
+    int16_t next = 0;
+    uint16_t drains = 0;
+    do
+    {
+        TEST_EQUAL(IAM20680HP_OK, iam20680hpReadFifoBlockWithGap(frames, 64, &framesRead, 1000, 36, &gap));
+        TEST_ASSERT(framesRead <= 512 / IAM20680HP_FIFO_FRAME_SIZE);
+        TEST_EQUAL(0, gap.fifoBytes % IAM20680HP_FIFO_FRAME_SIZE);
+        TEST_EQUAL(false, gap.misaligned);
+        TEST_EQUAL(0, gap.lostFrames);
+        for (uint16_t i = 0; i < framesRead; i++)
+        {
+            testCheckFrame(&frames[i], next++);
+        }
+        drains++;
+    } while (framesRead > 0 && drains < 100);
+
+    TEST_EQUAL(FRAMES, next);
+    TEST_ASSERT(iam20680hpReplayFinished());
+
+    IAM20680HP_replayStats_t stats;
+    iam20680hpReplayGetStats(&stats);
+    TEST_EQUAL(sizeof(raw), stats.fifoBytes);
+    TEST_EQUAL(sizeof(raw), stats.fileSize);
+
+    iam20680hpReplayClose();
+    unlink(path);
+}
+
+static void testRegisterShadow(void)
+{
+    uint8_t raw[IAM20680HP_FIFO_FRAME_SIZE] = {0};
+    char path[32];
+
+    TEST_EQUAL(0, testWriteFixture(path, raw, sizeof(raw)));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpReplayOpen(path, IAM20680HP_REPLAY_RAW_FIFO));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpInit());
+
+    // Written registers read back, also in the driver shadow (recovery, scrubber)
+    uint8_t divider = 9;
+    TEST_EQUAL(IAM20680HP_OK, iam20680SampleRateDivider(&divider, true));
+    divider = 0;
+    TEST_EQUAL(IAM20680HP_OK, iam20680SampleRateDivider(&divider, false));
+    TEST_EQUAL(9, divider);
+
+    uint8_t shadow = 0;
+    TEST_ASSERT(iam20680hpShadowGet(IAM20680HP_SMPLRT_DIV, &shadow));
+    TEST_EQUAL(9, shadow);
+
+    iam20680hpReplayClose();
+    unlink(path);
+}
+
+/*
+ * Appends a trace record
+ */
+static size_t testTraceRecord(uint8_t *trace, size_t position, uint8_t type, uint8_t reg, const uint8_t *payload, uint16_t length)
+{
+    trace[position] = type;
+    trace[position + 1] = reg;
+    trace[position + 2] = (uint8_t)length;
+    trace[position + 3] = (uint8_t)(length >> 8);
+    memcpy(&trace[position + 4], payload, length);
+    return position + 4 + length;
+}
+
+static void testTrace(void)
+{
+    uint8_t trace[128];
+    uint8_t frames[2 * IAM20680HP_FIFO_FRAME_SIZE];
+    const uint8_t count[2] = {0, sizeof(frames)};
+    char path[32];
+
+    testEncodeFrame(&frames[0], 40);
+    testEncodeFrame(&frames[IAM20680HP_FIFO_FRAME_SIZE], 41);
+    memcpy(trace, IAM20680HP_REPLAY_TRACE_MAGIC, 4);
+    size_t size = testTraceRecord(trace, 4, IAM20680HP_REPLAY_TRACE_READ, IAM20680HP_FIFO_COUNTH, count, sizeof(count));
+    size = testTraceRecord(trace, size, IAM20680HP_REPLAY_TRACE_READ, IAM20680HP_FIFO_R_W, frames, sizeof(frames));
+
+    TEST_EQUAL(0, testWriteFixture(path, trace, size));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpReplayOpen(path, IAM20680HP_REPLAY_TRACE));
+
+    IAM20680HP_fifoData_t decoded[4];
+    uint16_t framesRead = 0;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpReadFifoBlock(decoded, 4, &framesRead));
+    TEST_EQUAL(2, framesRead);
+    testCheckFrame(&decoded[0], 40);
+    testCheckFrame(&decoded[1], 41);
+    TEST_ASSERT(iam20680hpReplayFinished());
+
+    // After the recording the FIFO is empty
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpReadFifoBlock(decoded, 4, &framesRead));
+    TEST_EQUAL(0, framesRead);
+    iam20680hpReplayClose();
+    unlink(path);
+
+    // A trace needs the magic
+    TEST_EQUAL(0, testWriteFixture(path, frames, sizeof(frames)));
+    TEST_EQUAL(IAM20680HP_ERR_INVALID_PARAM, iam20680hpReplayOpen(path, IAM20680HP_REPLAY_TRACE));
+    unlink(path);
+    TEST_EQUAL(IAM20680HP_ERR_DEVICE_NOT_FOUND, iam20680hpReplayOpen(path, IAM20680HP_REPLAY_RAW_FIFO));
+}
+
+int main(void)
+{
+    testRawFifo();
+    testRegisterShadow();
+    testTrace();
+    return testResult("test_replay");
+}
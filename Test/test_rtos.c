@@ -0,0 +1,136 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host test of the RTOS layer with POSIX threads (IAM20680HP_RTOS 2): the sensor task drains a replayed FIFO into the block pool while the main thread uses the driver under the lock.
+
+*/
+
+#include "test.h"
+#include "iam20680hp_rtos.h"
+#include "iam20680hp_replay.h"
+
+#define FRAMES 2000
+#define ADDRESS 0x68
+
+/*
+ * Raw FIFO frame i: accel X = i, gyro X = -i, the rest 0
+ */
+static void testCapture(uint8_t *raw)
+{
+    memset(raw, 0, FRAMES * IAM20680HP_FIFO_FRAME_SIZE);
+    for (uint16_t i = 0; i < FRAMES; i++)
+    {
+        uint8_t *frame = &raw[i * IAM20680HP_FIFO_FRAME_SIZE];
+        frame[0] = (uint8_t)(i >> 8);
+        frame[1] = (uint8_t)i;
+        frame[8] = (uint8_t)((uint16_t)-i >> 8);
+        frame[9] = (uint8_t)(uint16_t)-i;
+    }
+}
+
+static void testSensorTask(void)
+{
+    static uint8_t raw[FRAMES * IAM20680HP_FIFO_FRAME_SIZE];
+    static IAM20680HP_rtos_t rtos;
+    char path[32];
+
+    testCapture(raw);
+    TEST_EQUAL(0, testWriteFixture(path, raw, sizeof(raw)));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpReplayOpen(path, IAM20680HP_REPLAY_RAW_FIFO));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpRtosInit());
+
+    iam20680hpRtosLock(ADDRESS);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpInit());
+    bool enable = true;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpFiFoEnable(&enable, &enable, &enable, &enable, &enable, true));
+    iam20680hpRtosUnlock(ADDRESS);
+
+    // A 2 kByte FiFo fills 73 frames by the target, more than a block
+    IAM20680HP_accelConfig_t accelConfig;
+    iam20680hpRtosLock(ADDRESS);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpAccelConfig(&accelConfig, false));
+    accelConfig.fifoSize = 2;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpAccelConfig(&accelConfig, true));
+    iam20680hpRtosUnlock(ADDRESS);
+    TEST_EQUAL(IAM20680HP_ERR_INVALID_PARAM, iam20680hpRtosStart(&rtos, ADDRESS));
+
+    iam20680hpRtosLock(ADDRESS);
+    accelConfig.fifoSize = 0;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpAccelConfig(&accelConfig, true));
+    iam20680hpRtosUnlock(ADDRESS);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpRtosStart(&rtos, ADDRESS));
+
+    // The sensor task waits for the lock: no drain while this thread holds it
+    iam20680hpRtosLock(ADDRESS);
+    iam20680hpRtosNotifyFromIsr(&rtos);
+    TEST_ASSERT(iam20680hpRtosReceive(&rtos, 50) == NULL);
+    TEST_EQUAL(0, rtos.drains);
+    iam20680hpRtosUnlock(ADDRESS);
+
+    // Every frame once and in order, with driver calls of this thread during the drains
+    uint32_t received = 0, blocks = 0, wrongFrames = 0, idErrors = 0;
+    while (received < FRAMES)
+    {
+        iam20680hpRtosNotifyFromIsr(&rtos);
+        for (uint8_t i = 0; i < 50; i++)
+        {
+            iam20680hpRtosLock(ADDRESS);
+            idErrors += iam20680hpCheckDeviceID() != IAM20680HP_OK;
+            iam20680hpRtosUnlock(ADDRESS);
+        }
+
+        IAM20680HP_rtosBlock_t *block = iam20680hpRtosReceive(&rtos, 1000);
+        if (block == NULL)
+        {
+            break;
+        }
+        TEST_ASSERT(block->count > 0 && block->count <= IAM20680HP_RTOS_BLOCK_FRAMES);
+        for (uint16_t i = 0; i < block->count; i++, received++)
+        {
+            wrongFrames += block->frames[i].accelData.xAccel != (int16_t)received || block->frames[i].gyroData.xGyro != (int16_t)-received;
+        }
+        blocks++;
+        iam20680hpRtosRelease(&rtos, block);
+    }
+
+    iam20680hpRtosStop(&rtos);
+    printf("rtos: %u frames in %u blocks, %u drains (%u notified)\n", (unsigned)received, (unsigned)blocks, (unsigned)rtos.drains,
+           (unsigned)rtos.notifications);
+
+    TEST_EQUAL(FRAMES, received);
+    TEST_EQUAL(0, wrongFrames);
+    TEST_EQUAL(0, idErrors);
+    TEST_EQUAL(0, rtos.errors);
+    TEST_ASSERT(rtos.notifications > 0);
+    TEST_ASSERT(iam20680hpReplayFinished());
+
+    iam20680hpReplayClose();
+    unlink(path);
+}
+
+int main(void)
+{
+    testSensorTask();
+    return testResult("test_rtos");
+}
@@ -0,0 +1,207 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host test of the streaming statistics: tumbling and sliding windows against a double reference, EWMA convergence.
+
+*/
+
+#include "test.h"
+#include "iam20680hp_stats.h"
+
+#include <math.h>
+
+#define SAMPLES 3700
+#define BLOCK 37
+
+static int16_t samples[SAMPLES];
+static IAM20680HP_statsResult_t windows[4];
+static uint8_t windowCount;
+
+static void testOutput(const IAM20680HP_statsResult_t *result, void *context)
+{
+    (void)context;
+    if (windowCount < 4)
+    {
+        windows[windowCount] = *result;
+    }
+    windowCount++;
+}
+
+/*
+ * Mean and variance of samples[first, first + count) in double
+ */
+static void testReference(uint32_t first, uint32_t count, double *mean, double *variance)
+{
+    double sum = 0, sumSquares = 0;
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        sum += samples[i];
+        sumSquares += (double)samples[i] * samples[i];
+    }
+    *mean = sum / count;
+    *variance = sumSquares / count - *mean * *mean;
+}
+
+/*
+ * Feeds all samples in blocks of 37 frames (windows do not align with the blocks): X = sample, Y = -sample, Z = 0
+ */
+static void testFeed(IAM20680HP_stats_t *stats)
+{
+    static IAM20680HP_fifoData_t frames[BLOCK];
+
+    for (uint32_t start = 0; start < SAMPLES; start += BLOCK)
+    {
+        for (uint16_t i = 0; i < BLOCK; i++)
+        {
+            frames[i].accelData.xAccel = samples[start + i];
+            frames[i].accelData.yAccel = (int16_t)-samples[start + i];
+            frames[i].accelData.zAccel = 0;
+        }
+        iam20680hpStatsUpdateFrames(stats, frames, BLOCK, false);
+    }
+}
+
+static void testInit(void)
+{
+    IAM20680HP_stats_t stats;
+    IAM20680HP_statsResult_t result;
+
+    TEST_EQUAL(IAM20680HP_ERR_INVALID_PARAM, iam20680hpStatsInit(&stats, IAM20680HP_STATS_TUMBLING, 0, NULL, NULL));
+    TEST_EQUAL(IAM20680HP_ERR_INVALID_PARAM, iam20680hpStatsInit(&stats, IAM20680HP_STATS_TUMBLING, IAM20680HP_STATS_MAX_LENGTH + 1, NULL, NULL));
+    TEST_EQUAL(IAM20680HP_ERR_INVALID_PARAM, iam20680hpStatsInit(&stats, IAM20680HP_STATS_SLIDING, IAM20680HP_STATS_SLOTS * 10 + 1, NULL, NULL));
+    TEST_EQUAL(IAM20680HP_ERR_INVALID_PARAM, iam20680hpStatsInit(&stats, IAM20680HP_STATS_EWMA, 17, NULL, NULL));
+
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpStatsInit(&stats, IAM20680HP_STATS_TUMBLING, 100, NULL, NULL));
+    TEST_EQUAL(IAM20680HP_ERR_NOT_READY, iam20680hpStatsResult(&stats, &result));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpStatsInit(&stats, IAM20680HP_STATS_SLIDING, 800, NULL, NULL));
+    TEST_EQUAL(IAM20680HP_ERR_NOT_READY, iam20680hpStatsResult(&stats, &result));
+}
+
+static void testTumbling(void)
+{
+    IAM20680HP_stats_t stats;
+    IAM20680HP_statsResult_t result;
+    double mean, variance;
+
+    windowCount = 0;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpStatsInit(&stats, IAM20680HP_STATS_TUMBLING, 1000, testOutput, NULL));
+    testFeed(&stats);
+    TEST_EQUAL(3, windowCount);
+
+    for (uint8_t window = 0; window < 3; window++)
+    {
+        testReference(window * 1000, 1000, &mean, &variance);
+        TEST_EQUAL(1000, windows[window].count);
+        TEST_NEAR(mean, windows[window].mean[0], 0.01);
+        TEST_NEAR(-mean, windows[window].mean[1], 0.01);
+        TEST_NEAR(variance, windows[window].variance[0], variance * 1e-5);
+        TEST_NEAR(variance, windows[window].variance[1], variance * 1e-5);
+        TEST_NEAR(sqrt(variance + mean * mean), windows[window].rms[0], 0.01);
+        TEST_EQUAL(0, windows[window].variance[2]);
+    }
+
+    // The result is the last complete window
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpStatsResult(&stats, &result));
+    TEST_EQUAL(0, memcmp(&windows[2], &result, sizeof(result)));
+
+    int16_t minimum = INT16_MAX, maximum = INT16_MIN;
+    for (uint32_t i = 2000; i < 3000; i++)
+    {
+        minimum = samples[i] < minimum ? samples[i] : minimum;
+        maximum = samples[i] > maximum ? samples[i] : maximum;
+    }
+    TEST_EQUAL(minimum, result.minimum[0]);
+    TEST_EQUAL(maximum, result.maximum[0]);
+    TEST_EQUAL(-maximum, result.minimum[1]);
+}
+
+static void testSliding(void)
+{
+    IAM20680HP_stats_t stats;
+    IAM20680HP_statsResult_t result;
+    double mean, variance;
+
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpStatsInit(&stats, IAM20680HP_STATS_SLIDING, 800, NULL, NULL));
+    testFeed(&stats);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpStatsResult(&stats, &result));
+
+    // Between (SLOTS - 1) and SLOTS slots of the most recent samples
+    TEST_ASSERT(result.count >= 700 && result.count <= 800);
+    testReference(SAMPLES - result.count, result.count, &mean, &variance);
+    TEST_NEAR(mean, result.mean[0], 0.01);
+    TEST_NEAR(variance, result.variance[0], variance * 1e-5);
+    TEST_NEAR(-mean, result.mean[1], 0.01);
+
+    iam20680hpStatsReset(&stats);
+    TEST_EQUAL(IAM20680HP_ERR_NOT_READY, iam20680hpStatsResult(&stats, &result));
+}
+
+static void testEwma(void)
+{
+    IAM20680HP_stats_t stats;
+    IAM20680HP_statsResult_t result;
+    static IAM20680HP_fifoData_t frames[BLOCK];
+
+    // A constant input converges to its value without variance
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpStatsInit(&stats, IAM20680HP_STATS_EWMA, 4, NULL, NULL));
+    for (uint16_t i = 0; i < BLOCK; i++)
+    {
+        frames[i].accelData.xAccel = -8192;
+        frames[i].accelData.yAccel = 0;
+        frames[i].accelData.zAccel = 16384;
+    }
+    for (uint8_t block = 0; block < 20; block++)
+    {
+        iam20680hpStatsUpdateFrames(&stats, frames, BLOCK, false);
+    }
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpStatsResult(&stats, &result));
+    TEST_NEAR(-8192, result.mean[0], 0.5);
+    TEST_NEAR(16384, result.mean[2], 0.5);
+    TEST_NEAR(0, result.variance[0], 0.5);
+    TEST_NEAR(16384, result.rms[2], 0.5);
+
+    // Uniform noise of +-1000 LSB: variance 1000^2 / 3 within the EWMA spread (shift 6, about 127 samples)
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpStatsInit(&stats, IAM20680HP_STATS_EWMA, 6, NULL, NULL));
+    testFeed(&stats);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpStatsResult(&stats, &result));
+    TEST_NEAR(16000, result.mean[0], 200);
+    TEST_NEAR(1000.0 * 1000.0 / 3, result.variance[0], 1000.0 * 1000.0 / 3 * 0.3);
+}
+
+int main(void)
+{
+    // Uniform noise of +-1000 LSB around 1g at 2g full-scale (fixed seed)
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < SAMPLES; i++)
+    {
+        seed = seed * 1664525 + 1013904223;
+        samples[i] = (int16_t)(16000 + (int32_t)((seed >> 16) % 2001) - 1000);
+    }
+
+    testInit();
+    testTumbling();
+    testSliding();
+    testEwma();
+    return testResult("test_stats");
+}
@@ -0,0 +1,190 @@
+/*
+
+MIT License
+
+Copyright (c) 2024 Rémy Hurx
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host test of the vibration analysis through the replay backend: a synthetic 125Hz tone gives the expected RMS, spectral
+peak and band RMS, and the configuration of before (with USER_CTRL FIFO_EN) is restored by a stop and after a failed start.
+
+*/
+
+#include "test.h"
+#include "iam20680hp_vibration.h"
+#include "iam20680hp_replay.h"
+
+#include <math.h>
+
+#define AVERAGES 8
+#define SAMPLES ((AVERAGES + 1) * IAM20680HP_VIBRATION_FFT_SIZE / 2)
+
+static const uint8_t settingRegisters[] = {IAM20680HP_SMPLRT_DIV, IAM20680HP_CONFIG, IAM20680HP_GYRO_CONFIG, IAM20680HP_ACCEL_CONFIG,
+                                           IAM20680HP_ACCEL_CONFIG2, IAM20680HP_FIFO_EN, IAM20680HP_USER_CTRL};
+
+static IAM20680HP_vibration_t vibration;
+static IAM20680HP_vibrationFeatures_t features;
+static uint8_t outputs;
+
+static void testOutput(const IAM20680HP_vibrationFeatures_t *result, void *context)
+{
+    (void)context;
+    features = *result;
+    outputs++;
+}
+
+static uint8_t testRegister(uint8_t reg)
+{
+    uint8_t value = 0;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpBusTransmit(&reg, 1));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpBusReceive(&value, 1));
+    return value;
+}
+
+/*
+ * Device after init, accel and gyro in the FiFo, FIFO_EN in USER_CTRL off
+ */
+static void testConfigure(uint8_t *settings)
+{
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpInit());
+    uint8_t divider = 9;
+    TEST_EQUAL(IAM20680HP_OK, iam20680SampleRateDivider(&divider, true));
+    bool enable = true;
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpFiFoEnable(&enable, &enable, &enable, &enable, &enable, true));
+
+    for (uint8_t i = 0; i < sizeof(settingRegisters); i++)
+    {
+        settings[i] = testRegister(settingRegisters[i]);
+    }
+}
+
+static void testSettings(const uint8_t *settings)
+{
+    for (uint8_t i = 0; i < sizeof(settingRegisters); i++)
+    {
+        TEST_EQUAL(settings[i], testRegister(settingRegisters[i]));
+    }
+}
+
+/*
+ * 125Hz at 1kHz is bin 32 of 256. The Hann window puts 5/6 of the power in bins 31 and 32 (band 1) and 1/6 in bin 33 
+ * (band 2)
+ */
+static void testTone(void)
+{
+    uint8_t settings[sizeof(settingRegisters)];
+
+    testConfigure(settings);
+    TEST_EQUAL(IAM20680HP_ERR_INVALID_PARAM, iam20680hpVibrationStart(&vibration, 2, AVERAGES, testOutput, NULL));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpVibrationStart(&vibration, IAM20680HP_VIBRATION_1KHZ, AVERAGES, testOutput, NULL));
+    TEST_EQUAL(0, testRegister(IAM20680HP_SMPLRT_DIV));
+    TEST_EQUAL(0x08, testRegister(IAM20680HP_FIFO_EN));
+    TEST_EQUAL(0x40, testRegister(IAM20680HP_USER_CTRL) & 0x40);
+
+    outputs = 0;
+    while (!iam20680hpReplayFinished())
+    {
+        TEST_EQUAL(IAM20680HP_OK, iam20680hpVibrationDrain(&vibration));
+    }
+    TEST_EQUAL(1, outputs);
+    TEST_EQUAL(1000, features.sampleRate);
+    TEST_EQUAL(AVERAGES, features.windows);
+    TEST_EQUAL(0, features.lostSamples);
+
+    // X: 2000 LSB, Y: 1000 LSB around -500, Z: 1g without vibration
+    const float amplitude[3] = {2000, 1000, 0};
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+        float rms = amplitude[axis] / sqrtf(2.0f);
+        TEST_NEAR(rms, features.rms[axis], 1.0);
+        TEST_NEAR(amplitude[axis], features.peak[axis], 1.0);
+        if (amplitude[axis] == 0)
+        {
+            TEST_EQUAL(0, features.crestFactor[axis]);
+            TEST_NEAR(0, features.peakAmplitude[axis][0], 1e-3);
+            continue;
+        }
+        TEST_NEAR(sqrtf(2.0f), features.crestFactor[axis], 0.01);
+        TEST_NEAR(125.0, features.peakFrequency[axis][0], 1e-3);
+        TEST_NEAR(amplitude[axis], features.peakAmplitude[axis][0], amplitude[axis] * 0.01);
+        TEST_NEAR(0, features.peakAmplitude[axis][1], amplitude[axis] * 0.01);
+
+        TEST_NEAR(rms * sqrtf(5.0f / 6.0f), features.bandRms[axis][1], rms * 0.01);
+        TEST_NEAR(rms * sqrtf(1.0f / 6.0f), features.bandRms[axis][2], rms * 0.01);
+        for (uint8_t band = 0; band < IAM20680HP_VIBRATION_BANDS; band++)
+        {
+            if (band != 1 && band != 2)
+            {
+                TEST_NEAR(0, features.bandRms[axis][band], rms * 0.01);
+            }
+        }
+    }
+
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpVibrationStop(&vibration));
+    testSettings(settings);
+}
+
+static void testFailedStart(void)
+{
+    uint8_t settings[sizeof(settingRegisters)];
+    IAM20680HP_err_t result;
+    uint32_t transfer = 0;
+
+    // Every bus call of the start fails once in turn: the configuration of before is kept
+    do
+    {
+        testConfigure(settings);
+        iam20680hpReplayInjectError(++transfer);
+        result = iam20680hpVibrationStart(&vibration, IAM20680HP_VIBRATION_4KHZ, AVERAGES, testOutput, NULL);
+        iam20680hpReplayInjectError(0);
+        if (result != IAM20680HP_OK)
+        {
+            TEST_EQUAL(IAM20680HP_ERR_I2C, result);
+            testSettings(settings);
+        }
+    } while (result != IAM20680HP_OK && transfer < 100);
+    TEST_ASSERT(transfer > 12);
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpVibrationStop(&vibration));
+    testSettings(settings);
+}
+
+int main(void)
+{
+    static uint8_t raw[SAMPLES * IAM20680HP_FIFO_ACCEL_FRAME_SIZE];
+    char path[32];
+
+    for (uint32_t i = 0; i < SAMPLES; i++)
+    {
+        double tone = sin(2 * M_PI * 125 * i / 1000.0);
+        const int16_t value[3] = {(int16_t)lround(2000 * tone), (int16_t)lround(1000 * tone - 500), 16384};
+        for (uint8_t j = 0; j < 3; j++)
+        {
+            raw[i * IAM20680HP_FIFO_ACCEL_FRAME_SIZE + 2 * j] = (uint8_t)((uint16_t)value[j] >> 8);
+            raw[i * IAM20680HP_FIFO_ACCEL_FRAME_SIZE + 2 * j + 1] = (uint8_t)value[j];
+        }
+    }
+    TEST_EQUAL(0, testWriteFixture(path, raw, sizeof(raw)));
+    TEST_EQUAL(IAM20680HP_OK, iam20680hpReplayOpen(path, IAM20680HP_REPLAY_RAW_FIFO));
+    testTone();
+    testFailedStart();
+    iam20680hpReplayClose();
+    unlink(path);
+    return testResult("test_vibration");
+}